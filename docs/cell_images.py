@@ -110,6 +110,18 @@ def remove_image():
     return cell
 
 
+def fill_image():
+    fill_cell = gdstk.Cell("FILL")
+    fill_cell.add(gdstk.rectangle((0, 0), (1, 1), layer=2))
+    chip = gdstk.Cell("CHIP")
+    chip.add(gdstk.rectangle((0, 0), (40, 40), layer=10))
+    chip.add(gdstk.ellipse((20, 20), 8, layer=1))
+    fill = chip.fill(fill_cell, 2, exclusions={(1, 0): 1})
+    chip.add(*fill)
+    chip.name = "fill"
+    return chip
+
+
 if __name__ == "__main__":
     path = pathlib.Path(__file__).parent.absolute() / "cell"
     path.mkdir(parents=True, exist_ok=True)
@@ -118,4 +130,5 @@ if __name__ == "__main__":
     draw(convex_hull_image(), path)
     draw(flatten_image(), path)
     draw(write_svg_image(), path)
+    draw(fill_image(), path)
     draw(remove_image(), path)
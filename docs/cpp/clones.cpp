@@ -0,0 +1,157 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <gdstk/gdstk.hpp>
+
+using namespace gdstk;
+
+static void check(bool condition, const char* message) {
+    if (!condition) {
+        fprintf(stderr, "Check failed: %s\n", message);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static Polygon* new_rectangle(double x, double y, Tag tag) {
+    Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
+    *poly = rectangle(Vec2{x, y}, Vec2{x + 1, y + 1}, tag);
+    return poly;
+}
+
+static Library* build_library() {
+    Library* lib = (Library*)allocate_clear(sizeof(Library));
+    lib->name = copy_string("library", NULL);
+    lib->unit = 1e-6;
+    lib->precision = 1e-9;
+
+    Cell* child = (Cell*)allocate_clear(sizeof(Cell));
+    child->name = copy_string("Child", NULL);
+    child->polygon_array.append(new_rectangle(0, 0, make_tag(1, 0)));
+    lib->cell_array.append(child);
+
+    Cell* top = (Cell*)allocate_clear(sizeof(Cell));
+    top->name = copy_string("Top", NULL);
+    top->polygon_array.append(new_rectangle(0, 0, make_tag(0, 0)));
+    FlexPath* path = (FlexPath*)allocate_clear(sizeof(FlexPath));
+    path->init(Vec2{0, 0}, 0.5, 0, 0.01, make_tag(3, 0));
+    path->segment(Vec2{4, 0}, NULL, NULL, false);
+    top->flexpath_array.append(path);
+    Reference* ref = (Reference*)allocate_clear(sizeof(Reference));
+    ref->init(child);
+    top->reference_array.append(ref);
+    ref = (Reference*)allocate_clear(sizeof(Reference));
+    ref->init("Child");
+    top->reference_array.append(ref);
+    Label* label = (Label*)allocate_clear(sizeof(Label));
+    label->init("Label");
+    top->label_array.append(label);
+    lib->cell_array.append(top);
+    return lib;
+}
+
+static void free_library(Library* lib) {
+    lib->free_all();
+    free_allocation(lib);
+}
+
+int main(int argc, char* argv[]) {
+    // Free the source, the clone and the clone of the clone in every order
+    const int orders[][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+    for (uint64_t n = 0; n < COUNT(orders); n++) {
+        Library* libs[3] = {build_library()};
+
+        libs[1] = (Library*)allocate_clear(sizeof(Library));
+        libs[1]->clone_from(*libs[0]);
+        Cell* source = libs[0]->get_cell("Top");
+        Cell* clone = libs[1]->get_cell("Top");
+        check(clone->reference_array[0]->cell == libs[1]->get_cell("Child"),
+              "clone references the cloned child");
+        check(source->reference_array[0]->cell == libs[0]->get_cell("Child"),
+              "source references the source child");
+
+        // The source cell is not changed by cloning: its elements can be
+        // modified in place without affecting the clone
+        source->polygon_array[0]->translate(Vec2{0, 20});
+        source->polygon_array[0]->scale(Vec2{2, 2}, Vec2{0, 0});
+        source->flexpath_array[0]->segment(Vec2{4, 4}, NULL, NULL, false);
+        source->label_array[0]->origin = Vec2{-1, -1};
+        check(clone->polygon_array[0]->point_array[0].y == 0, "clone polygon not translated");
+        check(clone->polygon_array[0]->point_array[2].x == 1, "clone polygon not scaled");
+        check(clone->flexpath_array[0]->spine.point_array.count == 2, "clone path unchanged");
+        check(clone->label_array[0]->origin.x == 0, "clone label unchanged");
+        source->polygon_array[0]->scale(Vec2{0.5, 0.5}, Vec2{0, 0});
+        source->polygon_array[0]->translate(Vec2{0, -10});
+        source->label_array[0]->origin = Vec2{0, 0};
+
+        // The arrays of the source cell can be modified directly
+        for (uint64_t i = 0; i < 100; i++) {
+            source->polygon_array.append(new_rectangle(2.0 * i, 2, make_tag(0, 0)));
+        }
+        check(source->polygon_array.count == 101, "source polygons appended");
+        check(clone->polygon_array.count == 1, "clone polygons unchanged");
+
+        // Shared elements are replaced by private copies before modification
+        clone->writable_polygon(0)->translate(Vec2{10, 0});
+        clone->writable_polygon_array().append(new_rectangle(0, 4, make_tag(2, 0)));
+        clone->writable_label(0)->origin = Vec2{5, 5};
+        check(source->polygon_array[0]->point_array[0].x == 0, "source polygon unchanged");
+        check(clone->polygon_array[0]->point_array[0].x == 10, "clone polygon translated");
+        check(source->label_array[0]->origin.x == 0, "source label unchanged");
+
+        libs[2] = (Library*)allocate_clear(sizeof(Library));
+        libs[2]->clone_from(*libs[1]);
+        Cell* second = libs[2]->get_cell("Top");
+        check(second->polygon_array.count == 2, "clone of clone polygons");
+        check(second->polygon_array[0]->point_array[0].x == 10, "clone of clone polygon");
+        check(second->label_array[0]->origin.x == 5, "clone of clone label");
+        check(second->reference_array[0]->cell == libs[2]->get_cell("Child"),
+              "clone of clone references its child");
+
+        // Library mutators only update private references
+        libs[1]->rename_cell("Child", "Renamed");
+        check(strcmp(clone->reference_array[0]->cell->name, "Renamed") == 0,
+              "clone reference renamed");
+        check(strcmp(clone->reference_array[1]->name, "Renamed") == 0,
+              "clone reference by name renamed");
+        check(strcmp(second->reference_array[1]->name, "Child") == 0,
+              "clone of clone reference unchanged");
+        check(strcmp(source->reference_array[1]->name, "Child") == 0,
+              "source reference unchanged");
+
+        second->writable_polygon_array().remove(1);
+        check(clone->polygon_array.count == 2, "clone unchanged by clone of clone");
+
+        // Cloning an unmodified clone shares its storage
+        Cell* third = (Cell*)allocate_clear(sizeof(Cell));
+        third->clone_from(*libs[0]->get_cell("Child"), NULL);
+        Cell* fourth = (Cell*)allocate_clear(sizeof(Cell));
+        fourth->clone_from(*third, NULL);
+        check(third->storage == fourth->storage, "unmodified clone storage shared");
+        check(fourth->polygon_array[0] == third->polygon_array[0], "clone elements shared");
+        third->free_all();
+        free_allocation(third);
+
+        // Library-wide mutators do not change other libraries
+        libs[1]->rescale(libs[1]->unit / 10);
+        check(clone->polygon_array[0]->point_array[0].x == 100, "clone rescaled");
+        check(source->polygon_array[0]->point_array[0].x == 0, "source not rescaled");
+        check(second->polygon_array[0]->point_array[0].x == 10, "clone of clone not rescaled");
+        check(fourth->polygon_array[0]->point_array[2].x == 1, "other clone not rescaled");
+        libs[0]->rescale(libs[0]->unit / 10);
+        check(source->polygon_array[0]->point_array[0].y == 100, "source rescaled");
+        check(second->polygon_array[0]->point_array[0].y == 0, "clone of clone unchanged");
+        check(fourth->polygon_array[0]->point_array[2].x == 1, "other clone unchanged");
+        fourth->free_all();
+        free_allocation(fourth);
+
+        for (uint64_t i = 0; i < 3; i++) free_library(libs[orders[n][i]]);
+    }
+    return 0;
+}
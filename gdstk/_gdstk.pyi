@@ -24,10 +24,25 @@ class Cell:
     polygons: list[Polygon]
     properties: list[list[str | bytes | float]]
     references: list[Reference]
+    tag_buckets: bool
     def __init__(self, name: str) -> None: ...
     def add(self, *elements: Polygon | FlexPath | RobustPath | Label | Reference) -> Self: ...
     def area(self, by_spec: bool = False) -> float | dict[tuple[int, int], float]: ...
     def bounding_box(self) -> Optional[tuple[tuple[float, float], tuple[float, float]]]: ...
+    def check_polygons(
+        self, repair: bool = False, precision: float = 1e-3
+    ) -> list[set[str]]: ...
+    def check_rules(
+        self,
+        rules: Sequence[
+            tuple[str, tuple[int, int], float]
+            | tuple[str, tuple[int, int], tuple[int, int], float]
+        ],
+        precision: float = 1e-3,
+    ) -> list[list[Polygon]]: ...
+    def content_hash(
+        self, precision: float = 1e-3, translation_invariant: bool = False
+    ) -> int: ...
     def convex_hull(self) -> numpy.ndarray[Any, numpy.dtype[numpy.float64]]: ...
     def copy(
         self,
@@ -39,7 +54,20 @@ class Cell:
         deep_copy: bool = True,
     ) -> Cell: ...
     def delete_property(self, name: str) -> Self: ...
+    def density_map(
+        self,
+        window_size: float | tuple[float, float],
+        window: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        tags: Optional[Iterable[tuple[int, int]]] = None,
+        precision: float = 1e-3,
+    ) -> dict[tuple[int, int], numpy.ndarray[Any, numpy.dtype[numpy.float64]]]: ...
     def dependencies(self, recursive: bool = True) -> Sequence[Cell | RawCell]: ...
+    def diff(
+        self,
+        other: Cell,
+        precision: float = 1e-3,
+        tile_size: Optional[float] = None,
+    ) -> list[tuple[Cell, Cell, dict[tuple[int, int], list[Polygon]]]]: ...
     def filter(
         self,
         spec: Iterable[tuple[int, int]],
@@ -48,6 +76,26 @@ class Cell:
         paths: bool = True,
         labels: bool = True,
     ) -> Self: ...
+    def extract_nets(
+        self,
+        conductors: Iterable[tuple[int, int]],
+        vias: Optional[dict[tuple[int, int], tuple[tuple[int, int], tuple[int, int]]]] = None,
+        labels: Optional[dict[tuple[int, int], tuple[int, int]]] = None,
+        window: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        precision: float = 1e-3,
+    ) -> list[tuple[list[str], list[Polygon]]]: ...
+    def fill(
+        self,
+        element: Cell | Polygon,
+        pitch: float | tuple[float, float],
+        window: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        exclusions: Optional[
+            dict[tuple[int, int], float] | Iterable[tuple[int, int]]
+        ] = None,
+        density: float = 0,
+        tile_size: Optional[float | tuple[float, float]] = None,
+        precision: float = 1e-3,
+    ) -> list[Reference] | list[Polygon]: ...
     def flatten(self, apply_repetitions: bool = True) -> Self: ...
     def get_labels(
         self,
@@ -55,14 +103,16 @@ class Cell:
         depth: Optional[int] = None,
         layer: Optional[int] = None,
         texttype: Optional[int] = None,
-    ) -> list[Label]: ...
+        tags: Optional[Sequence[tuple[int, int]]] = None,
+    ) -> list[Label] | dict[tuple[int, int], list[Label]]: ...
     def get_paths(
         self,
         apply_repetitions: bool = True,
         depth: Optional[int] = None,
         layer: Optional[int] = None,
         datatype: Optional[int] = None,
-    ) -> list[RobustPath | FlexPath]: ...
+        tags: Optional[Sequence[tuple[int, int]]] = None,
+    ) -> list[RobustPath | FlexPath] | dict[tuple[int, int], list[RobustPath | FlexPath]]: ...
     def get_polygons(
         self,
         apply_repetitions: bool = True,
@@ -70,12 +120,39 @@ class Cell:
         depth: Optional[int] = None,
         layer: Optional[int] = None,
         datatype: Optional[int] = None,
-    ) -> list[Polygon]: ...
+        tags: Optional[Sequence[tuple[int, int]]] = None,
+    ) -> list[Polygon] | dict[tuple[int, int], list[Polygon]]: ...
     def get_property(self, name: str) -> Optional[list[list[str | bytes | float]]]: ...
+    def group_repetitions(self, precision: float = 1e-3) -> Self: ...
+    def rasterize(
+        self,
+        width: int,
+        height: Optional[int] = None,
+        window: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        tags: Optional[Iterable[tuple[int, int]]] = None,
+    ) -> dict[tuple[int, int], numpy.ndarray[Any, numpy.dtype[numpy.uint8]]]: ...
     def remove(self, *elements: Label | Polygon | RobustPath | FlexPath | Reference) -> Self: ...
+    def render(
+        self,
+        width: int,
+        height: Optional[int] = None,
+        window: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        colors: Optional[dict[tuple[int, int], str]] = None,
+        background: str = "#222222",
+    ) -> numpy.ndarray[Any, numpy.dtype[numpy.uint8]]: ...
     def set_property(
         self, name: str, value: str | bytes | float | Sequence[str | bytes | float]
     ) -> Self: ...
+    def statistics(self, include_paths: bool = True) -> dict[Cell, dict[str, Any]]: ...
+    def write_png(
+        self,
+        outfile: str | pathlib.Path,
+        width: int,
+        height: Optional[int] = None,
+        window: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        colors: Optional[dict[tuple[int, int], str]] = None,
+        background: str = "#222222",
+    ) -> Self: ...
     def write_svg(
         self,
         outfile: str | pathlib.Path,
@@ -86,6 +163,10 @@ class Cell:
         background: str = "#222222",
         pad: float | str = "5%",
         sort_function: Optional[Callable[[Polygon, Polygon], bool]] = None,
+        min_size: float = 0,
+        outline: bool = False,
+        max_polygons: int = 0,
+        compress: Optional[bool] = None,
     ) -> Self: ...
 
 class Curve:
@@ -416,17 +497,31 @@ class Library:
         self, name: str = "library", unit: float = 1e-6, precision: float = 1e-9
     ) -> None: ...
     def add(self, *cells: Cell | RawCell) -> Self: ...
+    def deduplicate(self, translation_invariant: bool = False) -> list[Cell]: ...
     def delete_property(self, name: str) -> Self: ...
+    def find_labels(
+        self,
+        cell: Cell,
+        text: Optional[str] = None,
+        region: Optional[tuple[tuple[float, float], tuple[float, float]]] = None,
+        rebuild: bool = False,
+    ) -> list[
+        tuple[Cell, Label, tuple[float, float], tuple[tuple[float, float], float, float, bool]]
+    ]: ...
     def get_property(self, name: str) -> Optional[list[list[str | bytes | float]]]: ...
     def layers_and_datatypes(self) -> set[tuple[int, int]]: ...
     def layers_and_texttypes(self) -> set[tuple[int, int]]: ...
     def new_cell(self, name: str) -> Cell: ...
     def remove(self, *cells: Cell | RawCell) -> Self: ...
+    def copy(self, deep_copy: bool = True) -> Self: ...
     def rename_cell(self, old_name: str, new_name: str) -> Self: ...
+    def rename_cells(self, names: dict[str | Cell, str]) -> Self: ...
     def replace(self, *cells: Cell | RawCell) -> Self: ...
+    def rescale(self, unit: float) -> Self: ...
     def set_property(
         self, name: str, value: str | bytes | float | Sequence[str | bytes | float]
     ) -> Self: ...
+    def snap(self, grid: float) -> dict[str, int]: ...
     def top_level(self) -> list[Cell | RawCell]: ...
     def write_gds(
         self,
@@ -531,14 +626,16 @@ class Reference:
         depth: Optional[int] = None,
         layer: Optional[int] = None,
         texttype: Optional[int] = None,
-    ) -> list[Label]: ...
+        tags: Optional[Sequence[tuple[int, int]]] = None,
+    ) -> list[Label] | dict[tuple[int, int], list[Label]]: ...
     def get_paths(
         self,
         apply_repetitions: bool = True,
         depth: Optional[int] = None,
         layer: Optional[int] = None,
         datatype: Optional[int] = None,
-    ) -> list[RobustPath | FlexPath]: ...
+        tags: Optional[Sequence[tuple[int, int]]] = None,
+    ) -> list[RobustPath | FlexPath] | dict[tuple[int, int], list[RobustPath | FlexPath]]: ...
     def get_polygons(
         self,
         apply_repetitions: bool = True,
@@ -546,7 +643,8 @@ class Reference:
         depth: Optional[int] = None,
         layer: Optional[int] = None,
         datatype: Optional[int] = None,
-    ) -> list[Polygon]: ...
+        tags: Optional[Sequence[tuple[int, int]]] = None,
+    ) -> list[Polygon] | dict[tuple[int, int], list[Polygon]]: ...
     def get_property(self, name: str) -> Optional[list[list[str | bytes | float]]]: ...
     def set_gds_property(self, attr: int, value: str) -> Self: ...
     def set_property(
@@ -883,6 +981,13 @@ def boolean(
     layer: int = 0,
     datatype: int = 0,
 ) -> list[Polygon]: ...
+def check_polygons(
+    polygons: Polygon
+    | FlexPath
+    | RobustPath
+    | Reference
+    | Sequence[Polygon | FlexPath | RobustPath | Reference],
+) -> list[set[str]]: ...
 def contour(
     data: ArrayLike, # type: ignore
     level: int = 0,
@@ -911,6 +1016,25 @@ def ellipse(
 def gds_info(infile: str | pathlib.Path) -> dict[str, Any]: ...
 
 # def gds_timestamp(filename: str | pathlib.Path, timestamp:Optional[datetime.datetime]=None) -> datetime.datetime: ...
+def gds_to_oas(
+    infile: str | pathlib.Path,
+    outfile: str | pathlib.Path,
+    compression_level: int = 6,
+    detect_rectangles: bool = True,
+    detect_trapezoids: bool = True,
+    circle_tolerance: float = 0,
+    cell_offsets: bool = False,
+    validation: Optional[Literal["crc32", "checksum32"]] = None,
+) -> None: ...
+def gds_transform(
+    infile: str | pathlib.Path,
+    outfile: str | pathlib.Path,
+    filter: Optional[Iterable[tuple[int, int]]] = None,
+    layer_type_map: Optional[dict[tuple[int, int], tuple[int, int]]] = None,
+    rename: Optional[dict[str, str]] = None,
+    unit: float = 0,
+    precision: float = 0,
+) -> None: ...
 def gds_units(infile: str | pathlib.Path) -> tuple[float, float]: ...
 def inside(
     points: Sequence[tuple[float, float] | complex],
@@ -921,6 +1045,14 @@ def inside(
     | Sequence[Polygon | FlexPath | RobustPath | Reference],
 ) -> tuple[bool, ...]: ...
 def oas_precision(infile: str | pathlib.Path) -> float: ...
+def oas_to_gds(
+    infile: str | pathlib.Path,
+    outfile: str | pathlib.Path,
+    unit: float = 0,
+    tolerance: float = 0,
+    max_points: int = 199,
+    timestamp: Optional[datetime.datetime] = None,
+) -> None: ...
 def oas_validate(infile: str | pathlib.Path) -> tuple[bool, int]: ...
 def offset(
     polygons: Polygon
@@ -978,6 +1110,14 @@ def slice(
     axis: Literal["x", "y"],
     precision: float = 1e-3,
 ) -> list[list[Polygon]]: ...
+def spill_disable() -> None: ...
+def spill_enable(
+    threshold: int = 4096,
+    resident_limit: int = 1073741824,
+    directory: Optional[str | pathlib.Path] = None,
+) -> None: ...
+def spill_info() -> dict[str, int]: ...
+def spill_release() -> None: ...
 def text(
     text: str,
     size: float,
@@ -0,0 +1,126 @@
+# Copyright 2020 Lucas Heitzmann Gabrielli.
+# This file is part of gdstk, distributed under the terms of the
+# Boost Software License - Version 1.0.  See the accompanying
+# LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+
+"""Streaming conversion between layout files.
+
+Usage: python -m gdstk.convert [options] INFILE OUTFILE
+
+The conversion direction is defined by the file extensions.
+"""
+
+import argparse
+import pathlib
+import sys
+
+import gdstk
+
+
+def _tag(text):
+    layer, datatype = text.split("/")
+    return int(layer), int(datatype)
+
+
+def _pair(text, convert=str):
+    old, new = text.split(":")
+    return convert(old), convert(new)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        prog="python -m gdstk.convert",
+        description="Convert layout files without loading the whole library in memory.",
+    )
+    parser.add_argument("infile", type=pathlib.Path, help="input file (.gds or .oas)")
+    parser.add_argument("outfile", type=pathlib.Path, help="output file (.oas or .gds)")
+    parser.add_argument(
+        "--compression-level",
+        type=int,
+        default=6,
+        help="OASIS cell compression level (0 to 9, default 6)",
+    )
+    parser.add_argument(
+        "--circle-tolerance",
+        type=float,
+        default=0,
+        help="tolerance for circle detection in OASIS output (default 0: disabled)",
+    )
+    parser.add_argument(
+        "--cell-offsets",
+        action="store_true",
+        help="store the standard OASIS cell offset properties",
+    )
+    parser.add_argument(
+        "--validation",
+        choices=("crc32", "checksum32"),
+        default=None,
+        help="validation signature for OASIS output",
+    )
+    parser.add_argument(
+        "--max-points",
+        type=int,
+        default=199,
+        help="maximal number of polygon vertices in GDSII output (default 199)",
+    )
+    parser.add_argument(
+        "--filter",
+        type=_tag,
+        action="append",
+        metavar="LAYER/TYPE",
+        help="GDSII to GDSII: only keep shapes with this tag (repeatable)",
+    )
+    parser.add_argument(
+        "--remap",
+        type=lambda text: _pair(text, _tag),
+        action="append",
+        metavar="LAYER/TYPE:LAYER/TYPE",
+        help="GDSII to GDSII: remap a layer and type (repeatable)",
+    )
+    parser.add_argument(
+        "--rename",
+        type=_pair,
+        action="append",
+        metavar="OLD:NEW",
+        help="GDSII to GDSII: rename a cell (repeatable)",
+    )
+    parser.add_argument(
+        "--unit", type=float, default=0, help="GDSII to GDSII: new user unit"
+    )
+    parser.add_argument(
+        "--precision",
+        type=float,
+        default=0,
+        help="GDSII to GDSII: new database unit (coordinates are scaled)",
+    )
+    args = parser.parse_args(argv)
+
+    suffixes = (args.infile.suffix.lower(), args.outfile.suffix.lower())
+    if suffixes == (".gds", ".oas"):
+        gdstk.gds_to_oas(
+            args.infile,
+            args.outfile,
+            compression_level=args.compression_level,
+            circle_tolerance=args.circle_tolerance,
+            cell_offsets=args.cell_offsets,
+            validation=args.validation,
+        )
+    elif suffixes == (".gds", ".gds"):
+        gdstk.gds_transform(
+            args.infile,
+            args.outfile,
+            filter=args.filter,
+            layer_type_map=dict(args.remap) if args.remap else None,
+            rename=dict(args.rename) if args.rename else None,
+            unit=args.unit,
+            precision=args.precision,
+        )
+    elif suffixes == (".oas", ".gds"):
+        gdstk.oas_to_gds(args.infile, args.outfile, max_points=args.max_points)
+    else:
+        parser.error(f"unsupported conversion: {suffixes[0]} to {suffixes[1]}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -13,6 +13,7 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 namespace gdstk {
 
@@ -28,13 +29,51 @@ void free_allocation(void* ptr);
 
 #else  // GDSTK_CUSTOM_ALLOCATOR
 
-inline void* allocate(uint64_t size) { return malloc(size); };
-
-inline void* reallocate(void* ptr, uint64_t size) { return realloc(ptr, size); };
-
-inline void* allocate_clear(uint64_t size) { return calloc(1, size); };
-
-inline void free_allocation(void* ptr) { free(ptr); };
+// Out-of-core storage (see spill.hpp).  While spill mode is active,
+// spill_threshold is the minimal allocation size served from the spill file;
+// it is 0 otherwise.  All spill blocks lie in the address range [spill_begin,
+// spill_end), which is how they are told apart from heap allocations.
+extern uint64_t spill_threshold;
+extern uint8_t* spill_begin;
+extern uint8_t* spill_end;
+
+void* spill_allocate(uint64_t size);
+
+void* spill_reallocate(void* ptr, uint64_t size);
+
+void spill_free(void* ptr);
+
+inline bool is_spilled(const void* ptr) {
+    return (const uint8_t*)ptr >= spill_begin && (const uint8_t*)ptr < spill_end;
+};
+
+inline void* allocate(uint64_t size) {
+    if (spill_threshold > 0 && size >= spill_threshold) return spill_allocate(size);
+    return malloc(size);
+};
+
+inline void* reallocate(void* ptr, uint64_t size) {
+    if (is_spilled(ptr) || (spill_threshold > 0 && size >= spill_threshold))
+        return spill_reallocate(ptr, size);
+    return realloc(ptr, size);
+};
+
+inline void* allocate_clear(uint64_t size) {
+    if (spill_threshold > 0 && size >= spill_threshold) {
+        void* ptr = spill_allocate(size);
+        if (ptr) memset(ptr, 0, size);
+        return ptr;
+    }
+    return calloc(1, size);
+};
+
+inline void free_allocation(void* ptr) {
+    if (is_spilled(ptr)) {
+        spill_free(ptr);
+    } else {
+        free(ptr);
+    }
+};
 
 #endif  // GDSTK_CUSTOM_ALLOCATOR
 
@@ -32,27 +32,119 @@ namespace gdstk {
 // second argument.
 typedef bool (*PolygonComparisonFunction)(Polygon* const&, Polygon* const&);
 
-// This structure is used for caching bounding box and convex hull results from
-// cells.  This is a snapshot of the cells at a specific point in time.  It
+// This structure is used for caching bounding box, convex hull and tag results
+// from cells.  This is a snapshot of the cells at a specific point in time.  It
 // must be invalidated whenever the cell contents changes.
 struct GeometryInfo {
     Array<Vec2> convex_hull;
     Vec2 bounding_box_min;
     Vec2 bounding_box_max;
+    // Tags of the shapes (polygons and paths) and labels in the cell and all
+    // its dependencies
+    Set<Tag> shape_tags;
+    Set<Tag> label_tags;
 
-    // These flags indicate whether the convex hull and bounding box values are
-    // valid, even when convex_hull.count == 0 or bounding_box_min.x >
-    // bounding_box_max.x (empty cell)
+    // These flags indicate whether the convex hull, bounding box, and tag
+    // values are valid, even when convex_hull.count == 0 or
+    // bounding_box_min.x > bounding_box_max.x (empty cell)
     bool convex_hull_valid;
     bool bounding_box_valid;
+    bool tags_valid;
 
     void clear() {
         convex_hull.clear();
+        shape_tags.clear();
+        label_tags.clear();
         convex_hull_valid = false;
         bounding_box_valid = false;
+        tags_valid = false;
     }
 };
 
+// Clear all cached values and the cache itself
+void clear_geometry_cache(Map<GeometryInfo>& cache);
+
+// Level-of-detail options for SVG output.  Polygons (including those from
+// paths) and references with scaled bounding box dimensions smaller than
+// min_size (in px, measured in the coordinates of the cell where they are
+// drawn) are culled from the output.  Culled polygons with a repetition are
+// culled as a whole.  If outline is true, culled polygons are replaced by
+// their bounding boxes and culled references by the outline of their bounding
+// boxes.  Cells that are only instantiated by culled references are not
+// included in the output.  If max_polygons > 0, at most that number of
+// polygons (including replacement boxes) is drawn for each tag in each cell,
+// keeping the ones with the largest bounding boxes.
+struct SvgLevelOfDetail {
+    double min_size;
+    bool outline;
+    uint64_t max_polygons;
+};
+
+// Contiguous range of elements with the same tag in a cell array
+struct TagRange {
+    Tag tag;
+    uint64_t offset;
+    uint64_t count;
+};
+
+// Index of the element arrays of a cell in bucketed storage mode (see
+// Cell::set_tag_buckets).  Each array is sorted by tag and the ranges (also
+// sorted by tag) locate the elements with each tag.  Paths are bucketed by
+// the tag of their elements; paths with elements in distinct tags (or without
+// elements) are placed after all ranges, starting at the mixed position.
+struct TagBuckets {
+    Array<TagRange> polygon_ranges;
+    Array<TagRange> flexpath_ranges;
+    Array<TagRange> robustpath_ranges;
+    Array<TagRange> label_ranges;
+    uint64_t flexpath_mixed;
+    uint64_t robustpath_mixed;
+
+    // State of the cell when the buckets were built, used to detect
+    // modifications (see Cell::modification_count and tag_change_count).
+    uint64_t modification_count;
+    uint64_t tag_change_count;
+    Polygon** polygon_items;
+    FlexPath** flexpath_items;
+    RobustPath** robustpath_items;
+    Label** label_items;
+    uint64_t polygon_count;
+    uint64_t flexpath_count;
+    uint64_t robustpath_count;
+    uint64_t label_count;
+
+    void clear() {
+        polygon_ranges.clear();
+        flexpath_ranges.clear();
+        robustpath_ranges.clear();
+        label_ranges.clear();
+    }
+};
+
+// Incremented whenever the tag of an element is changed in place by code that
+// cannot reach the cell that holds the element (the Python element setters,
+// for example).  Tag buckets built before the change are stale.
+extern uint64_t tag_change_count;
+
+// Elements shared by copy-on-write clones of cells (see Cell::clone_from).
+// The element arrays (owned by the storage) hold the contents of the cloned
+// cell at the time it was cloned (its private elements are copied).  The
+// elements in owned (sorted by address) belong to this storage and are freed
+// with it; the remaining ones belong to its parent storage.
+struct CellStorage {
+    uint64_t reference_count;  // Cells and child storages using this storage
+    CellStorage* parent;
+    Array<Polygon*> polygon_array;
+    Array<Reference*> reference_array;
+    Array<FlexPath*> flexpath_array;
+    Array<RobustPath*> robustpath_array;
+    Array<Label*> label_array;
+    Array<const void*> owned;
+
+    // Test whether element belongs to this storage or any of its parents.
+    bool owns(const void* element) const;
+};
+
 struct Cell {
     // NULL-terminated string with cell name.  The GDSII specification allows
     // only ASCII-encoded strings.  The OASIS specification restricts the
@@ -73,6 +165,21 @@ struct Cell {
 
     Property* properties;
 
+    // Tag index in bucketed storage mode (NULL otherwise).  Use
+    // set_tag_buckets to change the storage mode.
+    TagBuckets* tag_buckets;
+
+    // Incremented whenever elements are added to or removed from the cell, or
+    // the tags of its elements change.  Code that modifies the element arrays
+    // directly must also increment it, so that indices derived from the cell
+    // contents (such as the tag buckets) are rebuilt.
+    uint64_t modification_count;
+
+    // Elements shared with copy-on-write clones (NULL if not shared).  In
+    // clones, element arrays that have not been modified since cloning use
+    // the same items as the storage arrays.
+    CellStorage* storage;
+
     // Used by the python interface to store the associated PyObject* (if any).
     // No functions in gdstk namespace should touch this value!
     void* owner;
@@ -83,29 +190,8 @@ struct Cell {
 
     void clear();
 
-    void free_all() {
-        for (uint64_t j = 0; j < polygon_array.count; j++) {
-            polygon_array[j]->clear();
-            free_allocation(polygon_array[j]);
-        }
-        for (uint64_t j = 0; j < flexpath_array.count; j++) {
-            flexpath_array[j]->clear();
-            free_allocation(flexpath_array[j]);
-        }
-        for (uint64_t j = 0; j < robustpath_array.count; j++) {
-            robustpath_array[j]->clear();
-            free_allocation(robustpath_array[j]);
-        }
-        for (uint64_t j = 0; j < reference_array.count; j++) {
-            reference_array[j]->clear();
-            free_allocation(reference_array[j]);
-        }
-        for (uint64_t j = 0; j < label_array.count; j++) {
-            label_array[j]->clear();
-            free_allocation(label_array[j]);
-        }
-        clear();
-    }
+    // Clear and free all elements (except those owned by storage).
+    void free_all();
 
     // Bounding box corners are returned in min and max.  For an empty cell,
     // return min.x > max.x.  Internally, this function simply calls the
@@ -123,12 +209,75 @@ struct Cell {
     // Caching version of the convex hull calculation.
     GeometryInfo convex_hull(Map<GeometryInfo>& cache) const;
 
+    // Hash of the cell contents: polygons, paths (through their polygonal
+    // representation), references, labels and properties, with coordinates
+    // rounded to multiples of 1 / scaling.  The hash is independent of the
+    // order of the elements in the cell and of the cell name, so cells with
+    // the same geometry have the same hash.  Referenced cells contribute their
+    // own content hashes, which are computed recursively and stored in cache
+    // (indexed by cell name).
+    uint64_t content_hash(double scaling, Map<uint64_t>& cache) const;
+    // Translation-invariant version of the content hash.  Coordinates are
+    // taken relative to the lower left corner of the bounding box of each
+    // cell (computed with geometry_cache), so cells that differ only by a
+    // translation have the same hash.  Hashes from both versions should not
+    // be mixed in the same cache.
+    uint64_t content_hash(double scaling, Map<uint64_t>& cache,
+                          Map<GeometryInfo>& geometry_cache) const;
+
+    // Enable or disable the bucketed storage mode.  When enabled, polygons,
+    // paths and labels are reordered by tag (preserving the relative order
+    // of elements with the same tag) and indexed, so that tag gathering, tag
+    // remapping and filtered element getters only touch the elements with
+    // the relevant tags.  The element arrays can still be modified directly:
+    // the buckets become stale when modification_count or tag_change_count
+    // change and are rebuilt by update_tag_buckets (functions that do not
+    // modify the cell simply ignore stale buckets).
+    void set_tag_buckets(bool enable);
+    // Rebuild the buckets if the storage mode is enabled and they are stale
+    // (or always, if force is true).
+    void update_tag_buckets(bool force);
+    // Current buckets, or NULL if the storage mode is disabled or they are
+    // stale.
+    const TagBuckets* current_tag_buckets() const;
+
     // This cell instance must be zeroed before copy_from.  If a new_name is
     // NULL, use the same name as the source cell.  If deep_copy == true, new
     // elements (polygons, paths, references, and labels) are allocated and
-    // copied from the source cell.  Otherwise, the same pointers are used.
+    // copied from the source cell (large arrays in parallel).  Otherwise, the
+    // same pointers are used.
     void copy_from(const Cell& cell, const char* new_name, bool deep_copy);
 
+    // Copy-on-write clone: this cell instance (which must be zeroed) shares
+    // its element arrays and elements with other clones until they are
+    // modified.  The source cell is not changed and remains fully private:
+    // its arrays and elements can still be modified directly.  To achieve
+    // that, the first clone copies the elements of cell (once) into a shared
+    // storage, unless cell is itself an unmodified clone.  Cloning a clone
+    // only copies its private elements, so many variants of a cell should be
+    // cloned from a single clone of it.  Clones are read-only views of the
+    // shared storage: their arrays must be obtained with the writable array
+    // functions before being modified (which copies only the requested
+    // array), and their elements with the writable element functions (which
+    // replace the element at the given index with a private copy, if needed).
+    // Functions in Cell and Library that modify elements in place (flatten,
+    // group_repetitions, remap_tags, rescale, snap, etc.) unshare first.
+    // Clear and free_all release the shared elements, which are freed with
+    // the last clone using them, so cells can be freed in any order.
+    void clone_from(const Cell& cell, const char* new_name);
+    Array<Polygon*>& writable_polygon_array();
+    Array<Reference*>& writable_reference_array();
+    Array<FlexPath*>& writable_flexpath_array();
+    Array<RobustPath*>& writable_robustpath_array();
+    Array<Label*>& writable_label_array();
+    Polygon* writable_polygon(uint64_t index);
+    Reference* writable_reference(uint64_t index);
+    FlexPath* writable_flexpath(uint64_t index);
+    RobustPath* writable_robustpath(uint64_t index);
+    Label* writable_label(uint64_t index);
+    // Replace all shared elements with private copies and release storage.
+    void unshare();
+
     // Append a (newly allocated) copy of all the polygons in the cell to
     // result.  If paths are included, their polygonal representation is
     // calculated and also appended.  Polygons from references are included up
@@ -136,17 +285,54 @@ struct Cell {
     // included, depth == 1 includes polygons from referenced cells (with their
     // transformation properly applied), but not from references thereof, and
     // so on.  Depth < 0, removes the limit in the recursion depth.  If filter
-    // is true, only polygons with the indicated tag are appended.
+    // is true, only polygons with the indicated tag are appended, and
+    // references to cells without that tag anywhere in their hierarchy are
+    // skipped.  Internally, this function simply calls the caching version
+    // with an empty cache.
     void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
                       Tag tag, Array<Polygon*>& result) const;
+    // Caching version of get_polygons.  The cache is used for the tags in the
+    // referenced cells when filtering (see get_tags).
+    void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                      Tag tag, Array<Polygon*>& result, Map<GeometryInfo>& cache) const;
 
     // Similar to get_polygons, but for paths and labels.
     void get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                        Array<FlexPath*>& result) const;
+    void get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                       Array<FlexPath*>& result, Map<GeometryInfo>& cache) const;
     void get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                          Array<RobustPath*>& result) const;
+    void get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                         Array<RobustPath*>& result, Map<GeometryInfo>& cache) const;
     void get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                     Array<Label*>& result) const;
+    void get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                    Array<Label*>& result, Map<GeometryInfo>& cache) const;
+
+    // Multi-tag versions of the element getters: elements with tags[i] are
+    // appended to result[i] (result must hold tags.count arrays), so that
+    // several tags can be extracted with a single traversal of the hierarchy.
+    // Elements with tags not in tags are skipped, as are references to cells
+    // without any of them.  Paths are split by element tag.  Tags must not be
+    // repeated.
+    void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                      const Array<Tag>& tags, Array<Polygon*>* result) const;
+    void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                      const Array<Tag>& tags, Array<Polygon*>* result,
+                      Map<GeometryInfo>& cache) const;
+    void get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                       Array<FlexPath*>* result) const;
+    void get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                       Array<FlexPath*>* result, Map<GeometryInfo>& cache) const;
+    void get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                         Array<RobustPath*>* result) const;
+    void get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                         Array<RobustPath*>* result, Map<GeometryInfo>& cache) const;
+    void get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                    Array<Label*>* result) const;
+    void get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                    Array<Label*>* result, Map<GeometryInfo>& cache) const;
 
     // Insert all dependencies in result.  Dependencies are cells that appear
     // in this cell's references. If recursive, include the whole dependency
@@ -158,6 +344,10 @@ struct Cell {
     // References are not included in the result.
     void get_shape_tags(Set<Tag>& result) const;
     void get_label_tags(Set<Tag>& result) const;
+    // Caching version of the tag gathering, including the tags from all
+    // referenced cells (recursively).  The returned GeometryInfo is guaranteed
+    // to have the tags of this cell instance (tags_valid == true).
+    GeometryInfo get_tags(Map<GeometryInfo>& cache) const;
 
     // Transform a cell hierarchy into a flat cell, with no dependencies, by
     // inserting the elements from this cell's references directly into the
@@ -165,6 +355,17 @@ struct Cell {
     // appended to removed_references.
     void flatten(bool apply_repetitions, Array<Reference*>& removed_references);
 
+    // Replace sets of references (or polygons) that differ only by a
+    // translation with a single element with a repetition (found by
+    // find_repetitions, comparing coordinates rounded to multiples of 1 /
+    // scaling).  References are grouped by referenced cell, transformation and
+    // properties, and polygons by their shape (see Polygon::content_hash).
+    // Only elements without repetitions are considered.  Replaced elements are
+    // removed from the cell and appended to removed_references and
+    // removed_polygons (they are not freed).
+    void group_repetitions(double scaling, Array<Reference*>& removed_references,
+                           Array<Polygon*>& removed_polygons);
+
     // Change the tags of all elements in this cell.  Map keys are the current
     // tags and map values are the desired new tags.  Elements in references
     // are not remapped (use get_dependencies to loop over and remap them).
@@ -172,11 +373,19 @@ struct Cell {
 
     // These functions output the cell and its contents in the GDSII and SVG
     // formats.  They are not supposed to be called by the user.  Use
-    // Library.write_gds and Cell.write_svg instead.
+    // Library.write_gds and Cell.write_svg instead.  Argument cache in to_svg
+    // holds the cell bounding boxes used for level-of-detail culling.  SVG
+    // output can also be appended to a memory buffer.
     ErrorCode to_gds(FILE* out, double scaling, uint64_t max_points, double precision,
                      const tm* timestamp) const;
     ErrorCode to_svg(FILE* out, double scaling, uint32_t precision, const char* attributes,
                      PolygonComparisonFunction comp) const;
+    ErrorCode to_svg(FILE* out, double scaling, uint32_t precision, const char* attributes,
+                     PolygonComparisonFunction comp, const SvgLevelOfDetail* lod,
+                     Map<GeometryInfo>& cache) const;
+    ErrorCode to_svg(Array<char>& out, double scaling, uint32_t precision,
+                     const char* attributes, PolygonComparisonFunction comp,
+                     const SvgLevelOfDetail* lod, Map<GeometryInfo>& cache) const;
 
     // Output this cell to filename in SVG format.  The geometry is drawn in
     // the default units (px), but can be scaled freely.  Argument precision
@@ -188,10 +397,18 @@ struct Cell {
     // cell bounding box, unless pad_as_percentage == true, in which case it is
     // interpreted as a percentage of the largest bounding box dimension.
     // Argument comp in to_svg can be used to sort the polygons in the SVG
-    // output, which affects their draw order.
+    // output, which affects their draw order.  If lod is not NULL, elements
+    // are culled according to the level-of-detail options.  Polygons are
+    // encoded in parallel.  If compressed is true, the output is gzip
+    // compressed (SVGZ format).  The first overload writes uncompressed output
+    // without level-of-detail options.
     ErrorCode write_svg(const char* filename, double scaling, uint32_t precision,
                         StyleMap* shape_style, StyleMap* label_style, const char* background,
                         double pad, bool pad_as_percentage, PolygonComparisonFunction comp) const;
+    ErrorCode write_svg(const char* filename, double scaling, uint32_t precision,
+                        StyleMap* shape_style, StyleMap* label_style, const char* background,
+                        double pad, bool pad_as_percentage, PolygonComparisonFunction comp,
+                        const SvgLevelOfDetail* lod, bool compressed) const;
 };
 
 }  // namespace gdstk
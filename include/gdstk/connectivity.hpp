@@ -0,0 +1,65 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_CONNECTIVITY
+#define GDSTK_HEADER_CONNECTIVITY
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "polygon.hpp"
+#include "utils.hpp"
+#include "vec.hpp"
+
+namespace gdstk {
+
+// Shapes with tag via connect the shapes with tags bottom and top that they
+// touch.
+struct ViaRule {
+    Tag via;
+    Tag bottom;
+    Tag top;
+};
+
+// Labels with tag label name the net of the shape with tag conductor that
+// contains their origin.
+struct LabelRule {
+    Tag label;
+    Tag conductor;
+};
+
+// Connected set of shapes
+struct Net {
+    Array<Polygon*> polygon_array;
+    Array<char*> name_array;  // Unique label texts attached to the net
+
+    // Polygons and names are freed
+    void clear();
+};
+
+// Trace the electrical connectivity of the geometry in cell.  Shapes
+// (polygons and paths converted to polygons) with tags in conductor_tags
+// connect to the touching shapes with the same tag, and shapes with via tags
+// connect according to via_rules.  Shapes are considered touching when their
+// distance is less than precision / 2.  The cell hierarchy is traversed
+// pruning references outside the window (min, max), and all shapes that
+// overlap the window are included whole.  If min.x > max.x, the whole cell is
+// used.  Candidate pairs are found with a uniform grid index, tested in
+// parallel per grid tile, and merged with union-find.  Labels are assigned
+// to nets according to label_rules.  Nets are appended to result in the order
+// of their first shape in the hierarchy traversal.
+ErrorCode extract_nets(const Cell& cell, const Array<Tag>& conductor_tags,
+                       const Array<ViaRule>& via_rules, const Array<LabelRule>& label_rules,
+                       const Vec2 min, const Vec2 max, double precision, Array<Net>& result);
+
+}  // namespace gdstk
+
+#endif
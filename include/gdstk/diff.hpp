@@ -0,0 +1,52 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_DIFF
+#define GDSTK_HEADER_DIFF
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "polygon.hpp"
+#include "utils.hpp"
+#include "vec.hpp"
+
+namespace gdstk {
+
+// Geometric differences between a pair of corresponding cells
+struct CellDiff {
+    const Cell* cell1;
+    const Cell* cell2;
+    // Regions covered by only one of the cells, tagged with their layer and
+    // data type
+    Array<Polygon*> polygon_array;
+
+    // Polygons are freed
+    void clear();
+};
+
+// Compare the geometry of 2 cell hierarchies.  Cells are fingerprinted with
+// Cell::content_hash (with the given precision), so identical subtrees are
+// skipped entirely.  For cells that differ, references with the same hash are
+// matched and skipped, references with the same transformation and
+// referenced cell name are compared recursively (reporting the differences in
+// the referenced cells), and remaining references are flattened.  The
+// polygons in each layer are XOR-ed in tiles of the given size (if tile_size
+// <= 0, a size is chosen automatically), processed in parallel.  Tiles with
+// identical polygons in both cells are skipped.  The differences for each
+// pair of cells with non-empty XOR are appended to result.  References to
+// rawcells or by name are only compared by their hashes.
+ErrorCode diff_cells(const Cell& cell1, const Cell& cell2, double precision, double tile_size,
+                     Array<CellDiff>& result);
+
+}  // namespace gdstk
+
+#endif
@@ -0,0 +1,65 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_DRC
+#define GDSTK_HEADER_DRC
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "polygon.hpp"
+#include "utils.hpp"
+#include "vec.hpp"
+
+namespace gdstk {
+
+enum struct DrcCheck {
+    Width,      // Minimal width of tag1
+    Spacing,    // Minimal spacing between tag1 and tag2 (can be the same)
+    Enclosure,  // Minimal enclosure of tag2 by tag1
+    Area,       // Minimal area of tag1
+};
+
+struct DrcRule {
+    DrcCheck check;
+    Tag tag1;
+    Tag tag2;
+    double value;
+};
+
+// Design rule checking.  Geometry with each tag is merged (with the given
+// precision) before checking, so the rules apply to the union of all shapes
+// in a layer.  Width, spacing and enclosure are edge-pair checks: pairs of
+// edges with an angle larger than 90° (for width and spacing) or smaller than
+// 90° (for enclosure), facing each other (inside or outside of the shapes, as
+// appropriate) and closer than the rule value (Euclidean distance), are
+// violations.  Enclosure also reports the parts of tag2 not covered by tag1.
+// Area reports merged polygons with area less than the rule value.  Edge
+// pairs are searched with a uniform grid index, processing grid tiles in
+// parallel.
+//
+// The check is hierarchical: references without magnification whose bounding
+// boxes (grown by the largest rule value) don't interact with any other
+// geometry in the parent cell reuse the result of checking the referenced
+// cell, which is computed only once.  Other references are flattened into the
+// parent check.
+//
+// Violation markers are appended to markers[i] for rules[i] (markers must hold
+// rules.count arrays).  Markers for edge-pair violations are quadrilaterals
+// joining both edge segments, area violations are marked by the polygon
+// itself, and missing enclosure by the uncovered region.  Markers have the
+// tag1 of the corresponding rule.
+ErrorCode check_rules(const Cell& cell, const Array<DrcRule>& rules, double precision,
+                      Array<Polygon*>* markers);
+
+}  // namespace gdstk
+
+#endif
@@ -0,0 +1,55 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_FILL
+#define GDSTK_HEADER_FILL
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "polygon.hpp"
+#include "reference.hpp"
+#include "utils.hpp"
+#include "vec.hpp"
+
+namespace gdstk {
+
+// Dummy fill generation.  Fill elements are placed on a regular grid of sites
+// with the given pitch, starting at the lower left corner of the window (min,
+// max), such that the bounding box of each element lies within the window.
+// A site is blocked when the bounding box of the element, grown by
+// keep_out[i], overlaps the (flattened) geometry of cell with tag
+// exclusion_tags[i].  The window is divided in tiles with approximately
+// tile_size (rounded to a whole number of sites), which are processed in
+// parallel.  If density > 0, fill is only added to tiles where the pattern
+// density of the element tags is below this target, and only as many sites
+// as needed to reach it are used (whole rows of sites are selected, evenly
+// distributed in the tile).  Sites are grouped in rectangular repetitions
+// whenever possible: runs of adjacent sites in a row and equally spaced rows
+// with identical runs within a tile.  Argument precision is used for the
+// density calculation (see density_map).
+
+// Fill with references to element.  New references are appended to result.
+ErrorCode fill_cell(const Cell& cell, const Vec2 min, const Vec2 max, Cell* element,
+                    const Vec2 pitch, const Array<Tag>& exclusion_tags,
+                    const Array<double>& keep_out, double density, const Vec2 tile_size,
+                    double precision, Array<Reference*>& result);
+
+// Fill with copies of element (its repetition is ignored).  New polygons are
+// appended to result.
+ErrorCode fill_polygon(const Cell& cell, const Vec2 min, const Vec2 max, const Polygon& element,
+                       const Vec2 pitch, const Array<Tag>& exclusion_tags,
+                       const Array<double>& keep_out, double density, const Vec2 tile_size,
+                       double precision, Array<Polygon*>& result);
+
+}  // namespace gdstk
+
+#endif
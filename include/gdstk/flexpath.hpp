@@ -167,6 +167,7 @@ struct FlexPath {
     ErrorCode to_gds(FILE* out, double scaling);
     ErrorCode to_oas(OasisStream& out, OasisState& state);
     ErrorCode to_svg(FILE* out, double scaling, uint32_t precision);
+    ErrorCode to_svg(Array<char>& out, double scaling, uint32_t precision);
 
    private:
     void remove_overlapping_points();
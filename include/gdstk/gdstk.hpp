@@ -30,25 +30,34 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include "array.hpp"
 #include "cell.hpp"
 #include "clipper_tools.hpp"
+#include "connectivity.hpp"
+#include "diff.hpp"
+#include "drc.hpp"
 #include "curve.hpp"
+#include "fill.hpp"
 #include "flexpath.hpp"
 #include "gdsii.hpp"
 #include "gdswriter.hpp"
 #include "label.hpp"
+#include "labelindex.hpp"
 #include "library.hpp"
 #include "map.hpp"
 #include "oasis.hpp"
 #include "pathcommon.hpp"
 #include "polygon.hpp"
 #include "raithdata.hpp"
+#include "raster.hpp"
 #include "rawcell.hpp"
 #include "reference.hpp"
 #include "repetition.hpp"
 #include "robustpath.hpp"
 #include "set.hpp"
 #include "sort.hpp"
+#include "spill.hpp"
+#include "statistics.hpp"
 #include "style.hpp"
 #include "utils.hpp"
+#include "validity.hpp"
 #include "vec.hpp"
 
 #endif
@@ -56,6 +56,10 @@ struct Label {
     // into account for the calculation.
     void bounding_box(Vec2& min, Vec2& max) const;
 
+    // Hash of all label attributes, with offset subtracted from the origin,
+    // which is then rounded to multiples of 1 / scaling.
+    uint64_t content_hash(double scaling, const Vec2 offset) const;
+
     // Transformations are applied in the order of arguments, starting with
     // magnification and translating by origin at the end.  This is equivalent
     // to the transformation defined by a Reference with the same arguments.
@@ -68,8 +72,15 @@ struct Label {
     // not supposed to be called by the user.
     ErrorCode to_gds(FILE* out, double scaling) const;
     ErrorCode to_svg(FILE* out, double scaling, uint32_t precision) const;
+    ErrorCode to_svg(Array<char>& out, double scaling, uint32_t precision) const;
 };
 
+// Incremented whenever the text, origin, tag or repetition of a label is
+// changed in place by code that cannot reach the cell that holds the label
+// (the Python label setters, for example).  Label indices built before the
+// change are stale.
+extern uint64_t label_change_count;
+
 }  // namespace gdstk
 
 #endif
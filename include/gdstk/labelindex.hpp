@@ -0,0 +1,107 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_LABELINDEX
+#define GDSTK_HEADER_LABELINDEX
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "label.hpp"
+#include "map.hpp"
+#include "utils.hpp"
+#include "vec.hpp"
+
+// Number of 64-bit words in the text filter of each indexed cell
+#define GDSTK_LABEL_FILTER_WORDS 8
+
+namespace gdstk {
+
+// Label instance in the flattened hierarchy of a top cell
+struct LabelInstance {
+    const Cell* cell;  // Cell that contains the label
+    const Label* label;
+    // Label origin (including the repetition offset) in top cell coordinates
+    Vec2 position;
+    // Accumulated transformation from cell to top cell coordinates, applied
+    // in the same order as in references: magnification, x_reflection,
+    // rotation and translation by origin.
+    Vec2 origin;
+    double rotation;
+    double magnification;
+    bool x_reflection;
+};
+
+// Indexed labels of a single cell
+struct LabelIndexCell {
+    const Cell* cell;
+    Array<Label*> label_array;  // Labels in cell sorted by text
+    // Bloom filters of the label texts in the cell (local) and in its whole
+    // hierarchy
+    uint64_t local_filter[GDSTK_LABEL_FILTER_WORDS];
+    uint64_t filter[GDSTK_LABEL_FILTER_WORDS];
+    // Bounding boxes of the label origins in the cell (local) and in its
+    // whole hierarchy (min.x > max.x if empty)
+    Vec2 local_min, local_max;
+    Vec2 min, max;
+    // State of the cell when indexed, used to detect insertions and removals
+    uint64_t modification_count;
+    Label** label_items;
+    Reference** reference_items;
+    uint64_t label_count;
+    uint64_t reference_count;
+    // Generation of the hierarchy data (0 if it must be computed) and last
+    // updates that visited this cell
+    uint64_t generation;
+    uint64_t update_count;
+    uint64_t aggregate_count;
+
+    void clear() { label_array.clear(); }
+};
+
+// Hierarchical label index for text and spatial queries.  Cells are indexed
+// lazily, when first found in the hierarchy of a queried top cell, with their
+// labels sorted by text (cells are indexed in parallel).  Each cell also
+// keeps a filter of the texts and the bounding box of the labels in its
+// hierarchy, so that queries skip references that cannot contain matches.
+// Cells with added or removed labels or references (see
+// Cell::modification_count) are indexed again automatically, and so is the
+// whole index after labels are changed in place (see label_change_count).
+// Changes to existing references (transformation or repetition) require
+// clearing the index.
+// Queries must not run concurrently.
+struct LabelIndex {
+    Map<LabelIndexCell*> cell_map;  // Indexed cells by name
+    uint64_t update_count;
+    uint64_t generation;
+    uint64_t label_change_count;  // Value of label_change_count when indexed
+
+    void clear();
+
+    // Index the hierarchy of top, if necessary.  This is called by the
+    // queries, but can be used to build the index in advance.
+    void update(const Cell& top);
+
+    // Append to result the label instances in the flattened hierarchy of top
+    // with the given text (any text if NULL) and position within the
+    // rectangle defined by min and max (inclusive).  References by name and
+    // to rawcells are ignored.
+    void find(const Cell& top, const char* text, const Vec2 min, const Vec2 max,
+              Array<LabelInstance>& result);
+
+    void find_text(const Cell& top, const char* text, Array<LabelInstance>& result);
+    void find_region(const Cell& top, const Vec2 min, const Vec2 max,
+                     Array<LabelInstance>& result);
+};
+
+}  // namespace gdstk
+
+#endif
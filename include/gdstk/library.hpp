@@ -73,9 +73,16 @@ struct Library {
 
     // This library instance must be zeroed before copy_from.
     // If deep_copy == true, new cells are allocated and deep copied from the
-    // source.  Otherwise, the same cell pointers are used.
+    // source in parallel, with references to cells in the source library
+    // redirected to their copies.  Otherwise, the same cell pointers are used.
     void copy_from(const Library& library, bool deep_copy);
 
+    // Copy-on-write clone of library (see Cell::clone_from): new cells are
+    // cloned from the source cells and references to cells in the source
+    // library are redirected to their clones.  The source library is not
+    // changed.  This library instance must be zeroed before clone_from.
+    void clone_from(const Library& library);
+
     // Append all polygons/paths or labels tags found in this library's cells
     // to result (rawcells are not included).
     void get_shape_tags(Set<Tag>& result) const;
@@ -104,11 +111,66 @@ struct Library {
     void replace_cell(Cell* old_cell, RawCell* new_cell);
     void replace_cell(RawCell* old_cell, RawCell* new_cell);
 
+    // Reverse reference index: the references in all library cells, grouped
+    // by the name of the cell, rawcell or name they refer to.  The indexed
+    // versions of rename_cell and replace_cell only visit the references
+    // affected by each operation and keep the index up to date, which makes
+    // long sequences of renames or replacements linear in the number of
+    // references.  References shared with copy-on-write clones are replaced
+    // by private copies in their cells, so that they can be updated in place.
+    // The index must be rebuilt if references are added or removed by other
+    // means.  Arrays in the index must be cleared by the caller.
+    void reference_index(Map<Array<Reference*>>& result);
+    void rename_cell(Cell* cell, const char* new_name, Map<Array<Reference*>>& index);
+    void replace_cell(Cell* old_cell, Cell* new_cell, Map<Array<Reference*>>& index);
+    void replace_cell(RawCell* old_cell, Cell* new_cell, Map<Array<Reference*>>& index);
+    void replace_cell(Cell* old_cell, RawCell* new_cell, Map<Array<Reference*>>& index);
+    void replace_cell(RawCell* old_cell, RawCell* new_cell, Map<Array<Reference*>>& index);
+
+    // Batch versions of rename_cell and replace_cell with a single pass over
+    // all references.  In rename_cells, names maps current cell names to new
+    // names (all lookups use the names before renaming, so names can be
+    // swapped).  In replace_cells, replacements maps the names of the cells
+    // and rawcells to be replaced to their new cells.  Replaced cells are
+    // removed from the library (they are not freed) and replacements not in
+    // the library are appended to it.
+    void rename_cells(const Map<const char*>& names);
+    void replace_cells(const Map<Cell*>& replacements);
+
+    // Remove cells with the same content hash (see Cell::content_hash,
+    // computed with the library precision) as a previous cell in cell_array,
+    // updating references to them with references to that first cell, as
+    // replace_cell does.  If translation_invariant, cells that differ only by
+    // a translation are also removed, and the origins of the updated
+    // references are adjusted accordingly.  Removed cells are appended to
+    // removed (they are not freed), and the cells that replace them to
+    // replacements.
+    void deduplicate(bool translation_invariant, Array<Cell*>& removed,
+                     Array<Cell*>& replacements);
+
     // Change the tags of all elements in this library.  Map keys are the
     // current element tags and map values are the desired new tags.
-    void remap_tags(const TagMap& map) {
-        for (uint64_t i = 0; i < cell_array.count; i++) cell_array[i]->remap_tags(map);
-    };
+    // Elements are processed in parallel, and elements shared between cells
+    // are remapped only once.  Raw cells are not modified.
+    void remap_tags(const TagMap& map);
+
+    // Change the library unit to new_unit, scaling all geometry so that its
+    // physical dimensions are preserved: polygons, path spines, widths,
+    // extensions, bend radii and tolerances, reference and label origins, and
+    // repetitions.  Reference and label magnifications are not changed.
+    // Elements are processed in parallel, and elements shared between cells
+    // are scaled only once.  Raw cells are not rescaled: their contents remain
+    // in the original unit.
+    void rescale(double new_unit);
+
+    // Snap all coordinates to multiples of grid (in user units): polygon
+    // vertices, flexpath spine points, reference and label origins, and
+    // repetition vectors and offsets (robustpaths are not snapped).  The
+    // number of coordinates moved in each cell (by more than 1e-6 grid) is
+    // appended to moved, in the order of cell_array (elements shared between
+    // cells are counted in each of them, but snapped only once).  Elements are
+    // processed in parallel.  Raw cells are not modified.
+    void snap(double grid, Array<uint64_t>& moved);
 
     // Output this library to a GDSII file.  All polygons are fractured to
     // max_points before saving (but the originals are kept) if max_points > 4.
@@ -166,6 +228,72 @@ struct LibraryInfo {
 Library read_gds(const char* filename, double unit, double tolerance, const Set<Tag>* shape_tags,
                  ErrorCode* error_code);
 
+// Streaming GDSII reader.  Cells are read one at a time, so that only the
+// current cell must be kept in memory.  References in the returned cells are
+// always of type ReferenceType::Name, because the referenced cells might not
+// have been read yet.  Readers must be created with gdsreader_init, which
+// reads the library header (see read_gds for the meaning of its arguments),
+// and closed after use.
+struct GdsReader {
+    FILE* in;
+    char* library_name;
+    double unit;
+    double precision;
+    double factor;
+    double tolerance;
+    const Set<Tag>* shape_tags;
+    bool finished;  // ENDLIB record found
+
+    // Return the next cell in the file, or NULL at the end of the library or
+    // on error (in which case, finished is false).  The caller takes
+    // ownership of the returned cell and its contents.
+    Cell* read_cell(ErrorCode* error_code);
+
+    void close();
+};
+
+GdsReader gdsreader_init(const char* filename, double unit, double tolerance,
+                         const Set<Tag>* shape_tags, ErrorCode* error_code);
+
+// Convert a GDSII file to OASIS without loading the whole library.  Cells are
+// read, encoded and written one at a time, so memory usage is bounded by the
+// largest cells in the file.  When OpenMP support is available, cell
+// compression runs in parallel for batches of cells.  Arguments are the same
+// as in Library::write_oas, except that, from the standard properties in
+// config_flags, only OASIS_CONFIG_PROPERTY_CELL_OFFSET is supported (the
+// others require the whole library).
+ErrorCode gds_to_oas(const char* gds_filename, const char* oas_filename, double circle_tolerance,
+                     uint8_t compression_level, uint16_t config_flags);
+
+// Convert an OASIS file to GDSII without loading the whole library.  The name
+// tables are read first (only the tail of the file is read when they are
+// strict), then cells are decoded and written one at a time, so memory usage
+// is bounded by the largest cells in the file.  OASIS-only constructs are
+// expanded as in read_oas followed by Library::write_gds: circles and
+// trapezoids become polygons, regular repetitions of references become AREFs
+// and other repetitions are expanded.  Polygons are fractured to max_points
+// (if > 4), in parallel for batches of cells when OpenMP support is available.
+// Arguments unit and tolerance are the same as in read_oas; timestamp as in
+// Library::write_gds.
+ErrorCode oas_to_gds(const char* oas_filename, const char* gds_filename, double unit,
+                     double tolerance, uint64_t max_points, tm* timestamp);
+
+// Copy a GDSII file applying a series of transformations without loading the
+// library.  Records are streamed from input to output and copied verbatim,
+// unless modified by one of the following stages (disabled if NULL or not
+// positive):
+// - shape_tags: only polygons and paths with these tags are kept (labels and
+//   references are not filtered), as in read_gds;
+// - tag_map: layer and data/text types of polygons, paths and labels are
+//   remapped, as in Library::remap_tags (after filtering);
+// - cell_names: cells and references with names in the map are renamed;
+// - unit and precision: the library units are replaced and, if precision
+//   changes, all coordinates and widths are scaled to the new database unit.
+//   Raith PXXDATA records are not scaled.
+ErrorCode gds_transform(const char* input_filename, const char* output_filename,
+                        const Set<Tag>* shape_tags, const TagMap* tag_map,
+                        const Map<const char*>* cell_names, double unit, double precision);
+
 // Read the contents of an OASIS file into a new library.  If unit is not zero,
 // the units in the file are converted (all elements are properly scaled to the
 // desired unit).  The value of tolerance is used as the default tolerance for
@@ -17,6 +17,7 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include "array.hpp"
 #include "map.hpp"
 #include "repetition.hpp"
+#include "tagmap.hpp"
 #include "utils.hpp"
 
 namespace gdstk {
@@ -161,6 +162,8 @@ struct OasisState {
     double circle_tolerance;
     Map<uint64_t> property_name_map;
     Array<PropertyValue*> property_value_array;
+    // Hash of the string values in property_value_array to their position + 1
+    TagMap property_value_map;
     uint16_t config_flags;
 };
 
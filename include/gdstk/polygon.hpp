@@ -60,6 +60,12 @@ struct Polygon {
     // for the calculation.
     void bounding_box(Vec2& min, Vec2& max) const;
 
+    // Hash of the polygon tag, vertices, repetition and properties, with
+    // offset subtracted from the vertices, which are then rounded to multiples
+    // of 1 / scaling.  The hash does not depend on which vertex is the first,
+    // but it does depend on orientation.
+    uint64_t content_hash(double scaling, const Vec2 offset) const;
+
     void translate(const Vec2 v);
     void scale(const Vec2 scale, const Vec2 center);
     void mirror(const Vec2 p0, const Vec2 p1);
@@ -87,10 +93,12 @@ struct Polygon {
     void apply_repetition(Array<Polygon*>& result);
 
     // These functions output the polygon in the GDSII, OASIS and SVG formats.
-    // They are not supposed to be called by the user.
+    // They are not supposed to be called by the user.  SVG output can also be
+    // appended to a memory buffer.
     ErrorCode to_gds(FILE* out, double scaling) const;
     ErrorCode to_oas(OasisStream& out, OasisState& state) const;
     ErrorCode to_svg(FILE* out, double scaling, uint32_t precision) const;
+    ErrorCode to_svg(Array<char>& out, double scaling, uint32_t precision) const;
 };
 
 Polygon rectangle(const Vec2 corner1, const Vec2 corner2, Tag tag);
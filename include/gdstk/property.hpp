@@ -24,12 +24,20 @@ struct OasisState;
 // Properties (and their members) are assumed to always be allocated through
 // allocate, allocate_clear, or reallocate.
 
+// Property lists with at least this many properties are indexed by name.
+#define GDSTK_PROPERTY_INDEX_MIN 16
+
 enum struct PropertyType { UnsignedInteger, Integer, Real, String };
 
 // Each property can hold a series of values, which are represented by a
-// NULL-terminated linked list of PropertyValue
+// NULL-terminated linked list of PropertyValue.  String values created by the
+// functions below store their bytes in the same allocation as the value
+// (bytes_inline == true), so they must not be freed or reallocated
+// separately.  Values built by hand must be zero-initialized (bytes_inline ==
+// false): their bytes are freed with the value.
 struct PropertyValue {
     PropertyType type;
+    bool bytes_inline;
     union {
         uint64_t unsigned_integer;
         int64_t integer;
@@ -42,22 +50,52 @@ struct PropertyValue {
     PropertyValue* next;
 };
 
+struct PropertyIndex;
+
 // Properties are stored as a NULL-terminated linked list.  Their name is a
 // NULL-terminated string.  Property names in the OASIS should be strings of
 // characters within the range 0x21 and 0x7E with at least 1 character.
+//
+// Properties created by the functions below use interned names
+// (name_interned == true), which are shared by all properties with the same
+// name and never freed.  Properties built by hand must be zero-initialized:
+// their names are freed with the property.
+//
+// Large lists are indexed by name (index is set in the first property of the
+// indexed part of the list and NULL elsewhere), so that getting and setting
+// properties does not require a linear search.  Indices are only created and
+// maintained by the functions below.  Lists without indices can be built and
+// modified by hand, and properties can always be prepended by hand to a list
+// (they are searched linearly until the indexed part), but any other change
+// to an indexed list must go through these functions.
 struct Property {
     char* name;
     PropertyValue* value;
     Property* next;
+    PropertyIndex* index;
+    bool name_interned;
 };
 
+// Return the interned copy of name.  Interned names remain valid until the
+// end of the program.
+char* property_name_intern(const char* name);
+
 void properties_print(Property* properties);
 void properties_clear(Property*& properties);
 Property* properties_copy(const Property* properties);
 
-// property_values_copy is used in the OASIS reader; it is not intended to be
-// used elsewhere.
+// Hash of the properties names and values.  It is independent of the order of
+// the properties in the list, but not of the order of their values.
+uint64_t properties_hash(const Property* properties);
+
+// property_values_copy and property_values_clear are used in the OASIS reader;
+// they are not intended to be used elsewhere.
 PropertyValue* property_values_copy(const PropertyValue* values);
+void property_values_clear(PropertyValue* values);
+
+// Add a new property to the start of properties.  Values is a NULL-terminated
+// list owned by the new property.
+void add_property(Property*& properties, const char* name, PropertyValue* values);
 
 // The set_property functions add values to the first existing property with
 // the given name.  A new one is created if none exists or create_new == true.
@@ -0,0 +1,81 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_RASTER
+#define GDSTK_HEADER_RASTER
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "utils.hpp"
+#include "vec.hpp"
+
+namespace gdstk {
+
+// Number of pixel rows rendered by each parallel rasterization task.
+#define GDSTK_RASTER_BAND_HEIGHT 32
+
+// Overlapping geometry in density maps is merged in regions split in half
+// until they hold at most GDSTK_DENSITY_MERGE_COUNT polygons (up to
+// GDSTK_DENSITY_MERGE_DEPTH times).
+#define GDSTK_DENSITY_MERGE_COUNT 256
+#define GDSTK_DENSITY_MERGE_DEPTH 24
+
+// Rasterization of cell geometry.  The rectangular window with corners min and
+// max (in user units) is mapped to an image with width × height pixels.  Pixels
+// are stored in row-major order, starting from the top row (max.y).  The cell
+// is rendered hierarchically: polygons and paths from references are included
+// with the reference transformations, and references (or repetition instances)
+// whose bounding boxes are outside the window are pruned.  Pixel coverage is
+// calculated exactly from the polygon areas (anti-aliased scanline fill), with
+// overlapping polygons in the same tag accumulated and clipped to full
+// coverage.  Image bands of GDSTK_RASTER_BAND_HEIGHT rows are rendered in
+// parallel.
+
+// Render the coverage of the geometry with each tag in tags.  Argument
+// coverage must hold tags.count buffers of width × height bytes, where the
+// coverage of tags[i] is written, from 0 (empty) to 255 (fully covered).
+ErrorCode rasterize_coverage(const Cell& cell, const Vec2 min, const Vec2 max, uint64_t width,
+                             uint64_t height, const Array<Tag>& tags, uint8_t** coverage);
+
+// Render the geometry with tags in tags to an RGBA image (width × height × 4
+// bytes, non-premultiplied alpha).  Each tag is composed with colors[i]
+// (0xRRGGBBAA) over the background, in the order they appear in tags.
+ErrorCode rasterize_rgba(const Cell& cell, const Vec2 min, const Vec2 max, uint64_t width,
+                         uint64_t height, const Array<Tag>& tags, const uint32_t* colors,
+                         uint32_t background, uint8_t* rgba);
+
+// Pattern density map.  The grid of columns × rows windows with size
+// window_size, starting at origin (lower left corner of the first window), is
+// filled with the fraction of each window area covered by the geometry with
+// each tag in tags.  Argument density must hold tags.count buffers of columns
+// × rows values, in row-major order starting from the bottom row (origin.y).
+// Areas are calculated analytically, with overlapping geometry merged by
+// boolean operations (executed with the given precision).  The polygons of
+// each cell are merged only once and references are accumulated
+// hierarchically: when the offset between repetition instances is a whole
+// number of windows, the contribution of the first instance is reused for the
+// others.  Where the bounding boxes of polygons and instances in a cell
+// overlap, its contents are flattened and merged within the accumulated
+// region instead.  Bands of windows are processed in parallel.
+ErrorCode density_map(const Cell& cell, const Vec2 origin, const Vec2 window_size,
+                      uint64_t columns, uint64_t rows, const Array<Tag>& tags, double precision,
+                      double** density);
+
+// Write a width × height image with 8-bit channels in PNG format.  The number
+// of channels must be 1 (grayscale), 2 (grayscale and alpha), 3 (RGB) or 4
+// (RGBA).
+ErrorCode write_png(const char* filename, const uint8_t* data, uint64_t width, uint64_t height,
+                    uint8_t channels);
+
+}  // namespace gdstk
+
+#endif
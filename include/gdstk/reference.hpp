@@ -86,6 +86,14 @@ struct Reference {
     void convex_hull(Array<Vec2>& result) const;
     void convex_hull(Array<Vec2>& result, Map<GeometryInfo>& cache) const;
 
+    // Hash of the reference transformation, repetition and properties, with
+    // offset subtracted from the origin, and coordinates rounded to multiples
+    // of 1 / scaling.  The content hash also includes the content hash of the
+    // referenced cell (see Cell::content_hash), or the name and size of the
+    // referenced rawcell.
+    uint64_t placement_hash(double scaling, const Vec2 offset) const;
+    uint64_t content_hash(double scaling, Map<uint64_t>& cache) const;
+
     // Transformations are applied in the order of arguments, starting with
     // magnification and translating by origin at the end.  This is equivalent
     // to the transformation defined by a Reference with the same arguments.
@@ -104,20 +112,48 @@ struct Reference {
     // negative, all levels are included.  If include_paths is true, the
     // polygonal representation of paths are also included in polygons.  If
     // filter is true, only polygons in the indicated layer and data type are
-    // created.
+    // created.  The caching versions use cache as in the equivalent Cell
+    // functions.
     void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
                       Tag tag, Array<Polygon*>& result) const;
+    void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                      Tag tag, Array<Polygon*>& result, Map<GeometryInfo>& cache) const;
     void get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                        Array<FlexPath*>& result) const;
+    void get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                       Array<FlexPath*>& result, Map<GeometryInfo>& cache) const;
     void get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                          Array<RobustPath*>& result) const;
+    void get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                         Array<RobustPath*>& result, Map<GeometryInfo>& cache) const;
     void get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                     Array<Label*>& result) const;
+    void get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                    Array<Label*>& result, Map<GeometryInfo>& cache) const;
+    // Multi-tag versions, as in the equivalent Cell functions.
+    void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                      const Array<Tag>& tags, Array<Polygon*>* result) const;
+    void get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                      const Array<Tag>& tags, Array<Polygon*>* result,
+                      Map<GeometryInfo>& cache) const;
+    void get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                       Array<FlexPath*>* result) const;
+    void get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                       Array<FlexPath*>* result, Map<GeometryInfo>& cache) const;
+    void get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                         Array<RobustPath*>* result) const;
+    void get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                         Array<RobustPath*>* result, Map<GeometryInfo>& cache) const;
+    void get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                    Array<Label*>* result) const;
+    void get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                    Array<Label*>* result, Map<GeometryInfo>& cache) const;
 
     // These functions output the reference in the GDSII and SVG formats.  They
     // are not supposed to be called by the user.
     ErrorCode to_gds(FILE* out, double scaling) const;
     ErrorCode to_svg(FILE* out, double scaling, uint32_t precision) const;
+    ErrorCode to_svg(Array<char>& out, double scaling, uint32_t precision) const;
 };
 
 }  // namespace gdstk
@@ -68,8 +68,48 @@ struct Repetition {
     // magnification and rotating at the end.  This is equivalent to the
     // transformation defined by a Reference with the same arguments.
     void transform(double magnification, bool x_reflection, double rotation);
+
+    // Hash of the repetition parameters with coordinates rounded to multiples
+    // of 1 / scaling.  Explicit offsets are hashed independently of order.
+    uint64_t content_hash(double scaling) const;
+};
+
+// Iterator over the offsets generated by a repetition, in the same order as
+// Repetition::get_offsets, without allocating memory.  A repetition of type
+// None generates a single offset (0, 0).  The repetition must not be modified
+// during the iteration.  Usage:
+//   RepetitionIterator iterator = {};
+//   iterator.init(repetition);
+//   Vec2 offset;
+//   while (iterator.next(offset)) { ... }
+struct RepetitionIterator {
+    const Repetition* repetition;
+    uint64_t count;  // Total number of offsets
+    uint64_t index;  // Index of the next offset
+    uint64_t column;
+    uint64_t row;
+
+    void init(const Repetition& repetition_);
+
+    // Write the next offset and return true, or return false if there are no
+    // more offsets.
+    bool next(Vec2& offset);
 };
 
+// Find subsets of points generated by repetitions.  Points are compared after
+// rounding to multiples of 1 / scaling.  If all points form a regular lattice
+// (1D or 2D, axis-aligned or not), a single rectangular or regular repetition
+// is found.  Otherwise, points with the same y coordinate are grouped in
+// rectangular (equally spaced) or explicit x repetitions, and remaining points
+// with the same x coordinate in rectangular or explicit y repetitions.  For
+// each subset, the index of its origin point (corresponding to offset (0, 0))
+// is appended to origins, and the repetition to repetitions.  The entries in
+// covered for the other points in the subset are set to true (covered must
+// have points.count entries).  Duplicate points are not included in any
+// subset.
+void find_repetitions(const Array<Vec2>& points, double scaling, Array<uint64_t>& origins,
+                      Array<Repetition>& repetitions, bool* covered);
+
 }  // namespace gdstk
 
 #endif
@@ -277,6 +277,7 @@ struct RobustPath {
     ErrorCode to_gds(FILE* out, double scaling) const;
     ErrorCode to_oas(OasisStream& out, OasisState& state) const;
     ErrorCode to_svg(FILE* out, double scaling, uint32_t precision) const;
+    ErrorCode to_svg(Array<char>& out, double scaling, uint32_t precision) const;
 
    private:
     void simple_scale(double scale);
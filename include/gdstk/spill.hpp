@@ -0,0 +1,75 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_SPILL
+#define GDSTK_HEADER_SPILL
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "allocator.hpp"
+#include "utils.hpp"
+
+namespace gdstk {
+
+// Size of the spill file chunks used as eviction units for the resident
+// working set.
+#define GDSTK_SPILL_CHUNK_SIZE (1ULL << 20)
+
+// Spill file growth step.
+#define GDSTK_SPILL_GROWTH (64ULL << 20)
+
+// Address space reserved for the spill file mapping.
+#define GDSTK_SPILL_RESERVATION (1ULL << 40)
+
+// Out-of-core storage mode.  While active, every request of at least threshold
+// bytes made through allocate, reallocate and allocate_clear is served from a
+// memory-mapped spill file instead of the heap.  That includes polygon points,
+// path spines and repetition offsets, which are stored in Array, so they are
+// still accessed transparently.  Chunks of the spill file are tracked in least
+// recently used order: when more than resident_limit bytes have been touched,
+// the oldest chunks are released from memory (they are written back to the
+// file and loaded again automatically when accessed).  Chunks that are not
+// resident are protected, so any access to them, including reads and in-place
+// modifications outside the allocator, is caught by a SIGSEGV/SIGBUS handler
+// that makes them resident again and evicts older ones.  Signals not caused by
+// spill accesses are forwarded to the previously installed handlers.  System
+// calls do not fault (they fail with EFAULT), so spill data must be resident
+// when passed to them directly: the writers only pass buffers they have just
+// filled, which remain resident as long as they are smaller than the limit.
+// The limit is raised to at least 4 chunks.  The spill file is created in
+// directory (or the system temporary directory, if NULL) and removed
+// automatically.
+//
+// The default allocator is required (GDSTK_CUSTOM_ALLOCATOR must not be
+// defined) and spill mode is only available on POSIX systems.  Spill
+// allocations and faults from parallel loops are serialized.
+struct SpillInfo {
+    uint64_t threshold;       // Current threshold (0 if inactive)
+    uint64_t file_size;       // Size of the spill file
+    uint64_t allocated;       // Bytes currently in use in live blocks
+    uint64_t block_count;     // Number of live blocks
+    uint64_t resident;        // Bytes in chunks currently resident
+    uint64_t resident_limit;  // Maximal resident bytes before eviction
+};
+
+ErrorCode spill_enable(const char* directory, uint64_t threshold, uint64_t resident_limit);
+
+// Stop serving new allocations from the spill file.  Existing blocks remain
+// valid; the file is closed when the last of them is freed.
+void spill_disable();
+
+// Release all spill data from memory.  It is loaded back when accessed.
+void spill_release();
+
+SpillInfo spill_info();
+
+}  // namespace gdstk
+
+#endif
@@ -0,0 +1,62 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_STATISTICS
+#define GDSTK_HEADER_STATISTICS
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "utils.hpp"
+
+namespace gdstk {
+
+// Flattened totals for a tag.  Polygons use the tag as layer and data type,
+// labels as layer and text type.
+struct TagStatistics {
+    Tag tag;
+    uint64_t polygon_count;
+    uint64_t vertex_count;
+    uint64_t label_count;
+    double area;  // Sum of the polygon areas (overlaps are counted repeatedly)
+};
+
+struct CellStatistics {
+    const Cell* cell;
+    // Number of instances of cell in the flattened top cell (1 for the top
+    // cell itself)
+    uint64_t instance_count;
+    // Totals for a single, flattened instance of cell
+    uint64_t polygon_count;
+    uint64_t vertex_count;
+    uint64_t label_count;
+    uint64_t reference_count;  // Instances of all referenced cells and rawcells
+    double area;
+    Array<TagStatistics> tag_array;  // Sorted by tag
+
+    void print() const;
+    void clear();
+};
+
+// Statistics of the flattened contents of cell and each cell in its
+// hierarchy, computed without flattening: the local contents of each cell are
+// counted only once and the totals of referenced cells are multiplied by the
+// number of repetitions in each reference (areas are also scaled by the
+// squared magnification).  If include_paths, paths are converted to polygons
+// for counting.  References to rawcells are counted as instances, but their
+// contents are not; references by name are ignored.  One entry is appended to
+// result for each cell, after the entries of all cells it references, so the
+// top cell is the last.
+ErrorCode cell_statistics(const Cell& cell, bool include_paths, Array<CellStatistics>& result);
+
+}  // namespace gdstk
+
+#endif
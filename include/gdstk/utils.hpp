@@ -56,6 +56,30 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #define FSEEK64 fseek
 #endif
 
+// Loops marked with GDSTK_PARALLEL_FOR run in parallel when the library is
+// compiled with OpenMP support.  Loop indices must be signed integers and the
+// loop body must not modify shared containers (Array, Map, Set, etc.)
+#ifdef _OPENMP
+#ifdef _MSC_VER
+#define GDSTK_PARALLEL_FOR __pragma(omp parallel for schedule(dynamic))
+#else
+#define GDSTK_PARALLEL_FOR _Pragma("omp parallel for schedule(dynamic)")
+#endif
+#else
+#define GDSTK_PARALLEL_FOR
+#endif
+
+// Loops marked with GDSTK_SIMD are vectorized with OpenMP SIMD directives when
+// available.  GDSTK_SIMD_SUM(var) also declares var as a sum reduction.
+#if defined(_OPENMP) && !defined(_MSC_VER)
+#define GDSTK_PRAGMA(x) _Pragma(#x)
+#define GDSTK_SIMD GDSTK_PRAGMA(omp simd)
+#define GDSTK_SIMD_SUM(var) GDSTK_PRAGMA(omp simd reduction(+ : var))
+#else
+#define GDSTK_SIMD
+#define GDSTK_SIMD_SUM(var)
+#endif
+
 #include <stdint.h>
 #include <time.h>
 
@@ -196,15 +220,28 @@ void convex_hull(const Array<Vec2> points, Array<Vec2>& result);
 // with a maximal precision set.  This function is meant for internal use only.
 char* double_print(double value, uint32_t precision, char* buffer, size_t buffer_size);
 
+// Append the NULL-terminated string (without the terminator) or the
+// printf-style formatted text to buffer.  Used to build text output in memory.
+void append_string(Array<char>& buffer, const char* str);
+void append_format(Array<char>& buffer, const char* format, ...);
+
 // Returns the default SVG style for a given tag.  The return value points to a
 // statically allocated buffer that is overwritten in future calls to this
 // function.
 const char* default_svg_shape_style(Tag tag);
 const char* default_svg_label_style(Tag tag);
 
+// Returns the default RGBA color (0xRRGGBBAA) for a given tag in raster
+// images, matching the default SVG shape style.
+uint32_t default_raster_color(Tag tag);
+
 // Thread-safe version of localtime.
 tm* get_now(tm& result);
 
+// Maximal number of threads used in parallel loops (1 if the library is
+// compiled without OpenMP support).
+uint64_t get_thread_count();
+
 // FNV-1a hash function (64 bits)
 #define HASH_FNV_PRIME 0x00000100000001b3
 #define HASH_FNV_OFFSET 0xcbf29ce484222325
@@ -228,6 +265,19 @@ inline uint64_t hash(const char* key) {
     return result;
 }
 
+// Mix value into the hash seed (64-bit finalizer from SplitMix64)
+inline uint64_t hash_combine(uint64_t seed, uint64_t value) {
+    uint64_t z = seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// Hash of a coordinate value rounded to a multiple of 1 / scaling
+inline uint64_t hash_coordinate(double value, double scaling) {
+    return (uint64_t)llround(value * scaling);
+}
+
 extern FILE* error_logger;
 void set_error_logger(FILE* log);
 
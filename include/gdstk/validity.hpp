@@ -0,0 +1,65 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#ifndef GDSTK_HEADER_VALIDITY
+#define GDSTK_HEADER_VALIDITY
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include "array.hpp"
+#include "cell.hpp"
+#include "polygon.hpp"
+#include "utils.hpp"
+
+namespace gdstk {
+
+// Problems found in a polygon.  Coordinates are compared exactly, so
+// callers working on a grid should snap the polygons first.
+struct PolygonCheck {
+    bool duplicate_point;    // Consecutive coincident vertices
+    bool spike;              // Collinear consecutive edges that reverse direction
+    bool degenerate;         // Less than 3 distinct vertices or zero area
+    bool self_intersecting;  // Non-adjacent edges crossing each other
+    // Orientation of the polygon.  This is informative only and does not
+    // make the polygon invalid.
+    bool clockwise;
+
+    bool valid() const { return !(duplicate_point || spike || degenerate || self_intersecting); }
+};
+
+// Check a single polygon.  Self-intersections are found with a sweep over the
+// edges sorted by their lower x coordinate, so only edges with overlapping
+// bounding boxes are tested against each other.  Edges that touch or overlap
+// without crossing (as in holes connected to the outer boundary by a
+// zero-width cut) are not reported as intersecting.
+PolygonCheck check_polygon(const Polygon& polygon);
+
+// Check each polygon in parallel, appending one entry per polygon to result.
+void check_polygons(const Array<Polygon*>& polygons, Array<PolygonCheck>& result);
+
+// Replace invalid polygons (according to their entries in checks) by the
+// result of merging each of them individually with the given scaling (see
+// merge), which removes spikes, duplicate points and zero-area parts and
+// splits self-intersecting polygons.  New polygons keep the tag, repetition
+// and properties of the original and take its position in the array.
+// Replaced polygons are appended to removed and not freed.  Merging is done
+// in parallel.
+ErrorCode repair_polygons(Array<Polygon*>& polygons, const Array<PolygonCheck>& checks,
+                          double scaling, Array<Polygon*>& removed);
+
+// Check the polygons in cell (paths are not included), appending the results
+// to result.  If repair, invalid polygons are replaced in the cell as in
+// repair_polygons.
+ErrorCode check_cell_polygons(Cell& cell, bool repair, double scaling,
+                              Array<PolygonCheck>& result, Array<Polygon*>& removed);
+
+}  // namespace gdstk
+
+#endif
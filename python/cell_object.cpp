@@ -72,6 +72,7 @@ static int cell_object_init(CellObject* self, PyObject* args, PyObject* kwds) {
 static PyObject* cell_object_add(CellObject* self, PyObject* args) {
     uint64_t len = PyTuple_GET_SIZE(args);
     Cell* cell = self->cell;
+    cell->modification_count++;
     for (uint64_t i = 0; i < len; i++) {
         PyObject* arg = PyTuple_GET_ITEM(args, i);
         Py_INCREF(arg);
@@ -248,13 +249,16 @@ static PyObject* cell_object_get_polygons(CellObject* self, PyObject* args, PyOb
     PyObject* py_depth = Py_None;
     PyObject* py_layer = Py_None;
     PyObject* py_datatype = Py_None;
+    PyObject* py_tags = Py_None;
     const char* keywords[] = {
-        "apply_repetitions", "include_paths", "depth", "layer", "datatype", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ppOOO:get_polygons", (char**)keywords,
+        "apply_repetitions", "include_paths", "depth", "layer", "datatype", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ppOOOO:get_polygons", (char**)keywords,
                                      &apply_repetitions, &include_paths, &py_depth, &py_layer,
-                                     &py_datatype))
+                                     &py_datatype, &py_tags))
         return NULL;
 
+    self->cell->update_tag_buckets(false);
+
     int64_t depth = -1;
     if (py_depth != Py_None) {
         depth = PyLong_AsLongLong(py_depth);
@@ -264,6 +268,26 @@ static PyObject* cell_object_get_polygons(CellObject* self, PyObject* args, PyOb
         }
     }
 
+    if (py_tags != Py_None) {
+        if (py_layer != Py_None || py_datatype != Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument tags cannot be used with layer or datatype.");
+            return NULL;
+        }
+        Array<Tag> tags = {};
+        if (parse_tag_array(py_tags, tags, "tags") < 0) {
+            tags.clear();
+            return NULL;
+        }
+        Array<Polygon*>* arrays =
+            (Array<Polygon*>*)allocate_clear(tags.count * sizeof(Array<Polygon*>));
+        self->cell->get_polygons(apply_repetitions > 0, include_paths > 0, depth, tags, arrays);
+        PyObject* result = build_tagged_elements(tags, arrays, (Array<Polygon*>*)NULL);
+        free_allocation(arrays);
+        tags.clear();
+        return result;
+    }
+
     if ((py_layer == Py_None) != (py_datatype == Py_None)) {
         PyErr_SetString(PyExc_ValueError,
                         "Filtering is only enabled if both layer and datatype are set.");
@@ -319,11 +343,15 @@ static PyObject* cell_object_get_paths(CellObject* self, PyObject* args, PyObjec
     PyObject* py_depth = Py_None;
     PyObject* py_layer = Py_None;
     PyObject* py_datatype = Py_None;
-    const char* keywords[] = {"apply_repetitions", "depth", "layer", "datatype", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOO:get_polygons", (char**)keywords,
-                                     &apply_repetitions, &py_depth, &py_layer, &py_datatype))
+    PyObject* py_tags = Py_None;
+    const char* keywords[] = {"apply_repetitions", "depth", "layer", "datatype", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOOO:get_paths", (char**)keywords,
+                                     &apply_repetitions, &py_depth, &py_layer, &py_datatype,
+                                     &py_tags))
         return NULL;
 
+    self->cell->update_tag_buckets(false);
+
     int64_t depth = -1;
     if (py_depth != Py_None) {
         depth = PyLong_AsLongLong(py_depth);
@@ -333,6 +361,30 @@ static PyObject* cell_object_get_paths(CellObject* self, PyObject* args, PyObjec
         }
     }
 
+    if (py_tags != Py_None) {
+        if (py_layer != Py_None || py_datatype != Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument tags cannot be used with layer or datatype.");
+            return NULL;
+        }
+        Array<Tag> tags = {};
+        if (parse_tag_array(py_tags, tags, "tags") < 0) {
+            tags.clear();
+            return NULL;
+        }
+        Array<FlexPath*>* fp_arrays =
+            (Array<FlexPath*>*)allocate_clear(tags.count * sizeof(Array<FlexPath*>));
+        Array<RobustPath*>* rp_arrays =
+            (Array<RobustPath*>*)allocate_clear(tags.count * sizeof(Array<RobustPath*>));
+        self->cell->get_flexpaths(apply_repetitions > 0, depth, tags, fp_arrays);
+        self->cell->get_robustpaths(apply_repetitions > 0, depth, tags, rp_arrays);
+        PyObject* result = build_tagged_elements(tags, fp_arrays, rp_arrays);
+        free_allocation(fp_arrays);
+        free_allocation(rp_arrays);
+        tags.clear();
+        return result;
+    }
+
     uint32_t layer = 0;
     uint32_t datatype = 0;
     bool filter = (py_layer != Py_None) && (py_datatype != Py_None);
@@ -400,11 +452,15 @@ static PyObject* cell_object_get_labels(CellObject* self, PyObject* args, PyObje
     PyObject* py_depth = Py_None;
     PyObject* py_layer = Py_None;
     PyObject* py_texttype = Py_None;
-    const char* keywords[] = {"apply_repetitions", "depth", "layer", "texttype", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOO:get_polygons", (char**)keywords,
-                                     &apply_repetitions, &py_depth, &py_layer, &py_texttype))
+    PyObject* py_tags = Py_None;
+    const char* keywords[] = {"apply_repetitions", "depth", "layer", "texttype", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOOO:get_labels", (char**)keywords,
+                                     &apply_repetitions, &py_depth, &py_layer, &py_texttype,
+                                     &py_tags))
         return NULL;
 
+    self->cell->update_tag_buckets(false);
+
     int64_t depth = -1;
     if (py_depth != Py_None) {
         depth = PyLong_AsLongLong(py_depth);
@@ -414,6 +470,25 @@ static PyObject* cell_object_get_labels(CellObject* self, PyObject* args, PyObje
         }
     }
 
+    if (py_tags != Py_None) {
+        if (py_layer != Py_None || py_texttype != Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument tags cannot be used with layer or texttype.");
+            return NULL;
+        }
+        Array<Tag> tags = {};
+        if (parse_tag_array(py_tags, tags, "tags") < 0) {
+            tags.clear();
+            return NULL;
+        }
+        Array<Label*>* arrays = (Array<Label*>*)allocate_clear(tags.count * sizeof(Array<Label*>));
+        self->cell->get_labels(apply_repetitions > 0, depth, tags, arrays);
+        PyObject* result = build_tagged_elements(tags, arrays, (Array<Label*>*)NULL);
+        free_allocation(arrays);
+        tags.clear();
+        return result;
+    }
+
     uint32_t layer = 0;
     uint32_t texttype = 0;
     bool filter = (py_layer != Py_None) && (py_texttype != Py_None);
@@ -662,6 +737,14 @@ static PyObject* cell_object_copy(CellObject* self, PyObject* args, PyObject* kw
     return (PyObject*)result;
 }
 
+static PyObject* cell_object_deepcopy(CellObject* self, PyObject* arg) {
+    PyObject* args = Py_BuildValue("(s)", self->cell->name);
+    if (!args) return NULL;
+    PyObject* result = cell_object_copy(self, args, NULL);
+    Py_DECREF(args);
+    return result;
+}
+
 static PyObject* cell_object_write_svg(CellObject* self, PyObject* args, PyObject* kwds) {
     double scaling = 10;
     unsigned int precision = 6;
@@ -670,14 +753,22 @@ static PyObject* cell_object_write_svg(CellObject* self, PyObject* args, PyObjec
     PyObject* label_style_obj = Py_None;
     PyObject* pad_obj = NULL;
     PyObject* sort_obj = Py_None;
+    PyObject* compress_obj = Py_None;
     const char* background = "#222222";
-    const char* keywords[] = {"outfile",     "scaling",       "precision",
-                              "shape_style", "label_style",   "background",
-                              "pad",         "sort_function", NULL};
-    if (!PyArg_ParseTupleAndKeywords(
-            args, kwds, "O&|dIOOzOO:write_svg", (char**)keywords, PyUnicode_FSConverter, &pybytes,
-            &scaling, &precision, &style_obj, &label_style_obj, &background, &pad_obj, &sort_obj))
+    SvgLevelOfDetail lod = {};
+    int outline = 0;
+    unsigned long long max_polygons = 0;
+    const char* keywords[] = {"outfile",     "scaling",    "precision",    "shape_style",
+                              "label_style", "background", "pad",          "sort_function",
+                              "min_size",    "outline",    "max_polygons", "compress",
+                              NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|dIOOzOOdpKO:write_svg", (char**)keywords,
+                                     PyUnicode_FSConverter, &pybytes, &scaling, &precision,
+                                     &style_obj, &label_style_obj, &background, &pad_obj, &sort_obj,
+                                     &lod.min_size, &outline, &max_polygons, &compress_obj))
         return NULL;
+    lod.outline = outline > 0;
+    lod.max_polygons = max_polygons;
 
     double pad = 5;
     bool pad_as_percentage = true;
@@ -725,10 +816,20 @@ static PyObject* cell_object_write_svg(CellObject* self, PyObject* args, PyObjec
 
     const char* filename = PyBytes_AS_STRING(pybytes);
 
+    bool compressed;
+    if (compress_obj == Py_None) {
+        uint64_t len = strlen(filename);
+        compressed = len >= 5 && strcmp(filename + len - 5, ".svgz") == 0;
+    } else {
+        compressed = PyObject_IsTrue(compress_obj) > 0;
+    }
+    const SvgLevelOfDetail* lod_p = lod.min_size > 0 || lod.max_polygons > 0 ? &lod : NULL;
+
     ErrorCode error_code;
     if (sort_obj == Py_None) {
         error_code = self->cell->write_svg(filename, scaling, precision, &shape_style, &label_style,
-                                           background, pad, pad_as_percentage, NULL);
+                                           background, pad, pad_as_percentage, NULL, lod_p,
+                                           compressed);
     } else {
         if (!PyCallable_Check(sort_obj)) {
             PyErr_SetString(PyExc_TypeError, "Argument sort_function must be callable.");
@@ -740,7 +841,8 @@ static PyObject* cell_object_write_svg(CellObject* self, PyObject* args, PyObjec
         polygon_comparison_pyfunc = sort_obj;
         polygon_comparison_pylist = PyList_New(0);
         error_code = self->cell->write_svg(filename, scaling, precision, &shape_style, &label_style,
-                                           background, pad, pad_as_percentage, polygon_comparison);
+                                           background, pad, pad_as_percentage, polygon_comparison,
+                                           lod_p, compressed);
         Py_DECREF(polygon_comparison_pylist);
         polygon_comparison_pylist = NULL;
         polygon_comparison_pyfunc = NULL;
@@ -757,8 +859,977 @@ static PyObject* cell_object_write_svg(CellObject* self, PyObject* args, PyObjec
     return (PyObject*)self;
 }
 
+// Parse the rasterization window and image height.  The cell bounding box is
+// used if the window is None and the height is calculated from the window
+// aspect ratio if it is None.
+static int parse_raster_window(const Cell* cell, PyObject* py_window, uint64_t width,
+                               PyObject* py_height, Vec2& min, Vec2& max, uint64_t& height) {
+    if (py_window == Py_None) {
+        cell->bounding_box(min, max);
+        if (min.x > max.x) {
+            min = Vec2{0, 0};
+            max = Vec2{1, 1};
+        }
+    } else if (!PySequence_Check(py_window) || PySequence_Length(py_window) != 2) {
+        PyErr_SetString(PyExc_TypeError,
+                        "Argument window must be a sequence of 2 points (lower left and upper "
+                        "right corners).");
+        return -1;
+    } else {
+        PyObject* point = PySequence_ITEM(py_window, 0);
+        int result = parse_point(point, min, "window");
+        Py_XDECREF(point);
+        if (result < 0) return -1;
+        point = PySequence_ITEM(py_window, 1);
+        result = parse_point(point, max, "window");
+        Py_XDECREF(point);
+        if (result < 0) return -1;
+    }
+    if (width == 0) {
+        PyErr_SetString(PyExc_ValueError, "Argument width must be positive.");
+        return -1;
+    }
+    if (py_height == Py_None) {
+        Vec2 size = max - min;
+        height = size.x > 0 ? (uint64_t)llround(width * size.y / size.x) : width;
+        if (height == 0) height = 1;
+    } else {
+        height = PyLong_AsUnsignedLongLong(py_height);
+        if (PyErr_Occurred() || height == 0) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_ValueError, "Argument height must be a positive integer.");
+            return -1;
+        }
+    }
+    if (max.x <= min.x || max.y <= min.y) {
+        PyErr_SetString(PyExc_ValueError, "Argument window must have a positive area.");
+        return -1;
+    }
+    return 0;
+}
+
+// Shape tags of cell and its dependencies, sorted
+static void raster_shape_tags(const Cell* cell, Array<Tag>& result) {
+    Set<Tag> tags = {};
+    cell->get_shape_tags(tags);
+    Map<Cell*> cell_map = {};
+    cell->get_dependencies(true, cell_map);
+    for (MapItem<Cell*>* item = cell_map.next(NULL); item; item = cell_map.next(item)) {
+        item->value->get_shape_tags(tags);
+    }
+    cell_map.clear();
+    tags.to_array(result);
+    tags.clear();
+    sort(result);
+}
+
+// Parse the colors of the rendered tags.  All shape tags are rendered with
+// default colors if py_colors is None.
+static int parse_raster_colors(const Cell* cell, PyObject* py_colors, Array<Tag>& tags,
+                               Array<uint32_t>& colors) {
+    if (py_colors == Py_None) {
+        raster_shape_tags(cell, tags);
+        colors.ensure_slots(tags.count);
+        for (uint64_t i = 0; i < tags.count; i++) {
+            colors.append_unsafe(default_raster_color(tags[i]));
+        }
+        return 0;
+    }
+
+    if (!PyDict_Check(py_colors)) {
+        PyErr_SetString(PyExc_TypeError, "Argument colors must be a dictionary.");
+        return -1;
+    }
+    PyObject* py_tag;
+    PyObject* py_color;
+    Py_ssize_t j = 0;
+    while (PyDict_Next(py_colors, &j, &py_tag, &py_color)) {
+        Tag tag;
+        if (!parse_tag(py_tag, tag)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError,
+                            "Keys in argument colors must be (layer, datatype) tuples.");
+            return -1;
+        }
+        tags.append(tag);
+    }
+    sort(tags);
+    colors.ensure_slots(tags.count);
+    for (uint64_t i = 0; i < tags.count; i++) {
+        PyObject* key = Py_BuildValue("(II)", get_layer(tags[i]), get_type(tags[i]));
+        py_color = PyDict_GetItem(py_colors, key);
+        Py_DECREF(key);
+        uint32_t color;
+        if (!py_color || !parse_color(py_color, color, "colors")) return -1;
+        colors.append_unsafe(color);
+    }
+    return 0;
+}
+
+static PyObject* cell_object_rasterize(CellObject* self, PyObject* args, PyObject* kwds) {
+    unsigned long long width = 0;
+    PyObject* py_height = Py_None;
+    PyObject* py_window = Py_None;
+    PyObject* py_tags = Py_None;
+    const char* keywords[] = {"width", "height", "window", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "K|OOO:rasterize", (char**)keywords, &width,
+                                     &py_height, &py_window, &py_tags))
+        return NULL;
+
+    Cell* cell = self->cell;
+    Vec2 min, max;
+    uint64_t height;
+    if (parse_raster_window(cell, py_window, width, py_height, min, max, height) < 0) return NULL;
+
+    Array<Tag> tags = {};
+    if (py_tags == Py_None) {
+        raster_shape_tags(cell, tags);
+    } else {
+        Set<Tag> tag_set = {};
+        if (parse_tag_sequence(py_tags, tag_set, "tags") < 0) {
+            tag_set.clear();
+            return NULL;
+        }
+        tag_set.to_array(tags);
+        tag_set.clear();
+        sort(tags);
+    }
+
+    PyObject* result = PyDict_New();
+    uint8_t** coverage = (uint8_t**)allocate(tags.count * sizeof(uint8_t*));
+    npy_intp dims[] = {(npy_intp)height, (npy_intp)width};
+    for (uint64_t i = 0; i < tags.count; i++) {
+        PyObject* array = PyArray_SimpleNew(2, dims, NPY_UINT8);
+        if (!array) {
+            PyErr_SetString(PyExc_MemoryError, "Unable to create return array.");
+            Py_DECREF(result);
+            free_allocation(coverage);
+            tags.clear();
+            return NULL;
+        }
+        coverage[i] = (uint8_t*)PyArray_DATA((PyArrayObject*)array);
+        PyObject* key = Py_BuildValue("(II)", get_layer(tags[i]), get_type(tags[i]));
+        PyDict_SetItem(result, key, array);
+        Py_DECREF(key);
+        Py_DECREF(array);
+    }
+
+    ErrorCode error_code = rasterize_coverage(*cell, min, max, width, height, tags, coverage);
+    free_allocation(coverage);
+    tags.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Dimensions given as a single number or a pair of numbers, both positive
+static int parse_positive_size(PyObject* py_size, Vec2& size, const char* name) {
+    if (PyComplex_Check(py_size) || PySequence_Check(py_size)) {
+        if (parse_point(py_size, size, name) < 0) return -1;
+    } else {
+        size.x = size.y = PyFloat_AsDouble(py_size);
+        if (PyErr_Occurred()) {
+            PyErr_Format(PyExc_TypeError,
+                         "Argument %s must be a number or a sequence of 2 numbers.", name);
+            return -1;
+        }
+    }
+    if (size.x <= 0 || size.y <= 0) {
+        PyErr_Format(PyExc_ValueError, "Argument %s must be positive.", name);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* cell_object_density_map(CellObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* py_size = NULL;
+    PyObject* py_window = Py_None;
+    PyObject* py_tags = Py_None;
+    double precision = 1e-3;
+    const char* keywords[] = {"window_size", "window", "tags", "precision", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOd:density_map", (char**)keywords, &py_size,
+                                     &py_window, &py_tags, &precision))
+        return NULL;
+
+    Vec2 size;
+    if (parse_positive_size(py_size, size, "window_size") < 0) return NULL;
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    Cell* cell = self->cell;
+    Vec2 min, max;
+    uint64_t height;
+    if (parse_raster_window(cell, py_window, 1, Py_None, min, max, height) < 0) return NULL;
+    uint64_t columns = (uint64_t)ceil((max.x - min.x) / size.x - 1e-9);
+    uint64_t rows = (uint64_t)ceil((max.y - min.y) / size.y - 1e-9);
+    if (columns == 0) columns = 1;
+    if (rows == 0) rows = 1;
+
+    Array<Tag> tags = {};
+    if (py_tags == Py_None) {
+        raster_shape_tags(cell, tags);
+    } else {
+        Set<Tag> tag_set = {};
+        if (parse_tag_sequence(py_tags, tag_set, "tags") < 0) {
+            tag_set.clear();
+            return NULL;
+        }
+        tag_set.to_array(tags);
+        tag_set.clear();
+        sort(tags);
+    }
+
+    PyObject* result = PyDict_New();
+    double** density = (double**)allocate(tags.count * sizeof(double*));
+    npy_intp dims[] = {(npy_intp)rows, (npy_intp)columns};
+    for (uint64_t i = 0; i < tags.count; i++) {
+        PyObject* array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+        if (!array) {
+            PyErr_SetString(PyExc_MemoryError, "Unable to create return array.");
+            Py_DECREF(result);
+            free_allocation(density);
+            tags.clear();
+            return NULL;
+        }
+        density[i] = (double*)PyArray_DATA((PyArrayObject*)array);
+        PyObject* key = Py_BuildValue("(II)", get_layer(tags[i]), get_type(tags[i]));
+        PyDict_SetItem(result, key, array);
+        Py_DECREF(key);
+        Py_DECREF(array);
+    }
+
+    ErrorCode error_code = density_map(*cell, min, size, columns, rows, tags, precision, density);
+    free_allocation(density);
+    tags.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Exclusion tags given as a mapping from (layer, datatype) to keep-out
+// distance or as a sequence of (layer, datatype) (no keep-out).
+static int parse_fill_exclusions(PyObject* py_exclusions, Array<Tag>& tags,
+                                 Array<double>& keep_out) {
+    if (py_exclusions == Py_None) return 0;
+    if (PyDict_Check(py_exclusions)) {
+        Py_ssize_t pos = 0;
+        PyObject* key;
+        PyObject* value;
+        while (PyDict_Next(py_exclusions, &pos, &key, &value)) {
+            Tag tag;
+            if (!parse_tag(key, tag)) {
+                PyErr_SetString(PyExc_TypeError,
+                                "Keys in argument exclusions must be (layer, datatype) tuples.");
+                return -1;
+            }
+            double distance = PyFloat_AsDouble(value);
+            if (PyErr_Occurred()) {
+                PyErr_SetString(PyExc_TypeError,
+                                "Values in argument exclusions must be keep-out distances.");
+                return -1;
+            }
+            if (distance < 0) {
+                PyErr_SetString(PyExc_ValueError, "Keep-out distances cannot be negative.");
+                return -1;
+            }
+            tags.append(tag);
+            keep_out.append(distance);
+        }
+        return 0;
+    }
+    Set<Tag> tag_set = {};
+    if (parse_tag_sequence(py_exclusions, tag_set, "exclusions") < 0) {
+        tag_set.clear();
+        return -1;
+    }
+    tag_set.to_array(tags);
+    tag_set.clear();
+    for (uint64_t i = 0; i < tags.count; i++) keep_out.append(0);
+    return 0;
+}
+
+static PyObject* cell_object_fill(CellObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* py_element = NULL;
+    PyObject* py_pitch = NULL;
+    PyObject* py_window = Py_None;
+    PyObject* py_exclusions = Py_None;
+    double density = 0;
+    PyObject* py_tile_size = Py_None;
+    double precision = 1e-3;
+    const char* keywords[] = {"element", "pitch",     "window",    "exclusions",
+                              "density", "tile_size", "precision", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|OOdOd:fill", (char**)keywords, &py_element,
+                                     &py_pitch, &py_window, &py_exclusions, &density,
+                                     &py_tile_size, &precision))
+        return NULL;
+
+    if (!CellObject_Check(py_element) && !PolygonObject_Check(py_element)) {
+        PyErr_SetString(PyExc_TypeError, "Argument element must be a Cell or a Polygon.");
+        return NULL;
+    }
+    Vec2 pitch;
+    if (parse_positive_size(py_pitch, pitch, "pitch") < 0) return NULL;
+    Vec2 tile_size = {0, 0};
+    if (py_tile_size != Py_None && parse_positive_size(py_tile_size, tile_size, "tile_size") < 0)
+        return NULL;
+    if (density < 0 || density > 1) {
+        PyErr_SetString(PyExc_ValueError, "Argument density must be between 0 and 1.");
+        return NULL;
+    }
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    Cell* cell = self->cell;
+    Vec2 min, max;
+    uint64_t height;
+    if (parse_raster_window(cell, py_window, 1, Py_None, min, max, height) < 0) return NULL;
+
+    Array<Tag> exclusion_tags = {};
+    Array<double> keep_out = {};
+    if (parse_fill_exclusions(py_exclusions, exclusion_tags, keep_out) < 0) {
+        exclusion_tags.clear();
+        keep_out.clear();
+        return NULL;
+    }
+
+    PyObject* result;
+    ErrorCode error_code;
+    if (CellObject_Check(py_element)) {
+        CellObject* element = (CellObject*)py_element;
+        Array<Reference*> references = {};
+        error_code = fill_cell(*cell, min, max, element->cell, pitch, exclusion_tags, keep_out,
+                               density, tile_size, precision, references);
+        result = PyList_New(references.count);
+        for (uint64_t i = 0; i < references.count; i++) {
+            Reference* reference = references[i];
+            ReferenceObject* obj = PyObject_New(ReferenceObject, &reference_object_type);
+            obj = (ReferenceObject*)PyObject_Init((PyObject*)obj, &reference_object_type);
+            obj->reference = reference;
+            reference->owner = obj;
+            Py_INCREF(element);
+            PyList_SET_ITEM(result, i, (PyObject*)obj);
+        }
+        references.clear();
+    } else {
+        Array<Polygon*> polygons = {};
+        error_code = fill_polygon(*cell, min, max, *((PolygonObject*)py_element)->polygon, pitch,
+                                  exclusion_tags, keep_out, density, tile_size, precision,
+                                  polygons);
+        result = PyList_New(polygons.count);
+        for (uint64_t i = 0; i < polygons.count; i++) {
+            Polygon* polygon = polygons[i];
+            PolygonObject* obj = PyObject_New(PolygonObject, &polygon_object_type);
+            obj = (PolygonObject*)PyObject_Init((PyObject*)obj, &polygon_object_type);
+            obj->polygon = polygon;
+            polygon->owner = obj;
+            PyList_SET_ITEM(result, i, (PyObject*)obj);
+        }
+        polygons.clear();
+    }
+    exclusion_tags.clear();
+    keep_out.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Via rules given as a mapping from via (layer, datatype) to a pair of
+// connected (layer, datatype)
+static int parse_via_rules(PyObject* py_vias, Array<ViaRule>& rules) {
+    if (py_vias == Py_None) return 0;
+    if (!PyDict_Check(py_vias)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "Argument vias must be a dictionary mapping (layer, datatype) tuples "
+                        "to pairs of (layer, datatype) tuples.");
+        return -1;
+    }
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    while (PyDict_Next(py_vias, &pos, &key, &value)) {
+        ViaRule rule;
+        bool valid = parse_tag(key, rule.via) && PySequence_Check(value) &&
+                     PySequence_Length(value) == 2;
+        if (valid) {
+            PyObject* item = PySequence_ITEM(value, 0);
+            valid = item && parse_tag(item, rule.bottom);
+            Py_XDECREF(item);
+        }
+        if (valid) {
+            PyObject* item = PySequence_ITEM(value, 1);
+            valid = item && parse_tag(item, rule.top);
+            Py_XDECREF(item);
+        }
+        if (!valid) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError,
+                            "Argument vias must be a dictionary mapping (layer, datatype) tuples "
+                            "to pairs of (layer, datatype) tuples.");
+            return -1;
+        }
+        rules.append(rule);
+    }
+    return 0;
+}
+
+// Label rules given as a mapping from label (layer, texttype) to conductor
+// (layer, datatype)
+static int parse_label_rules(PyObject* py_labels, Array<LabelRule>& rules) {
+    if (!PyDict_Check(py_labels)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "Argument labels must be a dictionary mapping (layer, texttype) tuples "
+                        "to (layer, datatype) tuples.");
+        return -1;
+    }
+    Py_ssize_t pos = 0;
+    PyObject* key;
+    PyObject* value;
+    while (PyDict_Next(py_labels, &pos, &key, &value)) {
+        LabelRule rule;
+        if (!parse_tag(key, rule.label) || !parse_tag(value, rule.conductor)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError,
+                            "Argument labels must be a dictionary mapping (layer, texttype) "
+                            "tuples to (layer, datatype) tuples.");
+            return -1;
+        }
+        rules.append(rule);
+    }
+    return 0;
+}
+
+static PyObject* cell_object_extract_nets(CellObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* py_conductors = NULL;
+    PyObject* py_vias = Py_None;
+    PyObject* py_labels = Py_None;
+    PyObject* py_window = Py_None;
+    double precision = 1e-3;
+    const char* keywords[] = {"conductors", "vias", "labels", "window", "precision", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOOd:extract_nets", (char**)keywords,
+                                     &py_conductors, &py_vias, &py_labels, &py_window,
+                                     &precision))
+        return NULL;
+
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    Vec2 min = {1, 1};
+    Vec2 max = {-1, -1};
+    if (py_window != Py_None) {
+        uint64_t height;
+        if (parse_raster_window(self->cell, py_window, 1, Py_None, min, max, height) < 0)
+            return NULL;
+    }
+
+    Array<Tag> conductor_tags = {};
+    Set<Tag> tag_set = {};
+    if (parse_tag_sequence(py_conductors, tag_set, "conductors") < 0) {
+        tag_set.clear();
+        return NULL;
+    }
+    tag_set.to_array(conductor_tags);
+    tag_set.clear();
+    sort(conductor_tags);
+
+    Array<ViaRule> via_rules = {};
+    if (parse_via_rules(py_vias, via_rules) < 0) {
+        conductor_tags.clear();
+        via_rules.clear();
+        return NULL;
+    }
+
+    Array<LabelRule> label_rules = {};
+    if (py_labels == Py_None) {
+        label_rules.ensure_slots(conductor_tags.count);
+        for (uint64_t i = 0; i < conductor_tags.count; i++) {
+            label_rules.append_unsafe(LabelRule{conductor_tags[i], conductor_tags[i]});
+        }
+    } else {
+        if (parse_label_rules(py_labels, label_rules) < 0) {
+            conductor_tags.clear();
+            via_rules.clear();
+            label_rules.clear();
+            return NULL;
+        }
+    }
+
+    Array<Net> nets = {};
+    ErrorCode error_code = extract_nets(*self->cell, conductor_tags, via_rules, label_rules, min,
+                                        max, precision, nets);
+    conductor_tags.clear();
+    via_rules.clear();
+    label_rules.clear();
+
+    PyObject* result = PyList_New(nets.count);
+    for (uint64_t i = 0; i < nets.count; i++) {
+        Net* net = nets.items + i;
+        PyObject* names = PyList_New(net->name_array.count);
+        for (uint64_t j = 0; j < net->name_array.count; j++) {
+            PyList_SET_ITEM(names, j, PyUnicode_FromString(net->name_array[j]));
+        }
+        PyObject* polygons = PyList_New(net->polygon_array.count);
+        for (uint64_t j = 0; j < net->polygon_array.count; j++) {
+            Polygon* polygon = net->polygon_array[j];
+            PolygonObject* obj = PyObject_New(PolygonObject, &polygon_object_type);
+            obj = (PolygonObject*)PyObject_Init((PyObject*)obj, &polygon_object_type);
+            obj->polygon = polygon;
+            polygon->owner = obj;
+            PyList_SET_ITEM(polygons, j, (PyObject*)obj);
+        }
+        // Polygons are now owned by the Python objects
+        net->polygon_array.count = 0;
+        net->clear();
+        PyList_SET_ITEM(result, i, PyTuple_Pack(2, names, polygons));
+        Py_DECREF(names);
+        Py_DECREF(polygons);
+    }
+    nets.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+// Rules given as a sequence of tuples: ("width", tag, value), ("spacing", tag1,
+// [tag2,] value), ("enclosure", outer_tag, inner_tag, value), ("area", tag, value)
+static int parse_drc_rules(PyObject* py_rules, Array<DrcRule>& rules) {
+    const char* message =
+        "Argument rules must be a sequence of tuples (check, (layer, datatype), [(layer, "
+        "datatype),] value), with check one of 'width', 'spacing', 'enclosure' or 'area'.";
+    if (!PySequence_Check(py_rules)) {
+        PyErr_SetString(PyExc_TypeError, message);
+        return -1;
+    }
+    Py_ssize_t count = PySequence_Length(py_rules);
+    rules.ensure_slots(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* py_rule = PySequence_ITEM(py_rules, i);
+        if (!py_rule) return -1;
+        Py_ssize_t size = PySequence_Check(py_rule) ? PySequence_Length(py_rule) : -1;
+        if (size < 3 || size > 4) {
+            Py_DECREF(py_rule);
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError, message);
+            return -1;
+        }
+        DrcRule rule = {};
+        PyObject* item = PySequence_ITEM(py_rule, 0);
+        const char* name = item && PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+        bool valid = name != NULL;
+        bool two_tags = size == 4;
+        if (valid) {
+            if (strcmp(name, "width") == 0) {
+                rule.check = DrcCheck::Width;
+                valid = !two_tags;
+            } else if (strcmp(name, "spacing") == 0) {
+                rule.check = DrcCheck::Spacing;
+            } else if (strcmp(name, "enclosure") == 0) {
+                rule.check = DrcCheck::Enclosure;
+                valid = two_tags;
+            } else if (strcmp(name, "area") == 0) {
+                rule.check = DrcCheck::Area;
+                valid = !two_tags;
+            } else {
+                valid = false;
+            }
+        }
+        Py_XDECREF(item);
+        if (valid) {
+            item = PySequence_ITEM(py_rule, 1);
+            valid = item && parse_tag(item, rule.tag1);
+            Py_XDECREF(item);
+        }
+        rule.tag2 = rule.tag1;
+        if (valid && two_tags) {
+            item = PySequence_ITEM(py_rule, 2);
+            valid = item && parse_tag(item, rule.tag2);
+            Py_XDECREF(item);
+        }
+        if (valid) {
+            item = PySequence_ITEM(py_rule, size - 1);
+            rule.value = item ? PyFloat_AsDouble(item) : -1;
+            valid = !PyErr_Occurred();
+            Py_XDECREF(item);
+        }
+        Py_DECREF(py_rule);
+        if (!valid) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_TypeError, message);
+            return -1;
+        }
+        if (rule.value <= 0) {
+            PyErr_Format(PyExc_ValueError, "Value for rule %" PRIu64 " must be positive.",
+                         (uint64_t)i);
+            return -1;
+        }
+        rules.append_unsafe(rule);
+    }
+    return 0;
+}
+
+static PyObject* cell_object_check_rules(CellObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* py_rules = NULL;
+    double precision = 1e-3;
+    const char* keywords[] = {"rules", "precision", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|d:check_rules", (char**)keywords, &py_rules,
+                                     &precision))
+        return NULL;
+
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    Array<DrcRule> rules = {};
+    if (parse_drc_rules(py_rules, rules) < 0) {
+        rules.clear();
+        return NULL;
+    }
+
+    Array<Polygon*>* markers =
+        (Array<Polygon*>*)allocate_clear(rules.count * sizeof(Array<Polygon*>));
+    ErrorCode error_code = check_rules(*self->cell, rules, precision, markers);
+
+    PyObject* result = PyList_New(rules.count);
+    for (uint64_t i = 0; i < rules.count; i++) {
+        PyObject* polygons = PyList_New(markers[i].count);
+        for (uint64_t j = 0; j < markers[i].count; j++) {
+            Polygon* polygon = markers[i][j];
+            PolygonObject* obj = PyObject_New(PolygonObject, &polygon_object_type);
+            obj = (PolygonObject*)PyObject_Init((PyObject*)obj, &polygon_object_type);
+            obj->polygon = polygon;
+            polygon->owner = obj;
+            PyList_SET_ITEM(polygons, j, (PyObject*)obj);
+        }
+        markers[i].clear();
+        PyList_SET_ITEM(result, i, polygons);
+    }
+    free_allocation(markers);
+    rules.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* cell_object_content_hash(CellObject* self, PyObject* args, PyObject* kwds) {
+    double precision = 1e-3;
+    int translation_invariant = 0;
+    const char* keywords[] = {"precision", "translation_invariant", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|dp:content_hash", (char**)keywords, &precision,
+                                     &translation_invariant))
+        return NULL;
+
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    uint64_t result;
+    Map<uint64_t> cache = {};
+    if (translation_invariant) {
+        Map<GeometryInfo> geometry_cache = {};
+        result = self->cell->content_hash(1 / precision, cache, geometry_cache);
+        clear_geometry_cache(geometry_cache);
+    } else {
+        result = self->cell->content_hash(1 / precision, cache);
+    }
+    cache.clear();
+    return PyLong_FromUnsignedLongLong(result);
+}
+
+static PyObject* cell_object_group_repetitions(CellObject* self, PyObject* args,
+                                               PyObject* kwds) {
+    double precision = 1e-3;
+    const char* keywords[] = {"precision", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|d:group_repetitions", (char**)keywords,
+                                     &precision))
+        return NULL;
+
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    Array<Reference*> reference_array = {};
+    Array<Polygon*> polygon_array = {};
+    self->cell->group_repetitions(1 / precision, reference_array, polygon_array);
+    Reference** ref = reference_array.items;
+    for (uint64_t i = reference_array.count; i > 0; i--, ref++) Py_XDECREF((*ref)->owner);
+    reference_array.clear();
+    Polygon** poly = polygon_array.items;
+    for (uint64_t i = polygon_array.count; i > 0; i--, poly++) Py_XDECREF((*poly)->owner);
+    polygon_array.clear();
+
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
+static PyObject* cell_object_check_polygons(CellObject* self, PyObject* args, PyObject* kwds) {
+    int repair = 0;
+    double precision = 1e-3;
+    const char* keywords[] = {"repair", "precision", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pd:check_polygons", (char**)keywords, &repair,
+                                     &precision))
+        return NULL;
+
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+
+    Cell* cell = self->cell;
+    Array<PolygonCheck> checks = {};
+    Array<Polygon*> removed = {};
+    ErrorCode error_code =
+        check_cell_polygons(*cell, repair > 0, 1 / precision, checks, removed);
+
+    if (removed.count > 0) {
+        Polygon** poly = removed.items;
+        for (uint64_t i = removed.count; i > 0; i--, poly++) Py_XDECREF((*poly)->owner);
+        poly = cell->polygon_array.items;
+        for (uint64_t i = cell->polygon_array.count; i > 0; i--, poly++) {
+            if ((*poly)->owner) continue;
+            PolygonObject* obj = PyObject_New(PolygonObject, &polygon_object_type);
+            obj = (PolygonObject*)PyObject_Init((PyObject*)obj, &polygon_object_type);
+            obj->polygon = *poly;
+            obj->polygon->owner = obj;
+        }
+    }
+    removed.clear();
+
+    PyObject* result = build_polygon_checks(checks);
+    checks.clear();
+    if (return_error(error_code)) {
+        Py_XDECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* cell_object_statistics(CellObject* self, PyObject* args, PyObject* kwds) {
+    int include_paths = 1;
+    const char* keywords[] = {"include_paths", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p:statistics", (char**)keywords,
+                                     &include_paths))
+        return NULL;
+
+    Array<CellStatistics> statistics = {};
+    ErrorCode error_code = cell_statistics(*self->cell, include_paths > 0, statistics);
+
+    PyObject* result = PyDict_New();
+    for (uint64_t i = 0; i < statistics.count; i++) {
+        CellStatistics* stats = statistics.items + i;
+        PyObject* layers = PyDict_New();
+        for (uint64_t j = 0; j < stats->tag_array.count; j++) {
+            const TagStatistics* item = stats->tag_array.items + j;
+            PyObject* key = Py_BuildValue("(II)", get_layer(item->tag), get_type(item->tag));
+            PyObject* value = Py_BuildValue("{sKsKsKsd}", "polygons", item->polygon_count,
+                                            "vertices", item->vertex_count, "labels",
+                                            item->label_count, "area", item->area);
+            PyDict_SetItem(layers, key, value);
+            Py_DECREF(key);
+            Py_DECREF(value);
+        }
+        PyObject* value = Py_BuildValue(
+            "{sKsKsKsKsKsdsN}", "instances", stats->instance_count, "polygons",
+            stats->polygon_count, "vertices", stats->vertex_count, "labels", stats->label_count,
+            "references", stats->reference_count, "area", stats->area, "layers", layers);
+        PyDict_SetItem(result, (PyObject*)stats->cell->owner, value);
+        Py_DECREF(value);
+        stats->clear();
+    }
+    statistics.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* cell_object_diff(CellObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* py_other = NULL;
+    double precision = 1e-3;
+    PyObject* py_tile_size = Py_None;
+    const char* keywords[] = {"other", "precision", "tile_size", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|dO:diff", (char**)keywords, &py_other,
+                                     &precision, &py_tile_size))
+        return NULL;
+
+    if (!CellObject_Check(py_other)) {
+        PyErr_SetString(PyExc_TypeError, "Argument other must be a Cell.");
+        return NULL;
+    }
+    if (precision <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Precision must be positive.");
+        return NULL;
+    }
+    double tile_size = 0;
+    if (py_tile_size != Py_None) {
+        tile_size = PyFloat_AsDouble(py_tile_size);
+        if (PyErr_Occurred()) {
+            PyErr_SetString(PyExc_TypeError, "Argument tile_size must be a number or None.");
+            return NULL;
+        }
+        if (tile_size <= 0) {
+            PyErr_SetString(PyExc_ValueError, "Argument tile_size must be positive.");
+            return NULL;
+        }
+    }
+
+    Array<CellDiff> diffs = {};
+    ErrorCode error_code =
+        diff_cells(*self->cell, *((CellObject*)py_other)->cell, precision, tile_size, diffs);
+
+    PyObject* result = PyList_New(diffs.count);
+    for (uint64_t i = 0; i < diffs.count; i++) {
+        CellDiff* cell_diff = diffs.items + i;
+        PyObject* layers = PyDict_New();
+        for (uint64_t j = 0; j < cell_diff->polygon_array.count; j++) {
+            Polygon* polygon = cell_diff->polygon_array[j];
+            PyObject* key = Py_BuildValue("(II)", get_layer(polygon->tag), get_type(polygon->tag));
+            PyObject* polygons = PyDict_GetItem(layers, key);
+            if (!polygons) {
+                polygons = PyList_New(0);
+                PyDict_SetItem(layers, key, polygons);
+                Py_DECREF(polygons);
+            }
+            Py_DECREF(key);
+            PolygonObject* obj = PyObject_New(PolygonObject, &polygon_object_type);
+            obj = (PolygonObject*)PyObject_Init((PyObject*)obj, &polygon_object_type);
+            obj->polygon = polygon;
+            polygon->owner = obj;
+            PyList_Append(polygons, (PyObject*)obj);
+            Py_DECREF(obj);
+        }
+        // Polygons are now owned by the Python objects
+        cell_diff->polygon_array.clear();
+        PyObject* cell1 = (PyObject*)cell_diff->cell1->owner;
+        PyObject* cell2 = (PyObject*)cell_diff->cell2->owner;
+        PyList_SET_ITEM(result, i, PyTuple_Pack(3, cell1, cell2, layers));
+        Py_DECREF(layers);
+    }
+    diffs.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* cell_object_render(CellObject* self, PyObject* args, PyObject* kwds) {
+    unsigned long long width = 0;
+    PyObject* py_height = Py_None;
+    PyObject* py_window = Py_None;
+    PyObject* py_colors = Py_None;
+    PyObject* py_background = NULL;
+    const char* keywords[] = {"width", "height", "window", "colors", "background", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "K|OOOO:render", (char**)keywords, &width,
+                                     &py_height, &py_window, &py_colors, &py_background))
+        return NULL;
+
+    Cell* cell = self->cell;
+    Vec2 min, max;
+    uint64_t height;
+    if (parse_raster_window(cell, py_window, width, py_height, min, max, height) < 0) return NULL;
+
+    uint32_t background = 0x222222FF;
+    if (py_background && !parse_color(py_background, background, "background")) return NULL;
+
+    Array<Tag> tags = {};
+    Array<uint32_t> colors = {};
+    if (parse_raster_colors(cell, py_colors, tags, colors) < 0) {
+        tags.clear();
+        colors.clear();
+        return NULL;
+    }
+
+    npy_intp dims[] = {(npy_intp)height, (npy_intp)width, 4};
+    PyObject* result = PyArray_SimpleNew(3, dims, NPY_UINT8);
+    if (!result) {
+        PyErr_SetString(PyExc_MemoryError, "Unable to create return array.");
+        tags.clear();
+        colors.clear();
+        return NULL;
+    }
+    uint8_t* rgba = (uint8_t*)PyArray_DATA((PyArrayObject*)result);
+    ErrorCode error_code =
+        rasterize_rgba(*cell, min, max, width, height, tags, colors.items, background, rgba);
+    tags.clear();
+    colors.clear();
+    if (return_error(error_code)) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* cell_object_write_png(CellObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* pybytes = NULL;
+    unsigned long long width = 0;
+    PyObject* py_height = Py_None;
+    PyObject* py_window = Py_None;
+    PyObject* py_colors = Py_None;
+    PyObject* py_background = NULL;
+    const char* keywords[] = {"outfile", "width",      "height", "window",
+                              "colors",  "background", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&K|OOOO:write_png", (char**)keywords,
+                                     PyUnicode_FSConverter, &pybytes, &width, &py_height,
+                                     &py_window, &py_colors, &py_background))
+        return NULL;
+
+    Cell* cell = self->cell;
+    Vec2 min, max;
+    uint64_t height;
+    uint32_t background = 0x222222FF;
+    if (parse_raster_window(cell, py_window, width, py_height, min, max, height) < 0 ||
+        (py_background && !parse_color(py_background, background, "background"))) {
+        Py_DECREF(pybytes);
+        return NULL;
+    }
+
+    Array<Tag> tags = {};
+    Array<uint32_t> colors = {};
+    if (parse_raster_colors(cell, py_colors, tags, colors) < 0) {
+        Py_DECREF(pybytes);
+        tags.clear();
+        colors.clear();
+        return NULL;
+    }
+
+    uint8_t* rgba = (uint8_t*)allocate(4 * width * height);
+    ErrorCode error_code =
+        rasterize_rgba(*cell, min, max, width, height, tags, colors.items, background, rgba);
+    tags.clear();
+    colors.clear();
+    if (error_code == ErrorCode::NoError) {
+        error_code = write_png(PyBytes_AS_STRING(pybytes), rgba, width, height, 4);
+    }
+    free_allocation(rgba);
+    Py_DECREF(pybytes);
+    if (return_error(error_code)) return NULL;
+
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
 static PyObject* cell_object_remove(CellObject* self, PyObject* args) {
     uint64_t len = PyTuple_GET_SIZE(args);
+    self->cell->modification_count++;
     for (uint64_t i = 0; i < len; i++) {
         PyObject* arg = PyTuple_GET_ITEM(args, i);
         if (PolygonObject_Check(arg)) {
@@ -821,6 +1892,7 @@ static PyObject* cell_object_filter(CellObject* self, PyObject* args, PyObject*
     }
 
     Cell* cell = self->cell;
+    cell->modification_count++;
 
     if (polygons > 0) {
         uint64_t i = 0;
@@ -1035,8 +2107,32 @@ static PyMethodDef cell_object_methods[] = {
     {"flatten", (PyCFunction)cell_object_flatten, METH_VARARGS | METH_KEYWORDS,
      cell_object_flatten_doc},
     {"copy", (PyCFunction)cell_object_copy, METH_VARARGS | METH_KEYWORDS, cell_object_copy_doc},
+    {"__deepcopy__", (PyCFunction)cell_object_deepcopy, METH_VARARGS | METH_KEYWORDS,
+     cell_object_deepcopy_doc},
     {"write_svg", (PyCFunction)cell_object_write_svg, METH_VARARGS | METH_KEYWORDS,
      cell_object_write_svg_doc},
+    {"density_map", (PyCFunction)cell_object_density_map, METH_VARARGS | METH_KEYWORDS,
+     cell_object_density_map_doc},
+    {"extract_nets", (PyCFunction)cell_object_extract_nets, METH_VARARGS | METH_KEYWORDS,
+     cell_object_extract_nets_doc},
+    {"check_rules", (PyCFunction)cell_object_check_rules, METH_VARARGS | METH_KEYWORDS,
+     cell_object_check_rules_doc},
+    {"content_hash", (PyCFunction)cell_object_content_hash, METH_VARARGS | METH_KEYWORDS,
+     cell_object_content_hash_doc},
+    {"diff", (PyCFunction)cell_object_diff, METH_VARARGS | METH_KEYWORDS, cell_object_diff_doc},
+    {"group_repetitions", (PyCFunction)cell_object_group_repetitions,
+     METH_VARARGS | METH_KEYWORDS, cell_object_group_repetitions_doc},
+    {"check_polygons", (PyCFunction)cell_object_check_polygons, METH_VARARGS | METH_KEYWORDS,
+     cell_object_check_polygons_doc},
+    {"statistics", (PyCFunction)cell_object_statistics, METH_VARARGS | METH_KEYWORDS,
+     cell_object_statistics_doc},
+    {"fill", (PyCFunction)cell_object_fill, METH_VARARGS | METH_KEYWORDS, cell_object_fill_doc},
+    {"rasterize", (PyCFunction)cell_object_rasterize, METH_VARARGS | METH_KEYWORDS,
+     cell_object_rasterize_doc},
+    {"render", (PyCFunction)cell_object_render, METH_VARARGS | METH_KEYWORDS,
+     cell_object_render_doc},
+    {"write_png", (PyCFunction)cell_object_write_png, METH_VARARGS | METH_KEYWORDS,
+     cell_object_write_png_doc},
     {"remove", (PyCFunction)cell_object_remove, METH_VARARGS, cell_object_remove_doc},
     {"filter", (PyCFunction)cell_object_filter, METH_VARARGS | METH_KEYWORDS,
      cell_object_filter_doc},
@@ -1153,6 +2249,17 @@ PyObject* cell_object_get_labels_attr(CellObject* self, void*) {
     return result;
 }
 
+static PyObject* cell_object_get_tag_buckets(CellObject* self, void*) {
+    return PyBool_FromLong(self->cell->tag_buckets != NULL);
+}
+
+int cell_object_set_tag_buckets(CellObject* self, PyObject* arg, void*) {
+    int enable = PyObject_IsTrue(arg);
+    if (enable < 0) return -1;
+    self->cell->set_tag_buckets(enable > 0);
+    return 0;
+}
+
 static PyObject* cell_object_get_properties(CellObject* self, void*) {
     return build_properties(self->cell->properties);
 }
@@ -1168,6 +2275,8 @@ static PyGetSetDef cell_object_getset[] = {
     {"references", (getter)cell_object_get_references, NULL, cell_object_references_doc, NULL},
     {"paths", (getter)cell_object_get_paths_attr, NULL, cell_object_paths_doc, NULL},
     {"labels", (getter)cell_object_get_labels_attr, NULL, cell_object_labels_doc, NULL},
+    {"tag_buckets", (getter)cell_object_get_tag_buckets, (setter)cell_object_set_tag_buckets,
+     cell_object_tag_buckets_doc, NULL},
     {"properties", (getter)cell_object_get_properties, (setter)cell_object_set_properties,
      object_properties_doc, NULL},
     {NULL}};
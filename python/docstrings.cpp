@@ -707,7 +707,7 @@ Notes:
 
 PyDoc_STRVAR(
     reference_object_get_polygons_doc,
-    R"!(get_polygons(apply_repetitions=True, include_paths=True, depth=None, layer=None, datatype=None) -> list
+    R"!(get_polygons(apply_repetitions=True, include_paths=True, depth=None, layer=None, datatype=None, tags=None) -> list or dict
 
 Return a copy of all polygons created by this reference.
 
@@ -724,14 +724,18 @@ Args:
       returned.
     datatype: If set, only polygons in the defined layer and data type
       are returned.
+    tags: If set, sequence of (layer, datatype) tuples.  A dictionary is
+      returned with these tags as keys and lists of the polygons with
+      each tag as values, gathered in a single traversal of the
+      reference hierarchy.
 
 Notes:
     Arguments ``layer`` and ``datatype`` must both be set to integers
     for the filtering to be executed.  If either one is ``None`` they
-    are both ignored.)!");
+    are both ignored.  They cannot be used together with ``tags``.)!");
 
 PyDoc_STRVAR(reference_object_get_paths_doc,
-             R"!(get_paths(apply_repetitions=True, depth=None, layer=None, datatype=None) -> list
+             R"!(get_paths(apply_repetitions=True, depth=None, layer=None, datatype=None, tags=None) -> list or dict
 
 Return a copy of all paths created by this reference.
 
@@ -746,14 +750,18 @@ Args:
       returned.
     datatype: If set, only paths in the defined layer and data type are
       returned.
+    tags: If set, sequence of (layer, datatype) tuples.  A dictionary is
+      returned with these tags as keys and lists of the paths with
+      each tag as values, gathered in a single traversal of the
+      reference hierarchy.  Paths are split by element tag.
 
 Notes:
     Arguments ``layer`` and ``datatype`` must both be set to integers
     for the filtering to be executed.  If either one is ``None`` they
-    are both ignored.)!");
+    are both ignored.  They cannot be used together with ``tags``.)!");
 
 PyDoc_STRVAR(reference_object_get_labels_doc,
-             R"!(get_labels(apply_repetitions=True, depth=None, layer=None, texttype=None) -> list
+             R"!(get_labels(apply_repetitions=True, depth=None, layer=None, texttype=None, tags=None) -> list or dict
 
 Return a copy of all labels created by this reference.
 
@@ -768,11 +776,15 @@ Args:
       returned.
     texttype: If set, only labels in the defined layer and text type
       are returned.
+    tags: If set, sequence of (layer, texttype) tuples.  A dictionary is
+      returned with these tags as keys and lists of the labels with
+      each tag as values, gathered in a single traversal of the
+      reference hierarchy.
 
 Notes:
     Arguments ``layer`` and ``texttype`` must both be set to integers
     for the filtering to be executed.  If either one is ``None`` they
-    are both ignored.)!");
+    are both ignored.  They cannot be used together with ``tags``.)!");
 
 PyDoc_STRVAR(reference_object_apply_repetition_doc, R"!(apply_repetition() -> list
 
@@ -2522,7 +2534,7 @@ Notes:
 
 PyDoc_STRVAR(
     cell_object_get_polygons_doc,
-    R"!(get_polygons(apply_repetitions=True, include_paths=True, depth=None, layer=None, datatype=None) -> list
+    R"!(get_polygons(apply_repetitions=True, include_paths=True, depth=None, layer=None, datatype=None, tags=None) -> list or dict
 
 Return a copy of all polygons in the cell.
 
@@ -2539,14 +2551,18 @@ Args:
       returned.
     datatype: If set, only polygons in the defined layer and data type
       are returned.
+    tags: If set, sequence of (layer, datatype) tuples.  A dictionary is
+      returned with these tags as keys and lists of the polygons with
+      each tag as values, gathered in a single traversal of the
+      reference hierarchy.
 
 Notes:
     Arguments ``layer`` and ``datatype`` must both be set to integers
     for the filtering to be executed.  If either one is ``None`` they
-    are both ignored.)!");
+    are both ignored.  They cannot be used together with ``tags``.)!");
 
 PyDoc_STRVAR(cell_object_get_paths_doc,
-             R"!(get_paths(apply_repetitions=True, depth=None, layer=None, datatype=None) -> list
+             R"!(get_paths(apply_repetitions=True, depth=None, layer=None, datatype=None, tags=None) -> list or dict
 
 Return a copy of all paths in the cell.
 
@@ -2561,14 +2577,18 @@ Args:
       returned.
     datatype: If set, only paths in the defined layer and data type are
       returned.
+    tags: If set, sequence of (layer, datatype) tuples.  A dictionary is
+      returned with these tags as keys and lists of the paths with
+      each tag as values, gathered in a single traversal of the
+      reference hierarchy.  Paths are split by element tag.
 
 Notes:
     Arguments ``layer`` and ``datatype`` must both be set to integers
     for the filtering to be executed.  If either one is ``None`` they
-    are both ignored.)!");
+    are both ignored.  They cannot be used together with ``tags``.)!");
 
 PyDoc_STRVAR(cell_object_get_labels_doc,
-             R"!(get_labels(apply_repetitions=True, depth=None, layer=None, texttype=None) -> list
+             R"!(get_labels(apply_repetitions=True, depth=None, layer=None, texttype=None, tags=None) -> list or dict
 
 Return a copy of all labels in the cell.
 
@@ -2583,11 +2603,15 @@ Args:
       returned.
     texttype: If set, only labels in the defined layer and text type
       are returned.
+    tags: If set, sequence of (layer, texttype) tuples.  A dictionary is
+      returned with these tags as keys and lists of the labels with
+      each tag as values, gathered in a single traversal of the
+      reference hierarchy.
 
 Notes:
     Arguments ``layer`` and ``texttype`` must both be set to integers
     for the filtering to be executed.  If either one is ``None`` they
-    are both ignored.)!");
+    are both ignored.  They cannot be used together with ``tags``.)!");
 
 PyDoc_STRVAR(cell_object_flatten_doc, R"!(flatten(apply_repetitions=True) -> self
 
@@ -2643,9 +2667,21 @@ Args:
 Returns:
     Copy of this cell.)!");
 
+PyDoc_STRVAR(cell_object_deepcopy_doc, R"!(__deepcopy__(memo) -> gdstk.Cell
+
+Create a deep copy of this cell with the same name.
+
+References in the new cell point to the same cells as the original.
+
+Args:
+    memo: Dict used internally by the deepcopy function.
+
+Returns:
+    Copy of this cell.)!");
+
 PyDoc_STRVAR(
     cell_object_write_svg_doc,
-    R"!(write_svg(outfile, scaling=10, precision=6, shape_style=None, label_style=None, background="#222222", pad="5%", sort_function=None) -> self
+    R"!(write_svg(outfile, scaling=10, precision=6, shape_style=None, label_style=None, background="#222222", pad="5%", sort_function=None, min_size=0, outline=False, max_polygons=0, compress=None) -> self
 
 Export this cell to an SVG image file. Colors and attributes must follow
 SVG specification.
@@ -2664,11 +2700,29 @@ Args:
     sort_function (callable): If set, the polygons on each cell will be
       sorted according to this function.  It must accept 2 polygons and
       return ``True`` if the first one is below the second.
+    min_size (number): Polygons and references with bounding box
+      smaller than this value (after scaling) are not drawn.
+    outline (bool): If ``True``, polygons not drawn due to `min_size`
+      are replaced by their bounding boxes, and references by the
+      outline of their bounding boxes.
+    max_polygons (int): If positive, maximal number of polygons drawn
+      for each layer and data type in each cell.  The largest polygons
+      are kept.
+    compress (bool): If ``True``, the output is gzip-compressed (SVGZ
+      format).  If ``None``, the output is compressed if the file name
+      ends with ".svgz".
 
 Notes:
     Labels in referenced cells will be affected by the the reference
     transformation, including magnification.
 
+    The level of detail options `min_size` and `max_polygons` can be
+    used to create previews of large layouts.  Polygons are measured in
+    the coordinates of the cell where they are defined, so the
+    magnification of references is not taken into account for them.
+    Cells that are only used in references too small to be drawn are
+    not included in the image.
+
 Examples:
     >>> # (layer, datatype) = (0, 1)
     >>> poly1 = gdstk.ellipse((0, 0), (13, 10), datatype=1)
@@ -2694,6 +2748,399 @@ Examples:
     .. image:: ../cell/write_svg.svg
        :align: center)!");
 
+PyDoc_STRVAR(cell_object_density_map_doc, R"!(density_map(window_size, window=None, tags=None, precision=1e-3) -> dict
+
+Calculate the pattern density of the cell geometry for each layer and
+data type.
+
+Args:
+    window_size (number or sequence of 2 numbers): Dimensions of the
+      density windows.
+    window (sequence of 2 points): Lower left and upper right corners
+      of the analyzed area.  If ``None``, the cell bounding box is used.
+    tags (iterable of tuples): Sequence of (layer, datatype) to analyze.
+      If ``None``, all layers and data types in the cell hierarchy are
+      used.
+    precision (float): Desired precision for merging overlapping
+      polygons.
+
+Returns:
+    Dictionary with (layer, datatype) keys and arrays with the fraction
+    of each density window covered by geometry as values.  The first
+    row of each array corresponds to the bottom of the area.
+
+Notes:
+    Covered areas are calculated analytically, with overlapping
+    geometry merged, including overlaps between different cells or
+    references.
+
+    The contents of each cell are processed only once.  For references
+    with repetitions whose offsets are multiples of the window size, the
+    density of the first instance is reused for all others.  Cells whose
+    polygons and references overlap are flattened and merged in the
+    overlapping regions, which is slower.
+
+Examples:
+    >>> cell = gdstk.Cell("DENSITY")
+    >>> cell.add(gdstk.rectangle((0, 0), (3, 1)))
+    >>> cell.density_map(2, window=((0, 0), (4, 2)))
+    {(0, 0): array([[0.5 , 0.25]])})!");
+
+PyDoc_STRVAR(cell_object_check_rules_doc, R"!(check_rules(rules, precision=1e-3) -> list
+
+Check design rules in the cell geometry.
+
+Polygons and paths from the whole cell hierarchy are merged per layer
+before checking.  Width and spacing violations are pairs of facing edges
+closer than the rule value.  Enclosure violations are inner edges closer
+than the rule value to the outer edges facing them, and parts of the
+inner layer not covered by the outer one.  References without
+magnification that do not interact with other geometry reuse the check
+of the referenced cell.
+
+Args:
+    rules (sequence of tuples): Each rule is one of ``("width", tag,
+      value)``, ``("spacing", tag, value)``, ``("spacing", tag1, tag2,
+      value)``, ``("enclosure", outer_tag, inner_tag, value)``, or
+      ``("area", tag, value)``, with tags as (layer, datatype) tuples.
+    precision (float): Precision used to merge the geometry.
+
+Returns:
+    List with the violation markers for each rule.  Edge pair violations
+    are marked by the quadrilateral joining the edges, area violations by
+    the violating polygon, and missing enclosure by the uncovered region.
+
+Examples:
+    >>> cell = gdstk.Cell("DRC")
+    >>> cell.add(
+    ...     gdstk.rectangle((0, 0), (0.5, 5)),
+    ...     gdstk.rectangle((1, 0), (3, 5)),
+    ... )
+    >>> markers = cell.check_rules([("width", (0, 0), 1), ("spacing", (0, 0), 1)])
+    >>> [len(m) for m in markers]
+    [1, 1])!");
+
+PyDoc_STRVAR(cell_object_group_repetitions_doc, R"!(group_repetitions(precision=1e-3) -> self
+
+Replace sets of equal references or polygons with repetitions.
+
+References to the same cell with the same transformation and properties,
+as well as polygons with the same shape, layer, data type, and
+properties, are grouped by their positions.  Regular 2D lattices, rows
+and columns of equally spaced elements, and rows or columns with
+arbitrary spacing are detected and replaced by a single element with the
+corresponding repetition.
+
+Args:
+    precision (float): Coordinates are compared after rounding to
+      multiples of this value.
+
+Examples:
+    >>> cell = gdstk.Cell("CELL")
+    >>> for i in range(4):
+    ...     for j in range(3):
+    ...         cell.add(gdstk.rectangle((2 * i, 3 * j), (2 * i + 1, 3 * j + 1)))
+    >>> len(cell.group_repetitions().polygons)
+    1
+    >>> repetition = cell.polygons[0].repetition
+    >>> repetition.columns, repetition.rows, repetition.spacing
+    (4, 3, (2.0, 3.0))
+
+Notes:
+    Only elements without repetitions are considered.
+
+See also:
+    :attr:`gdstk.Repetition`)!");
+
+PyDoc_STRVAR(cell_object_check_polygons_doc,
+             R"!(check_polygons(repair=False, precision=1e-3) -> list
+
+Check the validity of the polygons in this cell.
+
+Paths and references are not included.  The problems are reported as in
+:func:`gdstk.check_polygons`.
+
+Args:
+    repair (bool): If ``True``, invalid polygons are replaced in the
+      cell by the result of merging each of them with
+      :func:`gdstk.boolean`, which removes spikes, duplicate points, and
+      zero-area parts, and splits self-intersecting polygons.  The new
+      polygons keep the layer, data type, repetition and properties of
+      the original ones.
+    precision (number): Desired precision for rounding vertex
+      coordinates when repairing.
+
+Returns:
+    List with a set of problems for each polygon in the cell, before
+    any repairs.)!");
+
+PyDoc_STRVAR(cell_object_statistics_doc, R"!(statistics(include_paths=True) -> dict
+
+Calculate statistics of the flattened contents of this cell and of each
+cell in its hierarchy, without flattening.
+
+Each cell is analyzed only once, and the totals of referenced cells are
+multiplied by the number of instances in each reference, including
+repetitions.
+
+Args:
+    include_paths (bool): If ``True``, paths are converted to polygons
+      and included in the statistics.
+
+Returns:
+    Dictionary with each :class:`gdstk.Cell` in the hierarchy as keys.
+    The values are dictionaries with keys ``"instances"`` (number of
+    instances in the flattened top cell), and ``"polygons"``,
+    ``"vertices"``, ``"labels"``, ``"references"``, ``"area"``, and
+    ``"layers"`` with the totals for a single flattened instance.
+    ``"layers"`` is a dictionary with keys ``(layer, datatype)`` (or
+    ``(layer, texttype)`` for labels) and values with the totals of
+    ``"polygons"``, ``"vertices"``, ``"labels"``, and ``"area"`` for
+    that tag.
+
+Examples:
+    >>> unit = gdstk.Cell("UNIT")
+    >>> unit.add(gdstk.rectangle((0, 0), (1, 1), layer=1))
+    >>> top = gdstk.Cell("TOP")
+    >>> top.add(gdstk.Reference(unit, columns=1000, rows=1000, spacing=(2, 2)))
+    >>> stats = top.statistics()
+    >>> stats[top]["polygons"], stats[top]["vertices"], stats[unit]["instances"]
+    (1000000, 4000000, 1000000)
+    >>> stats[top]["layers"][(1, 0)]["area"]
+    1000000.0
+
+Notes:
+    Areas of overlapping polygons are added together.  The contents of
+    :class:`gdstk.RawCell` are not included.)!");
+
+PyDoc_STRVAR(cell_object_content_hash_doc, R"!(content_hash(precision=1e-3, translation_invariant=False) -> int
+
+Calculate a hash of the contents of this cell.
+
+The hash includes polygons, paths, references, labels, and properties,
+but it is independent of the order of the elements and of the cell name.
+Referenced cells contribute their own content hashes.
+
+Args:
+    precision (float): Coordinates are rounded to multiples of this value.
+    translation_invariant (bool): If ``True``, coordinates are taken
+      relative to the lower left corner of the bounding box of each cell,
+      so cells that differ only by a translation have the same hash.
+
+Examples:
+    >>> cell1 = gdstk.Cell("A")
+    >>> cell1.add(gdstk.rectangle((0, 0), (1, 1)), gdstk.Label("A", (0, 0)))
+    >>> cell2 = gdstk.Cell("B")
+    >>> cell2.add(gdstk.Label("A", (2, 0)), gdstk.rectangle((2, 0), (3, 1)))
+    >>> cell1.content_hash() == cell2.content_hash()
+    False
+    >>> cell1.content_hash(translation_invariant=True) == cell2.content_hash(
+    ...     translation_invariant=True
+    ... )
+    True)!");
+
+PyDoc_STRVAR(cell_object_diff_doc, R"!(diff(other, precision=1e-3, tile_size=None) -> list
+
+Compare the geometry of this cell with another.
+
+Cells are fingerprinted by their contents, independently of element
+order, so identical subtrees are skipped.  References that match in both
+cells are skipped, references with the same transformation to cells
+with the same name are compared recursively, and other references are
+flattened.  The polygons in each layer are compared in parallel tiles
+with an XOR operation.
+
+Args:
+    other (Cell): Cell to compare against.
+    precision (float): Precision used to fingerprint cells and in the
+      boolean operations.
+    tile_size (number): Size of the square tiles used for the XOR
+      operations.  If ``None``, a size is chosen automatically.
+
+Returns:
+    List of tuples with a cell from this hierarchy, the corresponding
+    cell in the other, and a dictionary mapping (layer, datatype) to the
+    list of polygons covered by only one of the cells.
+
+Examples:
+    >>> unit1 = gdstk.Cell("UNIT")
+    >>> unit1.add(gdstk.rectangle((0, 0), (1, 1)))
+    >>> top1 = gdstk.Cell("TOP")
+    >>> top1.add(gdstk.Reference(unit1, columns=8, rows=8, spacing=(2, 2)))
+    >>> unit2 = gdstk.Cell("UNIT")
+    >>> unit2.add(gdstk.rectangle((0, 0), (1, 2)))
+    >>> top2 = gdstk.Cell("TOP")
+    >>> top2.add(gdstk.Reference(unit2, columns=8, rows=8, spacing=(2, 2)))
+    >>> [(c1.name, c2.name, d[(0, 0)][0].area()) for c1, c2, d in top1.diff(top2)]
+    [('UNIT', 'UNIT', 1.0)])!");
+
+PyDoc_STRVAR(cell_object_extract_nets_doc, R"!(extract_nets(conductors, vias=None, labels=None, window=None, precision=1e-3) -> list
+
+Trace the electrical connectivity of the cell geometry.
+
+Shapes in conductor layers connect to the touching shapes in the same
+layer.  Via shapes connect to the touching shapes in the layers they
+join.  Polygons and paths from the whole cell hierarchy are used.
+
+Args:
+    conductors (iterable of tuples): Sequence of (layer, datatype) of the
+      conductor layers.
+    vias (dict): Mapping from the (layer, datatype) of a via layer to a
+      pair with the (layer, datatype) of the layers it connects.
+    labels (dict): Mapping from (layer, texttype) of labels to the
+      (layer, datatype) of the conductor they name.  If ``None``, labels
+      name conductors with the same layer and data type.
+    window (sequence of 2 points): Lower left and upper right corners
+      of the analyzed area.  Shapes overlapping the window are included
+      whole.  If ``None``, the whole cell is used.
+    precision (float): Shapes closer than half this value are considered
+      touching.
+
+Returns:
+    List of nets.  Each net is a tuple with the list of label texts
+    attached to it and the list of its polygons.
+
+Examples:
+    >>> cell = gdstk.Cell("NETS")
+    >>> cell.add(
+    ...     gdstk.rectangle((0, 0), (10, 1), layer=1),
+    ...     gdstk.rectangle((9, 0), (10, 1), layer=2),
+    ...     gdstk.rectangle((9, 0), (10, 10), layer=3),
+    ...     gdstk.rectangle((0, 5), (5, 6), layer=3),
+    ...     gdstk.Label("VDD", (0.5, 0.5), layer=1),
+    ... )
+    >>> nets = cell.extract_nets([(1, 0), (3, 0)], vias={(2, 0): ((1, 0), (3, 0))})
+    >>> [(names, len(polygons)) for names, polygons in nets]
+    [(['VDD'], 3), ([], 1)])!");
+
+PyDoc_STRVAR(cell_object_fill_doc, R"!(fill(element, pitch, window=None, exclusions=None, density=0, tile_size=None, precision=1e-3) -> list
+
+Generate dummy fill for this cell.
+
+Fill elements are placed on a regular grid of sites, starting at the
+lower left corner of the fill window, wherever they do not overlap the
+exclusion geometry.  Adjacent sites are grouped in references or
+polygons with rectangular repetitions.
+
+Args:
+    element (Cell or Polygon): Fill element.  Sites have the size of
+      its bounding box.
+    pitch (number or sequence of 2 numbers): Distance between sites
+      along each axis.
+    window (sequence of 2 points): Lower left and upper right corners
+      of the area to fill.  If ``None``, the cell bounding box is used.
+    exclusions: Mapping from (layer, datatype) to keep-out distance, or
+      sequence of (layer, datatype) without keep-out.  Sites whose
+      bounding box gets closer than the keep-out distance to geometry in
+      these layers are not used.
+    density (float): Target pattern density.  If positive, fill is only
+      added to tiles where the density of the element layers is below
+      this value, and only as many evenly spaced rows of sites as
+      needed to reach it are filled.
+    tile_size (number or sequence of 2 numbers): Dimensions of the tiles
+      used for the density target and parallel processing.  If
+      ``None``, the whole window is a single tile.
+    precision (float): Desired precision for the density calculation.
+
+Returns:
+    List of references to `element` if it is a cell, or copies of it
+    if it is a polygon.  The new elements are not added to this cell.
+
+Notes:
+    Exclusion geometry is flattened from the whole cell hierarchy.  The
+    keep-out region around each site is rectangular.
+
+Examples:
+    >>> fill_cell = gdstk.Cell("FILL")
+    >>> fill_cell.add(gdstk.rectangle((0, 0), (1, 1), layer=2))
+    >>> chip = gdstk.Cell("CHIP")
+    >>> chip.add(gdstk.rectangle((0, 0), (40, 40), layer=10))
+    >>> chip.add(gdstk.ellipse((20, 20), 8, layer=1))
+    >>> fill = chip.fill(fill_cell, 2, exclusions={(1, 0): 1})
+    >>> chip.add(*fill)
+
+    .. image:: ../cell/fill.svg
+       :align: center)!");
+
+PyDoc_STRVAR(cell_object_rasterize_doc, R"!(rasterize(width, height=None, window=None, tags=None) -> dict
+
+Calculate the pixel coverage of the cell geometry for each layer and
+data type.
+
+Args:
+    width (int): Image width in pixels.
+    height (int): Image height in pixels.  If ``None``, it is calculated
+      from the window aspect ratio.
+    window (sequence of 2 points): Lower left and upper right corners
+      of the rendered area.  If ``None``, the cell bounding box is used.
+    tags (iterable of tuples): Sequence of (layer, datatype) to render.
+      If ``None``, all layers and data types in the cell hierarchy are
+      rendered.
+
+Returns:
+    Dictionary with (layer, datatype) keys and coverage arrays with
+    shape (height, width) as values.  Coverage values range from 0
+    (empty pixel) to 255 (fully covered), with the first row at the top
+    of the window.
+
+Notes:
+    Pixel coverage is calculated from the exact area of each polygon
+    inside each pixel (anti-aliased rendering).  Overlapping polygons in
+    the same layer and data type are accumulated, so their coverage is
+    only approximate at the borders of the overlap.
+
+    References with bounding boxes outside of the window are skipped.
+    The image is rendered in parallel bands when the library is compiled
+    with OpenMP support.)!");
+
+PyDoc_STRVAR(cell_object_render_doc, R"!(render(width, height=None, window=None, colors=None, background="#222222") -> numpy.ndarray
+
+Render the cell geometry to an RGBA image.
+
+Args:
+    width (int): Image width in pixels.
+    height (int): Image height in pixels.  If ``None``, it is calculated
+      from the window aspect ratio.
+    window (sequence of 2 points): Lower left and upper right corners
+      of the rendered area.  If ``None``, the cell bounding box is used.
+    colors (dict): Dictionary with (layer, datatype) keys and color
+      values in the format "#RRGGBB" or "#RRGGBBAA".  Only these layers
+      and data types are rendered.  If ``None``, all layers and data
+      types are rendered with default colors.
+    background (str): Image background color in the format "#RRGGBB",
+      "#RRGGBBAA", or "none" for transparent.
+
+Returns:
+    Array with shape (height, width, 4) with the RGBA image.
+
+Notes:
+    Layers and data types are drawn in ascending order, each over the
+    previous ones.
+
+See also:
+    :meth:`gdstk.Cell.rasterize`)!");
+
+PyDoc_STRVAR(cell_object_write_png_doc, R"!(write_png(outfile, width, height=None, window=None, colors=None, background="#222222") -> self
+
+Render the cell geometry to a PNG image file.
+
+Args:
+    outfile (str or pathlib.Path): Name of the output file.
+    width (int): Image width in pixels.
+    height (int): Image height in pixels.  If ``None``, it is calculated
+      from the window aspect ratio.
+    window (sequence of 2 points): Lower left and upper right corners
+      of the rendered area.  If ``None``, the cell bounding box is used.
+    colors (dict): Dictionary with (layer, datatype) keys and color
+      values in the format "#RRGGBB" or "#RRGGBBAA".  Only these layers
+      and data types are rendered.  If ``None``, all layers and data
+      types are rendered with default colors.
+    background (str): Image background color in the format "#RRGGBB",
+      "#RRGGBBAA", or "none" for transparent.
+
+See also:
+    :meth:`gdstk.Cell.render`)!");
+
 PyDoc_STRVAR(cell_object_remove_doc, R"!(remove(*elements) -> self
 
 Remove polygons, paths, labels and references from this cell.
@@ -2771,6 +3218,17 @@ PyDoc_STRVAR(cell_object_labels_doc, R"!(List of cell labels.
 Notes:
     This attribute is read-only.)!");
 
+PyDoc_STRVAR(cell_object_tag_buckets_doc, R"!(Bucketed storage mode flag.
+
+When set, polygons, paths and labels in the cell are reordered by layer
+and data/text type and indexed, so that operations on specific layers
+(filtered ``get_polygons``, ``get_paths`` and ``get_labels``, layer and
+data type gathering, and ``remap``) only process the relevant elements.
+
+Notes:
+    The index is rebuilt automatically when elements are added or
+    removed, or when the layer or data type of any element changes.)!");
+
 // RawCell
 
 PyDoc_STRVAR(rawcell_object_type_doc, R"!(RawCell(name)
@@ -2860,11 +3318,35 @@ PyDoc_STRVAR(library_object_remove_doc, R"!(remove(*cells) -> self
 
 Remove cells from this library.)!");
 
+PyDoc_STRVAR(library_object_copy_doc, R"!(copy(deep_copy=True) -> gdstk.Library
+
+Create a copy of this library.
+
+Args:
+    deep_copy: If ``True``, new cells are created with copies of all
+      their elements. Cells are copied in parallel and references to
+      cells in this library are redirected to their copies. Otherwise,
+      the new library shares the same cells. Raw cells are always shared.
+
+Returns:
+    Copy of this library.)!");
+
+PyDoc_STRVAR(library_object_deepcopy_doc, R"!(__deepcopy__(memo) -> gdstk.Library
+
+Create a deep copy of this library (see :meth:`gdstk.Library.copy`).
+
+Args:
+    memo: Dict used internally by the deepcopy function.
+
+Returns:
+    Copy of this library.)!");
+
 PyDoc_STRVAR(library_object_replace_doc, R"!(replace(*cells) -> self
 
 Add cells to this library, replacing any cells with the same name.
 
 References to any removed cells are also replaced with the new cell.
+All cells are replaced in a single pass over the library references.
 
 Examples:
     >>> polygon = gdstk.rectangle((-10, -10), (10, 10))
@@ -2873,6 +3355,34 @@ Examples:
     >>> lib = gdstk.read_gds("layout.gds")
     >>> lib.replace(cell))!");
 
+PyDoc_STRVAR(library_object_deduplicate_doc, R"!(deduplicate(translation_invariant=False) -> list
+
+Remove cells with identical contents from this library.
+
+Cells are compared by a content hash (see :meth:`gdstk.Cell.content_hash`)
+computed with the library precision.  For each group of identical cells,
+the first one in the library is kept, and references to the others are
+updated to point to it.
+
+Args:
+    translation_invariant (bool): If ``True``, cells that differ only by
+      a translation are also removed, and the origins of the updated
+      references are adjusted accordingly.
+
+Returns:
+    List of removed cells.
+
+Examples:
+    >>> lib = gdstk.Library()
+    >>> unit1 = lib.new_cell("UNIT1")
+    >>> unit1.add(gdstk.rectangle((0, 0), (1, 1)))
+    >>> unit2 = lib.new_cell("UNIT2")
+    >>> unit2.add(gdstk.rectangle((0, 0), (1, 1)))
+    >>> top = lib.new_cell("TOP")
+    >>> top.add(gdstk.Reference(unit1), gdstk.Reference(unit2, (2, 0)))
+    >>> [c.name for c in lib.deduplicate()]
+    ['UNIT2'])!");
+
 PyDoc_STRVAR(library_object_new_cell_doc, R"!(new_cell(name) -> gdstk.Cell
 
 Create a new cell and add it to this library.
@@ -2895,6 +3405,16 @@ Args:
     old_name (str or Cell): Cell or name of the cell to be renamed.
     new_name (str): New cell name.)!");
 
+PyDoc_STRVAR(library_object_rename_cells_doc, R"!(rename_cells(names) -> self
+
+Rename several cells in this library, updating any references that use
+the old names, in a single pass over all references.
+
+Args:
+    names (dict): Mapping from cells or names of the cells to be renamed
+      to their new names.  All names are looked up before renaming, so
+      names can be swapped.)!");
+
 PyDoc_STRVAR(library_object_top_level_doc, R"!(top_level() -> list
 
 Return the top-level cells in the library.
@@ -2914,10 +3434,92 @@ PyDoc_STRVAR(library_object_remap_doc, R"!(remap(layer_type_map) -> self
 
 Remap layers and data/text types for all elements in this library.
 
+Elements shared between cells are remapped only once. Raw cells are not
+modified.
+
 Args:
     layer_type_map: Dictionary mapping existing (layer, type) tuples to
       desired (layer, type) tuples.)!");
 
+PyDoc_STRVAR(library_object_rescale_doc, R"!(rescale(unit) -> self
+
+Change the library unit, scaling all geometry to preserve its physical
+dimensions.
+
+Polygons, paths (including widths, extensions, bend radii and
+tolerances), reference and label origins, and repetitions are scaled.
+Reference and label magnifications are not changed. Elements are
+processed in parallel, and elements shared between cells are scaled only
+once. :class:`gdstk.RawCell` contents are not rescaled.
+
+Args:
+    unit: New library unit (in meters).)!");
+
+PyDoc_STRVAR(library_object_snap_doc, R"!(snap(grid) -> dict
+
+Snap all coordinates in this library to a grid.
+
+Polygon vertices, :class:`gdstk.FlexPath` spine points, reference and
+label origins, and repetition vectors and offsets are snapped.
+:class:`gdstk.RobustPath` elements and :class:`gdstk.RawCell` contents
+are not modified. Elements are processed in parallel, and elements
+shared between cells are snapped only once (but counted in each cell).
+
+Args:
+    grid: Grid spacing (in library units).
+
+Returns:
+    Dictionary with the names of the cells with coordinates that moved as
+    keys and the number of moved coordinates in each cell as values.)!");
+
+PyDoc_STRVAR(library_object_find_labels_doc,
+             R"!(find_labels(cell, text=None, region=None, rebuild=False) -> list
+
+Find labels by text and position in the hierarchy of a cell.
+
+The labels are looked up in an index that is built the first time each
+cell is reached by a query (cells are indexed in parallel) and kept with
+the library.  Each indexed cell keeps its labels sorted by text, and a
+summary of the texts and positions of the labels in its hierarchy, so
+that queries skip references that cannot contain matches.
+
+Cells with added or removed labels or references are indexed again
+automatically, and so is the whole index after any label attribute used
+in the queries (text, origin, layer, texttype or repetition) is changed.
+Changes to existing references (transformation or repetition) require
+rebuilding the index.
+
+Args:
+    cell (Cell): Top cell for the query.
+    text (str): If set, only labels with this text are returned.
+    region (sequence of 2 points): If set, only labels with origin
+      within the rectangle defined by the lower left and upper right
+      corners in this sequence are returned.
+    rebuild (bool): If ``True``, the index is rebuilt before the query.
+
+Returns:
+    List with a tuple ``(cell, label, position, transform)`` for each
+    label instance in the flattened hierarchy of ``cell``, where
+    ``position`` is the label origin in the top cell coordinates and
+    ``transform`` is a tuple ``(origin, rotation, magnification,
+    x_reflection)`` with the accumulated transformation from ``cell``
+    to the top cell coordinates.
+
+Examples:
+    >>> pin = gdstk.Cell("PIN")
+    >>> pin.add(gdstk.Label("VDD", (0, 1)))
+    >>> top = gdstk.Cell("TOP")
+    >>> top.add(gdstk.Reference(pin, (10, 0), x_reflection=True))
+    >>> lib = gdstk.Library()
+    >>> lib.add(top, pin)
+    >>> cell, label, position, transform = lib.find_labels(top, "VDD")[0]
+    >>> position
+    (10.0, -1.0)
+
+Note:
+    :meth:`gdstk.Library.rescale` and :meth:`gdstk.Library.snap` reset
+    the index.)!");
+
 PyDoc_STRVAR(library_object_write_gds_doc,
              R"!(write_gds(outfile, max_points=199, timestamp=None) -> None
 
@@ -3520,6 +4122,39 @@ Args:
 Returns:
     `True` if any point is inside the polygon set, `False` otherwise.)!");
 
+PyDoc_STRVAR(check_polygons_function_doc, R"!(check_polygons(polygons) -> list
+
+Check the validity of a set of polygons.
+
+The problems reported for each polygon are:
+
+- ``"duplicate_point"``: consecutive coincident vertices;
+- ``"spike"``: consecutive collinear edges that reverse direction;
+- ``"degenerate"``: less than 3 distinct vertices or zero area;
+- ``"self_intersecting"``: non-adjacent edges crossing each other;
+- ``"clockwise"``: clockwise orientation (informative only).
+
+Edges that touch or overlap without crossing, as in holes connected to
+the outer boundary by a zero-width cut, are not considered intersecting.
+Coordinates are compared exactly.  Polygons are checked in parallel.
+
+Args:
+    polygons (Polygon, FlexPath, RobustPath, Reference, sequence):
+      Polygons to check. If this is a sequence, each element can be any
+      of the polygonal types or a sequence of points (coordinate pairs
+      or complex).
+
+Returns:
+    List with a set of problems for each polygon.
+
+Examples:
+    >>> bowtie = gdstk.Polygon([(0, 1), (2, 0), (2, 2), (0, 0)])
+    >>> gdstk.check_polygons([gdstk.rectangle((0, 0), (1, 1)), bowtie])
+    [set(), {'self_intersecting'}]
+
+See also:
+    :meth:`gdstk.Cell.check_polygons`)!");
+
 PyDoc_STRVAR(read_gds_function_doc,
              R"!(read_gds(infile, unit=0, tolerance=0, filter=None) -> gdstk.Library
 
@@ -3670,3 +4305,171 @@ Args:
 Returns:
     Validation result (True/False) and the calculated signature. If the
     file does not have a signature, returns (None, 0))!");
+
+PyDoc_STRVAR(
+    gds_to_oas_function_doc,
+    R"!(gds_to_oas(infile, outfile, compression_level=6, detect_rectangles=True, detect_trapezoids=True, circle_tolerance=0, cell_offsets=False, validation=None) -> None
+
+Convert a GDSII file to OASIS without loading the whole library.
+
+Cells are read, encoded and written one at a time, so that memory usage
+is bounded by the largest cells in the file, not by the library size.
+
+Args:
+    infile (str or pathlib.Path): Name of the input GDSII file.
+    outfile (str or pathlib.Path): Name of the output OASIS file.
+    compression_level: Level of compression for cells (between 0 and 9).
+      Setting to 0 will disable cell compression, 1 gives the best speed
+      and 9, the best compression.
+    detect_rectangles: Store rectangles in compressed format.
+    detect_trapezoids: Store trapezoids in compressed format.
+    circle_tolerance: Tolerance for detecting circles. If less or equal
+      to 0, no detection is performed. Circles are stored in compressed
+      format.
+    cell_offsets: Store the standard OASIS cell offset properties.
+    validation ("crc32", "checksum32", None): type of validation to
+      include in the saved file.
+
+Notes:
+    Other standard OASIS properties require the whole library and are
+    not available in this function.
+
+Examples:
+    The conversion can also be run from the command line:
+
+    .. code-block:: sh
+
+       python -m gdstk.convert input.gds output.oas
+
+See also:
+    :meth:`gdstk.Library.write_oas`)!");
+
+PyDoc_STRVAR(
+    gds_transform_function_doc,
+    R"!(gds_transform(infile, outfile, filter=None, layer_type_map=None, rename=None, unit=0, precision=0) -> None
+
+Copy a GDSII file applying transformations without loading the library.
+
+Records are streamed from the input to the output file and copied
+verbatim unless modified by one of the transformations, so that the
+conversion speed is mostly limited by the storage.
+
+Args:
+    infile (str or pathlib.Path): Name of the input GDSII file.
+    outfile (str or pathlib.Path): Name of the output GDSII file.
+    filter (iterable of tuples): If not None, only shapes with
+      layer and data type in this list are copied, as in
+      :func:`gdstk.read_gds`.
+    layer_type_map: Mapping of (layer, type) tuples used to remap the
+      layers and types of shapes and labels (after filtering), as in
+      :meth:`gdstk.Library.remap`.
+    rename (dict): Mapping from old to new cell names. Cells and
+      references are renamed accordingly.
+    unit (number): If greater than zero, replace the user units.
+    precision (number): If greater than zero, replace the database
+      units. All coordinates and path widths are scaled accordingly.
+
+Examples:
+    >>> gdstk.gds_transform(
+    ...     "input.gds",
+    ...     "output.gds",
+    ...     filter={(1, 0), (2, 0)},
+    ...     layer_type_map={(2, 0): (20, 0)},
+    ...     rename={"TOP": "CHIP"},
+    ...     precision=5e-10,
+    ... )
+
+See also:
+    :meth:`gdstk.Library.remap`, :meth:`gdstk.Library.rename_cell`)!");
+
+PyDoc_STRVAR(
+    oas_to_gds_function_doc,
+    R"!(oas_to_gds(infile, outfile, unit=0, tolerance=0, max_points=199, timestamp=None) -> None
+
+Convert an OASIS file to GDSII without loading the whole library.
+
+The name tables are loaded first, then cells are decoded and written one
+at a time, so that memory usage is bounded by the largest cells in the
+file, not by the library size.  Circles and trapezoids are converted to
+polygons, regular repetitions of references are written as array
+references and other repetitions are expanded.
+
+Args:
+    infile (str or pathlib.Path): Name of the input OASIS file.
+    outfile (str or pathlib.Path): Name of the output GDSII file.
+    unit (number): If greater than zero, convert the imported geometry
+      to this unit.
+    tolerance (number): Default tolerance for loaded paths and round
+      shapes. If zero or negative, the library rounding size is used
+      (`precision / unit`).
+    max_points (number): Maximal number of vertices per polygon.
+      Polygons with more vertices that this are automatically fractured.
+    timestamp (datetime object): Timestamp to be stored in the GDSII
+      file. If None, the current time is used.
+
+Examples:
+    The conversion can also be run from the command line:
+
+    .. code-block:: sh
+
+       python -m gdstk.convert input.oas output.gds
+
+See also:
+    :func:`gdstk.read_oas`, :meth:`gdstk.Library.write_gds`)!");
+
+PyDoc_STRVAR(spill_enable_function_doc,
+             R"!(spill_enable(threshold=4096, resident_limit=2**30, directory=None) -> None
+
+Enable out-of-core storage for large geometry arrays.
+
+While active, every internal allocation of at least `threshold` bytes,
+such as polygon points and repetition offsets, is stored in a
+memory-mapped spill file instead of the heap.  Access to the data is
+unchanged.  When more than `resident_limit` bytes of the file have been
+accessed recently, the least recently used parts of the file are released from
+memory, which keeps the resident memory bounded while flattening,
+extracting polygons or writing files from very large libraries.
+
+Args:
+    threshold: Minimal allocation size, in bytes, stored in the spill
+      file.
+    resident_limit: Maximal number of bytes of the spill file kept in
+      memory.  Values below 4 MiB are raised to 4 MiB.
+    directory (str or pathlib.Path): Directory for the spill file.  If
+      None, the system temporary directory is used.  The file is
+      removed automatically.
+
+Notes:
+    Spill mode is only available on POSIX systems.
+
+    All accesses count towards `resident_limit`, including reads.
+    Parts of the file that are not in memory are protected, and the
+    first access to them is handled by a segmentation fault handler
+    that loads them back and releases older ones.  Signals that are not
+    related to the spill file are forwarded to the previous handlers.
+
+See also:
+    :func:`gdstk.spill_disable`, :func:`gdstk.spill_release`,
+    :func:`gdstk.spill_info`)!");
+
+PyDoc_STRVAR(spill_disable_function_doc, R"!(spill_disable() -> None
+
+Stop using the spill file for new allocations.
+
+Data already in the spill file remains valid.  The file is closed when
+no more data is stored in it.)!");
+
+PyDoc_STRVAR(spill_release_function_doc, R"!(spill_release() -> None
+
+Release all data in the spill file from memory.
+
+The data remains valid and is loaded back when accessed.)!");
+
+PyDoc_STRVAR(spill_info_function_doc, R"!(spill_info() -> dict
+
+Report the current state of the spill file.
+
+Returns:
+    Dictionary with keys ``threshold`` (0 if spill mode is not active),
+    ``file_size``, ``allocated``, ``block_count``, ``resident`` and
+    ``resident_limit``.  Sizes are given in bytes.)!");
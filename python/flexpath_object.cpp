@@ -760,6 +760,7 @@ static PyObject* flexpath_object_set_layers(FlexPathObject* self, PyObject* arg)
             return NULL;
         }
     }
+    tag_change_count++;
     Py_INCREF(self);
     return (PyObject*)self;
 }
@@ -789,6 +790,7 @@ static PyObject* flexpath_object_set_datatypes(FlexPathObject* self, PyObject* a
             return NULL;
         }
     }
+    tag_change_count++;
     Py_INCREF(self);
     return (PyObject*)self;
 }
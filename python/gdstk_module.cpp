@@ -36,6 +36,7 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 #include <Python.h>
 #include <datetime.h>
+#include <float.h>
 #include <inttypes.h>
 #include <numpy/arrayobject.h>
 #include <structmember.h>
@@ -153,6 +154,7 @@ struct RawCellObject {
 struct LibraryObject {
     PyObject_HEAD;
     Library* library;
+    LabelIndex* label_index;  // Built on demand by Library.find_labels
 };
 
 struct GdsWriterObject {
@@ -788,6 +790,9 @@ static Array<Vec2> custom_bend_function(double radius, double initial_angle, dou
     return array;
 }
 
+// Defined below, after the object implementations (used in Library.copy)
+static PyObject* create_library_objects(Library* library);
+
 #include "cell_object.cpp"
 #include "curve_object.cpp"
 #include "flexpath_object.cpp"
@@ -1436,10 +1441,34 @@ static PyObject* any_inside_function(PyObject* mod, PyObject* args, PyObject* kw
     return result;
 }
 
+static PyObject* check_polygons_function(PyObject* mod, PyObject* args, PyObject* kwds) {
+    PyObject* py_polygons;
+    const char* keywords[] = {"polygons", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:check_polygons", (char**)keywords,
+                                     &py_polygons))
+        return NULL;
+
+    Array<Polygon*> polygons = {};
+    if (parse_polygons_in_order(py_polygons, polygons, "polygons") < 0) return NULL;
+
+    Array<PolygonCheck> checks = {};
+    check_polygons(polygons, checks);
+    PyObject* result = build_polygon_checks(checks);
+
+    for (uint64_t j = 0; j < polygons.count; j++) {
+        polygons[j]->clear();
+        free_allocation(polygons[j]);
+    }
+    polygons.clear();
+    checks.clear();
+    return result;
+}
+
 static PyObject* create_library_objects(Library* library) {
     LibraryObject* result = PyObject_New(LibraryObject, &library_object_type);
     result = (LibraryObject*)PyObject_Init((PyObject*)result, &library_object_type);
     result->library = library;
+    result->label_index = NULL;
     library->owner = result;
 
     Cell** cell = library->cell_array.items;
@@ -1500,8 +1529,11 @@ static PyObject* create_library_objects(Library* library) {
         Reference** reference = (*cell)->reference_array.items;
         for (uint64_t j = 0; j < (*cell)->reference_array.count; j++, reference++) {
             // Cell reference missing (ErrorCode::MissingReference); ignore
-            if ((*reference)->type == ReferenceType::Name) continue;
-            Py_INCREF((*reference)->cell->owner);
+            if ((*reference)->type == ReferenceType::Cell) {
+                Py_INCREF((*reference)->cell->owner);
+            } else if ((*reference)->type == ReferenceType::RawCell) {
+                Py_INCREF((*reference)->rawcell->owner);
+            }
         }
     }
 
@@ -1861,6 +1893,200 @@ static PyObject* oas_validate_function(PyObject* mod, PyObject* args) {
     return Py_BuildValue("Ok", result ? Py_True : Py_False, signature);
 }
 
+static PyObject* gds_to_oas_function(PyObject* mod, PyObject* args, PyObject* kwds) {
+    const char* keywords[] = {"infile",           "outfile",           "compression_level",
+                              "detect_rectangles", "detect_trapezoids", "circle_tolerance",
+                              "cell_offsets",      "validation",        NULL};
+    PyObject* pyinfile = NULL;
+    PyObject* pyoutfile = NULL;
+    uint8_t compression_level = 6;
+    int detect_rectangles = 1;
+    int detect_trapezoids = 1;
+    double circle_tolerance = 0;
+    int cell_offsets = 0;
+    char* validation = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|bppdpz:gds_to_oas", (char**)keywords,
+                                     PyUnicode_FSConverter, &pyinfile, PyUnicode_FSConverter,
+                                     &pyoutfile, &compression_level, &detect_rectangles,
+                                     &detect_trapezoids, &circle_tolerance, &cell_offsets,
+                                     &validation))
+        return NULL;
+
+    uint16_t config_flags = 0;
+    if (detect_rectangles == 1) config_flags |= OASIS_CONFIG_DETECT_RECTANGLES;
+    if (detect_trapezoids == 1) config_flags |= OASIS_CONFIG_DETECT_TRAPEZOIDS;
+    if (cell_offsets == 1) config_flags |= OASIS_CONFIG_PROPERTY_CELL_OFFSET;
+    if (validation != NULL) {
+        if (strcmp(validation, "crc32") == 0) {
+            config_flags |= OASIS_CONFIG_INCLUDE_CRC32;
+        } else if (strcmp(validation, "checksum32") == 0) {
+            config_flags |= OASIS_CONFIG_INCLUDE_CHECKSUM32;
+        } else {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument validation must be \"crc32\", \"checksum32\", or None.");
+            Py_DECREF(pyinfile);
+            Py_DECREF(pyoutfile);
+            return NULL;
+        }
+    }
+
+    ErrorCode error_code =
+        gds_to_oas(PyBytes_AS_STRING(pyinfile), PyBytes_AS_STRING(pyoutfile), circle_tolerance,
+                   compression_level, config_flags);
+    Py_DECREF(pyinfile);
+    Py_DECREF(pyoutfile);
+    if (return_error(error_code)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* oas_to_gds_function(PyObject* mod, PyObject* args, PyObject* kwds) {
+    const char* keywords[] = {"infile",     "outfile",   "unit", "tolerance",
+                              "max_points", "timestamp", NULL};
+    PyObject* pyinfile = NULL;
+    PyObject* pyoutfile = NULL;
+    PyObject* pytimestamp = Py_None;
+    double unit = 0;
+    double tolerance = 0;
+    uint64_t max_points = 199;
+    tm* timestamp = NULL;
+    tm _timestamp = {};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|ddKO:oas_to_gds", (char**)keywords,
+                                     PyUnicode_FSConverter, &pyinfile, PyUnicode_FSConverter,
+                                     &pyoutfile, &unit, &tolerance, &max_points, &pytimestamp))
+        return NULL;
+
+    if (pytimestamp != Py_None) {
+        if (!PyDateTime_Check(pytimestamp)) {
+            PyErr_SetString(PyExc_TypeError, "Timestamp must be a datetime object.");
+            Py_DECREF(pyinfile);
+            Py_DECREF(pyoutfile);
+            return NULL;
+        }
+        _timestamp.tm_year = PyDateTime_GET_YEAR(pytimestamp) - 1900;
+        _timestamp.tm_mon = PyDateTime_GET_MONTH(pytimestamp) - 1;
+        _timestamp.tm_mday = PyDateTime_GET_DAY(pytimestamp);
+        _timestamp.tm_hour = PyDateTime_DATE_GET_HOUR(pytimestamp);
+        _timestamp.tm_min = PyDateTime_DATE_GET_MINUTE(pytimestamp);
+        _timestamp.tm_sec = PyDateTime_DATE_GET_SECOND(pytimestamp);
+        timestamp = &_timestamp;
+    }
+
+    ErrorCode error_code = oas_to_gds(PyBytes_AS_STRING(pyinfile), PyBytes_AS_STRING(pyoutfile),
+                                      unit, tolerance, max_points, timestamp);
+    Py_DECREF(pyinfile);
+    Py_DECREF(pyoutfile);
+    if (return_error(error_code)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* gds_transform_function(PyObject* mod, PyObject* args, PyObject* kwds) {
+    const char* keywords[] = {"infile", "outfile", "filter", "layer_type_map",
+                              "rename", "unit",    "precision", NULL};
+    PyObject* pyinfile = NULL;
+    PyObject* pyoutfile = NULL;
+    PyObject* pyfilter = Py_None;
+    PyObject* pytag_map = Py_None;
+    PyObject* pyrename = Py_None;
+    double unit = 0;
+    double precision = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&O&|OOOdd:gds_transform", (char**)keywords,
+                                     PyUnicode_FSConverter, &pyinfile, PyUnicode_FSConverter,
+                                     &pyoutfile, &pyfilter, &pytag_map, &pyrename, &unit,
+                                     &precision))
+        return NULL;
+
+    Set<Tag> shape_tags = {};
+    TagMap tag_map = {};
+    Map<const char*> cell_names = {};
+    PyObject* py_items = NULL;
+    PyObject* result = NULL;
+
+    if (pyfilter != Py_None && parse_tag_sequence(pyfilter, shape_tags, "filter") < 0)
+        goto CLEANUP;
+    if (pytag_map != Py_None && parse_tag_map(pytag_map, tag_map, "layer_type_map") < 0)
+        goto CLEANUP;
+    if (pyrename != Py_None) {
+        if (!PyMapping_Check(pyrename) || !(py_items = PyMapping_Items(pyrename))) {
+            PyErr_SetString(PyExc_TypeError, "Argument rename must be a mapping of strings.");
+            goto CLEANUP;
+        }
+        // Strings remain valid while py_items holds the references
+        const int64_t count = PyList_Size(py_items);
+        for (int64_t i = 0; i < count; i++) {
+            PyObject* py_item = PyList_GET_ITEM(py_items, i);
+            const char* old_name = PyUnicode_Check(PyTuple_GET_ITEM(py_item, 0))
+                                       ? PyUnicode_AsUTF8(PyTuple_GET_ITEM(py_item, 0))
+                                       : NULL;
+            const char* new_name = PyUnicode_Check(PyTuple_GET_ITEM(py_item, 1))
+                                       ? PyUnicode_AsUTF8(PyTuple_GET_ITEM(py_item, 1))
+                                       : NULL;
+            if (!old_name || !new_name) {
+                if (!PyErr_Occurred()) {
+                    PyErr_SetString(PyExc_TypeError,
+                                    "Argument rename must be a mapping of strings.");
+                }
+                goto CLEANUP;
+            }
+            cell_names.set(old_name, new_name);
+        }
+    }
+
+    {
+        ErrorCode error_code = gds_transform(
+            PyBytes_AS_STRING(pyinfile), PyBytes_AS_STRING(pyoutfile),
+            pyfilter == Py_None ? NULL : &shape_tags, pytag_map == Py_None ? NULL : &tag_map,
+            pyrename == Py_None ? NULL : &cell_names, unit, precision);
+        if (!return_error(error_code)) {
+            Py_INCREF(Py_None);
+            result = Py_None;
+        }
+    }
+
+CLEANUP:
+    Py_XDECREF(py_items);
+    shape_tags.clear();
+    tag_map.clear();
+    cell_names.clear();
+    Py_DECREF(pyinfile);
+    Py_DECREF(pyoutfile);
+    return result;
+}
+
+static PyObject* spill_enable_function(PyObject* mod, PyObject* args, PyObject* kwds) {
+    PyObject* pybytes = NULL;
+    unsigned long long threshold = 4096;
+    unsigned long long resident_limit = 1ULL << 30;
+    const char* keywords[] = {"threshold", "resident_limit", "directory", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|KKO&:spill_enable", (char**)keywords,
+                                     &threshold, &resident_limit, PyUnicode_FSConverter,
+                                     &pybytes))
+        return NULL;
+
+    const char* directory = pybytes ? PyBytes_AS_STRING(pybytes) : NULL;
+    ErrorCode error_code = spill_enable(directory, threshold, resident_limit);
+    Py_XDECREF(pybytes);
+    if (return_error(error_code)) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject* spill_disable_function(PyObject* mod, PyObject* args) {
+    spill_disable();
+    Py_RETURN_NONE;
+}
+
+static PyObject* spill_release_function(PyObject* mod, PyObject* args) {
+    spill_release();
+    Py_RETURN_NONE;
+}
+
+static PyObject* spill_info_function(PyObject* mod, PyObject* args) {
+    SpillInfo info = spill_info();
+    return Py_BuildValue("{sKsKsKsKsKsK}", "threshold", info.threshold, "file_size",
+                         info.file_size, "allocated", info.allocated, "block_count",
+                         info.block_count, "resident", info.resident, "resident_limit",
+                         info.resident_limit);
+}
+
 extern "C" {
 
 static PyMethodDef gdstk_methods[] = {
@@ -1882,6 +2108,8 @@ static PyMethodDef gdstk_methods[] = {
      all_inside_function_doc},
     {"any_inside", (PyCFunction)any_inside_function, METH_VARARGS | METH_KEYWORDS,
      any_inside_function_doc},
+    {"check_polygons", (PyCFunction)check_polygons_function, METH_VARARGS | METH_KEYWORDS,
+     check_polygons_function_doc},
     {"read_gds", (PyCFunction)read_gds_function, METH_VARARGS | METH_KEYWORDS,
      read_gds_function_doc},
     {"read_oas", (PyCFunction)read_oas_function, METH_VARARGS | METH_KEYWORDS,
@@ -1895,6 +2123,19 @@ static PyMethodDef gdstk_methods[] = {
     {"oas_precision", (PyCFunction)oas_precision_function, METH_VARARGS,
      oas_precision_function_doc},
     {"oas_validate", (PyCFunction)oas_validate_function, METH_VARARGS, oas_validate_function_doc},
+    {"gds_to_oas", (PyCFunction)gds_to_oas_function, METH_VARARGS | METH_KEYWORDS,
+     gds_to_oas_function_doc},
+    {"gds_transform", (PyCFunction)gds_transform_function, METH_VARARGS | METH_KEYWORDS,
+     gds_transform_function_doc},
+    {"oas_to_gds", (PyCFunction)oas_to_gds_function, METH_VARARGS | METH_KEYWORDS,
+     oas_to_gds_function_doc},
+    {"spill_enable", (PyCFunction)spill_enable_function, METH_VARARGS | METH_KEYWORDS,
+     spill_enable_function_doc},
+    {"spill_disable", (PyCFunction)spill_disable_function, METH_NOARGS,
+     spill_disable_function_doc},
+    {"spill_release", (PyCFunction)spill_release_function, METH_NOARGS,
+     spill_release_function_doc},
+    {"spill_info", (PyCFunction)spill_info_function, METH_NOARGS, spill_info_function_doc},
     {NULL, NULL, 0, NULL}};
 
 static int gdstk_exec(PyObject* module) {
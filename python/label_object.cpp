@@ -136,6 +136,7 @@ static PyObject* label_object_deepcopy(LabelObject* self, PyObject* arg) {
 static PyObject* label_object_apply_repetition(LabelObject* self, PyObject*) {
     Array<Label*> array = {};
     self->label->apply_repetition(array);
+    label_change_count++;
     PyObject* result = PyList_New(array.count);
     for (uint64_t i = 0; i < array.count; i++) {
         LabelObject* obj = PyObject_New(LabelObject, &label_object_type);
@@ -234,6 +235,7 @@ int label_object_set_text(LabelObject* self, PyObject* arg, void*) {
     Label* label = self->label;
     label->text = (char*)reallocate(label->text, ++len);
     memcpy(label->text, src, len);
+    label_change_count++;
     return 0;
 }
 
@@ -243,6 +245,7 @@ static PyObject* label_object_get_origin(LabelObject* self, void*) {
 
 int label_object_set_origin(LabelObject* self, PyObject* arg, void*) {
     if (parse_point(arg, self->label->origin, "origin") != 0) return -1;
+    label_change_count++;
     return 0;
 }
 
@@ -401,6 +404,8 @@ static PyObject* label_object_get_layer(LabelObject* self, void*) {
 
 static int label_object_set_layer(LabelObject* self, PyObject* arg, void*) {
     set_layer(self->label->tag, (uint32_t)PyLong_AsUnsignedLongLong(arg));
+    tag_change_count++;
+    label_change_count++;
     if (PyErr_Occurred()) {
         PyErr_SetString(PyExc_TypeError, "Unable to convert layer to int.");
         return -1;
@@ -414,6 +419,8 @@ static PyObject* label_object_get_texttype(LabelObject* self, void*) {
 
 static int label_object_set_texttype(LabelObject* self, PyObject* arg, void*) {
     set_type(self->label->tag, (uint32_t)PyLong_AsUnsignedLongLong(arg));
+    tag_change_count++;
+    label_change_count++;
     if (PyErr_Occurred()) {
         PyErr_SetString(PyExc_TypeError, "Unable to convert texttype to int.");
         return -1;
@@ -437,6 +444,7 @@ static PyObject* label_object_get_repetition(LabelObject* self, void*) {
 }
 
 int label_object_set_repetition(LabelObject* self, PyObject* arg, void*) {
+    label_change_count++;
     if (arg == Py_None) {
         self->label->repetition.clear();
         return 0;
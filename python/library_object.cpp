@@ -13,6 +13,14 @@ static PyObject* library_object_str(LibraryObject* self) {
     return PyUnicode_FromString(buffer);
 }
 
+static void clear_label_index(LibraryObject* self) {
+    if (self->label_index) {
+        self->label_index->clear();
+        free_allocation(self->label_index);
+        self->label_index = NULL;
+    }
+}
+
 static void library_object_dealloc(LibraryObject* self) {
     Library* library = self->library;
     if (library) {
@@ -23,6 +31,7 @@ static void library_object_dealloc(LibraryObject* self) {
         library->clear();
         free_allocation(library);
     }
+    clear_label_index(self);
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -53,6 +62,7 @@ static int library_object_init(LibraryObject* self, PyObject* args, PyObject* kw
         for (uint64_t i = 0; i < library->rawcell_array.count; i++)
             Py_DECREF(library->rawcell_array[i]->owner);
         library->clear();
+        clear_label_index(self);
     } else {
         self->library = (Library*)allocate_clear(sizeof(Library));
         library = self->library;
@@ -103,6 +113,88 @@ static PyObject* library_object_add(LibraryObject* self, PyObject* args) {
     return (PyObject*)self;
 }
 
+static PyObject* create_library_copy(const Library& source, bool deep_copy) {
+    Library* library = (Library*)allocate_clear(sizeof(Library));
+    library->copy_from(source, deep_copy);
+
+    PyObject* result;
+    if (deep_copy) {
+        result = create_library_objects(library);
+    } else {
+        LibraryObject* obj = PyObject_New(LibraryObject, &library_object_type);
+        obj = (LibraryObject*)PyObject_Init((PyObject*)obj, &library_object_type);
+        obj->library = library;
+        obj->label_index = NULL;
+        library->owner = obj;
+        for (uint64_t i = 0; i < library->cell_array.count; i++)
+            Py_INCREF(library->cell_array[i]->owner);
+        result = (PyObject*)obj;
+    }
+    // Rawcells are shared between both libraries
+    for (uint64_t i = 0; i < library->rawcell_array.count; i++)
+        Py_INCREF(library->rawcell_array[i]->owner);
+    return result;
+}
+
+static PyObject* library_object_copy(LibraryObject* self, PyObject* args, PyObject* kwds) {
+    int deep_copy = 1;
+    const char* keywords[] = {"deep_copy", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p:copy", (char**)keywords, &deep_copy))
+        return NULL;
+    return create_library_copy(*self->library, deep_copy > 0);
+}
+
+static PyObject* library_object_deepcopy(LibraryObject* self, PyObject* arg) {
+    return create_library_copy(*self->library, true);
+}
+
+static PyObject* library_object_deduplicate(LibraryObject* self, PyObject* args, PyObject* kwds) {
+    int translation_invariant = 0;
+    const char* keywords[] = {"translation_invariant", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|p:deduplicate", (char**)keywords,
+                                     &translation_invariant))
+        return NULL;
+
+    Library* library = self->library;
+
+    // Referenced cells before deduplication, to update the reference counts
+    // of the Python objects afterwards
+    Array<Reference*> references = {};
+    Array<Cell*> referenced = {};
+    for (uint64_t i = 0; i < library->cell_array.count; i++) {
+        Reference** reference = library->cell_array[i]->reference_array.items;
+        for (uint64_t j = library->cell_array[i]->reference_array.count; j > 0; j--, reference++) {
+            if ((*reference)->type == ReferenceType::Cell) {
+                references.append(*reference);
+                referenced.append((*reference)->cell);
+            }
+        }
+    }
+
+    Array<Cell*> removed = {};
+    Array<Cell*> replacements = {};
+    library->deduplicate(translation_invariant > 0, removed, replacements);
+
+    for (uint64_t i = 0; i < references.count; i++) {
+        Cell* cell = references[i]->cell;
+        if (cell != referenced[i]) {
+            Py_INCREF(cell->owner);
+            Py_DECREF(referenced[i]->owner);
+        }
+    }
+    references.clear();
+    referenced.clear();
+    replacements.clear();
+
+    // The library references to the removed cells are transferred to the list
+    PyObject* result = PyList_New(removed.count);
+    for (uint64_t i = 0; i < removed.count; i++) {
+        PyList_SET_ITEM(result, i, (PyObject*)removed[i]->owner);
+    }
+    removed.clear();
+    return result;
+}
+
 static PyObject* library_object_new_cell(LibraryObject* self, PyObject* args) {
     const char* name = NULL;
     if (!PyArg_ParseTuple(args, "s:new_cell", &name)) return NULL;
@@ -147,107 +239,107 @@ static PyObject* library_object_remove(LibraryObject* self, PyObject* args) {
     return (PyObject*)self;
 }
 
-static void library_replace_cell(Library* library, Cell* cell) {
+// Replace all cells and rawcells in the library with the same names as the
+// replacements (cell or rawcell objects, whose references are transferred to
+// the library), updating references in a single pass.
+static void library_replace(Library* library, const Map<PyObject*>& replacements,
+                            const Array<PyObject*>& order) {
     Array<Cell*>* cell_array = &library->cell_array;
+    uint64_t count = 0;
     for (uint64_t i = 0; i < cell_array->count; i++) {
         Cell* c = cell_array->items[i];
-        if (strcmp(cell->name, c->name) == 0) {
-            cell_array->remove_unordered(i--);
+        if (replacements.has_key(c->name)) {
             Py_DECREF(c->owner);
         } else {
-            Reference** ref_pp = c->reference_array.items;
-            for (uint64_t j = c->reference_array.count; j > 0; j--, ref_pp++) {
-                Reference* reference = *ref_pp;
-                if (reference->type == ReferenceType::Cell) {
-                    if (cell != reference->cell && strcmp(cell->name, reference->cell->name) == 0) {
-                        Py_DECREF(reference->cell->owner);
-                        Py_INCREF(cell->owner);
-                        reference->cell = cell;
-                    }
-                } else if (reference->type == ReferenceType::RawCell) {
-                    if (strcmp(cell->name, reference->rawcell->name) == 0) {
-                        Py_DECREF(reference->rawcell->owner);
-                        Py_INCREF(cell->owner);
-                        reference->type = ReferenceType::Cell;
-                        reference->cell = cell;
-                    }
-                }
-            }
+            cell_array->items[count++] = c;
         }
     }
+    cell_array->count = count;
+
     Array<RawCell*>* rawcell_array = &library->rawcell_array;
+    count = 0;
     for (uint64_t i = 0; i < rawcell_array->count; i++) {
         RawCell* c = rawcell_array->items[i];
-        if (strcmp(cell->name, c->name) == 0) {
-            rawcell_array->remove_unordered(i--);
+        if (replacements.has_key(c->name)) {
             Py_DECREF(c->owner);
+        } else {
+            rawcell_array->items[count++] = c;
         }
     }
-    library->cell_array.append(cell);
-}
+    rawcell_array->count = count;
 
-static void library_replace_rawcell(Library* library, RawCell* rawcell) {
-    Array<Cell*>* cell_array = &library->cell_array;
-    for (uint64_t i = 0; i < cell_array->count; i++) {
-        Cell* c = cell_array->items[i];
-        if (strcmp(rawcell->name, c->name) == 0) {
-            cell_array->remove_unordered(i--);
-            Py_DECREF(c->owner);
+    for (uint64_t i = 0; i < order.count; i++) {
+        PyObject* obj = order[i];
+        if (CellObject_Check(obj)) {
+            cell_array->append(((CellObject*)obj)->cell);
         } else {
-            Reference** ref_pp = c->reference_array.items;
-            for (uint64_t j = c->reference_array.count; j > 0; j--, ref_pp++) {
-                Reference* reference = *ref_pp;
-                if (reference->type == ReferenceType::Cell) {
-                    if (strcmp(rawcell->name, reference->cell->name) == 0) {
-                        Py_DECREF(reference->cell->owner);
-                        Py_INCREF(rawcell->owner);
-                        reference->rawcell = rawcell;
-                        reference->type = ReferenceType::RawCell;
-                    }
-                } else if (reference->type == ReferenceType::RawCell) {
-                    if (rawcell != reference->rawcell &&
-                        strcmp(rawcell->name, reference->rawcell->name) == 0) {
-                        Py_DECREF(reference->rawcell->owner);
-                        Py_INCREF(rawcell->owner);
-                        reference->rawcell = rawcell;
-                    }
-                }
-            }
+            rawcell_array->append(((RawCellObject*)obj)->rawcell);
         }
     }
-    Array<RawCell*>* rawcell_array = &library->rawcell_array;
-    for (uint64_t i = 0; i < rawcell_array->count; i++) {
-        RawCell* c = rawcell_array->items[i];
-        if (strcmp(rawcell->name, c->name) == 0) {
-            rawcell_array->remove_unordered(i--);
-            Py_DECREF(c->owner);
+
+    for (uint64_t i = 0; i < cell_array->count; i++) {
+        Cell* c = cell_array->items[i];
+        Reference** ref_pp = c->reference_array.items;
+        for (uint64_t j = c->reference_array.count; j > 0; j--, ref_pp++) {
+            Reference* reference = *ref_pp;
+            if (reference->type == ReferenceType::Name) continue;
+            bool is_cell = reference->type == ReferenceType::Cell;
+            PyObject* obj =
+                replacements.get(is_cell ? reference->cell->name : reference->rawcell->name);
+            if (!obj) continue;
+            PyObject* owner = is_cell ? (PyObject*)reference->cell->owner
+                                      : (PyObject*)reference->rawcell->owner;
+            if (owner == obj) continue;
+            Py_DECREF(owner);
+            Py_INCREF(obj);
+            if (CellObject_Check(obj)) {
+                reference->type = ReferenceType::Cell;
+                reference->cell = ((CellObject*)obj)->cell;
+            } else {
+                reference->type = ReferenceType::RawCell;
+                reference->rawcell = ((RawCellObject*)obj)->rawcell;
+            }
         }
     }
-    library->rawcell_array.append(rawcell);
+}
+
+// Add a replacement (stealing the reference to obj).  Later replacements
+// with the same name take precedence.
+static void add_replacement(PyObject* obj, Map<PyObject*>& replacements,
+                            Array<PyObject*>& order) {
+    const char* name = CellObject_Check(obj) ? ((CellObject*)obj)->cell->name
+                                             : ((RawCellObject*)obj)->rawcell->name;
+    PyObject* previous = replacements.get(name);
+    if (previous) {
+        order.remove_item(previous);
+        Py_DECREF(previous);
+    }
+    replacements.set(name, obj);
+    order.append(obj);
 }
 
 static PyObject* library_object_replace(LibraryObject* self, PyObject* args) {
     uint64_t len = PyTuple_GET_SIZE(args);
-    Library* library = self->library;
+    Map<PyObject*> replacements = {};
+    Array<PyObject*> order = {};
 
     for (uint64_t i = 0; i < len; i++) {
         PyObject* arg = PyTuple_GET_ITEM(args, i);
         Py_INCREF(arg);
-        if (CellObject_Check(arg)) {
-            library_replace_cell(library, ((CellObject*)arg)->cell);
-        } else if (RawCellObject_Check(arg)) {
-            library_replace_rawcell(library, ((RawCellObject*)arg)->rawcell);
+        if (CellObject_Check(arg) || RawCellObject_Check(arg)) {
+            add_replacement(arg, replacements, order);
         } else if (PyIter_Check(arg)) {
             PyObject* item = PyIter_Next(arg);
             while (item) {
-                if (CellObject_Check(item)) {
-                    library_replace_cell(library, ((CellObject*)item)->cell);
-                } else if (RawCellObject_Check(item)) {
-                    library_replace_rawcell(library, ((RawCellObject*)item)->rawcell);
+                if (CellObject_Check(item) || RawCellObject_Check(item)) {
+                    add_replacement(item, replacements, order);
                 } else {
                     PyErr_SetString(PyExc_TypeError, "Arguments must be of type Cell or RawCell.");
                     Py_DECREF(item);
                     Py_DECREF(arg);
+                    for (uint64_t j = 0; j < order.count; j++) Py_DECREF(order[j]);
+                    replacements.clear();
+                    order.clear();
                     return NULL;
                 }
                 item = PyIter_Next(arg);
@@ -256,9 +348,16 @@ static PyObject* library_object_replace(LibraryObject* self, PyObject* args) {
         } else {
             PyErr_SetString(PyExc_TypeError, "Arguments must be of type Cell or RawCell.");
             Py_DECREF(arg);
+            for (uint64_t j = 0; j < order.count; j++) Py_DECREF(order[j]);
+            replacements.clear();
+            order.clear();
             return NULL;
         }
     }
+
+    library_replace(self->library, replacements, order);
+    replacements.clear();
+    order.clear();
     Py_INCREF(self);
     return (PyObject*)self;
 }
@@ -282,6 +381,44 @@ static PyObject* library_object_rename_cell(LibraryObject* self, PyObject* args,
     return (PyObject*)self;
 }
 
+static PyObject* library_object_rename_cells(LibraryObject* self, PyObject* args, PyObject* kwds) {
+    const char* keywords[] = {"names", NULL};
+    PyObject* py_names = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O:rename_cells", (char**)keywords, &py_names))
+        return NULL;
+
+    if (!PyDict_Check(py_names)) {
+        PyErr_SetString(PyExc_TypeError, "Argument names must be a dictionary.");
+        return NULL;
+    }
+
+    Map<const char*> names = {};
+    Py_ssize_t pos = 0;
+    PyObject* py_key;
+    PyObject* py_value;
+    while (PyDict_Next(py_names, &pos, &py_key, &py_value)) {
+        const char* old_name = NULL;
+        if (PyUnicode_Check(py_key)) {
+            old_name = PyUnicode_AsUTF8(py_key);
+        } else if (CellObject_Check(py_key)) {
+            old_name = ((CellObject*)py_key)->cell->name;
+        }
+        const char* new_name = PyUnicode_Check(py_value) ? PyUnicode_AsUTF8(py_value) : NULL;
+        if (!old_name || !new_name) {
+            PyErr_SetString(PyExc_TypeError,
+                            "Keys in names must be strings or cells, and values strings.");
+            names.clear();
+            return NULL;
+        }
+        names.set(old_name, new_name);
+    }
+
+    self->library->rename_cells(names);
+    names.clear();
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
 static PyObject* library_object_top_level(LibraryObject* self, PyObject*) {
     Library* library = self->library;
     Array<Cell*> top_cells = {};
@@ -383,6 +520,123 @@ static PyObject* library_object_remap(LibraryObject* self, PyObject* args, PyObj
     return (PyObject*)self;
 }
 
+static PyObject* library_object_rescale(LibraryObject* self, PyObject* args, PyObject* kwds) {
+    double unit = 0;
+    const char* keywords[] = {"unit", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d:rescale", (char**)keywords, &unit))
+        return NULL;
+    if (unit <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Unit must be positive.");
+        return NULL;
+    }
+    self->library->rescale(unit);
+    clear_label_index(self);
+    Py_INCREF(self);
+    return (PyObject*)self;
+}
+
+static PyObject* library_object_snap(LibraryObject* self, PyObject* args, PyObject* kwds) {
+    double grid = 0;
+    const char* keywords[] = {"grid", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "d:snap", (char**)keywords, &grid)) return NULL;
+    if (grid <= 0) {
+        PyErr_SetString(PyExc_ValueError, "Grid must be positive.");
+        return NULL;
+    }
+
+    Library* library = self->library;
+    Array<uint64_t> moved = {};
+    library->snap(grid, moved);
+    clear_label_index(self);
+
+    PyObject* result = PyDict_New();
+    if (!result) {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to create dictionary.");
+        moved.clear();
+        return NULL;
+    }
+    for (uint64_t i = 0; i < moved.count; i++) {
+        if (moved[i] == 0) continue;
+        PyObject* value = PyLong_FromUnsignedLongLong(moved[i]);
+        if (!value || PyDict_SetItemString(result, library->cell_array[i]->name, value) < 0) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to insert value in dictionary.");
+            Py_XDECREF(value);
+            Py_DECREF(result);
+            moved.clear();
+            return NULL;
+        }
+        Py_DECREF(value);
+    }
+    moved.clear();
+    return result;
+}
+
+static PyObject* library_object_find_labels(LibraryObject* self, PyObject* args,
+                                            PyObject* kwds) {
+    PyObject* py_cell = NULL;
+    const char* text = NULL;
+    PyObject* py_region = Py_None;
+    int rebuild = 0;
+    const char* keywords[] = {"cell", "text", "region", "rebuild", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|zOp:find_labels", (char**)keywords, &py_cell,
+                                     &text, &py_region, &rebuild))
+        return NULL;
+
+    if (!CellObject_Check(py_cell)) {
+        PyErr_SetString(PyExc_TypeError, "Argument cell must be a Cell.");
+        return NULL;
+    }
+    const Cell* cell = ((CellObject*)py_cell)->cell;
+
+    Vec2 min = {-DBL_MAX, -DBL_MAX};
+    Vec2 max = {DBL_MAX, DBL_MAX};
+    if (py_region != Py_None) {
+        if (!PySequence_Check(py_region) || PySequence_Length(py_region) != 2) {
+            PyErr_SetString(PyExc_TypeError,
+                            "Argument region must be a sequence of 2 points (lower left and upper "
+                            "right corners).");
+            return NULL;
+        }
+        PyObject* point = PySequence_ITEM(py_region, 0);
+        int result = parse_point(point, min, "region");
+        Py_XDECREF(point);
+        if (result < 0) return NULL;
+        point = PySequence_ITEM(py_region, 1);
+        result = parse_point(point, max, "region");
+        Py_XDECREF(point);
+        if (result < 0) return NULL;
+    }
+
+    if (rebuild) clear_label_index(self);
+    if (!self->label_index) self->label_index = (LabelIndex*)allocate_clear(sizeof(LabelIndex));
+    Array<LabelInstance> instances = {};
+    self->label_index->find(*cell, text, min, max, instances);
+
+    PyObject* result = PyList_New(instances.count);
+    if (!result) {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to create return list.");
+        instances.clear();
+        return NULL;
+    }
+    for (uint64_t i = 0; i < instances.count; i++) {
+        const LabelInstance* instance = instances.items + i;
+        PyObject* item = Py_BuildValue(
+            "OO(dd)((dd)ddO)", (PyObject*)instance->cell->owner,
+            (PyObject*)instance->label->owner, instance->position.x, instance->position.y,
+            instance->origin.x, instance->origin.y, instance->rotation, instance->magnification,
+            instance->x_reflection ? Py_True : Py_False);
+        if (!item) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to create return value.");
+            Py_DECREF(result);
+            instances.clear();
+            return NULL;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+    instances.clear();
+    return result;
+}
+
 static PyObject* library_object_write_gds(LibraryObject* self, PyObject* args, PyObject* kwds) {
     const char* keywords[] = {"outfile", "max_points", "timestamp", NULL};
     PyObject* pybytes = NULL;
@@ -483,10 +737,18 @@ static PyObject* library_object_delete_property(LibraryObject* self, PyObject* a
 static PyMethodDef library_object_methods[] = {
     {"add", (PyCFunction)library_object_add, METH_VARARGS, library_object_add_doc},
     {"remove", (PyCFunction)library_object_remove, METH_VARARGS, library_object_remove_doc},
+    {"copy", (PyCFunction)library_object_copy, METH_VARARGS | METH_KEYWORDS,
+     library_object_copy_doc},
+    {"__deepcopy__", (PyCFunction)library_object_deepcopy, METH_VARARGS | METH_KEYWORDS,
+     library_object_deepcopy_doc},
     {"replace", (PyCFunction)library_object_replace, METH_VARARGS, library_object_replace_doc},
+    {"deduplicate", (PyCFunction)library_object_deduplicate, METH_VARARGS | METH_KEYWORDS,
+     library_object_deduplicate_doc},
     {"new_cell", (PyCFunction)library_object_new_cell, METH_VARARGS, library_object_new_cell_doc},
     {"rename_cell", (PyCFunction)library_object_rename_cell, METH_VARARGS | METH_KEYWORDS,
      library_object_rename_cell_doc},
+    {"rename_cells", (PyCFunction)library_object_rename_cells, METH_VARARGS | METH_KEYWORDS,
+     library_object_rename_cells_doc},
     {"top_level", (PyCFunction)library_object_top_level, METH_NOARGS, library_object_top_level_doc},
     {"layers_and_datatypes", (PyCFunction)library_object_layers_and_datatypes, METH_NOARGS,
      library_object_layers_and_datatypes_doc},
@@ -494,6 +756,12 @@ static PyMethodDef library_object_methods[] = {
      library_object_layers_and_texttypes_doc},
     {"remap", (PyCFunction)library_object_remap, METH_VARARGS | METH_KEYWORDS,
      library_object_remap_doc},
+    {"rescale", (PyCFunction)library_object_rescale, METH_VARARGS | METH_KEYWORDS,
+     library_object_rescale_doc},
+    {"snap", (PyCFunction)library_object_snap, METH_VARARGS | METH_KEYWORDS,
+     library_object_snap_doc},
+    {"find_labels", (PyCFunction)library_object_find_labels, METH_VARARGS | METH_KEYWORDS,
+     library_object_find_labels_doc},
     {"write_gds", (PyCFunction)library_object_write_gds, METH_VARARGS | METH_KEYWORDS,
      library_object_write_gds_doc},
     {"write_oas", (PyCFunction)library_object_write_oas, METH_VARARGS | METH_KEYWORDS,
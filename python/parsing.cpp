@@ -171,6 +171,114 @@ static int64_t parse_tag_sequence(PyObject* iterable, Set<Tag>& dest, const char
     return count;
 }
 
+static int64_t parse_tag_map(PyObject* py_map, TagMap& dest, const char* name) {
+    if (!PyMapping_Check(py_map)) {
+        PyErr_Format(PyExc_TypeError,
+                     "Argument %s must be a mapping of (layer, type) tuples to (layer, type) tuples.",
+                     name);
+        return -1;
+    }
+    PyObject* py_items = PyMapping_Items(py_map);
+    if (!py_items) {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to get map items.");
+        return -1;
+    }
+    const int64_t count = PyList_Size(py_items);
+    for (int64_t i = 0; i < count; i++) {
+        PyObject* py_item = PyList_GET_ITEM(py_items, i);
+        Tag key;
+        Tag value;
+        if (!parse_tag(PyTuple_GET_ITEM(py_item, 0), key) ||
+            !parse_tag(PyTuple_GET_ITEM(py_item, 1), value)) {
+            PyErr_Format(PyExc_TypeError,
+                         "Keys and values in argument %s must be (layer, type) tuples.", name);
+            Py_DECREF(py_items);
+            return -1;
+        }
+        dest.set(key, value);
+    }
+    Py_DECREF(py_items);
+    return count;
+}
+
+// Colors are given as "#RRGGBB" or "#RRGGBBAA" strings, or "none" for full
+// transparency.
+static bool parse_color(PyObject* py_color, uint32_t& color, const char* name) {
+    if (!PyUnicode_Check(py_color)) {
+        PyErr_Format(PyExc_TypeError, "Colors in %s must be strings.", name);
+        return false;
+    }
+    Py_ssize_t len = 0;
+    const char* str = PyUnicode_AsUTF8AndSize(py_color, &len);
+    if (!str) return false;
+    if (strcmp(str, "none") == 0) {
+        color = 0;
+        return true;
+    }
+    char* end = NULL;
+    if ((len == 7 || len == 9) && str[0] == '#') {
+        color = (uint32_t)strtoul(str + 1, &end, 16);
+        if (*end == 0) {
+            if (len == 7) color = (color << 8) | 0xFF;
+            return true;
+        }
+    }
+    PyErr_Format(PyExc_ValueError,
+                 "Invalid color '%s' in %s.  Colors must be in the formats \"#RRGGBB\" or "
+                 "\"#RRGGBBAA\".",
+                 str, name);
+    return false;
+}
+
+// Parse item i (arg) of sequence name appending the result to polygon_array.
+// On error, all polygons in polygon_array are freed.
+static int64_t parse_polygons_item(PyObject* arg, int64_t i, Array<Polygon*>& polygon_array,
+                                   const char* name) {
+    if (PolygonObject_Check(arg)) {
+        Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
+        polygon->copy_from(*((PolygonObject*)arg)->polygon);
+        polygon_array.append(polygon);
+    } else if (FlexPathObject_Check(arg)) {
+        ErrorCode error_code =
+            ((FlexPathObject*)arg)->flexpath->to_polygons(false, 0, polygon_array);
+        if (return_error(error_code)) {
+            for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
+                polygon_array[j]->clear();
+                free_allocation(polygon_array[j]);
+            }
+            polygon_array.clear();
+            return -1;
+        }
+    } else if (RobustPathObject_Check(arg)) {
+        ErrorCode error_code =
+            ((RobustPathObject*)arg)->robustpath->to_polygons(false, 0, polygon_array);
+        if (return_error(error_code)) {
+            for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
+                polygon_array[j]->clear();
+                free_allocation(polygon_array[j]);
+            }
+            polygon_array.clear();
+            return -1;
+        }
+    } else if (ReferenceObject_Check(arg)) {
+        ((ReferenceObject*)arg)->reference->get_polygons(true, true, -1, false, 0, polygon_array);
+    } else {
+        Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
+        if (parse_point_sequence(arg, polygon->point_array, "") <= 0) {
+            PyErr_Format(PyExc_RuntimeError,
+                         "Unable to parse item %" PRIu64 " from sequence %s.", i, name);
+            for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
+                polygon_array[j]->clear();
+                free_allocation(polygon_array[j]);
+            }
+            polygon_array.clear();
+            return -1;
+        }
+        polygon_array.append(polygon);
+    }
+    return 0;
+}
+
 // polygon_array should be zero-initialized
 static int64_t parse_polygons(PyObject* py_polygons, Array<Polygon*>& polygon_array,
                               const char* name) {
@@ -216,50 +324,9 @@ static int64_t parse_polygons(PyObject* py_polygons, Array<Polygon*>& polygon_ar
                 polygon_array.clear();
                 return -1;
             }
-            if (PolygonObject_Check(arg)) {
-                Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
-                polygon->copy_from(*((PolygonObject*)arg)->polygon);
-                polygon_array.append(polygon);
-            } else if (FlexPathObject_Check(arg)) {
-                ErrorCode error_code =
-                    ((FlexPathObject*)arg)->flexpath->to_polygons(false, 0, polygon_array);
-                if (return_error(error_code)) {
-                    for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
-                        polygon_array[j]->clear();
-                        free_allocation(polygon_array[j]);
-                    }
-                    polygon_array.clear();
-                    return -1;
-                }
-            } else if (RobustPathObject_Check(arg)) {
-                ErrorCode error_code =
-                    ((RobustPathObject*)arg)->robustpath->to_polygons(false, 0, polygon_array);
-                if (return_error(error_code)) {
-                    for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
-                        polygon_array[j]->clear();
-                        free_allocation(polygon_array[j]);
-                    }
-                    polygon_array.clear();
-                    return -1;
-                }
-            } else if (ReferenceObject_Check(arg)) {
-                ((ReferenceObject*)arg)
-                    ->reference->get_polygons(true, true, -1, false, 0, polygon_array);
-            } else {
-                Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
-                if (parse_point_sequence(arg, polygon->point_array, "") <= 0) {
-                    PyErr_Format(PyExc_RuntimeError,
-                                 "Unable to parse item %" PRIu64 " from sequence %s.", i, name);
-                    for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
-                        polygon_array[j]->clear();
-                        free_allocation(polygon_array[j]);
-                    }
-                    polygon_array.clear();
-                    return -1;
-                }
-                polygon_array.append(polygon);
-            }
+            int64_t error = parse_polygons_item(arg, i, polygon_array, name);
             Py_DECREF(arg);
+            if (error < 0) return -1;
         }
     } else {
         PyErr_Format(
@@ -272,6 +339,34 @@ static int64_t parse_polygons(PyObject* py_polygons, Array<Polygon*>& polygon_ar
     return polygon_array.count;
 }
 
+// Same as parse_polygons, but sequence items are parsed in order, so that the
+// polygons in polygon_array follow the order of the items.
+static int64_t parse_polygons_in_order(PyObject* py_polygons, Array<Polygon*>& polygon_array,
+                                       const char* name) {
+    if (!PySequence_Check(py_polygons) || PolygonObject_Check(py_polygons) ||
+        FlexPathObject_Check(py_polygons) || RobustPathObject_Check(py_polygons) ||
+        ReferenceObject_Check(py_polygons))
+        return parse_polygons(py_polygons, polygon_array, name);
+    const int64_t count = PySequence_Length(py_polygons);
+    for (int64_t i = 0; i < count; i++) {
+        PyObject* arg = PySequence_ITEM(py_polygons, i);
+        if (arg == NULL) {
+            PyErr_Format(PyExc_RuntimeError,
+                         "Unable to retrieve item %" PRIu64 " from sequence %s.", i, name);
+            for (int64_t j = polygon_array.count - 1; j >= 0; j--) {
+                polygon_array[j]->clear();
+                free_allocation(polygon_array[j]);
+            }
+            polygon_array.clear();
+            return -1;
+        }
+        int64_t error = parse_polygons_item(arg, i, polygon_array, name);
+        Py_DECREF(arg);
+        if (error < 0) return -1;
+    }
+    return polygon_array.count;
+}
+
 static int update_style(PyObject* dict, StyleMap& map, const char* name) {
     Array<char> buffer = {};
     buffer.ensure_slots(4096);
@@ -514,8 +609,7 @@ static int parse_properties(Property*& properties, PyObject* arg) {
             Py_DECREF(item);
             return -1;
         }
-        Py_ssize_t string_len = 0;
-        const char* name = PyUnicode_AsUTF8AndSize(item, &string_len);
+        const char* name = PyUnicode_AsUTF8(item);
         if (!name) {
             PyErr_Format(PyExc_RuntimeError, "Unable to get name from property %" PRId64 ".",
                          count);
@@ -523,15 +617,10 @@ static int parse_properties(Property*& properties, PyObject* arg) {
             Py_DECREF(item);
             return -1;
         }
+        add_property(properties, name, NULL);
+        Property* property = properties;
         Py_DECREF(item);
 
-        Property* property = (Property*)allocate(sizeof(Property));
-        property->name = (char*)allocate(++string_len);
-        memcpy(property->name, name, string_len);
-        property->value = NULL;
-        property->next = properties;
-        properties = property;
-
         for (; num_values >= 1; num_values--) {
             item = PySequence_ITEM(py_property, num_values);
             if (!item) {
@@ -564,11 +653,8 @@ static bool parse_property(Property*& properties, PyObject* args) {
     char* name;
     PyObject* py_value;
     if (!PyArg_ParseTuple(args, "sO:set_property", &name, &py_value)) return false;
-    Property* property = (Property*)allocate(sizeof(Property));
-    property->name = copy_string(name, NULL);
-    property->next = properties;
-    properties = property;
-    property->value = (PropertyValue*)allocate_clear(sizeof(PropertyValue));
+    add_property(properties, name, (PropertyValue*)allocate_clear(sizeof(PropertyValue)));
+    Property* property = properties;
     if (add_value(property->value, py_value)) return true;
     if (!PySequence_Check(py_value)) {
         PyErr_SetString(
@@ -608,6 +694,91 @@ static bool parse_property(Property*& properties, PyObject* args) {
     return true;
 }
 
+// Parse an iterable of (layer, type) tuples into an array of unique tags.
+static int64_t parse_tag_array(PyObject* iterable, Array<Tag>& dest, const char* name) {
+    Set<Tag> tag_set = {};
+    int64_t count = parse_tag_sequence(iterable, tag_set, name);
+    if (count >= 0) tag_set.to_array(dest);
+    tag_set.clear();
+    return count < 0 ? -1 : (int64_t)dest.count;
+}
+
+// New Python objects that take ownership of the given elements
+static PyObject* build_element(Polygon* polygon) {
+    PolygonObject* obj = PyObject_New(PolygonObject, &polygon_object_type);
+    obj = (PolygonObject*)PyObject_Init((PyObject*)obj, &polygon_object_type);
+    obj->polygon = polygon;
+    polygon->owner = obj;
+    return (PyObject*)obj;
+}
+
+static PyObject* build_element(FlexPath* path) {
+    FlexPathObject* obj = PyObject_New(FlexPathObject, &flexpath_object_type);
+    obj = (FlexPathObject*)PyObject_Init((PyObject*)obj, &flexpath_object_type);
+    obj->flexpath = path;
+    path->owner = obj;
+    return (PyObject*)obj;
+}
+
+static PyObject* build_element(RobustPath* path) {
+    RobustPathObject* obj = PyObject_New(RobustPathObject, &robustpath_object_type);
+    obj = (RobustPathObject*)PyObject_Init((PyObject*)obj, &robustpath_object_type);
+    obj->robustpath = path;
+    path->owner = obj;
+    return (PyObject*)obj;
+}
+
+static PyObject* build_element(Label* label) {
+    LabelObject* obj = PyObject_New(LabelObject, &label_object_type);
+    obj = (LabelObject*)PyObject_Init((PyObject*)obj, &label_object_type);
+    obj->label = label;
+    label->owner = obj;
+    return (PyObject*)obj;
+}
+
+// Append Python objects for the elements in array to list.  The ownership of
+// all elements is transferred (they are freed if list is NULL or on error) and
+// array is cleared.
+template <class T>
+static int append_elements(PyObject* list, Array<T*>& array) {
+    int result = list ? 0 : -1;
+    for (uint64_t i = 0; i < array.count; i++) {
+        PyObject* obj = build_element(array[i]);
+        if (result == 0 && PyList_Append(list, obj) < 0) result = -1;
+        Py_DECREF(obj);
+    }
+    array.clear();
+    return result;
+}
+
+// Dictionary with a (layer, type) key for each tag and, as value, the list of
+// elements from the corresponding array in arrays (and extra_arrays, if not
+// NULL).  All arrays are cleared, with ownership of their elements
+// transferred to the returned objects (or freed on error).
+template <class T, class U>
+static PyObject* build_tagged_elements(const Array<Tag>& tags, Array<T*>* arrays,
+                                       Array<U*>* extra_arrays) {
+    PyObject* result = PyDict_New();
+    if (!result) PyErr_SetString(PyExc_RuntimeError, "Unable to create return dictionary.");
+    for (uint64_t i = 0; i < tags.count; i++) {
+        PyObject* list = result ? PyList_New(0) : NULL;
+        int error = append_elements(list, arrays[i]);
+        if (extra_arrays && append_elements(list, extra_arrays[i]) < 0) error = -1;
+        if (error == 0) {
+            PyObject* key = Py_BuildValue("(II)", get_layer(tags[i]), get_type(tags[i]));
+            if (!key || PyDict_SetItem(result, key, list) < 0) error = -1;
+            Py_XDECREF(key);
+        }
+        Py_XDECREF(list);
+        if (error < 0 && result) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to create return dictionary.");
+            Py_DECREF(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
 static PyObject* build_tag_set(const Set<Tag>& tags) {
     PyObject* result = PySet_New(NULL);
     if (!result) {
@@ -633,3 +804,38 @@ static PyObject* build_tag_set(const Set<Tag>& tags) {
     }
     return result;
 }
+
+// List with a set of problem names for each check
+static PyObject* build_polygon_checks(const Array<PolygonCheck>& checks) {
+    PyObject* result = PyList_New(checks.count);
+    if (!result) {
+        PyErr_SetString(PyExc_RuntimeError, "Unable to create return list.");
+        return NULL;
+    }
+    for (uint64_t i = 0; i < checks.count; i++) {
+        const PolygonCheck* check = checks.items + i;
+        const char* names[] = {"duplicate_point", "spike", "degenerate", "self_intersecting",
+                               "clockwise"};
+        const bool flags[] = {check->duplicate_point, check->spike, check->degenerate,
+                              check->self_intersecting, check->clockwise};
+        PyObject* problems = PySet_New(NULL);
+        if (!problems) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to create set object.");
+            Py_DECREF(result);
+            return NULL;
+        }
+        PyList_SET_ITEM(result, i, problems);
+        for (uint64_t j = 0; j < COUNT(flags); j++) {
+            if (!flags[j]) continue;
+            PyObject* name = PyUnicode_FromString(names[j]);
+            if (!name || PySet_Add(problems, name) < 0) {
+                PyErr_SetString(PyExc_RuntimeError, "Unable to add item to set.");
+                Py_XDECREF(name);
+                Py_DECREF(result);
+                return NULL;
+            }
+            Py_DECREF(name);
+        }
+    }
+    return result;
+}
@@ -490,6 +490,7 @@ static PyObject* polygon_object_get_layer(PolygonObject* self, void*) {
 
 static int polygon_object_set_layer(PolygonObject* self, PyObject* arg, void*) {
     set_layer(self->polygon->tag, (uint32_t)PyLong_AsUnsignedLongLong(arg));
+    tag_change_count++;
     if (PyErr_Occurred()) {
         PyErr_SetString(PyExc_TypeError, "Unable to convert layer to int.");
         return -1;
@@ -503,6 +504,7 @@ static PyObject* polygon_object_get_datatype(PolygonObject* self, void*) {
 
 static int polygon_object_set_datatype(PolygonObject* self, PyObject* arg, void*) {
     set_type(self->polygon->tag, (uint32_t)PyLong_AsUnsignedLongLong(arg));
+    tag_change_count++;
     if (PyErr_Occurred()) {
         PyErr_SetString(PyExc_TypeError, "Unable to convert datatype to int.");
         return -1;
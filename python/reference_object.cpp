@@ -156,11 +156,12 @@ static PyObject* reference_object_get_polygons(ReferenceObject* self, PyObject*
     PyObject* py_depth = Py_None;
     PyObject* py_layer = Py_None;
     PyObject* py_datatype = Py_None;
+    PyObject* py_tags = Py_None;
     const char* keywords[] = {
-        "apply_repetitions", "include_paths", "depth", "layer", "datatype", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ppOOO:get_polygons", (char**)keywords,
+        "apply_repetitions", "include_paths", "depth", "layer", "datatype", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|ppOOOO:get_polygons", (char**)keywords,
                                      &apply_repetitions, &include_paths, &py_depth, &py_layer,
-                                     &py_datatype))
+                                     &py_datatype, &py_tags))
         return NULL;
 
     int64_t depth = -1;
@@ -172,6 +173,27 @@ static PyObject* reference_object_get_polygons(ReferenceObject* self, PyObject*
         }
     }
 
+    if (py_tags != Py_None) {
+        if (py_layer != Py_None || py_datatype != Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument tags cannot be used with layer or datatype.");
+            return NULL;
+        }
+        Array<Tag> tags = {};
+        if (parse_tag_array(py_tags, tags, "tags") < 0) {
+            tags.clear();
+            return NULL;
+        }
+        Array<Polygon*>* arrays =
+            (Array<Polygon*>*)allocate_clear(tags.count * sizeof(Array<Polygon*>));
+        self->reference->get_polygons(apply_repetitions > 0, include_paths > 0, depth, tags,
+                                      arrays);
+        PyObject* result = build_tagged_elements(tags, arrays, (Array<Polygon*>*)NULL);
+        free_allocation(arrays);
+        tags.clear();
+        return result;
+    }
+
     if ((py_layer == Py_None) != (py_datatype == Py_None)) {
         PyErr_SetString(PyExc_ValueError,
                         "Filtering is only enabled if both layer and datatype are set.");
@@ -227,9 +249,11 @@ static PyObject* reference_object_get_paths(ReferenceObject* self, PyObject* arg
     PyObject* py_depth = Py_None;
     PyObject* py_layer = Py_None;
     PyObject* py_datatype = Py_None;
-    const char* keywords[] = {"apply_repetitions", "depth", "layer", "datatype", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOO:get_polygons", (char**)keywords,
-                                     &apply_repetitions, &py_depth, &py_layer, &py_datatype))
+    PyObject* py_tags = Py_None;
+    const char* keywords[] = {"apply_repetitions", "depth", "layer", "datatype", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOOO:get_paths", (char**)keywords,
+                                     &apply_repetitions, &py_depth, &py_layer, &py_datatype,
+                                     &py_tags))
         return NULL;
 
     int64_t depth = -1;
@@ -241,6 +265,30 @@ static PyObject* reference_object_get_paths(ReferenceObject* self, PyObject* arg
         }
     }
 
+    if (py_tags != Py_None) {
+        if (py_layer != Py_None || py_datatype != Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument tags cannot be used with layer or datatype.");
+            return NULL;
+        }
+        Array<Tag> tags = {};
+        if (parse_tag_array(py_tags, tags, "tags") < 0) {
+            tags.clear();
+            return NULL;
+        }
+        Array<FlexPath*>* fp_arrays =
+            (Array<FlexPath*>*)allocate_clear(tags.count * sizeof(Array<FlexPath*>));
+        Array<RobustPath*>* rp_arrays =
+            (Array<RobustPath*>*)allocate_clear(tags.count * sizeof(Array<RobustPath*>));
+        self->reference->get_flexpaths(apply_repetitions > 0, depth, tags, fp_arrays);
+        self->reference->get_robustpaths(apply_repetitions > 0, depth, tags, rp_arrays);
+        PyObject* result = build_tagged_elements(tags, fp_arrays, rp_arrays);
+        free_allocation(fp_arrays);
+        free_allocation(rp_arrays);
+        tags.clear();
+        return result;
+    }
+
     uint32_t layer = 0;
     uint32_t datatype = 0;
     bool filter = (py_layer != Py_None) && (py_datatype != Py_None);
@@ -309,9 +357,11 @@ static PyObject* reference_object_get_labels(ReferenceObject* self, PyObject* ar
     PyObject* py_depth = Py_None;
     PyObject* py_layer = Py_None;
     PyObject* py_texttype = Py_None;
-    const char* keywords[] = {"apply_repetitions", "depth", "layer", "texttype", NULL};
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOO:get_polygons", (char**)keywords,
-                                     &apply_repetitions, &py_depth, &py_layer, &py_texttype))
+    PyObject* py_tags = Py_None;
+    const char* keywords[] = {"apply_repetitions", "depth", "layer", "texttype", "tags", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|pOOOO:get_labels", (char**)keywords,
+                                     &apply_repetitions, &py_depth, &py_layer, &py_texttype,
+                                     &py_tags))
         return NULL;
 
     int64_t depth = -1;
@@ -323,6 +373,25 @@ static PyObject* reference_object_get_labels(ReferenceObject* self, PyObject* ar
         }
     }
 
+    if (py_tags != Py_None) {
+        if (py_layer != Py_None || py_texttype != Py_None) {
+            PyErr_SetString(PyExc_ValueError,
+                            "Argument tags cannot be used with layer or texttype.");
+            return NULL;
+        }
+        Array<Tag> tags = {};
+        if (parse_tag_array(py_tags, tags, "tags") < 0) {
+            tags.clear();
+            return NULL;
+        }
+        Array<Label*>* arrays = (Array<Label*>*)allocate_clear(tags.count * sizeof(Array<Label*>));
+        self->reference->get_labels(apply_repetitions > 0, depth, tags, arrays);
+        PyObject* result = build_tagged_elements(tags, arrays, (Array<Label*>*)NULL);
+        free_allocation(arrays);
+        tags.clear();
+        return result;
+    }
+
     uint32_t layer = 0;
     uint32_t texttype = 0;
     bool filter = (py_layer != Py_None) && (py_texttype != Py_None);
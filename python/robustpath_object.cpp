@@ -628,6 +628,7 @@ static PyObject* robustpath_object_set_layers(RobustPathObject* self, PyObject*
             return NULL;
         }
     }
+    tag_change_count++;
     Py_INCREF(self);
     return (PyObject*)self;
 }
@@ -657,6 +658,7 @@ static PyObject* robustpath_object_set_datatypes(RobustPathObject* self, PyObjec
             return NULL;
         }
     }
+    tag_change_count++;
     Py_INCREF(self);
     return (PyObject*)self;
 }
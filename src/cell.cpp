@@ -10,10 +10,12 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 #include <float.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <zlib.h>
 
 #include <gdstk/allocator.hpp>
 #include <gdstk/cell.hpp>
@@ -24,6 +26,15 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 namespace gdstk {
 
+uint64_t tag_change_count = 0;
+
+void clear_geometry_cache(Map<GeometryInfo>& cache) {
+    for (MapItem<GeometryInfo>* item = cache.next(NULL); item; item = cache.next(item)) {
+        item->value.clear();
+    }
+    cache.clear();
+}
+
 void Cell::print(bool all) const {
     printf("Cell <%p> %s, %" PRIu64 " polygons, %" PRIu64 " flexpaths, %" PRIu64
            " robustpaths, %" PRIu64 " references, %" PRIu64 " labels, owner <%p>\n",
@@ -64,9 +75,84 @@ void Cell::print(bool all) const {
     properties_print(properties);
 }
 
+// Test whether element is in the sorted array owned
+static bool owned_by(const Array<const void*>& owned, const void* element) {
+    uint64_t lo = 0;
+    uint64_t hi = owned.count;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (owned[mid] < element) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < owned.count && owned[lo] == element;
+}
+
+bool CellStorage::owns(const void* element) const {
+    for (const CellStorage* s = this; s; s = s->parent) {
+        if (owned_by(s->owned, element)) return true;
+    }
+    return false;
+}
+
+template <class T>
+static void free_elements(Array<T*>& array, const CellStorage* storage) {
+    T** element = array.items;
+    for (uint64_t i = array.count; i > 0; i--, element++) {
+        if (storage && storage->owns(*element)) continue;
+        (*element)->clear();
+        free_allocation(*element);
+    }
+}
+
+template <class T>
+static void free_owned_elements(Array<T*>& array, const Array<const void*>& owned) {
+    T** element = array.items;
+    for (uint64_t i = array.count; i > 0; i--, element++) {
+        if (!owned_by(owned, *element)) continue;
+        (*element)->clear();
+        free_allocation(*element);
+    }
+    array.clear();
+}
+
+// Drop a reference to storage, freeing it (and its elements) if unused.
+static void storage_release(CellStorage* storage) {
+    while (storage && --storage->reference_count == 0) {
+        free_owned_elements(storage->polygon_array, storage->owned);
+        free_owned_elements(storage->reference_array, storage->owned);
+        free_owned_elements(storage->flexpath_array, storage->owned);
+        free_owned_elements(storage->robustpath_array, storage->owned);
+        free_owned_elements(storage->label_array, storage->owned);
+        storage->polygon_array.clear();
+        storage->reference_array.clear();
+        storage->flexpath_array.clear();
+        storage->robustpath_array.clear();
+        storage->label_array.clear();
+        storage->owned.clear();
+        CellStorage* parent = storage->parent;
+        free_allocation(storage);
+        storage = parent;
+    }
+}
+
 void Cell::clear() {
+    set_tag_buckets(false);
     if (name) free_allocation(name);
     name = NULL;
+    if (storage) {
+        // Arrays still in use by the storage are not freed here
+        if (polygon_array.items == storage->polygon_array.items) polygon_array.items = NULL;
+        if (reference_array.items == storage->reference_array.items) reference_array.items = NULL;
+        if (flexpath_array.items == storage->flexpath_array.items) flexpath_array.items = NULL;
+        if (robustpath_array.items == storage->robustpath_array.items)
+            robustpath_array.items = NULL;
+        if (label_array.items == storage->label_array.items) label_array.items = NULL;
+        storage_release(storage);
+        storage = NULL;
+    }
     polygon_array.clear();
     reference_array.clear();
     flexpath_array.clear();
@@ -80,10 +166,7 @@ void Cell::bounding_box(Vec2& min, Vec2& max) const {
     GeometryInfo info = bounding_box(cache);
     min = info.bounding_box_min;
     max = info.bounding_box_max;
-    for (MapItem<GeometryInfo>* item = cache.next(NULL); item; item = cache.next(item)) {
-        item->value.clear();
-    }
-    cache.clear();
+    clear_geometry_cache(cache);
 }
 
 GeometryInfo Cell::bounding_box(Map<GeometryInfo>& cache) const {
@@ -178,15 +261,13 @@ void Cell::convex_hull(Array<Vec2>& result) const {
     Map<GeometryInfo> cache = {};
     GeometryInfo info = convex_hull(cache);
     result.extend(info.convex_hull);
-    for (MapItem<GeometryInfo>* item = cache.next(NULL); item; item = cache.next(item)) {
-        item->value.clear();
-    }
-    cache.clear();
+    clear_geometry_cache(cache);
 }
 
 GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
     Array<Vec2> points = {};
-    Array<Vec2> offsets = {};
+    RepetitionIterator iterator = {};
+    Vec2 off;
 
     Reference** reference = reference_array.items;
     for (uint64_t i = 0; i < reference_array.count; i++, reference++) {
@@ -198,18 +279,16 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
         if (polygon->repetition.type == RepetitionType::None) {
             points.extend(polygon->point_array);
         } else {
-            polygon->repetition.get_offsets(offsets);
-            points.ensure_slots(polygon->point_array.count * offsets.count);
+            iterator.init(polygon->repetition);
+            points.ensure_slots(polygon->point_array.count * iterator.count);
             Vec2* dst = points.items + points.count;
-            for (uint64_t k = 0; k < offsets.count; k++) {
-                const Vec2 off = offsets[k];
+            while (iterator.next(off)) {
                 Vec2* src = polygon->point_array.items;
                 for (uint64_t h = 0; h < polygon->point_array.count; h++) {
                     *dst++ = *src++ + off;
                 }
             }
-            points.count += polygon->point_array.count * offsets.count;
-            offsets.count = 0;
+            points.count += polygon->point_array.count * iterator.count;
         }
     }
 
@@ -218,15 +297,13 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
         if (label->repetition.type == RepetitionType::None) {
             points.append(label->origin);
         } else {
-            label->repetition.get_offsets(offsets);
-            points.ensure_slots(offsets.count);
+            iterator.init(label->repetition);
+            points.ensure_slots(iterator.count);
             Vec2* dst = points.items + points.count;
-            Vec2* off = offsets.items;
-            for (uint64_t k = 0; k < offsets.count; k++) {
-                *dst++ = label->origin + *off++;
+            while (iterator.next(off)) {
+                *dst++ = label->origin + off;
             }
-            points.count += offsets.count;
-            offsets.count = 0;
+            points.count += iterator.count;
         }
     }
 
@@ -240,18 +317,16 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
             if (polygon->repetition.type == RepetitionType::None) {
                 points.extend(polygon->point_array);
             } else {
-                polygon->repetition.get_offsets(offsets);
-                points.ensure_slots(polygon->point_array.count * offsets.count);
+                iterator.init(polygon->repetition);
+                points.ensure_slots(polygon->point_array.count * iterator.count);
                 Vec2* dst = points.items + points.count;
-                for (uint64_t k = 0; k < offsets.count; k++) {
-                    const Vec2 off = offsets[k];
+                while (iterator.next(off)) {
                     Vec2* src = polygon->point_array.items;
                     for (uint64_t h = 0; h < polygon->point_array.count; h++) {
                         *dst++ = *src++ + off;
                     }
                 }
-                points.count += polygon->point_array.count * offsets.count;
-                offsets.count = 0;
+                points.count += polygon->point_array.count * iterator.count;
             }
             polygon->clear();
             free_allocation(polygon);
@@ -268,18 +343,16 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
             if (polygon->repetition.type == RepetitionType::None) {
                 points.extend(polygon->point_array);
             } else {
-                polygon->repetition.get_offsets(offsets);
-                points.ensure_slots(polygon->point_array.count * offsets.count);
+                iterator.init(polygon->repetition);
+                points.ensure_slots(polygon->point_array.count * iterator.count);
                 Vec2* dst = points.items + points.count;
-                for (uint64_t k = 0; k < offsets.count; k++) {
-                    const Vec2 off = offsets[k];
+                while (iterator.next(off)) {
                     Vec2* src = polygon->point_array.items;
                     for (uint64_t h = 0; h < polygon->point_array.count; h++) {
                         *dst++ = *src++ + off;
                     }
                 }
-                points.count += polygon->point_array.count * offsets.count;
-                offsets.count = 0;
+                points.count += polygon->point_array.count * iterator.count;
             }
             polygon->clear();
             free_allocation(polygon);
@@ -287,7 +360,6 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
         array.count = 0;
     }
     array.clear();
-    offsets.clear();
 
     GeometryInfo info = cache.get(name);
     info.convex_hull_valid = true;
@@ -297,62 +369,127 @@ GeometryInfo Cell::convex_hull(Map<GeometryInfo>& cache) const {
     return info;
 }
 
+// Content hash of cell.  If geometry_cache is not NULL, coordinates are taken
+// relative to the lower left corner of the cell bounding box.
+static uint64_t cell_content_hash(const Cell& cell, double scaling, Map<uint64_t>& cache,
+                                  Map<GeometryInfo>* geometry_cache) {
+    uint64_t result = cache.get(cell.name);
+    if (result != 0) return result;
+
+    Vec2 offset = {0, 0};
+    if (geometry_cache) {
+        GeometryInfo info = cell.bounding_box(*geometry_cache);
+        if (info.bounding_box_min.x <= info.bounding_box_max.x) offset = info.bounding_box_min;
+    }
+
+    // Element hashes are added, so that the order of the elements is irrelevant
+    uint64_t shapes = 0;
+    Polygon** polygon = cell.polygon_array.items;
+    for (uint64_t i = cell.polygon_array.count; i > 0; i--, polygon++) {
+        shapes += (*polygon)->content_hash(scaling, offset);
+    }
+
+    Array<Polygon*> path_polygons = {};
+    FlexPath** flexpath = cell.flexpath_array.items;
+    for (uint64_t i = cell.flexpath_array.count; i > 0; i--, flexpath++) {
+        (*flexpath)->to_polygons(false, 0, path_polygons);
+    }
+    RobustPath** robustpath = cell.robustpath_array.items;
+    for (uint64_t i = cell.robustpath_array.count; i > 0; i--, robustpath++) {
+        (*robustpath)->to_polygons(false, 0, path_polygons);
+    }
+    polygon = path_polygons.items;
+    for (uint64_t i = path_polygons.count; i > 0; i--, polygon++) {
+        shapes += (*polygon)->content_hash(scaling, offset);
+        (*polygon)->clear();
+        free_allocation(*polygon);
+    }
+    path_polygons.clear();
+
+    uint64_t references = 0;
+    Reference** reference = cell.reference_array.items;
+    for (uint64_t i = cell.reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (!geometry_cache) {
+            references += ref->content_hash(scaling, cache);
+        } else if (ref->type == ReferenceType::Cell) {
+            // The referenced cell is placed at its own lower left corner
+            Vec2 ref_offset = offset;
+            GeometryInfo info = ref->cell->bounding_box(*geometry_cache);
+            if (info.bounding_box_min.x <= info.bounding_box_max.x) {
+                Vec2 v = info.bounding_box_min * ref->magnification;
+                if (ref->x_reflection) v.y = -v.y;
+                double ca = cos(ref->rotation);
+                double sa = sin(ref->rotation);
+                ref_offset -= Vec2{v.x * ca - v.y * sa, v.x * sa + v.y * ca};
+            }
+            uint64_t h = ref->placement_hash(scaling, ref_offset);
+            references += hash_combine(
+                h, cell_content_hash(*ref->cell, scaling, cache, geometry_cache));
+        } else {
+            Reference copy = *ref;
+            copy.origin -= offset;
+            references += copy.content_hash(scaling, cache);
+        }
+    }
+
+    uint64_t labels = 0;
+    Label** label = cell.label_array.items;
+    for (uint64_t i = cell.label_array.count; i > 0; i--, label++) {
+        labels += (*label)->content_hash(scaling, offset);
+    }
+
+    result = hash_combine(hash_combine(0, shapes), references);
+    result = hash_combine(hash_combine(result, labels), properties_hash(cell.properties));
+    // Zero is reserved for missing cache entries
+    if (result == 0) result = 1;
+    cache.set(cell.name, result);
+    return result;
+}
+
+uint64_t Cell::content_hash(double scaling, Map<uint64_t>& cache) const {
+    return cell_content_hash(*this, scaling, cache, NULL);
+}
+
+uint64_t Cell::content_hash(double scaling, Map<uint64_t>& cache,
+                            Map<GeometryInfo>& geometry_cache) const {
+    return cell_content_hash(*this, scaling, cache, &geometry_cache);
+}
+
+// Element arrays with at least this many items are deep copied in parallel
+#define GDSTK_PARALLEL_COPY_MIN 1024
+
+template <class T>
+static void deep_copy_element(const T* src, T*& dst) {
+    dst = (T*)allocate_clear(sizeof(T));
+    dst->copy_from(*src);
+}
+
+template <class T>
+static void deep_copy_elements(const Array<T*>& src, Array<T*>& dst) {
+    dst.capacity = src.capacity;
+    dst.count = src.count;
+    dst.items = (T**)allocate(sizeof(T*) * dst.capacity);
+    if (src.count < GDSTK_PARALLEL_COPY_MIN) {
+        for (uint64_t i = 0; i < src.count; i++) deep_copy_element(src.items[i], dst.items[i]);
+    } else {
+        GDSTK_PARALLEL_FOR
+        for (int64_t i = 0; i < (int64_t)src.count; i++) {
+            deep_copy_element(src.items[i], dst.items[i]);
+        }
+    }
+}
+
 void Cell::copy_from(const Cell& cell, const char* new_name, bool deep_copy) {
     name = copy_string(new_name ? new_name : cell.name, NULL);
     properties = properties_copy(cell.properties);
 
     if (deep_copy) {
-        polygon_array.capacity = cell.polygon_array.capacity;
-        polygon_array.count = cell.polygon_array.count;
-        polygon_array.items = (Polygon**)allocate(sizeof(Polygon*) * polygon_array.capacity);
-        Polygon** psrc = cell.polygon_array.items;
-        Polygon** pdst = polygon_array.items;
-        for (uint64_t i = 0; i < cell.polygon_array.count; i++, psrc++, pdst++) {
-            *pdst = (Polygon*)allocate_clear(sizeof(Polygon));
-            (*pdst)->copy_from(**psrc);
-        }
-
-        reference_array.capacity = cell.reference_array.capacity;
-        reference_array.count = cell.reference_array.count;
-        reference_array.items =
-            (Reference**)allocate(sizeof(Reference*) * reference_array.capacity);
-        Reference** rsrc = cell.reference_array.items;
-        Reference** rdst = reference_array.items;
-        for (uint64_t i = 0; i < cell.reference_array.count; i++, rsrc++, rdst++) {
-            *rdst = (Reference*)allocate_clear(sizeof(Reference));
-            (*rdst)->copy_from(**rsrc);
-        }
-
-        flexpath_array.capacity = cell.flexpath_array.capacity;
-        flexpath_array.count = cell.flexpath_array.count;
-        flexpath_array.items = (FlexPath**)allocate(sizeof(FlexPath*) * flexpath_array.capacity);
-        FlexPath** fpsrc = cell.flexpath_array.items;
-        FlexPath** fpdst = flexpath_array.items;
-        for (uint64_t i = 0; i < cell.flexpath_array.count; i++, fpsrc++, fpdst++) {
-            *fpdst = (FlexPath*)allocate_clear(sizeof(FlexPath));
-            (*fpdst)->copy_from(**fpsrc);
-        }
-
-        robustpath_array.capacity = cell.robustpath_array.capacity;
-        robustpath_array.count = cell.robustpath_array.count;
-        robustpath_array.items =
-            (RobustPath**)allocate(sizeof(RobustPath*) * robustpath_array.capacity);
-        RobustPath** rpsrc = cell.robustpath_array.items;
-        RobustPath** rpdst = robustpath_array.items;
-        for (uint64_t i = 0; i < cell.robustpath_array.count; i++, rpsrc++, rpdst++) {
-            *rpdst = (RobustPath*)allocate_clear(sizeof(RobustPath));
-            (*rpdst)->copy_from(**rpsrc);
-        }
-
-        label_array.capacity = cell.label_array.capacity;
-        label_array.count = cell.label_array.count;
-        label_array.items = (Label**)allocate(sizeof(Label*) * label_array.capacity);
-        Label** lsrc = cell.label_array.items;
-        Label** ldst = label_array.items;
-        for (uint64_t i = 0; i < cell.label_array.count; i++, lsrc++, ldst++) {
-            *ldst = (Label*)allocate_clear(sizeof(Label));
-            (*ldst)->copy_from(**lsrc);
-        }
+        deep_copy_elements(cell.polygon_array, polygon_array);
+        deep_copy_elements(cell.reference_array, reference_array);
+        deep_copy_elements(cell.flexpath_array, flexpath_array);
+        deep_copy_elements(cell.robustpath_array, robustpath_array);
+        deep_copy_elements(cell.label_array, label_array);
     } else {
         polygon_array.copy_from(cell.polygon_array);
         reference_array.copy_from(cell.reference_array);
@@ -362,12 +499,464 @@ void Cell::copy_from(const Cell& cell, const char* new_name, bool deep_copy) {
     }
 }
 
+void Cell::free_all() {
+    free_elements(polygon_array, storage);
+    free_elements(reference_array, storage);
+    free_elements(flexpath_array, storage);
+    free_elements(robustpath_array, storage);
+    free_elements(label_array, storage);
+    clear();
+}
+
+// Copy array into the storage array shared.  Elements not owned by the parent
+// storage are private to the source cell, so the storage gets (and owns) copies
+// of them: the source cell can keep modifying its elements in place.
+template <class T>
+static void storage_share(const Array<T*>& array, Array<T*>& shared, const CellStorage* parent,
+                          Array<const void*>& owned) {
+    shared.copy_from(array);
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)array.count; i++) {
+        if (!parent || !parent->owns(array[i])) deep_copy_element(array[i], shared[i]);
+    }
+    for (uint64_t i = 0; i < array.count; i++) {
+        if (shared[i] != array[i]) owned.append(shared[i]);
+    }
+}
+
+// Test whether array holds the same elements as the storage array shared.
+template <class T>
+static bool storage_current(const Array<T*>& array, const Array<T*>& shared) {
+    if (array.count != shared.count) return false;
+    return array.items == shared.items || array.count == 0 ||
+           memcmp(array.items, shared.items, array.count * sizeof(T*)) == 0;
+}
+
+void Cell::clone_from(const Cell& cell, const char* new_name) {
+    CellStorage* shared = cell.storage;
+    if (!shared || !storage_current(cell.polygon_array, shared->polygon_array) ||
+        !storage_current(cell.reference_array, shared->reference_array) ||
+        !storage_current(cell.flexpath_array, shared->flexpath_array) ||
+        !storage_current(cell.robustpath_array, shared->robustpath_array) ||
+        !storage_current(cell.label_array, shared->label_array)) {
+        // The contents of cell are copied into a new storage, which holds a
+        // reference to the storage of cell (if any).  Cell itself is not
+        // changed: its private elements are copied, not shared.
+        CellStorage* parent = cell.storage;
+        shared = (CellStorage*)allocate_clear(sizeof(CellStorage));
+        shared->parent = parent;
+        if (parent) parent->reference_count++;
+        storage_share(cell.polygon_array, shared->polygon_array, parent, shared->owned);
+        storage_share(cell.reference_array, shared->reference_array, parent, shared->owned);
+        storage_share(cell.flexpath_array, shared->flexpath_array, parent, shared->owned);
+        storage_share(cell.robustpath_array, shared->robustpath_array, parent, shared->owned);
+        storage_share(cell.label_array, shared->label_array, parent, shared->owned);
+        sort(shared->owned);
+    }
+
+    name = copy_string(new_name ? new_name : cell.name, NULL);
+    properties = properties_copy(cell.properties);
+    storage = shared;
+    storage->reference_count++;
+    polygon_array = storage->polygon_array;
+    reference_array = storage->reference_array;
+    flexpath_array = storage->flexpath_array;
+    robustpath_array = storage->robustpath_array;
+    label_array = storage->label_array;
+}
+
+template <class T>
+static Array<T*>& writable_array(Array<T*>& array, const Array<T*>* shared) {
+    if (shared && array.items && array.items == shared->items) {
+        Array<T*> copy = {};
+        copy.copy_from(array);
+        array = copy;
+    }
+    return array;
+}
+
+template <class T>
+static T* writable_element(Array<T*>& array, uint64_t index, const CellStorage* storage) {
+    T*& element = array[index];
+    if (storage && storage->owns(element)) deep_copy_element(element, element);
+    return element;
+}
+
+Array<Polygon*>& Cell::writable_polygon_array() {
+    return writable_array(polygon_array, storage ? &storage->polygon_array : NULL);
+}
+
+Array<Reference*>& Cell::writable_reference_array() {
+    return writable_array(reference_array, storage ? &storage->reference_array : NULL);
+}
+
+Array<FlexPath*>& Cell::writable_flexpath_array() {
+    return writable_array(flexpath_array, storage ? &storage->flexpath_array : NULL);
+}
+
+Array<RobustPath*>& Cell::writable_robustpath_array() {
+    return writable_array(robustpath_array, storage ? &storage->robustpath_array : NULL);
+}
+
+Array<Label*>& Cell::writable_label_array() {
+    return writable_array(label_array, storage ? &storage->label_array : NULL);
+}
+
+Polygon* Cell::writable_polygon(uint64_t index) {
+    return writable_element(writable_polygon_array(), index, storage);
+}
+
+Reference* Cell::writable_reference(uint64_t index) {
+    return writable_element(writable_reference_array(), index, storage);
+}
+
+FlexPath* Cell::writable_flexpath(uint64_t index) {
+    return writable_element(writable_flexpath_array(), index, storage);
+}
+
+RobustPath* Cell::writable_robustpath(uint64_t index) {
+    return writable_element(writable_robustpath_array(), index, storage);
+}
+
+Label* Cell::writable_label(uint64_t index) {
+    return writable_element(writable_label_array(), index, storage);
+}
+
+template <class T>
+static void unshare_elements(Array<T*>& array, const CellStorage* storage) {
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)array.count; i++) {
+        if (storage->owns(array[i])) deep_copy_element(array[i], array[i]);
+    }
+}
+
+void Cell::unshare() {
+    if (!storage) return;
+    unshare_elements(writable_polygon_array(), storage);
+    unshare_elements(writable_reference_array(), storage);
+    unshare_elements(writable_flexpath_array(), storage);
+    unshare_elements(writable_robustpath_array(), storage);
+    unshare_elements(writable_label_array(), storage);
+    storage_release(storage);
+    storage = NULL;
+}
+
+// Tag used to bucket each element.  Paths with elements in distinct tags (or
+// without elements) cannot be bucketed.
+static bool bucket_tag(const Polygon* polygon, Tag& tag) {
+    tag = polygon->tag;
+    return true;
+}
+
+static bool bucket_tag(const Label* label, Tag& tag) {
+    tag = label->tag;
+    return true;
+}
+
+template <class T>
+static bool path_bucket_tag(const T* path, Tag& tag) {
+    if (path->num_elements == 0) return false;
+    tag = path->elements[0].tag;
+    for (uint64_t i = 1; i < path->num_elements; i++) {
+        if (path->elements[i].tag != tag) return false;
+    }
+    return true;
+}
+
+static bool bucket_tag(const FlexPath* path, Tag& tag) { return path_bucket_tag(path, tag); }
+
+static bool bucket_tag(const RobustPath* path, Tag& tag) { return path_bucket_tag(path, tag); }
+
+static void set_bucket_tag(Polygon* polygon, Tag tag) { polygon->tag = tag; }
+
+static void set_bucket_tag(Label* label, Tag tag) { label->tag = tag; }
+
+static void set_bucket_tag(FlexPath* path, Tag tag) {
+    for (uint64_t i = 0; i < path->num_elements; i++) path->elements[i].tag = tag;
+}
+
+static void set_bucket_tag(RobustPath* path, Tag tag) {
+    for (uint64_t i = 0; i < path->num_elements; i++) path->elements[i].tag = tag;
+}
+
+// Position of the range for tag in ranges, or where it should be inserted.
+static uint64_t range_position(const Array<TagRange>& ranges, Tag tag) {
+    uint64_t lo = 0;
+    uint64_t hi = ranges.count;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (ranges[mid].tag < tag) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Set [first, last) to the range of elements with tag (empty if there are
+// none).
+static void bucket_range(const Array<TagRange>& ranges, Tag tag, uint64_t& first,
+                         uint64_t& last) {
+    uint64_t position = range_position(ranges, tag);
+    if (position < ranges.count && ranges[position].tag == tag) {
+        first = ranges[position].offset;
+        last = first + ranges[position].count;
+    } else {
+        first = last = 0;
+    }
+}
+
+// Reorder array by bucket tag (stable), rebuilding its ranges.  Elements that
+// cannot be bucketed are moved to the end, starting at mixed.
+template <class T>
+static void bucket_elements(Array<T*>& array, Array<TagRange>& ranges, uint64_t& mixed) {
+    ranges.count = 0;
+    T** item = array.items;
+    for (uint64_t i = array.count; i > 0; i--, item++) {
+        Tag tag;
+        if (!bucket_tag(*item, tag)) continue;
+        uint64_t position = range_position(ranges, tag);
+        if (position == ranges.count || ranges[position].tag != tag) {
+            ranges.insert(position, TagRange{tag, 0, 0});
+        }
+        ranges[position].count++;
+    }
+
+    mixed = 0;
+    TagRange* range = ranges.items;
+    for (uint64_t i = ranges.count; i > 0; i--, range++) {
+        range->offset = mixed;
+        mixed += range->count;
+        range->count = 0;
+    }
+    if (array.count == 0) return;
+
+    T** items = (T**)allocate(array.capacity * sizeof(T*));
+    uint64_t mixed_position = mixed;
+    item = array.items;
+    for (uint64_t i = array.count; i > 0; i--, item++) {
+        Tag tag;
+        if (bucket_tag(*item, tag)) {
+            range = ranges.items + range_position(ranges, tag);
+            items[range->offset + range->count++] = *item;
+        } else {
+            items[mixed_position++] = *item;
+        }
+    }
+    free_allocation(array.items);
+    array.items = items;
+}
+
+// Remap the tags of all elements in the ranges, returning true if any tag
+// changed.
+template <class T>
+static bool remap_bucket_tags(Array<T*>& array, const Array<TagRange>& ranges, const TagMap& map) {
+    bool changed = false;
+    const TagRange* range = ranges.items;
+    for (uint64_t i = ranges.count; i > 0; i--, range++) {
+        Tag tag = map.get(range->tag);
+        if (tag == range->tag) continue;
+        changed = true;
+        T** item = array.items + range->offset;
+        for (uint64_t j = range->count; j > 0; j--, item++) set_bucket_tag(*item, tag);
+    }
+    return changed;
+}
+
+void Cell::set_tag_buckets(bool enable) {
+    if (enable) {
+        if (!tag_buckets) tag_buckets = (TagBuckets*)allocate_clear(sizeof(TagBuckets));
+        update_tag_buckets(true);
+    } else if (tag_buckets) {
+        tag_buckets->clear();
+        free_allocation(tag_buckets);
+        tag_buckets = NULL;
+    }
+}
+
+void Cell::update_tag_buckets(bool force) {
+    if (!tag_buckets || (!force && current_tag_buckets())) return;
+    TagBuckets* buckets = tag_buckets;
+    uint64_t mixed;
+    // Elements are reordered, but not modified
+    writable_polygon_array();
+    writable_flexpath_array();
+    writable_robustpath_array();
+    writable_label_array();
+    bucket_elements(polygon_array, buckets->polygon_ranges, mixed);
+    bucket_elements(flexpath_array, buckets->flexpath_ranges, buckets->flexpath_mixed);
+    bucket_elements(robustpath_array, buckets->robustpath_ranges, buckets->robustpath_mixed);
+    bucket_elements(label_array, buckets->label_ranges, mixed);
+    buckets->modification_count = modification_count;
+    buckets->tag_change_count = tag_change_count;
+    buckets->polygon_items = polygon_array.items;
+    buckets->flexpath_items = flexpath_array.items;
+    buckets->robustpath_items = robustpath_array.items;
+    buckets->label_items = label_array.items;
+    buckets->polygon_count = polygon_array.count;
+    buckets->flexpath_count = flexpath_array.count;
+    buckets->robustpath_count = robustpath_array.count;
+    buckets->label_count = label_array.count;
+}
+
+const TagBuckets* Cell::current_tag_buckets() const {
+    const TagBuckets* buckets = tag_buckets;
+    // Array states are also compared to catch direct modifications that did
+    // not increment modification_count.
+    if (!buckets || buckets->modification_count != modification_count ||
+        buckets->tag_change_count != tag_change_count ||
+        buckets->polygon_items != polygon_array.items ||
+        buckets->polygon_count != polygon_array.count ||
+        buckets->flexpath_items != flexpath_array.items ||
+        buckets->flexpath_count != flexpath_array.count ||
+        buckets->robustpath_items != robustpath_array.items ||
+        buckets->robustpath_count != robustpath_array.count ||
+        buckets->label_items != label_array.items || buckets->label_count != label_array.count)
+        return NULL;
+    return buckets;
+}
+
+// Copy of path with only the elements with the given tag, or NULL if there
+// are none.
+static FlexPath* flexpath_tag_copy(const FlexPath& source, Tag tag) {
+    FlexPath* path = NULL;
+    for (uint64_t j = 0; j < source.num_elements; j++) {
+        const FlexPathElement* esrc = source.elements + j;
+        if (esrc->tag != tag) continue;
+        if (!path) {
+            path = (FlexPath*)allocate_clear(sizeof(FlexPath));
+            path->spine.copy_from(source.spine);
+            path->properties = properties_copy(source.properties);
+            path->repetition.copy_from(source.repetition);
+            path->scale_width = source.scale_width;
+            path->simple_path = source.simple_path;
+            path->raith_data.copy_from(source.raith_data);
+        }
+        path->num_elements++;
+        path->elements = (FlexPathElement*)reallocate(
+            path->elements, path->num_elements * sizeof(FlexPathElement));
+        FlexPathElement* el = path->elements + (path->num_elements - 1);
+        el->half_width_and_offset.copy_from(esrc->half_width_and_offset);
+        el->tag = esrc->tag;
+        el->join_type = esrc->join_type;
+        el->join_function = esrc->join_function;
+        el->join_function_data = esrc->join_function_data;
+        el->end_type = esrc->end_type;
+        el->end_extensions = esrc->end_extensions;
+        el->end_function = esrc->end_function;
+        el->end_function_data = esrc->end_function_data;
+        el->bend_type = esrc->bend_type;
+        el->bend_radius = esrc->bend_radius;
+        el->bend_function = esrc->bend_function;
+        el->bend_function_data = esrc->bend_function_data;
+    }
+    return path;
+}
+
+static RobustPath* robustpath_tag_copy(const RobustPath& source, Tag tag) {
+    RobustPath* path = NULL;
+    for (uint64_t j = 0; j < source.num_elements; j++) {
+        const RobustPathElement* esrc = source.elements + j;
+        if (esrc->tag != tag) continue;
+        if (!path) {
+            path = (RobustPath*)allocate_clear(sizeof(RobustPath));
+            path->properties = properties_copy(source.properties);
+            path->repetition.copy_from(source.repetition);
+            path->end_point = source.end_point;
+            path->subpath_array.copy_from(source.subpath_array);
+            path->tolerance = source.tolerance;
+            path->max_evals = source.max_evals;
+            path->width_scale = source.width_scale;
+            path->offset_scale = source.offset_scale;
+            memcpy(path->trafo, source.trafo, 6 * sizeof(double));
+            path->scale_width = source.scale_width;
+            path->simple_path = source.simple_path;
+        }
+        path->num_elements++;
+        path->elements = (RobustPathElement*)reallocate(
+            path->elements, path->num_elements * sizeof(RobustPathElement));
+        RobustPathElement* el = path->elements + (path->num_elements - 1);
+        el->tag = esrc->tag;
+        el->end_width = esrc->end_width;
+        el->end_offset = esrc->end_offset;
+        el->end_type = esrc->end_type;
+        el->end_extensions = esrc->end_extensions;
+        el->end_function = esrc->end_function;
+        el->end_function_data = esrc->end_function_data;
+        el->width_array.copy_from(esrc->width_array);
+        el->offset_array.copy_from(esrc->offset_array);
+    }
+    return path;
+}
+
+// Tag from a multi-tag query with its position in the query
+struct TagPosition {
+    Tag tag;
+    uint64_t position;
+};
+
+static bool tag_position_order(const TagPosition& p1, const TagPosition& p2) {
+    return p1.tag < p2.tag || (p1.tag == p2.tag && p1.position < p2.position);
+}
+
+// Tags sorted for tag_position
+static void sort_tag_positions(const Array<Tag>& tags, Array<TagPosition>& result) {
+    result.ensure_slots(tags.count);
+    for (uint64_t i = 0; i < tags.count; i++) result.append_unsafe(TagPosition{tags[i], i});
+    sort(result, tag_position_order);
+}
+
+// Position of tag in the query (the first one, if repeated), or sorted.count
+// if not found.
+static uint64_t tag_position(const Array<TagPosition>& sorted, Tag tag) {
+    uint64_t lo = 0;
+    uint64_t hi = sorted.count;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (sorted[mid].tag < tag) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < sorted.count && sorted[lo].tag == tag ? sorted[lo].position : sorted.count;
+}
+
+static bool has_any_tag(const Set<Tag>& set, const Array<Tag>& tags) {
+    const Tag* item = tags.items;
+    for (uint64_t i = 0; i < tags.count; i++, item++) {
+        if (set.has_value(*item)) return true;
+    }
+    return false;
+}
+
+// Whether the tag of element j in a path is also used by a previous element.
+template <class T>
+static bool repeated_element_tag(const T* elements, uint64_t j) {
+    for (uint64_t k = 0; k < j; k++) {
+        if (elements[k].tag == elements[j].tag) return true;
+    }
+    return false;
+}
+
 void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
                         Tag tag, Array<Polygon*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_polygons(apply_repetitions, include_paths, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                        Tag tag, Array<Polygon*>& result, Map<GeometryInfo>& cache) const {
     uint64_t start = result.count;
+    const TagBuckets* buckets = filter ? current_tag_buckets() : NULL;
 
     if (filter) {
-        for (uint64_t i = 0; i < polygon_array.count; i++) {
+        uint64_t first = 0;
+        uint64_t last = polygon_array.count;
+        if (buckets) bucket_range(buckets->polygon_ranges, tag, first, last);
+        for (uint64_t i = first; i < last; i++) {
             Polygon* psrc = polygon_array[i];
             if (psrc->tag != tag) continue;
             Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
@@ -384,16 +973,36 @@ void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t dept
     }
 
     if (include_paths) {
-        FlexPath** flexpath = flexpath_array.items;
-        for (uint64_t i = 0; i < flexpath_array.count; i++, flexpath++) {
+        // With buckets, only the paths with the tag and those in the mixed
+        // range are converted.
+        uint64_t first = 0;
+        uint64_t last = flexpath_array.count;
+        uint64_t mixed = last;
+        if (buckets) {
+            bucket_range(buckets->flexpath_ranges, tag, first, last);
+            mixed = buckets->flexpath_mixed;
+        }
+        for (uint64_t i = first; i < last; i++) {
             // NOTE: return ErrorCode ignored here
-            (*flexpath)->to_polygons(filter, tag, result);
+            flexpath_array[i]->to_polygons(filter, tag, result);
+        }
+        for (uint64_t i = mixed; i < flexpath_array.count; i++) {
+            flexpath_array[i]->to_polygons(filter, tag, result);
         }
 
-        RobustPath** robustpath = robustpath_array.items;
-        for (uint64_t i = 0; i < robustpath_array.count; i++, robustpath++) {
+        first = 0;
+        last = robustpath_array.count;
+        mixed = last;
+        if (buckets) {
+            bucket_range(buckets->robustpath_ranges, tag, first, last);
+            mixed = buckets->robustpath_mixed;
+        }
+        for (uint64_t i = first; i < last; i++) {
             // NOTE: return ErrorCode ignored here
-            (*robustpath)->to_polygons(filter, tag, result);
+            robustpath_array[i]->to_polygons(filter, tag, result);
+        }
+        for (uint64_t i = mixed; i < robustpath_array.count; i++) {
+            robustpath_array[i]->to_polygons(filter, tag, result);
         }
     }
 
@@ -407,50 +1016,147 @@ void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t dept
     if (depth != 0) {
         Reference** ref = reference_array.items;
         for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if (filter && (*ref)->type == ReferenceType::Cell &&
+                !(*ref)->cell->get_tags(cache).shape_tags.has_value(tag))
+                continue;
+            (*ref)->get_polygons(apply_repetitions, include_paths, depth > 0 ? depth - 1 : -1,
+                                 filter, tag, result, cache);
+        }
+    }
+}
+
+void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                        const Array<Tag>& tags, Array<Polygon*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_polygons(apply_repetitions, include_paths, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                        const Array<Tag>& tags, Array<Polygon*>* result,
+                        Map<GeometryInfo>& cache) const {
+    uint64_t* start = (uint64_t*)allocate(tags.count * sizeof(uint64_t));
+    for (uint64_t t = 0; t < tags.count; t++) start[t] = result[t].count;
+    Array<TagPosition> sorted_tags = {};
+    sort_tag_positions(tags, sorted_tags);
+
+    const TagBuckets* buckets = current_tag_buckets();
+    if (buckets) {
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t first, last;
+            bucket_range(buckets->polygon_ranges, tags[t], first, last);
+            result[t].ensure_slots(last - first);
+            for (uint64_t i = first; i < last; i++) {
+                Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
+                poly->copy_from(*polygon_array[i]);
+                result[t].append_unsafe(poly);
+            }
+        }
+    } else {
+        Polygon** polygon = polygon_array.items;
+        for (uint64_t i = 0; i < polygon_array.count; i++, polygon++) {
+            uint64_t t = tag_position(sorted_tags, (*polygon)->tag);
+            if (t == tags.count) continue;
+            Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
+            poly->copy_from(**polygon);
+            result[t].append(poly);
+        }
+    }
+
+    if (include_paths) {
+        // Bucketed paths have a single tag; the others are converted once per
+        // tag used by their elements.
+        uint64_t flexpath_mixed = 0;
+        uint64_t robustpath_mixed = 0;
+        if (buckets) {
+            flexpath_mixed = buckets->flexpath_mixed;
+            robustpath_mixed = buckets->robustpath_mixed;
+            for (uint64_t t = 0; t < tags.count; t++) {
+                uint64_t first, last;
+                bucket_range(buckets->flexpath_ranges, tags[t], first, last);
+                for (uint64_t i = first; i < last; i++) {
+                    // NOTE: return ErrorCode ignored here
+                    flexpath_array[i]->to_polygons(false, 0, result[t]);
+                }
+                bucket_range(buckets->robustpath_ranges, tags[t], first, last);
+                for (uint64_t i = first; i < last; i++) {
+                    robustpath_array[i]->to_polygons(false, 0, result[t]);
+                }
+            }
+        }
+
+        FlexPath** flexpath = flexpath_array.items + flexpath_mixed;
+        for (uint64_t i = flexpath_mixed; i < flexpath_array.count; i++, flexpath++) {
+            const FlexPathElement* elements = (*flexpath)->elements;
+            for (uint64_t j = 0; j < (*flexpath)->num_elements; j++) {
+                uint64_t t = tag_position(sorted_tags, elements[j].tag);
+                if (t == tags.count || repeated_element_tag(elements, j)) continue;
+                // NOTE: return ErrorCode ignored here
+                (*flexpath)->to_polygons(true, elements[j].tag, result[t]);
+            }
+        }
+
+        RobustPath** robustpath = robustpath_array.items + robustpath_mixed;
+        for (uint64_t i = robustpath_mixed; i < robustpath_array.count; i++, robustpath++) {
+            const RobustPathElement* elements = (*robustpath)->elements;
+            for (uint64_t j = 0; j < (*robustpath)->num_elements; j++) {
+                uint64_t t = tag_position(sorted_tags, elements[j].tag);
+                if (t == tags.count || repeated_element_tag(elements, j)) continue;
+                // NOTE: return ErrorCode ignored here
+                (*robustpath)->to_polygons(true, elements[j].tag, result[t]);
+            }
+        }
+    }
+
+    if (apply_repetitions) {
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t finish = result[t].count;
+            for (uint64_t i = start[t]; i < finish; i++) {
+                result[t][i]->apply_repetition(result[t]);
+            }
+        }
+    }
+    free_allocation(start);
+    sorted_tags.clear();
+
+    if (depth != 0) {
+        Reference** ref = reference_array.items;
+        for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if ((*ref)->type == ReferenceType::Cell &&
+                !has_any_tag((*ref)->cell->get_tags(cache).shape_tags, tags))
+                continue;
             (*ref)->get_polygons(apply_repetitions, include_paths, depth > 0 ? depth - 1 : -1,
-                                 filter, tag, result);
+                                 tags, result, cache);
         }
     }
 }
 
 void Cell::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                          Array<FlexPath*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_flexpaths(apply_repetitions, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                         Array<FlexPath*>& result, Map<GeometryInfo>& cache) const {
     uint64_t start = result.count;
 
     if (filter) {
-        for (uint64_t i = 0; i < flexpath_array.count; i++) {
-            FlexPath* psrc = flexpath_array[i];
-            FlexPath* path = NULL;
-            for (uint64_t j = 0; j < psrc->num_elements; j++) {
-                FlexPathElement* esrc = psrc->elements + j;
-                if (esrc->tag != tag) continue;
-                if (!path) {
-                    path = (FlexPath*)allocate_clear(sizeof(FlexPath));
-                    path->spine.copy_from(psrc->spine);
-                    path->properties = properties_copy(psrc->properties);
-                    path->repetition.copy_from(psrc->repetition);
-                    path->scale_width = psrc->scale_width;
-                    path->simple_path = psrc->simple_path;
-                    path->raith_data.copy_from(psrc->raith_data);
-                }
-                path->num_elements++;
-                path->elements = (FlexPathElement*)reallocate(
-                    path->elements, path->num_elements * sizeof(FlexPathElement));
-                FlexPathElement* el = path->elements + (path->num_elements - 1);
-                el->half_width_and_offset.copy_from(esrc->half_width_and_offset);
-                el->tag = esrc->tag;
-                el->join_type = esrc->join_type;
-                el->join_function = esrc->join_function;
-                el->join_function_data = esrc->join_function_data;
-                el->end_type = esrc->end_type;
-                el->end_extensions = esrc->end_extensions;
-                el->end_function = esrc->end_function;
-                el->end_function_data = esrc->end_function_data;
-                el->bend_type = esrc->bend_type;
-                el->bend_radius = esrc->bend_radius;
-                el->bend_function = esrc->bend_function;
-                el->bend_function_data = esrc->bend_function_data;
-            }
+        uint64_t first = 0;
+        uint64_t last = flexpath_array.count;
+        uint64_t mixed = last;
+        const TagBuckets* buckets = current_tag_buckets();
+        if (buckets) {
+            bucket_range(buckets->flexpath_ranges, tag, first, last);
+            mixed = buckets->flexpath_mixed;
+        }
+        for (uint64_t i = first; i < last; i++) {
+            FlexPath* path = flexpath_tag_copy(*flexpath_array[i], tag);
+            if (path) result.append(path);
+        }
+        for (uint64_t i = mixed; i < flexpath_array.count; i++) {
+            FlexPath* path = flexpath_tag_copy(*flexpath_array[i], tag);
             if (path) result.append(path);
         }
     } else {
@@ -472,51 +1178,104 @@ void Cell::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag
     if (depth != 0) {
         Reference** ref = reference_array.items;
         for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if (filter && (*ref)->type == ReferenceType::Cell &&
+                !(*ref)->cell->get_tags(cache).shape_tags.has_value(tag))
+                continue;
             (*ref)->get_flexpaths(apply_repetitions, depth > 0 ? depth - 1 : -1, filter, tag,
-                                  result);
+                                  result, cache);
+        }
+    }
+}
+
+void Cell::get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                         Array<FlexPath*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_flexpaths(apply_repetitions, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                         Array<FlexPath*>* result, Map<GeometryInfo>& cache) const {
+    uint64_t* start = (uint64_t*)allocate(tags.count * sizeof(uint64_t));
+    for (uint64_t t = 0; t < tags.count; t++) start[t] = result[t].count;
+    Array<TagPosition> sorted_tags = {};
+    sort_tag_positions(tags, sorted_tags);
+
+    uint64_t mixed = 0;
+    const TagBuckets* buckets = current_tag_buckets();
+    if (buckets) {
+        mixed = buckets->flexpath_mixed;
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t first, last;
+            bucket_range(buckets->flexpath_ranges, tags[t], first, last);
+            result[t].ensure_slots(last - first);
+            for (uint64_t i = first; i < last; i++) {
+                FlexPath* path = (FlexPath*)allocate_clear(sizeof(FlexPath));
+                path->copy_from(*flexpath_array[i]);
+                result[t].append_unsafe(path);
+            }
+        }
+    }
+
+    FlexPath** flexpath = flexpath_array.items + mixed;
+    for (uint64_t i = mixed; i < flexpath_array.count; i++, flexpath++) {
+        const FlexPathElement* elements = (*flexpath)->elements;
+        for (uint64_t j = 0; j < (*flexpath)->num_elements; j++) {
+            uint64_t t = tag_position(sorted_tags, elements[j].tag);
+            if (t == tags.count || repeated_element_tag(elements, j)) continue;
+            result[t].append(flexpath_tag_copy(**flexpath, elements[j].tag));
+        }
+    }
+
+    if (apply_repetitions) {
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t finish = result[t].count;
+            for (uint64_t i = start[t]; i < finish; i++) {
+                result[t][i]->apply_repetition(result[t]);
+            }
+        }
+    }
+    free_allocation(start);
+    sorted_tags.clear();
+
+    if (depth != 0) {
+        Reference** ref = reference_array.items;
+        for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if ((*ref)->type == ReferenceType::Cell &&
+                !has_any_tag((*ref)->cell->get_tags(cache).shape_tags, tags))
+                continue;
+            (*ref)->get_flexpaths(apply_repetitions, depth > 0 ? depth - 1 : -1, tags, result,
+                                  cache);
         }
     }
 }
 
 void Cell::get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                            Array<RobustPath*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_robustpaths(apply_repetitions, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                           Array<RobustPath*>& result, Map<GeometryInfo>& cache) const {
     uint64_t start = result.count;
 
     if (filter) {
-        for (uint64_t i = 0; i < robustpath_array.count; i++) {
-            RobustPath* psrc = robustpath_array[i];
-            RobustPath* path = NULL;
-            for (uint64_t j = 0; j < psrc->num_elements; j++) {
-                RobustPathElement* esrc = psrc->elements + j;
-                if (esrc->tag != tag) continue;
-                if (!path) {
-                    path = (RobustPath*)allocate_clear(sizeof(RobustPath));
-                    path->properties = properties_copy(psrc->properties);
-                    path->repetition.copy_from(psrc->repetition);
-                    path->end_point = psrc->end_point;
-                    path->subpath_array.copy_from(psrc->subpath_array);
-                    path->tolerance = psrc->tolerance;
-                    path->max_evals = psrc->max_evals;
-                    path->width_scale = psrc->width_scale;
-                    path->offset_scale = psrc->offset_scale;
-                    memcpy(path->trafo, psrc->trafo, 6 * sizeof(double));
-                    path->scale_width = psrc->scale_width;
-                    path->simple_path = psrc->simple_path;
-                }
-                path->num_elements++;
-                path->elements = (RobustPathElement*)reallocate(
-                    path->elements, path->num_elements * sizeof(RobustPathElement));
-                RobustPathElement* el = path->elements + (path->num_elements - 1);
-                el->tag = esrc->tag;
-                el->end_width = esrc->end_width;
-                el->end_offset = esrc->end_offset;
-                el->end_type = esrc->end_type;
-                el->end_extensions = esrc->end_extensions;
-                el->end_function = esrc->end_function;
-                el->end_function_data = esrc->end_function_data;
-                el->width_array.copy_from(esrc->width_array);
-                el->offset_array.copy_from(esrc->offset_array);
-            }
+        uint64_t first = 0;
+        uint64_t last = robustpath_array.count;
+        uint64_t mixed = last;
+        const TagBuckets* buckets = current_tag_buckets();
+        if (buckets) {
+            bucket_range(buckets->robustpath_ranges, tag, first, last);
+            mixed = buckets->robustpath_mixed;
+        }
+        for (uint64_t i = first; i < last; i++) {
+            RobustPath* path = robustpath_tag_copy(*robustpath_array[i], tag);
+            if (path) result.append(path);
+        }
+        for (uint64_t i = mixed; i < robustpath_array.count; i++) {
+            RobustPath* path = robustpath_tag_copy(*robustpath_array[i], tag);
             if (path) result.append(path);
         }
     } else {
@@ -538,18 +1297,95 @@ void Cell::get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, T
     if (depth != 0) {
         Reference** ref = reference_array.items;
         for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if (filter && (*ref)->type == ReferenceType::Cell &&
+                !(*ref)->cell->get_tags(cache).shape_tags.has_value(tag))
+                continue;
             (*ref)->get_robustpaths(apply_repetitions, depth > 0 ? depth - 1 : -1, filter, tag,
-                                    result);
+                                    result, cache);
+        }
+    }
+}
+
+void Cell::get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                           Array<RobustPath*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_robustpaths(apply_repetitions, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                           Array<RobustPath*>* result, Map<GeometryInfo>& cache) const {
+    uint64_t* start = (uint64_t*)allocate(tags.count * sizeof(uint64_t));
+    for (uint64_t t = 0; t < tags.count; t++) start[t] = result[t].count;
+    Array<TagPosition> sorted_tags = {};
+    sort_tag_positions(tags, sorted_tags);
+
+    uint64_t mixed = 0;
+    const TagBuckets* buckets = current_tag_buckets();
+    if (buckets) {
+        mixed = buckets->robustpath_mixed;
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t first, last;
+            bucket_range(buckets->robustpath_ranges, tags[t], first, last);
+            result[t].ensure_slots(last - first);
+            for (uint64_t i = first; i < last; i++) {
+                RobustPath* path = (RobustPath*)allocate_clear(sizeof(RobustPath));
+                path->copy_from(*robustpath_array[i]);
+                result[t].append_unsafe(path);
+            }
+        }
+    }
+
+    RobustPath** robustpath = robustpath_array.items + mixed;
+    for (uint64_t i = mixed; i < robustpath_array.count; i++, robustpath++) {
+        const RobustPathElement* elements = (*robustpath)->elements;
+        for (uint64_t j = 0; j < (*robustpath)->num_elements; j++) {
+            uint64_t t = tag_position(sorted_tags, elements[j].tag);
+            if (t == tags.count || repeated_element_tag(elements, j)) continue;
+            result[t].append(robustpath_tag_copy(**robustpath, elements[j].tag));
+        }
+    }
+
+    if (apply_repetitions) {
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t finish = result[t].count;
+            for (uint64_t i = start[t]; i < finish; i++) {
+                result[t][i]->apply_repetition(result[t]);
+            }
+        }
+    }
+    free_allocation(start);
+    sorted_tags.clear();
+
+    if (depth != 0) {
+        Reference** ref = reference_array.items;
+        for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if ((*ref)->type == ReferenceType::Cell &&
+                !has_any_tag((*ref)->cell->get_tags(cache).shape_tags, tags))
+                continue;
+            (*ref)->get_robustpaths(apply_repetitions, depth > 0 ? depth - 1 : -1, tags, result,
+                                    cache);
         }
     }
 }
 
 void Cell::get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                       Array<Label*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_labels(apply_repetitions, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                      Array<Label*>& result, Map<GeometryInfo>& cache) const {
     uint64_t start = result.count;
 
     if (filter) {
-        for (uint64_t i = 0; i < label_array.count; i++) {
+        uint64_t first = 0;
+        uint64_t last = label_array.count;
+        const TagBuckets* buckets = current_tag_buckets();
+        if (buckets) bucket_range(buckets->label_ranges, tag, first, last);
+        for (uint64_t i = first; i < last; i++) {
             Label* lsrc = label_array[i];
             if (lsrc->tag != tag) continue;
             Label* label = (Label*)allocate_clear(sizeof(Label));
@@ -575,12 +1411,77 @@ void Cell::get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag ta
     if (depth != 0) {
         Reference** ref = reference_array.items;
         for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
-            (*ref)->get_labels(apply_repetitions, depth > 0 ? depth - 1 : -1, filter, tag, result);
+            if (filter && (*ref)->type == ReferenceType::Cell &&
+                !(*ref)->cell->get_tags(cache).label_tags.has_value(tag))
+                continue;
+            (*ref)->get_labels(apply_repetitions, depth > 0 ? depth - 1 : -1, filter, tag, result,
+                               cache);
+        }
+    }
+}
+
+void Cell::get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                      Array<Label*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_labels(apply_repetitions, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Cell::get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                      Array<Label*>* result, Map<GeometryInfo>& cache) const {
+    uint64_t* start = (uint64_t*)allocate(tags.count * sizeof(uint64_t));
+    for (uint64_t t = 0; t < tags.count; t++) start[t] = result[t].count;
+    Array<TagPosition> sorted_tags = {};
+    sort_tag_positions(tags, sorted_tags);
+
+    const TagBuckets* buckets = current_tag_buckets();
+    if (buckets) {
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t first, last;
+            bucket_range(buckets->label_ranges, tags[t], first, last);
+            result[t].ensure_slots(last - first);
+            for (uint64_t i = first; i < last; i++) {
+                Label* label = (Label*)allocate_clear(sizeof(Label));
+                label->copy_from(*label_array[i]);
+                result[t].append_unsafe(label);
+            }
+        }
+    } else {
+        Label** lsrc = label_array.items;
+        for (uint64_t i = 0; i < label_array.count; i++, lsrc++) {
+            uint64_t t = tag_position(sorted_tags, (*lsrc)->tag);
+            if (t == tags.count) continue;
+            Label* label = (Label*)allocate_clear(sizeof(Label));
+            label->copy_from(**lsrc);
+            result[t].append(label);
+        }
+    }
+
+    if (apply_repetitions) {
+        for (uint64_t t = 0; t < tags.count; t++) {
+            uint64_t finish = result[t].count;
+            for (uint64_t i = start[t]; i < finish; i++) {
+                result[t][i]->apply_repetition(result[t]);
+            }
+        }
+    }
+    free_allocation(start);
+    sorted_tags.clear();
+
+    if (depth != 0) {
+        Reference** ref = reference_array.items;
+        for (uint64_t i = 0; i < reference_array.count; i++, ref++) {
+            if ((*ref)->type == ReferenceType::Cell &&
+                !has_any_tag((*ref)->cell->get_tags(cache).label_tags, tags))
+                continue;
+            (*ref)->get_labels(apply_repetitions, depth > 0 ? depth - 1 : -1, tags, result, cache);
         }
     }
 }
 
 void Cell::flatten(bool apply_repetitions, Array<Reference*>& result) {
+    unshare();
+    modification_count++;
     uint64_t i = 0;
     while (i < reference_array.count) {
         Reference* ref = reference_array[i];
@@ -597,7 +1498,153 @@ void Cell::flatten(bool apply_repetitions, Array<Reference*>& result) {
     }
 }
 
+// Element candidate for repetition grouping
+struct RepetitionCandidate {
+    uint64_t key;
+    uint64_t index;
+    Vec2 position;
+};
+
+static bool repetition_candidate_order(const RepetitionCandidate& c1,
+                                       const RepetitionCandidate& c2) {
+    return c1.key < c2.key || (c1.key == c2.key && c1.index < c2.index);
+}
+
+// Set the repetitions for each group of candidates with the same key.  The
+// repetition of element i is set in repetitions[i], and removed[i] is set for
+// elements covered by another element's repetition.
+static void group_candidates(Array<RepetitionCandidate>& candidates, double scaling,
+                             Repetition* repetitions, bool* removed) {
+    sort(candidates, repetition_candidate_order);
+    Array<Vec2> points = {};
+    Array<uint64_t> origins = {};
+    Array<Repetition> group_repetitions = {};
+    bool* covered = NULL;
+    uint64_t start = 0;
+    for (uint64_t i = 1; i <= candidates.count; i++) {
+        if (i < candidates.count && candidates[i].key == candidates[start].key) continue;
+        const uint64_t count = i - start;
+        if (count > 1) {
+            points.count = 0;
+            points.ensure_slots(count);
+            for (uint64_t j = start; j < i; j++) points.append_unsafe(candidates[j].position);
+            covered = (bool*)reallocate(covered, count * sizeof(bool));
+            memset(covered, 0, count * sizeof(bool));
+            origins.count = 0;
+            group_repetitions.count = 0;
+            find_repetitions(points, scaling, origins, group_repetitions, covered);
+            for (uint64_t j = 0; j < origins.count; j++) {
+                repetitions[candidates[start + origins[j]].index] = group_repetitions[j];
+            }
+            for (uint64_t j = 0; j < count; j++) {
+                if (covered[j]) removed[candidates[start + j].index] = true;
+            }
+        }
+        start = i;
+    }
+    if (covered) free_allocation(covered);
+    points.clear();
+    origins.clear();
+    group_repetitions.clear();
+}
+
+void Cell::group_repetitions(double scaling, Array<Reference*>& removed_references,
+                             Array<Polygon*>& removed_polygons) {
+    unshare();
+    modification_count++;
+    Array<RepetitionCandidate> candidates = {};
+
+    const uint64_t reference_count = reference_array.count;
+    Repetition* repetitions =
+        (Repetition*)allocate_clear(reference_count * sizeof(Repetition));
+    bool* removed = (bool*)allocate_clear(reference_count * sizeof(bool));
+    for (uint64_t i = 0; i < reference_count; i++) {
+        const Reference* ref = reference_array[i];
+        if (ref->repetition.type != RepetitionType::None) continue;
+        uint64_t key = ref->placement_hash(scaling, ref->origin);
+        key = hash_combine(key, (uint64_t)ref->type);
+        key = hash_combine(key, hash(ref->type == ReferenceType::Cell ? (const char*)ref->cell->name
+                                     : ref->type == ReferenceType::RawCell
+                                         ? (const char*)ref->rawcell->name
+                                         : (const char*)ref->name));
+        candidates.append(RepetitionCandidate{key, i, ref->origin});
+    }
+    group_candidates(candidates, scaling, repetitions, removed);
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < reference_count; i++) {
+        Reference* ref = reference_array[i];
+        if (removed[i]) {
+            removed_references.append(ref);
+            continue;
+        }
+        if (repetitions[i].type != RepetitionType::None) ref->repetition = repetitions[i];
+        reference_array[count++] = ref;
+    }
+    reference_array.count = count;
+    free_allocation(repetitions);
+    free_allocation(removed);
+
+    candidates.count = 0;
+    const uint64_t polygon_count = polygon_array.count;
+    repetitions = (Repetition*)allocate_clear(polygon_count * sizeof(Repetition));
+    removed = (bool*)allocate_clear(polygon_count * sizeof(bool));
+    for (uint64_t i = 0; i < polygon_count; i++) {
+        const Polygon* polygon = polygon_array[i];
+        if (polygon->repetition.type != RepetitionType::None || polygon->point_array.count == 0)
+            continue;
+        Vec2 min, max;
+        polygon->bounding_box(min, max);
+        candidates.append(RepetitionCandidate{polygon->content_hash(scaling, min), i, min});
+    }
+    group_candidates(candidates, scaling, repetitions, removed);
+    count = 0;
+    for (uint64_t i = 0; i < polygon_count; i++) {
+        Polygon* polygon = polygon_array[i];
+        if (removed[i]) {
+            removed_polygons.append(polygon);
+            continue;
+        }
+        if (repetitions[i].type != RepetitionType::None) polygon->repetition = repetitions[i];
+        polygon_array[count++] = polygon;
+    }
+    polygon_array.count = count;
+    free_allocation(repetitions);
+    free_allocation(removed);
+    candidates.clear();
+}
+
 void Cell::remap_tags(const TagMap& map) {
+    unshare();
+    update_tag_buckets(false);
+    if (tag_buckets) {
+        // Each bucket is remapped as a whole, so only the elements with tags
+        // that change are touched.
+        TagBuckets* buckets = tag_buckets;
+        bool changed = remap_bucket_tags(polygon_array, buckets->polygon_ranges, map);
+        changed = remap_bucket_tags(flexpath_array, buckets->flexpath_ranges, map) || changed;
+        changed = remap_bucket_tags(robustpath_array, buckets->robustpath_ranges, map) || changed;
+        changed = remap_bucket_tags(label_array, buckets->label_ranges, map) || changed;
+        for (uint64_t i = buckets->flexpath_mixed; i < flexpath_array.count; i++) {
+            FlexPath* path = flexpath_array[i];
+            for (uint64_t j = 0; j < path->num_elements; j++) {
+                path->elements[j].tag = map.get(path->elements[j].tag);
+            }
+            changed = true;
+        }
+        for (uint64_t i = buckets->robustpath_mixed; i < robustpath_array.count; i++) {
+            RobustPath* path = robustpath_array[i];
+            for (uint64_t j = 0; j < path->num_elements; j++) {
+                path->elements[j].tag = map.get(path->elements[j].tag);
+            }
+            changed = true;
+        }
+        if (changed) {
+            modification_count++;
+            update_tag_buckets(true);
+        }
+        return;
+    }
+
     for (uint64_t i = 0; i < polygon_array.count; i++) {
         Polygon* polygon = polygon_array[i];
         polygon->tag = map.get(polygon->tag);
@@ -618,6 +1665,7 @@ void Cell::remap_tags(const TagMap& map) {
         Label* label = label_array[i];
         label->tag = map.get(label->tag);
     }
+    modification_count++;
 }
 
 void Cell::get_dependencies(bool recursive, Map<Cell*>& result) const {
@@ -650,18 +1698,32 @@ void Cell::get_raw_dependencies(bool recursive, Map<RawCell*>& result) const {
 }
 
 void Cell::get_shape_tags(Set<Tag>& result) const {
-    for (uint64_t i = 0; i < polygon_array.count; i++) {
-        result.add(polygon_array[i]->tag);
+    uint64_t flexpath_mixed = 0;
+    uint64_t robustpath_mixed = 0;
+    const TagBuckets* buckets = current_tag_buckets();
+    if (buckets) {
+        const Array<TagRange>* ranges[] = {&buckets->polygon_ranges, &buckets->flexpath_ranges,
+                                           &buckets->robustpath_ranges};
+        for (uint64_t i = 0; i < COUNT(ranges); i++) {
+            const TagRange* range = ranges[i]->items;
+            for (uint64_t j = ranges[i]->count; j > 0; j--, range++) result.add(range->tag);
+        }
+        flexpath_mixed = buckets->flexpath_mixed;
+        robustpath_mixed = buckets->robustpath_mixed;
+    } else {
+        for (uint64_t i = 0; i < polygon_array.count; i++) {
+            result.add(polygon_array[i]->tag);
+        }
     }
 
-    for (uint64_t i = 0; i < flexpath_array.count; i++) {
+    for (uint64_t i = flexpath_mixed; i < flexpath_array.count; i++) {
         const FlexPath* flexpath = flexpath_array[i];
         for (uint64_t ne = 0; ne < flexpath->num_elements; ne++) {
             result.add(flexpath->elements[ne].tag);
         }
     }
 
-    for (uint64_t i = 0; i < robustpath_array.count; i++) {
+    for (uint64_t i = robustpath_mixed; i < robustpath_array.count; i++) {
         const RobustPath* robustpath = robustpath_array[i];
         for (uint64_t ne = 0; ne < robustpath->num_elements; ne++) {
             result.add(robustpath->elements[ne].tag);
@@ -670,11 +1732,40 @@ void Cell::get_shape_tags(Set<Tag>& result) const {
 }
 
 void Cell::get_label_tags(Set<Tag>& result) const {
+    const TagBuckets* buckets = current_tag_buckets();
+    if (buckets) {
+        const TagRange* range = buckets->label_ranges.items;
+        for (uint64_t i = buckets->label_ranges.count; i > 0; i--, range++) result.add(range->tag);
+        return;
+    }
     for (uint64_t i = 0; i < label_array.count; i++) {
         result.add(label_array[i]->tag);
     }
 }
 
+GeometryInfo Cell::get_tags(Map<GeometryInfo>& cache) const {
+    GeometryInfo info = cache.get(name);
+    if (info.tags_valid) return info;
+    get_shape_tags(info.shape_tags);
+    get_label_tags(info.label_tags);
+    Reference** reference = reference_array.items;
+    for (uint64_t i = 0; i < reference_array.count; i++, reference++) {
+        if ((*reference)->type != ReferenceType::Cell) continue;
+        GeometryInfo child = (*reference)->cell->get_tags(cache);
+        for (SetItem<Tag>* item = child.shape_tags.next(NULL); item;
+             item = child.shape_tags.next(item)) {
+            info.shape_tags.add(item->value);
+        }
+        for (SetItem<Tag>* item = child.label_tags.next(NULL); item;
+             item = child.label_tags.next(item)) {
+            info.label_tags.add(item->value);
+        }
+    }
+    info.tags_valid = true;
+    cache.set(name, info);
+    return info;
+}
+
 ErrorCode Cell::to_gds(FILE* out, double scaling, uint64_t max_points, double precision,
                        const tm* timestamp) const {
     ErrorCode error_code = ErrorCode::NoError;
@@ -812,8 +1903,181 @@ ErrorCode Cell::to_gds(FILE* out, double scaling, uint64_t max_points, double pr
     return error_code;
 }
 
-ErrorCode Cell::to_svg(FILE* out, double scaling, uint32_t precision, const char* attributes,
-                       PolygonComparisonFunction comparison) const {
+// Number of polygons encoded by each parallel task in SVG output
+#define GDSTK_SVG_CHUNK_SIZE 4096
+
+// Polygon selected for SVG output.  If box is true, the polygon is replaced by
+// its bounding box (min, max).
+struct SvgPolygon {
+    Polygon* polygon;
+    uint64_t index;
+    double area;
+    Vec2 min;
+    Vec2 max;
+    bool box;
+};
+
+static bool svg_budget_order(const SvgPolygon& p1, const SvgPolygon& p2) {
+    if (p1.polygon->tag != p2.polygon->tag) return p1.polygon->tag < p2.polygon->tag;
+    return p1.area > p2.area;
+}
+
+static bool svg_index_order(const SvgPolygon& p1, const SvgPolygon& p2) {
+    return p1.index < p2.index;
+}
+
+static void svg_rect_attributes(Array<char>& out, Vec2 min, Vec2 max, double scaling,
+                                uint32_t precision) {
+    char double_buffer[GDSTK_DOUBLE_BUFFER_COUNT];
+    min *= scaling;
+    max *= scaling;
+    append_string(out, " x=\"");
+    append_string(out, double_print(min.x, precision, double_buffer, COUNT(double_buffer)));
+    append_string(out, "\" y=\"");
+    append_string(out, double_print(min.y, precision, double_buffer, COUNT(double_buffer)));
+    append_string(out, "\" width=\"");
+    append_string(out, double_print(max.x - min.x, precision, double_buffer, COUNT(double_buffer)));
+    append_string(out, "\" height=\"");
+    append_string(out, double_print(max.y - min.y, precision, double_buffer, COUNT(double_buffer)));
+    out.append('"');
+}
+
+static ErrorCode svg_polygon_to_svg(const SvgPolygon& item, Array<char>& out, double scaling,
+                                    uint32_t precision) {
+    if (!item.box) return item.polygon->to_svg(out, scaling, precision);
+    Tag tag = item.polygon->tag;
+    append_format(out, "<rect class=\"l%" PRIu32 "d%" PRIu32 "\"", get_layer(tag), get_type(tag));
+    svg_rect_attributes(out, item.min, item.max, scaling, precision);
+    append_string(out, "/>\n");
+    return ErrorCode::NoError;
+}
+
+// Append the polygons to be drawn to result, in their original order, applying
+// the level-of-detail options, if any.
+static void svg_select_polygons(Polygon* const* polygons, uint64_t count, double scaling,
+                                const SvgLevelOfDetail* lod, Array<SvgPolygon>& result) {
+    result.ensure_slots(count);
+    for (uint64_t i = 0; i < count; i++) {
+        Polygon* polygon = polygons[i];
+        SvgPolygon item = {polygon, i};
+        if (lod == NULL) {
+            result.append_unsafe(item);
+            continue;
+        }
+        if (polygon->point_array.count < 3) continue;
+        Vec2 min = polygon->point_array[0];
+        Vec2 max = min;
+        Vec2* p = polygon->point_array.items + 1;
+        for (uint64_t j = polygon->point_array.count - 1; j > 0; j--, p++) {
+            if (p->x < min.x) min.x = p->x;
+            if (p->x > max.x) max.x = p->x;
+            if (p->y < min.y) min.y = p->y;
+            if (p->y > max.y) max.y = p->y;
+        }
+        Vec2 size = max - min;
+        item.area = size.x * size.y;
+        if ((size.x > size.y ? size.x : size.y) * scaling < lod->min_size) {
+            if (!lod->outline) continue;
+            item.box = true;
+            if (polygon->repetition.type != RepetitionType::None) {
+                polygon->bounding_box(min, max);
+            }
+            item.min = min;
+            item.max = max;
+        }
+        result.append_unsafe(item);
+    }
+
+    if (lod == NULL || lod->max_polygons == 0 || result.count <= lod->max_polygons) return;
+
+    // Keep the largest max_polygons of each tag
+    sort(result, svg_budget_order);
+    SvgPolygon* src = result.items;
+    SvgPolygon* dst = result.items;
+    Tag tag = src->polygon->tag;
+    uint64_t budget = lod->max_polygons;
+    for (uint64_t i = result.count; i > 0; i--, src++) {
+        if (src->polygon->tag != tag) {
+            tag = src->polygon->tag;
+            budget = lod->max_polygons;
+        }
+        if (budget == 0) continue;
+        budget--;
+        *dst++ = *src;
+    }
+    result.count = dst - result.items;
+    sort(result, svg_index_order);
+}
+
+// Polygons are encoded in parallel into separate buffers, which are appended
+// to out in order.
+static ErrorCode svg_write_polygons(Array<char>& out, const Array<SvgPolygon>& items,
+                                    double scaling, uint32_t precision) {
+    ErrorCode error_code = ErrorCode::NoError;
+    const uint64_t chunk_count = (items.count + GDSTK_SVG_CHUNK_SIZE - 1) / GDSTK_SVG_CHUNK_SIZE;
+    if (chunk_count < 2 || get_thread_count() < 2) {
+        SvgPolygon* item = items.items;
+        for (uint64_t i = items.count; i > 0; i--, item++) {
+            ErrorCode err = svg_polygon_to_svg(*item, out, scaling, precision);
+            if (err != ErrorCode::NoError) error_code = err;
+        }
+        return error_code;
+    }
+
+    Array<char>* chunks = (Array<char>*)allocate_clear(chunk_count * sizeof(Array<char>));
+    ErrorCode* chunk_errors = (ErrorCode*)allocate_clear(chunk_count * sizeof(ErrorCode));
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)chunk_count; i++) {
+        uint64_t start = i * GDSTK_SVG_CHUNK_SIZE;
+        uint64_t end = start + GDSTK_SVG_CHUNK_SIZE;
+        if (end > items.count) end = items.count;
+        for (uint64_t j = start; j < end; j++) {
+            ErrorCode err = svg_polygon_to_svg(items[j], chunks[i], scaling, precision);
+            if (err != ErrorCode::NoError) chunk_errors[i] = err;
+        }
+    }
+
+    for (uint64_t i = 0; i < chunk_count; i++) {
+        if (chunk_errors[i] != ErrorCode::NoError) error_code = chunk_errors[i];
+        out.extend(chunks[i]);
+        chunks[i].clear();
+    }
+    free_allocation(chunks);
+    free_allocation(chunk_errors);
+    return error_code;
+}
+
+// Return true if the instances of reference are smaller than the level-of-detail
+// threshold.
+static bool svg_reference_culled(const Reference* reference, double scaling,
+                                 const SvgLevelOfDetail* lod, Map<GeometryInfo>& cache) {
+    if (lod == NULL || lod->min_size <= 0 || reference->type != ReferenceType::Cell) return false;
+    GeometryInfo info = cache.get(reference->cell->name);
+    if (!info.bounding_box_valid) info = reference->cell->bounding_box(cache);
+    Vec2 size = info.bounding_box_max - info.bounding_box_min;
+    if (size.x < 0) return false;
+    double max_size = (size.x > size.y ? size.x : size.y) * fabs(reference->magnification);
+    return max_size * scaling < lod->min_size;
+}
+
+// Add the cells required to draw cell to result, skipping those only
+// instantiated by culled references.
+static void svg_visible_dependencies(const Cell* cell, double scaling,
+                                     const SvgLevelOfDetail* lod, Map<GeometryInfo>& cache,
+                                     Map<Cell*>& result) {
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = 0; i < cell->reference_array.count; i++, reference++) {
+        Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell || result.has_key(ref->cell->name)) continue;
+        if (svg_reference_culled(ref, scaling, lod, cache)) continue;
+        result.set(ref->cell->name, ref->cell);
+        svg_visible_dependencies(ref->cell, scaling, lod, cache, result);
+    }
+}
+
+ErrorCode Cell::to_svg(Array<char>& out, double scaling, uint32_t precision,
+                       const char* attributes, PolygonComparisonFunction comparison,
+                       const SvgLevelOfDetail* lod, Map<GeometryInfo>& cache) const {
     ErrorCode error_code = ErrorCode::NoError;
     char* buffer = (char*)allocate(strlen(name) + 1);
     // NOTE: Here be dragons if name is not ASCII.  The GDSII specification imposes ASCII-only
@@ -823,65 +2087,149 @@ ErrorCode Cell::to_svg(FILE* out, double scaling, uint32_t precision, const char
     *d = 0;
 
     if (attributes) {
-        fprintf(out, "<g id=\"%s\" %s>\n", buffer, attributes);
+        append_format(out, "<g id=\"%s\" %s>\n", buffer, attributes);
     } else {
-        fprintf(out, "<g id=\"%s\">\n", buffer);
+        append_format(out, "<g id=\"%s\">\n", buffer);
     }
 
-    if (comparison == NULL) {
-        Polygon** polygon = polygon_array.items;
-        for (uint64_t i = 0; i < polygon_array.count; i++, polygon++) {
-            ErrorCode err = (*polygon)->to_svg(out, scaling, precision);
-            if (err != ErrorCode::NoError) error_code = err;
-        }
-
+    // Paths are converted to polygons only when sorting or culling.  Polygons
+    // from all_polygons starting at first_owned must be freed, except for those
+    // that got an owner during sorting.
+    Array<Polygon*> all_polygons = {};
+    uint64_t first_owned = 0;
+    if (comparison) {
+        get_polygons(false, true, 0, false, 0, all_polygons);
+        sort(all_polygons, comparison);
+    } else if (lod) {
+        all_polygons.extend(polygon_array);
+        first_owned = all_polygons.count;
         FlexPath** flexpath = flexpath_array.items;
         for (uint64_t i = 0; i < flexpath_array.count; i++, flexpath++) {
-            ErrorCode err = (*flexpath)->to_svg(out, scaling, precision);
+            ErrorCode err = (*flexpath)->to_polygons(false, 0, all_polygons);
             if (err != ErrorCode::NoError) error_code = err;
         }
-
         RobustPath** robustpath = robustpath_array.items;
         for (uint64_t i = 0; i < robustpath_array.count; i++, robustpath++) {
-            ErrorCode err = (*robustpath)->to_svg(out, scaling, precision);
+            ErrorCode err = (*robustpath)->to_polygons(false, 0, all_polygons);
             if (err != ErrorCode::NoError) error_code = err;
         }
-    } else {
-        Array<Polygon*> all_polygons = {};
-        get_polygons(false, true, -1, false, 0, all_polygons);
+    }
 
-        sort(all_polygons, comparison);
+    Array<SvgPolygon> items = {};
+    if (comparison || lod) {
+        svg_select_polygons(all_polygons.items, all_polygons.count, scaling, lod, items);
+    } else {
+        svg_select_polygons(polygon_array.items, polygon_array.count, scaling, NULL, items);
+    }
+    ErrorCode err = svg_write_polygons(out, items, scaling, precision);
+    if (err != ErrorCode::NoError) error_code = err;
+    items.clear();
 
-        Polygon** polygon = all_polygons.items;
-        for (uint64_t i = 0; i < all_polygons.count; i++, polygon++) {
-            ErrorCode err = (*polygon)->to_svg(out, scaling, precision);
-            if (err != ErrorCode::NoError) error_code = err;
+    if (comparison || lod) {
+        Polygon** polygon = all_polygons.items + first_owned;
+        for (uint64_t i = first_owned; i < all_polygons.count; i++, polygon++) {
+            if ((*polygon)->owner) continue;
             (*polygon)->clear();
+            free_allocation(*polygon);
         }
         all_polygons.clear();
+    } else {
+        FlexPath** flexpath = flexpath_array.items;
+        for (uint64_t i = 0; i < flexpath_array.count; i++, flexpath++) {
+            err = (*flexpath)->to_svg(out, scaling, precision);
+            if (err != ErrorCode::NoError) error_code = err;
+        }
+
+        RobustPath** robustpath = robustpath_array.items;
+        for (uint64_t i = 0; i < robustpath_array.count; i++, robustpath++) {
+            err = (*robustpath)->to_svg(out, scaling, precision);
+            if (err != ErrorCode::NoError) error_code = err;
+        }
     }
 
     Reference** reference = reference_array.items;
     for (uint64_t i = 0; i < reference_array.count; i++, reference++) {
-        ErrorCode err = (*reference)->to_svg(out, scaling, precision);
+        if (svg_reference_culled(*reference, scaling, lod, cache)) {
+            if (lod->outline) {
+                Vec2 min, max;
+                (*reference)->bounding_box(min, max, cache);
+                append_string(out, "<rect");
+                svg_rect_attributes(out, min, max, scaling, precision);
+                append_string(out,
+                              " fill=\"none\" stroke=\"#808080\" stroke-width=\"1\" "
+                              "vector-effect=\"non-scaling-stroke\"/>\n");
+            }
+            continue;
+        }
+        err = (*reference)->to_svg(out, scaling, precision);
         if (err != ErrorCode::NoError) error_code = err;
     }
 
     Label** label = label_array.items;
     for (uint64_t i = 0; i < label_array.count; i++, label++) {
-        ErrorCode err = (*label)->to_svg(out, scaling, precision);
+        err = (*label)->to_svg(out, scaling, precision);
         if (err != ErrorCode::NoError) error_code = err;
     }
 
-    fputs("</g>\n", out);
+    append_string(out, "</g>\n");
     free_allocation(buffer);
     return error_code;
 }
 
+// Write the SVG text in buffer to out or, if not NULL, gz_out and reset it.
+static ErrorCode svg_flush(Array<char>& buffer, FILE* out, gzFile gz_out) {
+    ErrorCode error_code = ErrorCode::NoError;
+    if (gz_out) {
+        char* data = buffer.items;
+        uint64_t remaining = buffer.count;
+        while (remaining > 0) {
+            unsigned size = remaining > (1 << 30) ? (1 << 30) : (unsigned)remaining;
+            if (gzwrite(gz_out, data, size) != (int)size) {
+                if (error_logger) fputs("[GDSTK] Error writing compressed SVG.\n", error_logger);
+                error_code = ErrorCode::ZlibError;
+                break;
+            }
+            data += size;
+            remaining -= size;
+        }
+    } else {
+        fwrite(buffer.items, 1, buffer.count, out);
+    }
+    buffer.count = 0;
+    return error_code;
+}
+
+ErrorCode Cell::to_svg(FILE* out, double scaling, uint32_t precision, const char* attributes,
+                       PolygonComparisonFunction comparison, const SvgLevelOfDetail* lod,
+                       Map<GeometryInfo>& cache) const {
+    Array<char> buffer = {};
+    ErrorCode error_code =
+        to_svg(buffer, scaling, precision, attributes, comparison, lod, cache);
+    svg_flush(buffer, out, NULL);
+    buffer.clear();
+    return error_code;
+}
+
+ErrorCode Cell::to_svg(FILE* out, double scaling, uint32_t precision, const char* attributes,
+                       PolygonComparisonFunction comparison) const {
+    Map<GeometryInfo> cache = {};
+    ErrorCode error_code = to_svg(out, scaling, precision, attributes, comparison, NULL, cache);
+    clear_geometry_cache(cache);
+    return error_code;
+}
+
 ErrorCode Cell::write_svg(const char* filename, double scaling, uint32_t precision,
                           StyleMap* shape_style, StyleMap* label_style, const char* background,
                           double pad, bool pad_as_percentage,
                           PolygonComparisonFunction comparison) const {
+    return write_svg(filename, scaling, precision, shape_style, label_style, background, pad,
+                     pad_as_percentage, comparison, NULL, false);
+}
+
+ErrorCode Cell::write_svg(const char* filename, double scaling, uint32_t precision,
+                          StyleMap* shape_style, StyleMap* label_style, const char* background,
+                          double pad, bool pad_as_percentage, PolygonComparisonFunction comparison,
+                          const SvgLevelOfDetail* lod, bool compressed) const {
     ErrorCode error_code = ErrorCode::NoError;
     Vec2 min, max;
     bounding_box(min, max);
@@ -903,33 +2251,46 @@ ErrorCode Cell::write_svg(const char* filename, double scaling, uint32_t precisi
     w += 2 * pad;
     h += 2 * pad;
 
-    FILE* out = fopen(filename, "w");
-    if (out == NULL) {
+    // The output is built in memory, one cell at a time, and written directly
+    // to the file (compressed, if requested)
+    gzFile gz_out = NULL;
+    FILE* out = NULL;
+    if (compressed) {
+        gz_out = gzopen(filename, "wb");
+    } else {
+        out = fopen(filename, "w");
+    }
+    if (out == NULL && gz_out == NULL) {
         if (error_logger) fputs("[GDSTK] Unable to open file for SVG output.\n", error_logger);
         return ErrorCode::OutputFileOpenError;
     }
 
-    fputs(
-        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
-        "<svg xmlns=\"http://www.w3.org/2000/svg\" "
-        "xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"",
-        out);
+    Array<char> buffer = {};
+    append_string(buffer,
+                  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                  "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+                  "xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"");
     char double_buffer[GDSTK_DOUBLE_BUFFER_COUNT];
-    fputs(double_print(w, precision, double_buffer, COUNT(double_buffer)), out);
-    fputs("\" height=\"", out);
-    fputs(double_print(h, precision, double_buffer, COUNT(double_buffer)), out);
-    fputs("\" viewBox=\"", out);
-    fputs(double_print(x, precision, double_buffer, COUNT(double_buffer)), out);
-    fputc(' ', out);
-    fputs(double_print(y, precision, double_buffer, COUNT(double_buffer)), out);
-    fputc(' ', out);
-    fputs(double_print(w, precision, double_buffer, COUNT(double_buffer)), out);
-    fputc(' ', out);
-    fputs(double_print(h, precision, double_buffer, COUNT(double_buffer)), out);
-    fputs("\">\n<defs>\n<style type=\"text/css\">\n", out);
+    append_string(buffer, double_print(w, precision, double_buffer, COUNT(double_buffer)));
+    append_string(buffer, "\" height=\"");
+    append_string(buffer, double_print(h, precision, double_buffer, COUNT(double_buffer)));
+    append_string(buffer, "\" viewBox=\"");
+    append_string(buffer, double_print(x, precision, double_buffer, COUNT(double_buffer)));
+    buffer.append(' ');
+    append_string(buffer, double_print(y, precision, double_buffer, COUNT(double_buffer)));
+    buffer.append(' ');
+    append_string(buffer, double_print(w, precision, double_buffer, COUNT(double_buffer)));
+    buffer.append(' ');
+    append_string(buffer, double_print(h, precision, double_buffer, COUNT(double_buffer)));
+    append_string(buffer, "\">\n<defs>\n<style type=\"text/css\">\n");
 
+    Map<GeometryInfo> cache = {};
     Map<Cell*> cell_map = {};
-    get_dependencies(true, cell_map);
+    if (lod) {
+        svg_visible_dependencies(this, scaling, lod, cache, cell_map);
+    } else {
+        get_dependencies(true, cell_map);
+    }
 
     Set<Tag> shape_tags = {};
     get_shape_tags(shape_tags);
@@ -947,13 +2308,15 @@ ErrorCode Cell::write_svg(const char* filename, double scaling, uint32_t precisi
             Tag tag = item->value;
             const char* style = shape_style->get(tag);
             if (!style) style = default_svg_shape_style(tag);
-            fprintf(out, ".l%" PRIu32 "d%" PRIu32 " {%s}\n", get_layer(tag), get_type(tag), style);
+            append_format(buffer, ".l%" PRIu32 "d%" PRIu32 " {%s}\n", get_layer(tag),
+                          get_type(tag), style);
         }
     } else {
         for (SetItem<Tag>* item = shape_tags.next(NULL); item; item = shape_tags.next(item)) {
             Tag tag = item->value;
             const char* style = default_svg_shape_style(tag);
-            fprintf(out, ".l%" PRIu32 "d%" PRIu32 " {%s}\n", get_layer(tag), get_type(tag), style);
+            append_format(buffer, ".l%" PRIu32 "d%" PRIu32 " {%s}\n", get_layer(tag),
+                          get_type(tag), style);
         }
     }
 
@@ -962,20 +2325,25 @@ ErrorCode Cell::write_svg(const char* filename, double scaling, uint32_t precisi
             Tag tag = item->value;
             const char* style = label_style->get(tag);
             if (!style) style = default_svg_label_style(tag);
-            fprintf(out, ".l%" PRIu32 "t%" PRIu32 " {%s}\n", get_layer(tag), get_type(tag), style);
+            append_format(buffer, ".l%" PRIu32 "t%" PRIu32 " {%s}\n", get_layer(tag),
+                          get_type(tag), style);
         }
     } else {
         for (SetItem<Tag>* item = label_tags.next(NULL); item; item = label_tags.next(item)) {
             Tag tag = item->value;
             const char* style = default_svg_label_style(tag);
-            fprintf(out, ".l%" PRIu32 "t%" PRIu32 " {%s}\n", get_layer(tag), get_type(tag), style);
+            append_format(buffer, ".l%" PRIu32 "t%" PRIu32 " {%s}\n", get_layer(tag),
+                          get_type(tag), style);
         }
     }
 
-    fputs("</style>\n", out);
+    append_string(buffer, "</style>\n");
 
     for (MapItem<Cell*>* item = cell_map.next(NULL); item != NULL; item = cell_map.next(item)) {
-        ErrorCode err = item->value->to_svg(out, scaling, precision, NULL, comparison);
+        ErrorCode err =
+            item->value->to_svg(buffer, scaling, precision, NULL, comparison, lod, cache);
+        if (err != ErrorCode::NoError) error_code = err;
+        err = svg_flush(buffer, out, gz_out);
         if (err != ErrorCode::NoError) error_code = err;
     }
 
@@ -983,22 +2351,36 @@ ErrorCode Cell::write_svg(const char* filename, double scaling, uint32_t precisi
     shape_tags.clear();
     label_tags.clear();
 
-    fputs("</defs>\n", out);
+    append_string(buffer, "</defs>\n");
     if (background) {
-        fputs("<rect x=\"", out);
-        fputs(double_print(x, precision, double_buffer, COUNT(double_buffer)), out);
-        fputs("\" y=\"", out);
-        fputs(double_print(y, precision, double_buffer, COUNT(double_buffer)), out);
-        fputs("\" width=\"", out);
-        fputs(double_print(w, precision, double_buffer, COUNT(double_buffer)), out);
-        fputs("\" height=\"", out);
-        fputs(double_print(h, precision, double_buffer, COUNT(double_buffer)), out);
-        fprintf(out, "\" fill=\"%s\" stroke=\"none\"/>\n", background);
-    }
-    ErrorCode err = to_svg(out, scaling, precision, "transform=\"scale(1 -1)\"", comparison);
+        append_string(buffer, "<rect x=\"");
+        append_string(buffer, double_print(x, precision, double_buffer, COUNT(double_buffer)));
+        append_string(buffer, "\" y=\"");
+        append_string(buffer, double_print(y, precision, double_buffer, COUNT(double_buffer)));
+        append_string(buffer, "\" width=\"");
+        append_string(buffer, double_print(w, precision, double_buffer, COUNT(double_buffer)));
+        append_string(buffer, "\" height=\"");
+        append_string(buffer, double_print(h, precision, double_buffer, COUNT(double_buffer)));
+        append_format(buffer, "\" fill=\"%s\" stroke=\"none\"/>\n", background);
+    }
+    ErrorCode err =
+        to_svg(buffer, scaling, precision, "transform=\"scale(1 -1)\"", comparison, lod, cache);
+    if (err != ErrorCode::NoError) error_code = err;
+    append_string(buffer, "</svg>");
+    err = svg_flush(buffer, out, gz_out);
     if (err != ErrorCode::NoError) error_code = err;
-    fputs("</svg>", out);
-    fclose(out);
+    buffer.clear();
+
+    clear_geometry_cache(cache);
+
+    if (compressed) {
+        if (gzclose(gz_out) != Z_OK && error_code != ErrorCode::ZlibError) {
+            if (error_logger) fputs("[GDSTK] Error writing compressed SVG.\n", error_logger);
+            error_code = ErrorCode::ZlibError;
+        }
+    } else {
+        fclose(out);
+    }
     return error_code;
 }
 
@@ -0,0 +1,473 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/connectivity.hpp>
+
+namespace gdstk {
+
+void Net::clear() {
+    for (uint64_t i = 0; i < polygon_array.count; i++) {
+        polygon_array[i]->clear();
+        free_allocation(polygon_array[i]);
+    }
+    polygon_array.clear();
+    for (uint64_t i = 0; i < name_array.count; i++) free_allocation(name_array[i]);
+    name_array.clear();
+}
+
+// Affine transformation (x, y) -> (xx * x + xy * y + x0, yx * x + yy * y + y0)
+struct NetTransform {
+    double xx, xy, yx, yy, x0, y0;
+
+    Vec2 apply(const Vec2 p) const {
+        return Vec2{xx * p.x + xy * p.y + x0, yx * p.x + yy * p.y + y0};
+    }
+};
+
+// Flattened shape with its bounding box and the index of its tag
+struct NetShape {
+    Polygon* polygon;
+    Vec2 min;
+    Vec2 max;
+    uint64_t layer;
+};
+
+// Flattened label position with the index of the conductor tag it names
+struct NetLabel {
+    const char* text;
+    Vec2 position;
+    uint64_t layer;
+};
+
+struct NetState {
+    bool use_window;
+    Vec2 min;
+    Vec2 max;
+    Array<Tag> tags;  // Conductor and via tags
+    const Array<LabelRule>* label_rules;
+    Map<GeometryInfo> cache;
+    Array<NetShape> shapes;
+    Array<NetLabel> labels;
+};
+
+static bool net_find_tag(const Array<Tag>& tags, Tag tag, uint64_t& index) {
+    for (uint64_t i = 0; i < tags.count; i++) {
+        if (tags[i] == tag) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void net_add_polygon(NetState& state, const Polygon* polygon, uint64_t layer,
+                            const NetTransform& t) {
+    const Array<Vec2>& point_array = polygon->point_array;
+    if (point_array.count < 2) return;
+    RepetitionIterator iterator = {};
+    iterator.init(polygon->repetition);
+    Vec2 offset;
+    while (iterator.next(offset)) {
+        Polygon* result = (Polygon*)allocate_clear(sizeof(Polygon));
+        result->tag = polygon->tag;
+        result->point_array.ensure_slots(point_array.count);
+        Vec2 min = {DBL_MAX, DBL_MAX};
+        Vec2 max = {-DBL_MAX, -DBL_MAX};
+        Vec2* src = point_array.items;
+        Vec2* dst = result->point_array.items;
+        for (uint64_t j = point_array.count; j > 0; j--, src++, dst++) {
+            *dst = t.apply(*src + offset);
+            if (dst->x < min.x) min.x = dst->x;
+            if (dst->x > max.x) max.x = dst->x;
+            if (dst->y < min.y) min.y = dst->y;
+            if (dst->y > max.y) max.y = dst->y;
+        }
+        result->point_array.count = point_array.count;
+        if (state.use_window && (max.x < state.min.x || min.x > state.max.x ||
+                                 max.y < state.min.y || min.y > state.max.y)) {
+            result->clear();
+            free_allocation(result);
+            continue;
+        }
+        state.shapes.append(NetShape{result, min, max, layer});
+    }
+}
+
+// Collect the shapes and labels from cell under transform t
+static void net_collect(NetState& state, const Cell* cell, const NetTransform& t) {
+    RepetitionIterator iterator = {};
+    Vec2 offset;
+    uint64_t layer;
+
+    Polygon** polygon = cell->polygon_array.items;
+    for (uint64_t i = cell->polygon_array.count; i > 0; i--, polygon++) {
+        if (net_find_tag(state.tags, (*polygon)->tag, layer)) {
+            net_add_polygon(state, *polygon, layer, t);
+        }
+    }
+
+    Array<Polygon*> path_polygons = {};
+    FlexPath** flexpath = cell->flexpath_array.items;
+    for (uint64_t i = cell->flexpath_array.count; i > 0; i--, flexpath++) {
+        // NOTE: return ErrorCode ignored here
+        (*flexpath)->to_polygons(false, 0, path_polygons);
+    }
+    RobustPath** robustpath = cell->robustpath_array.items;
+    for (uint64_t i = cell->robustpath_array.count; i > 0; i--, robustpath++) {
+        // NOTE: return ErrorCode ignored here
+        (*robustpath)->to_polygons(false, 0, path_polygons);
+    }
+    for (uint64_t i = 0; i < path_polygons.count; i++) {
+        Polygon* path_polygon = path_polygons[i];
+        if (net_find_tag(state.tags, path_polygon->tag, layer)) {
+            net_add_polygon(state, path_polygon, layer, t);
+        }
+        path_polygon->clear();
+        free_allocation(path_polygon);
+    }
+    path_polygons.clear();
+
+    const Array<LabelRule>& label_rules = *state.label_rules;
+    Label** label = cell->label_array.items;
+    for (uint64_t i = cell->label_array.count; i > 0; i--, label++) {
+        const Label* lbl = *label;
+        for (uint64_t j = 0; j < label_rules.count; j++) {
+            if (label_rules[j].label != lbl->tag ||
+                !net_find_tag(state.tags, label_rules[j].conductor, layer))
+                continue;
+            iterator.init(lbl->repetition);
+            while (iterator.next(offset)) {
+                Vec2 position = t.apply(lbl->origin + offset);
+                if (state.use_window &&
+                    (position.x < state.min.x || position.x > state.max.x ||
+                     position.y < state.min.y || position.y > state.max.y))
+                    continue;
+                state.labels.append(NetLabel{lbl->text, position, layer});
+            }
+        }
+    }
+
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+        GeometryInfo info = state.cache.get(ref->cell->name);
+        if (info.bounding_box_min.x > info.bounding_box_max.x) continue;
+
+        double m = ref->magnification;
+        double ca = m * cos(ref->rotation);
+        double sa = m * sin(ref->rotation);
+        double r = ref->x_reflection ? -1 : 1;
+        NetTransform rt = {ca, -r * sa, sa, r * ca, ref->origin.x, ref->origin.y};
+        NetTransform ti = {
+            t.xx * rt.xx + t.xy * rt.yx,          t.xx * rt.xy + t.xy * rt.yy,
+            t.yx * rt.xx + t.yy * rt.yx,          t.yx * rt.xy + t.yy * rt.yy,
+            t.xx * rt.x0 + t.xy * rt.y0 + t.x0, t.yx * rt.x0 + t.yy * rt.y0 + t.y0,
+        };
+
+        iterator.init(ref->repetition);
+        while (iterator.next(offset)) {
+            NetTransform tj = ti;
+            tj.x0 += t.xx * offset.x + t.xy * offset.y;
+            tj.y0 += t.yx * offset.x + t.yy * offset.y;
+            if (state.use_window) {
+                Vec2 corners[] = {info.bounding_box_min,
+                                  Vec2{info.bounding_box_min.x, info.bounding_box_max.y},
+                                  info.bounding_box_max,
+                                  Vec2{info.bounding_box_max.x, info.bounding_box_min.y}};
+                Vec2 min = {DBL_MAX, DBL_MAX};
+                Vec2 max = {-DBL_MAX, -DBL_MAX};
+                for (uint64_t k = 0; k < COUNT(corners); k++) {
+                    Vec2 p = tj.apply(corners[k]);
+                    if (p.x < min.x) min.x = p.x;
+                    if (p.x > max.x) max.x = p.x;
+                    if (p.y < min.y) min.y = p.y;
+                    if (p.y > max.y) max.y = p.y;
+                }
+                if (max.x < state.min.x || min.x > state.max.x || max.y < state.min.y ||
+                    min.y > state.max.y)
+                    continue;
+            }
+            net_collect(state, ref->cell, tj);
+        }
+    }
+}
+
+// Squared distance between point p and segment a–b
+static double net_point_segment_distance_sq(const Vec2 p, const Vec2 a, const Vec2 b) {
+    Vec2 ab = b - a;
+    Vec2 ap = p - a;
+    double len_sq = ab.length_sq();
+    double u = len_sq > 0 ? ap.inner(ab) / len_sq : 0;
+    if (u < 0) {
+        u = 0;
+    } else if (u > 1) {
+        u = 1;
+    }
+    return (ap - ab * u).length_sq();
+}
+
+// Test whether segments a0–a1 and b0–b1 are closer than sqrt(limit_sq)
+static bool net_segments_close(const Vec2 a0, const Vec2 a1, const Vec2 b0, const Vec2 b1,
+                               double limit_sq) {
+    double d0 = (a1 - a0).cross(b0 - a0);
+    double d1 = (a1 - a0).cross(b1 - a0);
+    double d2 = (b1 - b0).cross(a0 - b0);
+    double d3 = (b1 - b0).cross(a1 - b0);
+    if (((d0 < 0 && d1 > 0) || (d0 > 0 && d1 < 0)) && ((d2 < 0 && d3 > 0) || (d2 > 0 && d3 < 0)))
+        return true;
+    return net_point_segment_distance_sq(a0, b0, b1) <= limit_sq ||
+           net_point_segment_distance_sq(a1, b0, b1) <= limit_sq ||
+           net_point_segment_distance_sq(b0, a0, a1) <= limit_sq ||
+           net_point_segment_distance_sq(b1, a0, a1) <= limit_sq;
+}
+
+// Test whether the shapes overlap or are closer than eps.  Only edges close to
+// the bounding box of the other shape are compared.
+static bool net_shapes_touch(const NetShape& s1, const NetShape& s2, double eps) {
+    const Array<Vec2>& p1 = s1.polygon->point_array;
+    const Array<Vec2>& p2 = s2.polygon->point_array;
+    const double limit_sq = eps * eps;
+    Vec2 a0 = p1[p1.count - 1];
+    for (uint64_t i = 0; i < p1.count; i++) {
+        Vec2 a1 = p1[i];
+        Vec2 amin = {a0.x < a1.x ? a0.x : a1.x, a0.y < a1.y ? a0.y : a1.y};
+        Vec2 amax = {a0.x < a1.x ? a1.x : a0.x, a0.y < a1.y ? a1.y : a0.y};
+        if (amax.x + eps >= s2.min.x && amin.x - eps <= s2.max.x && amax.y + eps >= s2.min.y &&
+            amin.y - eps <= s2.max.y) {
+            Vec2 b0 = p2[p2.count - 1];
+            for (uint64_t j = 0; j < p2.count; j++) {
+                Vec2 b1 = p2[j];
+                if ((b0.x < b1.x ? b0.x : b1.x) - eps <= amax.x &&
+                    (b0.x < b1.x ? b1.x : b0.x) + eps >= amin.x &&
+                    (b0.y < b1.y ? b0.y : b1.y) - eps <= amax.y &&
+                    (b0.y < b1.y ? b1.y : b0.y) + eps >= amin.y &&
+                    net_segments_close(a0, a1, b0, b1, limit_sq))
+                    return true;
+                b0 = b1;
+            }
+        }
+        a0 = a1;
+    }
+    return s2.polygon->contain(p1[0]) || s1.polygon->contain(p2[0]);
+}
+
+static uint64_t net_find_root(uint64_t* parent, uint64_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Uniform grid over the shapes, with the list of shapes overlapping each bin
+struct NetGrid {
+    Vec2 origin;
+    Vec2 bin_size;
+    uint64_t columns;
+    uint64_t rows;
+    Array<uint64_t>* bins;
+
+    uint64_t column(double x) const {
+        double c = floor((x - origin.x) / bin_size.x);
+        return c < 0 ? 0 : (c >= columns ? columns - 1 : (uint64_t)c);
+    }
+
+    uint64_t row(double y) const {
+        double r = floor((y - origin.y) / bin_size.y);
+        return r < 0 ? 0 : (r >= rows ? rows - 1 : (uint64_t)r);
+    }
+};
+
+ErrorCode extract_nets(const Cell& cell, const Array<Tag>& conductor_tags,
+                       const Array<ViaRule>& via_rules, const Array<LabelRule>& label_rules,
+                       const Vec2 min, const Vec2 max, double precision, Array<Net>& result) {
+    NetState state = {};
+    state.use_window = min.x <= max.x;
+    state.min = min;
+    state.max = max;
+    state.label_rules = &label_rules;
+    for (uint64_t i = 0; i < conductor_tags.count; i++) {
+        if (!state.tags.contains(conductor_tags[i])) state.tags.append(conductor_tags[i]);
+    }
+    for (uint64_t i = 0; i < via_rules.count; i++) {
+        const ViaRule& rule = via_rules[i];
+        if (!state.tags.contains(rule.via)) state.tags.append(rule.via);
+        if (!state.tags.contains(rule.bottom)) state.tags.append(rule.bottom);
+        if (!state.tags.contains(rule.top)) state.tags.append(rule.top);
+    }
+
+    // Tag pairs that connect
+    const uint64_t layer_count = state.tags.count;
+    uint8_t* connect = (uint8_t*)allocate_clear(layer_count * layer_count);
+    for (uint64_t i = 0; i < conductor_tags.count; i++) {
+        uint64_t c = 0;
+        net_find_tag(state.tags, conductor_tags[i], c);
+        connect[c * layer_count + c] = 1;
+    }
+    for (uint64_t i = 0; i < via_rules.count; i++) {
+        uint64_t v = 0, b = 0, t = 0;
+        net_find_tag(state.tags, via_rules[i].via, v);
+        net_find_tag(state.tags, via_rules[i].bottom, b);
+        net_find_tag(state.tags, via_rules[i].top, t);
+        connect[v * layer_count + v] = 1;
+        connect[v * layer_count + b] = connect[b * layer_count + v] = 1;
+        connect[v * layer_count + t] = connect[t * layer_count + v] = 1;
+    }
+
+    cell.bounding_box(state.cache);
+    net_collect(state, &cell, NetTransform{1, 0, 0, 1, 0, 0});
+    clear_geometry_cache(state.cache);
+
+    const uint64_t count = state.shapes.count;
+    const double eps = 0.5 * precision;
+    uint64_t* parent = (uint64_t*)allocate(count * sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; i++) parent[i] = i;
+
+    NetGrid grid = {};
+    if (count > 0) {
+        Vec2 gmin = {DBL_MAX, DBL_MAX};
+        Vec2 gmax = {-DBL_MAX, -DBL_MAX};
+        NetShape* shape = state.shapes.items;
+        for (uint64_t i = count; i > 0; i--, shape++) {
+            if (shape->min.x < gmin.x) gmin.x = shape->min.x;
+            if (shape->min.y < gmin.y) gmin.y = shape->min.y;
+            if (shape->max.x > gmax.x) gmax.x = shape->max.x;
+            if (shape->max.y > gmax.y) gmax.y = shape->max.y;
+        }
+        // About 8 shapes per bin, assuming uniform distribution
+        uint64_t side = (uint64_t)ceil(sqrt(count / 8.0));
+        if (side > 4096) side = 4096;
+        grid.origin = gmin;
+        grid.columns = side;
+        grid.rows = side;
+        grid.bin_size = Vec2{(gmax.x - gmin.x) / side, (gmax.y - gmin.y) / side};
+        if (grid.bin_size.x <= 0) grid.bin_size.x = 1;
+        if (grid.bin_size.y <= 0) grid.bin_size.y = 1;
+        grid.bins = (Array<uint64_t>*)allocate_clear(side * side * sizeof(Array<uint64_t>));
+        shape = state.shapes.items;
+        for (uint64_t i = 0; i < count; i++, shape++) {
+            uint64_t c1 = grid.column(shape->max.x + eps);
+            uint64_t r1 = grid.row(shape->max.y + eps);
+            for (uint64_t r = grid.row(shape->min.y - eps); r <= r1; r++) {
+                for (uint64_t c = grid.column(shape->min.x - eps); c <= c1; c++) {
+                    grid.bins[r * side + c].append(i);
+                }
+            }
+        }
+
+        // Connected pairs are found in parallel for each bin.  Each pair is
+        // only tested in the bin containing the lower left corner of the
+        // intersection of their bounding boxes.
+        const uint64_t bin_count = side * side;
+        Array<uint64_t>* pairs =
+            (Array<uint64_t>*)allocate_clear(bin_count * sizeof(Array<uint64_t>));
+        GDSTK_PARALLEL_FOR
+        for (int64_t b = 0; b < (int64_t)bin_count; b++) {
+            const Array<uint64_t>& bin = grid.bins[b];
+            for (uint64_t i = 0; i < bin.count; i++) {
+                const NetShape& s1 = state.shapes[bin[i]];
+                for (uint64_t j = i + 1; j < bin.count; j++) {
+                    const NetShape& s2 = state.shapes[bin[j]];
+                    if (!connect[s1.layer * layer_count + s2.layer]) continue;
+                    if (s1.max.x + eps < s2.min.x || s2.max.x + eps < s1.min.x ||
+                        s1.max.y + eps < s2.min.y || s2.max.y + eps < s1.min.y)
+                        continue;
+                    double x = (s1.min.x > s2.min.x ? s1.min.x : s2.min.x) - eps;
+                    double y = (s1.min.y > s2.min.y ? s1.min.y : s2.min.y) - eps;
+                    if (grid.row(y) * grid.columns + grid.column(x) != (uint64_t)b) continue;
+                    if (net_shapes_touch(s1, s2, eps)) {
+                        pairs[b].append(bin[i]);
+                        pairs[b].append(bin[j]);
+                    }
+                }
+            }
+        }
+        for (uint64_t b = 0; b < bin_count; b++) {
+            Array<uint64_t>& bin_pairs = pairs[b];
+            for (uint64_t i = 0; i < bin_pairs.count; i += 2) {
+                uint64_t r0 = net_find_root(parent, bin_pairs[i]);
+                uint64_t r1 = net_find_root(parent, bin_pairs[i + 1]);
+                if (r0 < r1) {
+                    parent[r1] = r0;
+                } else if (r1 < r0) {
+                    parent[r0] = r1;
+                }
+            }
+            bin_pairs.clear();
+        }
+        free_allocation(pairs);
+    }
+
+    // Shape containing each label (count if none)
+    uint64_t* label_shape = (uint64_t*)allocate(state.labels.count * sizeof(uint64_t));
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)state.labels.count; i++) {
+        const NetLabel& label = state.labels[i];
+        label_shape[i] = count;
+        if (count == 0) continue;
+        const Array<uint64_t>& bin =
+            grid.bins[grid.row(label.position.y) * grid.columns + grid.column(label.position.x)];
+        for (uint64_t j = 0; j < bin.count; j++) {
+            const NetShape& shape = state.shapes[bin[j]];
+            if (shape.layer != label.layer || label.position.x < shape.min.x ||
+                label.position.x > shape.max.x || label.position.y < shape.min.y ||
+                label.position.y > shape.max.y || !shape.polygon->contain(label.position))
+                continue;
+            label_shape[i] = bin[j];
+            break;
+        }
+    }
+
+    // Nets are numbered in order of their first shape
+    uint64_t* net_index = (uint64_t*)allocate(count * sizeof(uint64_t));
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t root = net_find_root(parent, i);
+        if (root == i) {
+            net_index[i] = result.count;
+            result.append(Net{});
+        } else {
+            net_index[i] = net_index[root];
+        }
+        result[net_index[i]].polygon_array.append(state.shapes[i].polygon);
+    }
+    for (uint64_t i = 0; i < state.labels.count; i++) {
+        if (label_shape[i] == count) continue;
+        Net& net = result[net_index[label_shape[i]]];
+        const char* text = state.labels[i].text;
+        bool found = false;
+        for (uint64_t j = 0; j < net.name_array.count && !found; j++) {
+            found = strcmp(net.name_array[j], text) == 0;
+        }
+        if (!found) net.name_array.append(copy_string(text, NULL));
+    }
+
+    free_allocation(label_shape);
+    free_allocation(net_index);
+    free_allocation(parent);
+    free_allocation(connect);
+    if (grid.bins) {
+        for (uint64_t i = 0; i < grid.columns * grid.rows; i++) grid.bins[i].clear();
+        free_allocation(grid.bins);
+    }
+    state.tags.clear();
+    state.shapes.clear();
+    state.labels.clear();
+    return ErrorCode::NoError;
+}
+
+}  // namespace gdstk
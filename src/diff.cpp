@@ -0,0 +1,396 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/clipper_tools.hpp>
+#include <gdstk/diff.hpp>
+#include <gdstk/sort.hpp>
+
+namespace gdstk {
+
+void CellDiff::clear() {
+    for (uint64_t i = 0; i < polygon_array.count; i++) {
+        polygon_array[i]->clear();
+        free_allocation(polygon_array[i]);
+    }
+    polygon_array.clear();
+}
+
+struct DiffState {
+    double scaling;
+    double tile_size;
+    Map<uint64_t> hashes1;
+    Map<uint64_t> hashes2;
+    Map<bool> visited;  // Pairs of cells already compared
+};
+
+struct DiffReference {
+    const Reference* reference;
+    uint64_t key;
+    bool matched;
+};
+
+static bool diff_reference_order(const DiffReference& r1, const DiffReference& r2) {
+    return r1.key < r2.key;
+}
+
+// Polygon with its content hash
+struct DiffShape {
+    Polygon* polygon;
+    uint64_t hash;
+};
+
+static bool diff_shape_order(const DiffShape& s1, const DiffShape& s2) {
+    return s1.polygon->tag < s2.polygon->tag ||
+           (s1.polygon->tag == s2.polygon->tag && s1.hash < s2.hash);
+}
+
+// XOR task for a single tag in a single tile.  Shape indices are in
+// increasing order, so their hashes are sorted.
+struct DiffTile {
+    Tag tag;
+    Vec2 min;
+    Vec2 max;
+    bool clip;
+    Array<uint64_t> shapes1;
+    Array<uint64_t> shapes2;
+    Array<Polygon*> result;
+    ErrorCode error_code;
+};
+
+static void diff_shapes(const DiffState& state, Array<Polygon*>& polygons,
+                        Array<DiffShape>& shapes) {
+    shapes.ensure_slots(polygons.count);
+    shapes.count = polygons.count;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)polygons.count; i++) {
+        shapes[i] = DiffShape{polygons[i], polygons[i]->content_hash(state.scaling, Vec2{0, 0})};
+    }
+    sort(shapes, diff_shape_order);
+}
+
+// Append the tiles for the shapes in [start, end) of both arrays, all with
+// the same tag
+static void diff_add_tiles(const DiffState& state, const Array<DiffShape>& shapes1,
+                           uint64_t start1, uint64_t end1, const Array<DiffShape>& shapes2,
+                           uint64_t start2, uint64_t end2, Tag tag, Array<DiffTile>& tiles) {
+    const uint64_t count = end1 - start1 + end2 - start2;
+    Vec2* bb = (Vec2*)allocate(2 * count * sizeof(Vec2));
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    uint64_t k = 0;
+    for (uint64_t i = start1; i < end1; i++, k++) {
+        shapes1[i].polygon->bounding_box(bb[2 * k], bb[2 * k + 1]);
+    }
+    for (uint64_t i = start2; i < end2; i++, k++) {
+        shapes2[i].polygon->bounding_box(bb[2 * k], bb[2 * k + 1]);
+    }
+    for (k = 0; k < count; k++) {
+        if (bb[2 * k].x < min.x) min.x = bb[2 * k].x;
+        if (bb[2 * k].y < min.y) min.y = bb[2 * k].y;
+        if (bb[2 * k + 1].x > max.x) max.x = bb[2 * k + 1].x;
+        if (bb[2 * k + 1].y > max.y) max.y = bb[2 * k + 1].y;
+    }
+
+    uint64_t columns;
+    uint64_t rows;
+    if (state.tile_size > 0) {
+        columns = 1 + (uint64_t)((max.x - min.x) / state.tile_size);
+        rows = 1 + (uint64_t)((max.y - min.y) / state.tile_size);
+    } else {
+        // About 256 polygons per tile, assuming uniform distribution
+        columns = (uint64_t)ceil(sqrt(count / 256.0));
+        if (columns < 1) columns = 1;
+        rows = columns;
+    }
+    if (columns > 1024) columns = 1024;
+    if (rows > 1024) rows = 1024;
+    const Vec2 size = {(max.x - min.x) / columns, (max.y - min.y) / rows};
+    const bool clip = columns * rows > 1;
+
+    const uint64_t first = tiles.count;
+    tiles.ensure_slots(columns * rows);
+    for (uint64_t r = 0; r < rows; r++) {
+        for (uint64_t c = 0; c < columns; c++) {
+            DiffTile* tile = tiles.items + tiles.count++;
+            memset(tile, 0, sizeof(DiffTile));
+            tile->tag = tag;
+            tile->min = Vec2{min.x + c * size.x, min.y + r * size.y};
+            tile->max = Vec2{c + 1 == columns ? max.x : min.x + (c + 1) * size.x,
+                             r + 1 == rows ? max.y : min.y + (r + 1) * size.y};
+            tile->clip = clip;
+        }
+    }
+
+    k = 0;
+    for (uint64_t i = start1; i < end1 + end2 - start2; i++, k++) {
+        bool first_set = i < end1;
+        uint64_t index = first_set ? i : start2 + i - end1;
+        uint64_t c0 = 0, c1 = 0, r0 = 0, r1 = 0;
+        if (clip) {
+            double x0 = floor((bb[2 * k].x - min.x) / size.x);
+            double x1 = floor((bb[2 * k + 1].x - min.x) / size.x);
+            double y0 = floor((bb[2 * k].y - min.y) / size.y);
+            double y1 = floor((bb[2 * k + 1].y - min.y) / size.y);
+            c0 = x0 < 0 || size.x <= 0 ? 0 : (x0 >= columns ? columns - 1 : (uint64_t)x0);
+            c1 = x1 < 0 || size.x <= 0 ? 0 : (x1 >= columns ? columns - 1 : (uint64_t)x1);
+            r0 = y0 < 0 || size.y <= 0 ? 0 : (y0 >= rows ? rows - 1 : (uint64_t)y0);
+            r1 = y1 < 0 || size.y <= 0 ? 0 : (y1 >= rows ? rows - 1 : (uint64_t)y1);
+        }
+        for (uint64_t r = r0; r <= r1; r++) {
+            for (uint64_t c = c0; c <= c1; c++) {
+                DiffTile* tile = tiles.items + first + r * columns + c;
+                (first_set ? tile->shapes1 : tile->shapes2).append(index);
+            }
+        }
+    }
+    free_allocation(bb);
+}
+
+static void diff_tile(const DiffState& state, const Array<DiffShape>& shapes1,
+                      const Array<DiffShape>& shapes2, DiffTile& tile) {
+    if (tile.shapes1.count == tile.shapes2.count) {
+        bool equal = true;
+        for (uint64_t i = 0; i < tile.shapes1.count && equal; i++) {
+            equal = shapes1[tile.shapes1[i]].hash == shapes2[tile.shapes2[i]].hash;
+        }
+        if (equal) return;
+    }
+
+    Array<Polygon*> polygons1 = {};
+    Array<Polygon*> polygons2 = {};
+    polygons1.ensure_slots(tile.shapes1.count);
+    for (uint64_t i = 0; i < tile.shapes1.count; i++) {
+        polygons1.append_unsafe(shapes1[tile.shapes1[i]].polygon);
+    }
+    polygons2.ensure_slots(tile.shapes2.count);
+    for (uint64_t i = 0; i < tile.shapes2.count; i++) {
+        polygons2.append_unsafe(shapes2[tile.shapes2[i]].polygon);
+    }
+
+    if (tile.clip) {
+        Array<Polygon*> xor_result = {};
+        tile.error_code = boolean(polygons1, polygons2, Operation::Xor, state.scaling, xor_result);
+        Polygon window = rectangle(tile.min, tile.max, 0);
+        ErrorCode error_code =
+            boolean(xor_result, window, Operation::And, state.scaling, tile.result);
+        if (error_code != ErrorCode::NoError) tile.error_code = error_code;
+        window.clear();
+        for (uint64_t i = 0; i < xor_result.count; i++) {
+            xor_result[i]->clear();
+            free_allocation(xor_result[i]);
+        }
+        xor_result.clear();
+    } else {
+        tile.error_code = boolean(polygons1, polygons2, Operation::Xor, state.scaling, tile.result);
+    }
+    for (uint64_t i = 0; i < tile.result.count; i++) tile.result[i]->tag = tile.tag;
+    polygons1.clear();
+    polygons2.clear();
+}
+
+// XOR the polygons in each layer, appending the differences to result
+static ErrorCode diff_xor(const DiffState& state, Array<Polygon*>& polygons1,
+                          Array<Polygon*>& polygons2, Array<Polygon*>& result) {
+    Array<DiffShape> shapes1 = {};
+    Array<DiffShape> shapes2 = {};
+    diff_shapes(state, polygons1, shapes1);
+    diff_shapes(state, polygons2, shapes2);
+
+    Array<DiffTile> tiles = {};
+    uint64_t i1 = 0;
+    uint64_t i2 = 0;
+    while (i1 < shapes1.count || i2 < shapes2.count) {
+        Tag tag;
+        if (i2 == shapes2.count ||
+            (i1 < shapes1.count && shapes1[i1].polygon->tag < shapes2[i2].polygon->tag)) {
+            tag = shapes1[i1].polygon->tag;
+        } else {
+            tag = shapes2[i2].polygon->tag;
+        }
+        uint64_t end1 = i1;
+        while (end1 < shapes1.count && shapes1[end1].polygon->tag == tag) end1++;
+        uint64_t end2 = i2;
+        while (end2 < shapes2.count && shapes2[end2].polygon->tag == tag) end2++;
+        diff_add_tiles(state, shapes1, i1, end1, shapes2, i2, end2, tag, tiles);
+        i1 = end1;
+        i2 = end2;
+    }
+
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)tiles.count; i++) {
+        diff_tile(state, shapes1, shapes2, tiles[i]);
+    }
+
+    ErrorCode error_code = ErrorCode::NoError;
+    for (uint64_t i = 0; i < tiles.count; i++) {
+        DiffTile& tile = tiles[i];
+        if (tile.error_code != ErrorCode::NoError) error_code = tile.error_code;
+        result.extend(tile.result);
+        tile.result.clear();
+        tile.shapes1.clear();
+        tile.shapes2.clear();
+    }
+    tiles.clear();
+    shapes1.clear();
+    shapes2.clear();
+    return error_code;
+}
+
+static void diff_references(const Cell& cell, double scaling, Map<uint64_t>& cache,
+                            Array<DiffReference>& result) {
+    result.ensure_slots(cell.reference_array.count);
+    Reference** reference = cell.reference_array.items;
+    for (uint64_t i = cell.reference_array.count; i > 0; i--, reference++) {
+        result.append_unsafe(
+            DiffReference{*reference, (*reference)->content_hash(scaling, cache), false});
+    }
+    sort(result, diff_reference_order);
+}
+
+// Mark the unmatched references with the same keys in both arrays (sorted by
+// key) as matched.  If pairs is not NULL, matched references are appended to
+// it in pairs.
+static void diff_match(Array<DiffReference>& refs1, Array<DiffReference>& refs2,
+                       Array<const Reference*>* pairs) {
+    uint64_t i1 = 0;
+    uint64_t i2 = 0;
+    while (i1 < refs1.count && i2 < refs2.count) {
+        if (refs1[i1].matched) {
+            i1++;
+        } else if (refs2[i2].matched) {
+            i2++;
+        } else if (refs1[i1].key < refs2[i2].key) {
+            i1++;
+        } else if (refs2[i2].key < refs1[i1].key) {
+            i2++;
+        } else {
+            refs1[i1].matched = true;
+            refs2[i2].matched = true;
+            if (pairs) {
+                pairs->append(refs1[i1].reference);
+                pairs->append(refs2[i2].reference);
+            }
+            i1++;
+            i2++;
+        }
+    }
+}
+
+// Rekey unmatched references by their placement and referenced cell name
+static void diff_rekey(Array<DiffReference>& refs, double scaling) {
+    DiffReference* ref = refs.items;
+    for (uint64_t i = refs.count; i > 0; i--, ref++) {
+        if (ref->matched) continue;
+        if (ref->reference->type == ReferenceType::Cell) {
+            ref->key = hash_combine(ref->reference->placement_hash(scaling, Vec2{0, 0}),
+                                    hash((const char*)ref->reference->cell->name));
+        } else {
+            // References to rawcells or by name cannot be compared recursively
+            ref->key = 0;
+        }
+    }
+    sort(refs, diff_reference_order);
+}
+
+static void diff_flatten(const Array<DiffReference>& refs, Array<Polygon*>& result) {
+    const DiffReference* ref = refs.items;
+    for (uint64_t i = refs.count; i > 0; i--, ref++) {
+        if (!ref->matched && ref->reference->type == ReferenceType::Cell) {
+            ref->reference->get_polygons(true, true, -1, false, 0, result);
+        }
+    }
+}
+
+static ErrorCode diff_pair(DiffState& state, const Cell& cell1, const Cell& cell2,
+                           Array<CellDiff>& result) {
+    if (cell1.content_hash(state.scaling, state.hashes1) ==
+        cell2.content_hash(state.scaling, state.hashes2))
+        return ErrorCode::NoError;
+
+    uint64_t len1 = strlen(cell1.name);
+    uint64_t len2 = strlen(cell2.name);
+    char* key = (char*)allocate(len1 + len2 + 2);
+    memcpy(key, cell1.name, len1);
+    key[len1] = '\n';
+    memcpy(key + len1 + 1, cell2.name, len2 + 1);
+    bool visited = state.visited.get(key);
+    if (!visited) state.visited.set(key, true);
+    free_allocation(key);
+    if (visited) return ErrorCode::NoError;
+
+    ErrorCode error_code = ErrorCode::NoError;
+    Array<DiffReference> refs1 = {};
+    Array<DiffReference> refs2 = {};
+    diff_references(cell1, state.scaling, state.hashes1, refs1);
+    diff_references(cell2, state.scaling, state.hashes2, refs2);
+    diff_match(refs1, refs2, NULL);
+    diff_rekey(refs1, state.scaling);
+    diff_rekey(refs2, state.scaling);
+    // Skip the references that cannot be compared
+    for (uint64_t i = 0; i < refs1.count && refs1[i].key == 0; i++) refs1[i].matched = true;
+    for (uint64_t i = 0; i < refs2.count && refs2[i].key == 0; i++) refs2[i].matched = true;
+    Array<const Reference*> pairs = {};
+    diff_match(refs1, refs2, &pairs);
+
+    Array<Polygon*> polygons1 = {};
+    Array<Polygon*> polygons2 = {};
+    cell1.get_polygons(true, true, 0, false, 0, polygons1);
+    cell2.get_polygons(true, true, 0, false, 0, polygons2);
+    diff_flatten(refs1, polygons1);
+    diff_flatten(refs2, polygons2);
+    refs1.clear();
+    refs2.clear();
+
+    CellDiff cell_diff = {&cell1, &cell2};
+    error_code = diff_xor(state, polygons1, polygons2, cell_diff.polygon_array);
+    for (uint64_t i = 0; i < polygons1.count; i++) {
+        polygons1[i]->clear();
+        free_allocation(polygons1[i]);
+    }
+    polygons1.clear();
+    for (uint64_t i = 0; i < polygons2.count; i++) {
+        polygons2[i]->clear();
+        free_allocation(polygons2[i]);
+    }
+    polygons2.clear();
+    if (cell_diff.polygon_array.count > 0) {
+        result.append(cell_diff);
+    } else {
+        cell_diff.clear();
+    }
+
+    for (uint64_t i = 0; i < pairs.count; i += 2) {
+        ErrorCode err = diff_pair(state, *pairs[i]->cell, *pairs[i + 1]->cell, result);
+        if (err != ErrorCode::NoError) error_code = err;
+    }
+    pairs.clear();
+    return error_code;
+}
+
+ErrorCode diff_cells(const Cell& cell1, const Cell& cell2, double precision, double tile_size,
+                     Array<CellDiff>& result) {
+    DiffState state = {};
+    state.scaling = 1 / precision;
+    state.tile_size = tile_size;
+    ErrorCode error_code = diff_pair(state, cell1, cell2, result);
+    state.hashes1.clear();
+    state.hashes2.clear();
+    state.visited.clear();
+    return error_code;
+}
+
+}  // namespace gdstk
@@ -0,0 +1,549 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/clipper_tools.hpp>
+#include <gdstk/drc.hpp>
+#include <gdstk/sort.hpp>
+
+namespace gdstk {
+
+// Polygon edge oriented with the polygon interior to its left
+struct DrcEdge {
+    Vec2 p0;
+    Vec2 p1;
+};
+
+struct DrcState {
+    const Array<DrcRule>* rules;
+    Array<Tag> tags;  // All tags used in the rules
+    double scaling;
+    double margin;  // Largest rule value
+    Map<GeometryInfo> cache;
+    Map<Array<Polygon*>*> results;  // Markers for each checked cell
+};
+
+// Uniform grid over a set of bounding boxes
+struct DrcGrid {
+    Vec2 origin;
+    Vec2 bin_size;
+    uint64_t columns;
+    uint64_t rows;
+    Array<uint64_t>* bins;
+
+    void init(const Vec2 min, const Vec2 max, uint64_t count, double min_bin_size) {
+        origin = min;
+        // About 8 items per bin, assuming uniform distribution
+        uint64_t side = (uint64_t)ceil(sqrt(count / 8.0));
+        if (side > 4096) side = 4096;
+        if (side < 1) side = 1;
+        columns = side;
+        rows = side;
+        Vec2 size = max - min;
+        if (min_bin_size > 0) {
+            if (size.x / columns < min_bin_size) columns = 1 + (uint64_t)(size.x / min_bin_size);
+            if (size.y / rows < min_bin_size) rows = 1 + (uint64_t)(size.y / min_bin_size);
+        }
+        bin_size = Vec2{size.x / columns, size.y / rows};
+        if (bin_size.x <= 0) bin_size.x = 1;
+        if (bin_size.y <= 0) bin_size.y = 1;
+        bins = (Array<uint64_t>*)allocate_clear(columns * rows * sizeof(Array<uint64_t>));
+    }
+
+    uint64_t column(double x) const {
+        double c = floor((x - origin.x) / bin_size.x);
+        return c < 0 ? 0 : (c >= columns ? columns - 1 : (uint64_t)c);
+    }
+
+    uint64_t row(double y) const {
+        double r = floor((y - origin.y) / bin_size.y);
+        return r < 0 ? 0 : (r >= rows ? rows - 1 : (uint64_t)r);
+    }
+
+    void insert(uint64_t index, const Vec2 min, const Vec2 max) {
+        uint64_t c1 = column(max.x);
+        uint64_t r1 = row(max.y);
+        for (uint64_t r = row(min.y); r <= r1; r++) {
+            for (uint64_t c = column(min.x); c <= c1; c++) bins[r * columns + c].append(index);
+        }
+    }
+
+    void clear() {
+        for (uint64_t i = 0; i < columns * rows; i++) bins[i].clear();
+        free_allocation(bins);
+        bins = NULL;
+    }
+};
+
+static bool drc_point_order(const Vec2 a, const Vec2 b) {
+    return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+// Edges are sorted by their lexicographically smaller end point, then larger
+static bool drc_edge_order(const DrcEdge& e1, const DrcEdge& e2) {
+    bool s1 = drc_point_order(e1.p0, e1.p1);
+    bool s2 = drc_point_order(e2.p0, e2.p1);
+    Vec2 a1 = s1 ? e1.p0 : e1.p1;
+    Vec2 a2 = s2 ? e2.p0 : e2.p1;
+    if (a1 != a2) return drc_point_order(a1, a2);
+    Vec2 b1 = s1 ? e1.p1 : e1.p0;
+    Vec2 b2 = s2 ? e2.p1 : e2.p0;
+    return drc_point_order(b1, b2);
+}
+
+// Oriented edges from merged polygons.  Pairs of coincident edges with
+// opposite directions, created by linking holes to their outer boundaries,
+// are removed.
+static void drc_edges(const Array<Polygon*>& polygons, Array<DrcEdge>& edges) {
+    Array<DrcEdge> all = {};
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        const Array<Vec2>& points = polygons[i]->point_array;
+        if (points.count < 3) continue;
+        bool reverse = polygons[i]->signed_area() < 0;
+        all.ensure_slots(points.count);
+        Vec2 v0 = points[points.count - 1];
+        for (uint64_t j = 0; j < points.count; j++) {
+            Vec2 v1 = points[j];
+            if (v0 != v1) all.append_unsafe(reverse ? DrcEdge{v1, v0} : DrcEdge{v0, v1});
+            v0 = v1;
+        }
+    }
+    sort(all, drc_edge_order);
+    edges.ensure_slots(all.count);
+    for (uint64_t i = 0; i < all.count; i++) {
+        if (i + 1 < all.count && all[i].p0 == all[i + 1].p1 && all[i].p1 == all[i + 1].p0) {
+            i++;
+            continue;
+        }
+        edges.append_unsafe(all[i]);
+    }
+    all.clear();
+}
+
+// Clip segment p0–p1 to the half-plane (x - origin)·normal > 0 (or >= 0 if
+// closed).  Return false if nothing is left.
+static bool drc_clip(Vec2& p0, Vec2& p1, const Vec2 origin, const Vec2 normal, bool closed) {
+    double f0 = (p0 - origin).inner(normal);
+    double f1 = (p1 - origin).inner(normal);
+    if (closed ? (f0 < 0 && f1 < 0) : (f0 <= 0 && f1 <= 0)) return false;
+    if (f0 < 0) {
+        p0 = p0 + (p1 - p0) * (f0 / (f0 - f1));
+    } else if (f1 < 0) {
+        p1 = p1 + (p0 - p1) * (f1 / (f1 - f0));
+    }
+    return true;
+}
+
+// Squared distance between point p and segment a–b
+static double drc_point_segment_distance_sq(const Vec2 p, const Vec2 a, const Vec2 b) {
+    Vec2 ab = b - a;
+    Vec2 ap = p - a;
+    double len_sq = ab.length_sq();
+    double u = len_sq > 0 ? ap.inner(ab) / len_sq : 0;
+    if (u < 0) {
+        u = 0;
+    } else if (u > 1) {
+        u = 1;
+    }
+    return (ap - ab * u).length_sq();
+}
+
+static double drc_segment_distance_sq(const Vec2 a0, const Vec2 a1, const Vec2 b0, const Vec2 b1) {
+    double d0 = (a1 - a0).cross(b0 - a0);
+    double d1 = (a1 - a0).cross(b1 - a0);
+    double d2 = (b1 - b0).cross(a0 - b0);
+    double d3 = (b1 - b0).cross(a1 - b0);
+    if (((d0 < 0 && d1 > 0) || (d0 > 0 && d1 < 0)) && ((d2 < 0 && d3 > 0) || (d2 > 0 && d3 < 0)))
+        return 0;
+    double d = drc_point_segment_distance_sq(a0, b0, b1);
+    double t = drc_point_segment_distance_sq(a1, b0, b1);
+    if (t < d) d = t;
+    t = drc_point_segment_distance_sq(b0, a0, a1);
+    if (t < d) d = t;
+    t = drc_point_segment_distance_sq(b1, a0, a1);
+    if (t < d) d = t;
+    return d;
+}
+
+// Test the edge pair for a width, spacing or enclosure (e1 is inner, e2 is
+// outer) violation.  If found, the marker quadrilateral is returned in quad.
+static bool drc_test_pair(const DrcEdge& e1, const DrcEdge& e2, DrcCheck check, double value,
+                          Vec2* quad) {
+    const Vec2 d1 = e1.p1 - e1.p0;
+    const Vec2 d2 = e2.p1 - e2.p0;
+    const double dot = d1.inner(d2);
+    Vec2 n1 = d1.ortho();
+    Vec2 n2 = d2.ortho();
+    bool closed = false;
+    if (check == DrcCheck::Enclosure) {
+        if (dot <= 0) return false;
+        n1 = -n1;
+        closed = true;
+    } else {
+        if (dot >= 0 || e1.p0 == e2.p1 || e1.p1 == e2.p0) return false;
+        if (check == DrcCheck::Spacing) {
+            n1 = -n1;
+            n2 = -n2;
+        }
+    }
+    Vec2 a0 = e1.p0, a1 = e1.p1, b0 = e2.p0, b1 = e2.p1;
+    if (!drc_clip(b0, b1, e1.p0, n1, closed) || !drc_clip(a0, a1, e2.p0, n2, closed)) return false;
+    // Limit each segment to the band along the other edge, extended by value
+    const Vec2 u1 = d1 * (1 / d1.length());
+    const Vec2 u2 = d2 * (1 / d2.length());
+    if (!drc_clip(b0, b1, e1.p0 - u1 * value, u1, true) ||
+        !drc_clip(b0, b1, e1.p1 + u1 * value, -u1, true) ||
+        !drc_clip(a0, a1, e2.p0 - u2 * value, u2, true) ||
+        !drc_clip(a0, a1, e2.p1 + u2 * value, -u2, true))
+        return false;
+    if (drc_segment_distance_sq(a0, a1, b0, b1) >= value * value) return false;
+    quad[0] = a0;
+    quad[1] = a1;
+    if (dot > 0) {
+        quad[2] = b1;
+        quad[3] = b0;
+    } else {
+        quad[2] = b0;
+        quad[3] = b1;
+    }
+    return true;
+}
+
+// Edge-pair search between edges1 and edges2 (or within edges1, if same).
+// Each pair is tested once, in the grid bin containing the lower left corner
+// of the intersection of their grown bounding boxes.
+static void drc_edge_pairs(const Array<DrcEdge>& edges1, const Array<DrcEdge>& edges2, bool same,
+                           DrcCheck check, double value, Tag tag, Array<Polygon*>& result) {
+    const uint64_t count1 = edges1.count;
+    const uint64_t count = same ? count1 : count1 + edges2.count;
+    if (count1 == 0 || (!same && count == count1)) return;
+
+    const double half = 0.5 * value;
+    Vec2* bb = (Vec2*)allocate(2 * count * sizeof(Vec2));
+    Vec2 gmin = {DBL_MAX, DBL_MAX};
+    Vec2 gmax = {-DBL_MAX, -DBL_MAX};
+    for (uint64_t i = 0; i < count; i++) {
+        const DrcEdge& e = i < count1 ? edges1[i] : edges2[i - count1];
+        Vec2 min = {e.p0.x < e.p1.x ? e.p0.x : e.p1.x, e.p0.y < e.p1.y ? e.p0.y : e.p1.y};
+        Vec2 max = {e.p0.x < e.p1.x ? e.p1.x : e.p0.x, e.p0.y < e.p1.y ? e.p1.y : e.p0.y};
+        min = min - half;
+        max = max + half;
+        bb[2 * i] = min;
+        bb[2 * i + 1] = max;
+        if (min.x < gmin.x) gmin.x = min.x;
+        if (min.y < gmin.y) gmin.y = min.y;
+        if (max.x > gmax.x) gmax.x = max.x;
+        if (max.y > gmax.y) gmax.y = max.y;
+    }
+    DrcGrid grid = {};
+    grid.init(gmin, gmax, count, value);
+    for (uint64_t i = 0; i < count; i++) grid.insert(i, bb[2 * i], bb[2 * i + 1]);
+
+    const uint64_t bin_count = grid.columns * grid.rows;
+    Array<Polygon*>* bin_markers =
+        (Array<Polygon*>*)allocate_clear(bin_count * sizeof(Array<Polygon*>));
+    GDSTK_PARALLEL_FOR
+    for (int64_t b = 0; b < (int64_t)bin_count; b++) {
+        const Array<uint64_t>& bin = grid.bins[b];
+        for (uint64_t i = 0; i < bin.count; i++) {
+            const uint64_t i1 = bin[i];
+            if (i1 >= count1) continue;
+            for (uint64_t j = same ? i + 1 : 0; j < bin.count; j++) {
+                const uint64_t i2 = bin[j];
+                if (!same && i2 < count1) continue;
+                const Vec2 min1 = bb[2 * i1], max1 = bb[2 * i1 + 1];
+                const Vec2 min2 = bb[2 * i2], max2 = bb[2 * i2 + 1];
+                if (max1.x < min2.x || max2.x < min1.x || max1.y < min2.y || max2.y < min1.y)
+                    continue;
+                double x = min1.x > min2.x ? min1.x : min2.x;
+                double y = min1.y > min2.y ? min1.y : min2.y;
+                if (grid.row(y) * grid.columns + grid.column(x) != (uint64_t)b) continue;
+                const DrcEdge& e2 = i2 < count1 ? edges1[i2] : edges2[i2 - count1];
+                Vec2 quad[4];
+                if (!drc_test_pair(edges1[i1], e2, check, value, quad)) continue;
+                Polygon* marker = (Polygon*)allocate_clear(sizeof(Polygon));
+                marker->tag = tag;
+                marker->point_array.ensure_slots(4);
+                for (uint64_t k = 0; k < 4; k++) marker->point_array.append_unsafe(quad[k]);
+                bin_markers[b].append(marker);
+            }
+        }
+    }
+    for (uint64_t b = 0; b < bin_count; b++) {
+        result.extend(bin_markers[b]);
+        bin_markers[b].clear();
+    }
+    free_allocation(bin_markers);
+    free_allocation(bb);
+    grid.clear();
+}
+
+// Check the rules on the polygons in by_tag (one array for each tag in
+// state.tags), appending the markers to result
+static ErrorCode drc_check_flat(const DrcState& state, const Array<Polygon*>* by_tag,
+                                Array<Polygon*>* result) {
+    ErrorCode error_code = ErrorCode::NoError;
+    const Array<DrcRule>& rules = *state.rules;
+    const uint64_t tag_count = state.tags.count;
+    Array<Polygon*>* merged = (Array<Polygon*>*)allocate_clear(tag_count * sizeof(Array<Polygon*>));
+    Array<DrcEdge>* edges = (Array<DrcEdge>*)allocate_clear(tag_count * sizeof(Array<DrcEdge>));
+    ErrorCode* errors = (ErrorCode*)allocate_clear(tag_count * sizeof(ErrorCode));
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)tag_count; i++) {
+        if (by_tag[i].count == 0) continue;
+        errors[i] = merge(by_tag[i], state.scaling, merged[i]);
+        drc_edges(merged[i], edges[i]);
+    }
+    for (uint64_t i = 0; i < tag_count; i++) {
+        if (errors[i] != ErrorCode::NoError) error_code = errors[i];
+    }
+    free_allocation(errors);
+
+    for (uint64_t r = 0; r < rules.count; r++) {
+        const DrcRule& rule = rules[r];
+        uint64_t t1 = 0, t2 = 0;
+        while (state.tags[t1] != rule.tag1) t1++;
+        if (rule.check == DrcCheck::Spacing || rule.check == DrcCheck::Enclosure) {
+            while (state.tags[t2] != rule.tag2) t2++;
+        }
+        switch (rule.check) {
+            case DrcCheck::Width:
+                drc_edge_pairs(edges[t1], edges[t1], true, rule.check, rule.value, rule.tag1,
+                               result[r]);
+                break;
+            case DrcCheck::Spacing:
+                drc_edge_pairs(edges[t1], edges[t2], t1 == t2, rule.check, rule.value, rule.tag1,
+                               result[r]);
+                break;
+            case DrcCheck::Enclosure: {
+                drc_edge_pairs(edges[t2], edges[t1], false, rule.check, rule.value, rule.tag1,
+                               result[r]);
+                uint64_t start = result[r].count;
+                ErrorCode err =
+                    boolean(merged[t2], merged[t1], Operation::Not, state.scaling, result[r]);
+                if (err != ErrorCode::NoError) error_code = err;
+                for (uint64_t i = start; i < result[r].count; i++) result[r][i]->tag = rule.tag1;
+            } break;
+            case DrcCheck::Area: {
+                const Array<Polygon*>& polygons = merged[t1];
+                for (uint64_t i = 0; i < polygons.count; i++) {
+                    if (polygons[i]->area() >= rule.value) continue;
+                    Polygon* marker = (Polygon*)allocate_clear(sizeof(Polygon));
+                    marker->copy_from(*polygons[i]);
+                    marker->tag = rule.tag1;
+                    result[r].append(marker);
+                }
+            } break;
+        }
+    }
+
+    for (uint64_t i = 0; i < tag_count; i++) {
+        for (uint64_t j = 0; j < merged[i].count; j++) {
+            merged[i][j]->clear();
+            free_allocation(merged[i][j]);
+        }
+        merged[i].clear();
+        edges[i].clear();
+    }
+    free_allocation(merged);
+    free_allocation(edges);
+    return error_code;
+}
+
+// Reference instance (repetition offset applied) with its bounding box
+struct DrcInstance {
+    const Reference* reference;
+    Vec2 offset;
+    Vec2 min;
+    Vec2 max;
+    bool isolated;
+};
+
+// Check cell hierarchically.  The result is cached in state.results.
+static ErrorCode drc_cell(DrcState& state, const Cell* cell, Array<Polygon*>*& result) {
+    result = state.results.get(cell->name);
+    if (result) return ErrorCode::NoError;
+
+    ErrorCode error_code = ErrorCode::NoError;
+    const uint64_t rule_count = state.rules->count;
+    const uint64_t tag_count = state.tags.count;
+    Array<Polygon*>* by_tag = (Array<Polygon*>*)allocate_clear(tag_count * sizeof(Array<Polygon*>));
+    for (uint64_t i = 0; i < tag_count; i++) {
+        cell->get_polygons(true, true, 0, true, state.tags[i], by_tag[i]);
+    }
+
+    Array<DrcInstance> instances = {};
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+        Reference instance = *ref;
+        instance.repetition = Repetition{RepetitionType::None};
+        Vec2 min, max;
+        instance.bounding_box(min, max, state.cache);
+        if (min.x > max.x) continue;
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        // Rule values are not scaled, so magnified instances are never
+        // isolated (they can't reuse the result of the referenced cell).
+        const bool isolated = ref->magnification == 1;
+        instances.ensure_slots(iterator.count);
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            instances.append_unsafe(DrcInstance{ref, offset, min + offset, max + offset, isolated});
+        }
+    }
+
+    // Instances are isolated if their bounding boxes grown by the margin do
+    // not overlap any other geometry in the cell.
+    if (instances.count > 0) {
+        uint64_t own_count = 0;
+        for (uint64_t i = 0; i < tag_count; i++) own_count += by_tag[i].count;
+        const uint64_t count = instances.count + own_count;
+        Vec2* bb = (Vec2*)allocate(2 * count * sizeof(Vec2));
+        Vec2 gmin = {DBL_MAX, DBL_MAX};
+        Vec2 gmax = {-DBL_MAX, -DBL_MAX};
+        uint64_t k = 0;
+        for (uint64_t i = 0; i < instances.count; i++, k++) {
+            bb[2 * k] = instances[i].min;
+            bb[2 * k + 1] = instances[i].max;
+        }
+        for (uint64_t i = 0; i < tag_count; i++) {
+            for (uint64_t j = 0; j < by_tag[i].count; j++, k++) {
+                by_tag[i][j]->bounding_box(bb[2 * k], bb[2 * k + 1]);
+            }
+        }
+        for (k = 0; k < count; k++) {
+            if (bb[2 * k].x < gmin.x) gmin.x = bb[2 * k].x;
+            if (bb[2 * k].y < gmin.y) gmin.y = bb[2 * k].y;
+            if (bb[2 * k + 1].x > gmax.x) gmax.x = bb[2 * k + 1].x;
+            if (bb[2 * k + 1].y > gmax.y) gmax.y = bb[2 * k + 1].y;
+        }
+        DrcGrid grid = {};
+        grid.init(gmin, gmax, count, 0);
+        for (k = 0; k < count; k++) grid.insert(k, bb[2 * k], bb[2 * k + 1]);
+        const double margin = state.margin;
+        GDSTK_PARALLEL_FOR
+        for (int64_t i = 0; i < (int64_t)instances.count; i++) {
+            DrcInstance& instance = instances[i];
+            Vec2 min = instance.min - margin;
+            Vec2 max = instance.max + margin;
+            uint64_t c1 = grid.column(max.x);
+            uint64_t r1 = grid.row(max.y);
+            for (uint64_t r = grid.row(min.y); r <= r1 && instance.isolated; r++) {
+                for (uint64_t c = grid.column(min.x); c <= c1 && instance.isolated; c++) {
+                    const Array<uint64_t>& bin = grid.bins[r * grid.columns + c];
+                    for (uint64_t j = 0; j < bin.count; j++) {
+                        uint64_t other = bin[j];
+                        if (other == (uint64_t)i) continue;
+                        if (bb[2 * other].x < max.x && bb[2 * other + 1].x > min.x &&
+                            bb[2 * other].y < max.y && bb[2 * other + 1].y > min.y) {
+                            instance.isolated = false;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        grid.clear();
+        free_allocation(bb);
+    }
+
+    result = (Array<Polygon*>*)allocate_clear(rule_count * sizeof(Array<Polygon*>));
+    for (uint64_t i = 0; i < instances.count; i++) {
+        const DrcInstance& instance = instances[i];
+        const Reference* ref = instance.reference;
+        if (instance.isolated) {
+            Array<Polygon*>* child;
+            ErrorCode err = drc_cell(state, ref->cell, child);
+            if (err != ErrorCode::NoError) error_code = err;
+            for (uint64_t r = 0; r < rule_count; r++) {
+                result[r].ensure_slots(child[r].count);
+                for (uint64_t j = 0; j < child[r].count; j++) {
+                    Polygon* marker = (Polygon*)allocate_clear(sizeof(Polygon));
+                    marker->copy_from(*child[r][j]);
+                    marker->transform(ref->magnification, ref->x_reflection, ref->rotation,
+                                      ref->origin + instance.offset);
+                    result[r].append_unsafe(marker);
+                }
+            }
+        } else {
+            Reference flat = *ref;
+            flat.repetition = Repetition{RepetitionType::None};
+            flat.origin = ref->origin + instance.offset;
+            for (uint64_t t = 0; t < tag_count; t++) {
+                flat.get_polygons(true, true, -1, true, state.tags[t], by_tag[t], state.cache);
+            }
+        }
+    }
+    instances.clear();
+
+    ErrorCode err = drc_check_flat(state, by_tag, result);
+    if (err != ErrorCode::NoError) error_code = err;
+    for (uint64_t i = 0; i < tag_count; i++) {
+        for (uint64_t j = 0; j < by_tag[i].count; j++) {
+            by_tag[i][j]->clear();
+            free_allocation(by_tag[i][j]);
+        }
+        by_tag[i].clear();
+    }
+    free_allocation(by_tag);
+    state.results.set(cell->name, result);
+    return error_code;
+}
+
+ErrorCode check_rules(const Cell& cell, const Array<DrcRule>& rules, double precision,
+                      Array<Polygon*>* markers) {
+    if (rules.count == 0) return ErrorCode::NoError;
+    DrcState state = {};
+    state.rules = &rules;
+    state.scaling = 1 / precision;
+    for (uint64_t i = 0; i < rules.count; i++) {
+        const DrcRule& rule = rules[i];
+        if (!state.tags.contains(rule.tag1)) state.tags.append(rule.tag1);
+        if ((rule.check == DrcCheck::Spacing || rule.check == DrcCheck::Enclosure) &&
+            !state.tags.contains(rule.tag2))
+            state.tags.append(rule.tag2);
+        if (rule.check != DrcCheck::Area && rule.value > state.margin) state.margin = rule.value;
+    }
+
+    cell.bounding_box(state.cache);
+    Array<Polygon*>* result;
+    ErrorCode error_code = drc_cell(state, &cell, result);
+    for (uint64_t r = 0; r < rules.count; r++) {
+        markers[r].extend(result[r]);
+        result[r].count = 0;
+    }
+
+    for (MapItem<Array<Polygon*>*>* item = state.results.next(NULL); item;
+         item = state.results.next(item)) {
+        Array<Polygon*>* cell_markers = item->value;
+        for (uint64_t r = 0; r < rules.count; r++) {
+            for (uint64_t j = 0; j < cell_markers[r].count; j++) {
+                cell_markers[r][j]->clear();
+                free_allocation(cell_markers[r][j]);
+            }
+            cell_markers[r].clear();
+        }
+        free_allocation(cell_markers);
+    }
+    state.results.clear();
+    clear_geometry_cache(state.cache);
+    state.tags.clear();
+    return error_code;
+}
+
+}  // namespace gdstk
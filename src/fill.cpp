@@ -0,0 +1,433 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/fill.hpp>
+#include <gdstk/raster.hpp>
+#include <gdstk/sort.hpp>
+
+namespace gdstk {
+
+// Grid of fill sites.  The footprint of site (column, row) is the rectangle
+// with lower left corner origin + (column * pitch.x, row * pitch.y) and the
+// dimensions of the fill element.
+struct FillGrid {
+    Vec2 origin;
+    Vec2 size;
+    Vec2 pitch;
+    uint64_t columns;
+    uint64_t rows;
+    uint64_t tile_columns;  // Sites per tile
+    uint64_t tile_rows;
+    uint64_t tiles_x;
+    uint64_t tiles_y;
+};
+
+// Sites column, ..., column + columns - 1 in rows row, row + step, ...,
+// row + (rows - 1) * step.
+struct FillRun {
+    uint64_t column;
+    uint64_t columns;
+    uint64_t row;
+    uint64_t rows;
+    uint64_t step;
+};
+
+static bool fill_run_order(const FillRun& r1, const FillRun& r2) {
+    if (r1.column != r2.column) return r1.column < r2.column;
+    if (r1.columns != r2.columns) return r1.columns < r2.columns;
+    return r1.row < r2.row;
+}
+
+// Range of sites along one axis whose footprint, grown by keep_out, overlaps
+// the open interval (lo, hi).  Return false if the range is empty.
+static bool fill_site_range(double lo, double hi, double origin, double pitch, double size,
+                            double keep_out, uint64_t count, uint64_t& first, uint64_t& last) {
+    double a = floor((lo - keep_out - size - origin) / pitch) + 1;
+    double b = ceil((hi + keep_out - origin) / pitch) - 1;
+    if (a < 0) a = 0;
+    if (b > (double)count - 1) b = (double)count - 1;
+    if (a > b) return false;
+    first = (uint64_t)a;
+    last = (uint64_t)b;
+    return true;
+}
+
+// Mark the sites in row (within the tile starting at column0, with width
+// columns) that overlap the interval (lo, hi).
+static void fill_block_interval(const FillGrid& grid, double lo, double hi, double keep_out,
+                                uint64_t column0, uint64_t columns, uint8_t* blocked_row) {
+    uint64_t first, last;
+    if (!fill_site_range(lo, hi, grid.origin.x, grid.pitch.x, grid.size.x, keep_out, grid.columns,
+                         first, last))
+        return;
+    if (first < column0) first = column0;
+    if (last >= column0 + columns) last = column0 + columns - 1;
+    for (uint64_t c = first; c <= last && c >= first; c++) blocked_row[c - column0] = 1;
+}
+
+// Mark the sites in the tile with first site (column0, row0) and dimensions
+// columns × rows that overlap polygon, grown by keep_out.  For each row of
+// sites, the polygon is projected on the x axis within the (grown) row band:
+// the projection is the union of the projections of the edges clipped to the
+// band with the interior intervals of the polygon along the band boundary.
+static void fill_block_polygon(const FillGrid& grid, const Polygon* polygon, double keep_out,
+                               uint64_t column0, uint64_t row0, uint64_t columns, uint64_t rows,
+                               uint8_t* blocked, Array<double>& crossings) {
+    const Array<Vec2>& point_array = polygon->point_array;
+    if (point_array.count < 2) return;
+    Vec2 min, max;
+    polygon->bounding_box(min, max);
+    uint64_t first, last;
+    if (!fill_site_range(min.y, max.y, grid.origin.y, grid.pitch.y, grid.size.y, keep_out,
+                         grid.rows, first, last))
+        return;
+    if (first < row0) first = row0;
+    if (last >= row0 + rows) last = row0 + rows - 1;
+    for (uint64_t r = first; r <= last && r >= first; r++) {
+        uint8_t* blocked_row = blocked + (r - row0) * columns;
+        const double y0 = grid.origin.y + r * grid.pitch.y - keep_out;
+        const double y1 = y0 + grid.size.y + 2 * keep_out;
+        crossings.count = 0;
+        Vec2 a = point_array[point_array.count - 1];
+        Vec2* b = point_array.items;
+        for (uint64_t i = point_array.count; i > 0; i--, a = *b++) {
+            if ((a.y <= y0) != (b->y <= y0)) {
+                crossings.append(a.x + (y0 - a.y) * (b->x - a.x) / (b->y - a.y));
+            }
+            double ymin = a.y < b->y ? a.y : b->y;
+            double ymax = a.y < b->y ? b->y : a.y;
+            if (ymax <= y0 || ymin >= y1) continue;
+            double xa, xb;
+            if (a.y == b->y) {
+                xa = a.x;
+                xb = b->x;
+            } else {
+                double dxdy = (b->x - a.x) / (b->y - a.y);
+                xa = a.x + ((ymin < y0 ? y0 : ymin) - a.y) * dxdy;
+                xb = a.x + ((ymax > y1 ? y1 : ymax) - a.y) * dxdy;
+            }
+            if (xa > xb) {
+                double x = xa;
+                xa = xb;
+                xb = x;
+            }
+            fill_block_interval(grid, xa, xb, keep_out, column0, columns, blocked_row);
+        }
+        sort(crossings);
+        for (uint64_t i = 1; i < crossings.count; i += 2) {
+            fill_block_interval(grid, crossings[i - 1], crossings[i], keep_out, column0, columns,
+                                blocked_row);
+        }
+    }
+}
+
+// Runs of free sites in a tile.  If needed < free sites in the tile, only
+// evenly spaced rows are used.  Runs with the same columns in equally spaced
+// rows are merged.
+static void fill_tile_runs(const FillGrid& grid, const uint8_t* blocked, uint64_t column0,
+                           uint64_t row0, uint64_t columns, uint64_t rows, int64_t needed,
+                           Array<FillRun>& result) {
+    uint64_t available = 0;
+    const uint8_t* b = blocked;
+    for (uint64_t i = columns * rows; i > 0; i--) available += *b++ == 0;
+    if (available == 0 || needed == 0) return;
+
+    uint64_t step = 1;
+    uint64_t start = 0;
+    if (needed > 0 && (uint64_t)needed < available) {
+        step = available / (uint64_t)needed;
+        if (step > rows) step = rows;
+        start = (step - 1) / 2;
+    }
+
+    Array<FillRun> runs = {};
+    for (uint64_t r = start; r < rows; r += step) {
+        const uint8_t* blocked_row = blocked + r * columns;
+        uint64_t c = 0;
+        while (c < columns) {
+            if (blocked_row[c]) {
+                c++;
+                continue;
+            }
+            uint64_t c_end = c + 1;
+            while (c_end < columns && blocked_row[c_end] == 0) c_end++;
+            runs.append(FillRun{column0 + c, c_end - c, row0 + r, 1, 1});
+            c = c_end;
+        }
+    }
+    sort(runs, fill_run_order);
+
+    FillRun* run = runs.items;
+    for (uint64_t i = runs.count; i > 0; i--, run++) {
+        if (result.count > 0) {
+            FillRun* last = result.items + result.count - 1;
+            if (last->column == run->column && last->columns == run->columns) {
+                uint64_t last_row = last->row + (last->rows - 1) * last->step;
+                uint64_t delta = run->row - last_row;
+                if (last->rows == 1) {
+                    last->step = delta;
+                    last->rows = 2;
+                    continue;
+                } else if (delta == last->step) {
+                    last->rows++;
+                    continue;
+                }
+            }
+        }
+        result.append(*run);
+    }
+    runs.clear();
+}
+
+// Calculate the fill runs for an element with bounding box (element_min,
+// element_max).  Tags and areas of the element geometry are used for the
+// density target.  Argument grid is filled with the site grid.
+static ErrorCode fill_runs(const Cell& cell, const Vec2 min, const Vec2 max,
+                           const Vec2 element_min, const Vec2 element_max, const Vec2 pitch,
+                           const Array<Tag>& exclusion_tags, const Array<double>& keep_out,
+                           double density, const Vec2 tile_size, double precision,
+                           const Array<Tag>& element_tags, const Array<double>& element_areas,
+                           FillGrid& grid, Array<FillRun>& result) {
+    ErrorCode error_code = ErrorCode::NoError;
+    grid = FillGrid{};
+    grid.origin = min;
+    grid.size = element_max - element_min;
+    grid.pitch = pitch;
+    if (pitch.x <= 0 || pitch.y <= 0 || grid.size.x < 0 || grid.size.y < 0) return error_code;
+    if (max.x - min.x < grid.size.x || max.y - min.y < grid.size.y) return error_code;
+    // Small tolerance for rounding errors in the number of sites
+    grid.columns = 1 + (uint64_t)floor((max.x - min.x - grid.size.x) / pitch.x + 1e-9);
+    grid.rows = 1 + (uint64_t)floor((max.y - min.y - grid.size.y) / pitch.y + 1e-9);
+    grid.tile_columns = grid.columns;
+    grid.tile_rows = grid.rows;
+    if (tile_size.x > 0 && tile_size.y > 0) {
+        double tc = round(tile_size.x / pitch.x);
+        double tr = round(tile_size.y / pitch.y);
+        if (tc < 1) tc = 1;
+        if (tr < 1) tr = 1;
+        if (tc < grid.columns) grid.tile_columns = (uint64_t)tc;
+        if (tr < grid.rows) grid.tile_rows = (uint64_t)tr;
+    }
+    grid.tiles_x = (grid.columns + grid.tile_columns - 1) / grid.tile_columns;
+    grid.tiles_y = (grid.rows + grid.tile_rows - 1) / grid.tile_rows;
+    const uint64_t tile_count = grid.tiles_x * grid.tiles_y;
+
+    // Existing pattern density of the element tags in each tile
+    const Vec2 tile_pitch = {grid.tile_columns * pitch.x, grid.tile_rows * pitch.y};
+    double** tile_density = NULL;
+    if (density > 0 && element_tags.count > 0) {
+        tile_density = (double**)allocate(element_tags.count * sizeof(double*));
+        for (uint64_t i = 0; i < element_tags.count; i++) {
+            tile_density[i] = (double*)allocate(tile_count * sizeof(double));
+        }
+        error_code = density_map(cell, min, tile_pitch, grid.tiles_x, grid.tiles_y, element_tags,
+                                 precision, tile_density);
+    }
+
+    // Exclusion polygons are binned by the tiles they might block
+    Array<Polygon*> polygons = {};
+    Array<double> polygon_keep_out = {};
+    Map<GeometryInfo> cache = {};
+    for (uint64_t i = 0; i < exclusion_tags.count; i++) {
+        uint64_t start = polygons.count;
+        cell.get_polygons(true, true, -1, true, exclusion_tags[i], polygons, cache);
+        double k = i < keep_out.count ? keep_out[i] : 0;
+        polygon_keep_out.ensure_slots(polygons.count - start);
+        for (uint64_t j = polygons.count - start; j > 0; j--) polygon_keep_out.append_unsafe(k);
+    }
+    clear_geometry_cache(cache);
+    Array<uint64_t>* tile_polygons =
+        (Array<uint64_t>*)allocate_clear(tile_count * sizeof(Array<uint64_t>));
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        Vec2 pmin, pmax;
+        polygons[i]->bounding_box(pmin, pmax);
+        uint64_t c0, c1, r0, r1;
+        if (!fill_site_range(pmin.x, pmax.x, grid.origin.x, pitch.x, grid.size.x,
+                             polygon_keep_out[i], grid.columns, c0, c1) ||
+            !fill_site_range(pmin.y, pmax.y, grid.origin.y, pitch.y, grid.size.y,
+                             polygon_keep_out[i], grid.rows, r0, r1))
+            continue;
+        for (uint64_t ty = r0 / grid.tile_rows; ty <= r1 / grid.tile_rows; ty++) {
+            for (uint64_t tx = c0 / grid.tile_columns; tx <= c1 / grid.tile_columns; tx++) {
+                tile_polygons[ty * grid.tiles_x + tx].append(i);
+            }
+        }
+    }
+
+    Array<FillRun>* tile_runs =
+        (Array<FillRun>*)allocate_clear(tile_count * sizeof(Array<FillRun>));
+    GDSTK_PARALLEL_FOR
+    for (int64_t t = 0; t < (int64_t)tile_count; t++) {
+        const uint64_t tx = t % grid.tiles_x;
+        const uint64_t ty = t / grid.tiles_x;
+        const uint64_t column0 = tx * grid.tile_columns;
+        const uint64_t row0 = ty * grid.tile_rows;
+        const uint64_t columns = grid.columns - column0 < grid.tile_columns
+                                     ? grid.columns - column0
+                                     : grid.tile_columns;
+        const uint64_t rows = grid.rows - row0 < grid.tile_rows ? grid.rows - row0 : grid.tile_rows;
+
+        int64_t needed = -1;
+        if (tile_density) {
+            // Area of the tile within the window
+            double x0 = min.x + tx * tile_pitch.x;
+            double y0 = min.y + ty * tile_pitch.y;
+            double x1 = x0 + tile_pitch.x > max.x ? max.x : x0 + tile_pitch.x;
+            double y1 = y0 + tile_pitch.y > max.y ? max.y : y0 + tile_pitch.y;
+            double tile_area = (x1 - x0) * (y1 - y0);
+            needed = 0;
+            for (uint64_t i = 0; i < element_tags.count; i++) {
+                if (element_areas[i] <= 0) continue;
+                double missing =
+                    density * tile_area - tile_density[i][t] * tile_pitch.x * tile_pitch.y;
+                if (missing <= 0) continue;
+                int64_t n = (int64_t)ceil(missing / element_areas[i] - 1e-9);
+                if (n > needed) needed = n;
+            }
+            if (needed == 0) continue;
+        }
+
+        uint8_t* blocked = (uint8_t*)allocate_clear(columns * rows);
+        Array<double> crossings = {};
+        const Array<uint64_t>& indices = tile_polygons[t];
+        for (uint64_t i = 0; i < indices.count; i++) {
+            fill_block_polygon(grid, polygons[indices[i]], polygon_keep_out[indices[i]], column0,
+                               row0, columns, rows, blocked, crossings);
+        }
+        crossings.clear();
+        fill_tile_runs(grid, blocked, column0, row0, columns, rows, needed, tile_runs[t]);
+        free_allocation(blocked);
+    }
+
+    for (uint64_t t = 0; t < tile_count; t++) {
+        result.extend(tile_runs[t]);
+        tile_runs[t].clear();
+        tile_polygons[t].clear();
+    }
+    free_allocation(tile_runs);
+    free_allocation(tile_polygons);
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        polygons[i]->clear();
+        free_allocation(polygons[i]);
+    }
+    polygons.clear();
+    polygon_keep_out.clear();
+    if (tile_density) {
+        for (uint64_t i = 0; i < element_tags.count; i++) free_allocation(tile_density[i]);
+        free_allocation(tile_density);
+    }
+    return error_code;
+}
+
+// Origin and repetition of the element for run
+static void fill_placement(const FillGrid& grid, const Vec2 element_min, const FillRun& run,
+                           Vec2& origin, Repetition& repetition) {
+    origin = grid.origin - element_min + Vec2{run.column * grid.pitch.x, run.row * grid.pitch.y};
+    if (run.columns > 1 || run.rows > 1) {
+        repetition.type = RepetitionType::Rectangular;
+        repetition.columns = run.columns;
+        repetition.rows = run.rows;
+        repetition.spacing = Vec2{grid.pitch.x, run.step * grid.pitch.y};
+    }
+}
+
+ErrorCode fill_cell(const Cell& cell, const Vec2 min, const Vec2 max, Cell* element,
+                    const Vec2 pitch, const Array<Tag>& exclusion_tags,
+                    const Array<double>& keep_out, double density, const Vec2 tile_size,
+                    double precision, Array<Reference*>& result) {
+    Vec2 element_min, element_max;
+    element->bounding_box(element_min, element_max);
+    if (element_min.x > element_max.x) return ErrorCode::NoError;
+
+    Array<Tag> tags = {};
+    Array<double> areas = {};
+    if (density > 0) {
+        Array<Polygon*> polygons = {};
+        element->get_polygons(true, true, -1, false, 0, polygons);
+        for (uint64_t i = 0; i < polygons.count; i++) {
+            Polygon* polygon = polygons[i];
+            uint64_t j = 0;
+            while (j < tags.count && tags[j] != polygon->tag) j++;
+            if (j == tags.count) {
+                tags.append(polygon->tag);
+                areas.append(0);
+            }
+            areas[j] += polygon->area();
+            polygon->clear();
+            free_allocation(polygon);
+        }
+        polygons.clear();
+    }
+
+    FillGrid grid;
+    Array<FillRun> runs = {};
+    ErrorCode error_code =
+        fill_runs(cell, min, max, element_min, element_max, pitch, exclusion_tags, keep_out,
+                  density, tile_size, precision, tags, areas, grid, runs);
+    tags.clear();
+    areas.clear();
+
+    result.ensure_slots(runs.count);
+    for (uint64_t i = 0; i < runs.count; i++) {
+        Reference* reference = (Reference*)allocate_clear(sizeof(Reference));
+        reference->init(element);
+        fill_placement(grid, element_min, runs[i], reference->origin, reference->repetition);
+        result.append_unsafe(reference);
+    }
+    runs.clear();
+    return error_code;
+}
+
+ErrorCode fill_polygon(const Cell& cell, const Vec2 min, const Vec2 max, const Polygon& element,
+                       const Vec2 pitch, const Array<Tag>& exclusion_tags,
+                       const Array<double>& keep_out, double density, const Vec2 tile_size,
+                       double precision, Array<Polygon*>& result) {
+    if (element.point_array.count < 3) return ErrorCode::NoError;
+    Vec2 element_min, element_max;
+    element.bounding_box(element_min, element_max);
+
+    Array<Tag> tags = {};
+    Array<double> areas = {};
+    if (density > 0) {
+        tags.append(element.tag);
+        areas.append(element.area());
+    }
+
+    FillGrid grid;
+    Array<FillRun> runs = {};
+    ErrorCode error_code =
+        fill_runs(cell, min, max, element_min, element_max, pitch, exclusion_tags, keep_out,
+                  density, tile_size, precision, tags, areas, grid, runs);
+    tags.clear();
+    areas.clear();
+
+    result.ensure_slots(runs.count);
+    for (uint64_t i = 0; i < runs.count; i++) {
+        Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
+        polygon->point_array.copy_from(element.point_array);
+        polygon->tag = element.tag;
+        polygon->properties = properties_copy(element.properties);
+        Vec2 origin;
+        fill_placement(grid, element_min, runs[i], origin, polygon->repetition);
+        polygon->translate(origin);
+        result.append_unsafe(polygon);
+    }
+    runs.clear();
+    return error_code;
+}
+
+}  // namespace gdstk
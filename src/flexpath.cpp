@@ -183,21 +183,24 @@ void FlexPath::rotate(double angle, const Vec2 center) {
 void FlexPath::apply_repetition(Array<FlexPath*>& result) {
     if (repetition.type == RepetitionType::None) return;
 
-    Array<Vec2> offsets = {};
-    repetition.get_offsets(offsets);
-    repetition.clear();
+    // Take the repetition out so that it is not copied to the new elements
+    Repetition rep = repetition;
+    repetition.type = RepetitionType::None;
 
+    RepetitionIterator iterator = {};
+    iterator.init(rep);
+    Vec2 offset;
     // Skip first offset (0, 0)
-    Vec2* offset_p = offsets.items + 1;
-    result.ensure_slots(offsets.count - 1);
-    for (uint64_t offset_count = offsets.count - 1; offset_count > 0; offset_count--) {
+    iterator.next(offset);
+    result.ensure_slots(iterator.count - 1);
+    while (iterator.next(offset)) {
         FlexPath* path = (FlexPath*)allocate_clear(sizeof(FlexPath));
         path->copy_from(*this);
-        path->translate(*offset_p++);
+        path->translate(offset);
         result.append_unsafe(path);
     }
 
-    offsets.clear();
+    rep.clear();
     return;
 }
 
@@ -779,14 +782,8 @@ ErrorCode FlexPath::to_gds(FILE* out, double scaling) {
     uint16_t buffer_end[] = {4, 0x1100};
     big_endian_swap16(buffer_end, COUNT(buffer_end));
 
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
+    RepetitionIterator iterator = {};
+    Vec2 offset;
 
     Array<int32_t> coords = {};
     Array<Vec2> point_array = {};
@@ -856,8 +853,8 @@ ErrorCode FlexPath::to_gds(FILE* out, double scaling) {
         coords.ensure_slots(point_array.count * 2);
         coords.count = point_array.count * 2;
 
-        double* offset_p = (double*)offsets.items;
-        for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
+        iterator.init(repetition);
+        while (iterator.next(offset)) {
             fwrite(buffer_start, sizeof(uint16_t), COUNT(buffer_start), out);
             fwrite(&width, sizeof(int32_t), 1, out);
             if (raith_data.base_cell_name) {
@@ -878,11 +875,9 @@ ErrorCode FlexPath::to_gds(FILE* out, double scaling) {
 
             int32_t* c = coords.items;
             double* p = (double*)point_array.items;
-            double offset_x = *offset_p++;
-            double offset_y = *offset_p++;
             for (uint64_t i = point_array.count; i > 0; i--) {
-                *c++ = (int32_t)lround((*p++ + offset_x) * scaling);
-                *c++ = (int32_t)lround((*p++ + offset_y) * scaling);
+                *c++ = (int32_t)lround((*p++ + offset.x) * scaling);
+                *c++ = (int32_t)lround((*p++ + offset.y) * scaling);
             }
             big_endian_swap32((uint32_t*)coords.items, coords.count);
 
@@ -909,7 +904,6 @@ ErrorCode FlexPath::to_gds(FILE* out, double scaling) {
 
     coords.clear();
     point_array.clear();
-    if (repetition.type != RepetitionType::None) offsets.clear();
     return error_code;
 }
 
@@ -985,6 +979,14 @@ ErrorCode FlexPath::to_oas(OasisStream& out, OasisState& state) {
 }
 
 ErrorCode FlexPath::to_svg(FILE* out, double scaling, uint32_t precision) {
+    Array<char> buffer = {};
+    ErrorCode error_code = to_svg(buffer, scaling, precision);
+    fwrite(buffer.items, 1, buffer.count, out);
+    buffer.clear();
+    return error_code;
+}
+
+ErrorCode FlexPath::to_svg(Array<char>& out, double scaling, uint32_t precision) {
     Array<Polygon*> array = {};
     ErrorCode error_code = to_polygons(false, 0, array);
     for (uint64_t i = 0; i < array.count; i++) {
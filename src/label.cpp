@@ -18,6 +18,8 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 namespace gdstk {
 
+uint64_t label_change_count = 0;
+
 void Label::print() {
     printf("Label <%p> %s, at (%lg, %lg), %lg rad, mag %lg,%s reflected, layer %" PRIu32
            ", texttype %" PRIu32 ", properties <%p>, owner <%p>\n",
@@ -67,6 +69,18 @@ void Label::bounding_box(Vec2& min, Vec2& max) const {
     }
 }
 
+uint64_t Label::content_hash(double scaling, const Vec2 offset) const {
+    uint64_t result = hash_combine(hash(tag), hash((const char*)text));
+    result = hash_combine(result, hash_coordinate(origin.x - offset.x, scaling));
+    result = hash_combine(result, hash_coordinate(origin.y - offset.y, scaling));
+    result = hash_combine(result, (uint64_t)anchor);
+    result = hash_combine(result, hash_coordinate(rotation, 1e9));
+    result = hash_combine(result, hash_coordinate(magnification, 1e9));
+    result = hash_combine(result, x_reflection ? 1 : 0);
+    result = hash_combine(result, repetition.content_hash(scaling));
+    return hash_combine(result, properties_hash(properties));
+}
+
 void Label::transform(double mag, bool x_refl, double rot, const Vec2 orig) {
     const int r1 = x_refl ? -1 : 1;
     const double crot = cos(rot);
@@ -83,22 +97,24 @@ void Label::transform(double mag, bool x_refl, double rot, const Vec2 orig) {
 void Label::apply_repetition(Array<Label*>& result) {
     if (repetition.type == RepetitionType::None) return;
 
-    Array<Vec2> offsets = {};
-    repetition.get_offsets(offsets);
-    repetition.clear();
+    // Take the repetition out so that it is not copied to the new elements
+    Repetition rep = repetition;
+    repetition.type = RepetitionType::None;
 
+    RepetitionIterator iterator = {};
+    iterator.init(rep);
+    Vec2 offset;
     // Skip first offset (0, 0)
-    double* offset_p = (double*)(offsets.items + 1);
-    result.ensure_slots(offsets.count - 1);
-    for (uint64_t offset_count = offsets.count - 1; offset_count > 0; offset_count--) {
+    iterator.next(offset);
+    result.ensure_slots(iterator.count - 1);
+    while (iterator.next(offset)) {
         Label* label = (Label*)allocate_clear(sizeof(Label));
         label->copy_from(*this);
-        label->origin.x += *offset_p++;
-        label->origin.y += *offset_p++;
+        label->origin += offset;
         result.append_unsafe(label);
     }
 
-    offsets.clear();
+    rep.clear();
     return;
 }
 
@@ -152,17 +168,10 @@ ErrorCode Label::to_gds(FILE* out, double scaling) const {
         big_endian_swap16(buffer_flags, COUNT(buffer_flags));
     }
 
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
-
-    Vec2* offset_p = offsets.items;
-    for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--, offset_p++) {
+    RepetitionIterator iterator = {};
+    iterator.init(repetition);
+    Vec2 offset;
+    while (iterator.next(offset)) {
         fwrite(buffer_start, sizeof(uint16_t), COUNT(buffer_start), out);
 
         if (transform_) {
@@ -177,8 +186,8 @@ ErrorCode Label::to_gds(FILE* out, double scaling) const {
             }
         }
 
-        int32_t buffer_pos[] = {(int32_t)(lround((origin.x + offset_p->x) * scaling)),
-                                (int32_t)(lround((origin.y + offset_p->y) * scaling))};
+        int32_t buffer_pos[] = {(int32_t)(lround((origin.x + offset.x) * scaling)),
+                                (int32_t)(lround((origin.y + offset.y) * scaling))};
         big_endian_swap32((uint32_t*)buffer_pos, COUNT(buffer_pos));
 
         fwrite(buffer_xy, sizeof(uint16_t), COUNT(buffer_xy), out);
@@ -191,107 +200,115 @@ ErrorCode Label::to_gds(FILE* out, double scaling) const {
         if (err != ErrorCode::NoError) error_code = err;
         fwrite(buffer_end, sizeof(uint16_t), COUNT(buffer_end), out);
     }
-    if (repetition.type != RepetitionType::None) offsets.clear();
     return error_code;
 }
 
 ErrorCode Label::to_svg(FILE* out, double scaling, uint32_t precision) const {
-    fprintf(out, "<text id=\"%p\" class=\"l%" PRIu32 "t%" PRIu32 "\"", this, get_layer(tag),
-            get_type(tag));
+    Array<char> buffer = {};
+    ErrorCode error_code = to_svg(buffer, scaling, precision);
+    fwrite(buffer.items, 1, buffer.count, out);
+    buffer.clear();
+    return error_code;
+}
+
+ErrorCode Label::to_svg(Array<char>& out, double scaling, uint32_t precision) const {
+    append_format(out, "<text id=\"%p\" class=\"l%" PRIu32 "t%" PRIu32 "\"", this, get_layer(tag),
+                  get_type(tag));
     switch (anchor) {
         case Anchor::NW:
         case Anchor::W:
         case Anchor::SW:
-            fputs(" text-anchor=\"start\"", out);
+            append_string(out, " text-anchor=\"start\"");
             break;
         case Anchor::N:
         case Anchor::O:
         case Anchor::S:
-            fputs(" text-anchor=\"middle\"", out);
+            append_string(out, " text-anchor=\"middle\"");
             break;
         case Anchor::NE:
         case Anchor::E:
         case Anchor::SE:
-            fputs(" text-anchor=\"end\"", out);
+            append_string(out, " text-anchor=\"end\"");
             break;
     }
     switch (anchor) {
         case Anchor::NW:
         case Anchor::N:
         case Anchor::NE:
-            fputs(" dominant-baseline=\"text-before-edge\"", out);
+            append_string(out, " dominant-baseline=\"text-before-edge\"");
             break;
         case Anchor::W:
         case Anchor::O:
         case Anchor::E:
-            fputs(" dominant-baseline=\"central\"", out);
+            append_string(out, " dominant-baseline=\"central\"");
             break;
         case Anchor::SW:
         case Anchor::S:
         case Anchor::SE:
-            fputs(" dominant-baseline=\"text-after-edge\"", out);
+            append_string(out, " dominant-baseline=\"text-after-edge\"");
             break;
     }
 
     char double_buffer[GDSTK_DOUBLE_BUFFER_COUNT];
-    fputs(" transform=\"translate(", out);
-    fputs(double_print(scaling * origin.x, precision, double_buffer, COUNT(double_buffer)), out);
-    fputc(' ', out);
-    fputs(double_print(scaling * origin.y, precision, double_buffer, COUNT(double_buffer)), out);
-    fputc(')', out);
+    append_string(out, " transform=\"translate(");
+    append_string(out, double_print(scaling * origin.x, precision, double_buffer,
+                                    COUNT(double_buffer)));
+    out.append(' ');
+    append_string(out, double_print(scaling * origin.y, precision, double_buffer,
+                                    COUNT(double_buffer)));
+    out.append(')');
 
     if (rotation != 0) {
-        fputs(" rotate(", out);
-        fputs(
-            double_print(rotation * (180.0 / M_PI), precision, double_buffer, COUNT(double_buffer)),
-            out);
-        fputc(')', out);
+        append_string(out, " rotate(");
+        append_string(out, double_print(rotation * (180.0 / M_PI), precision, double_buffer,
+                                        COUNT(double_buffer)));
+        out.append(')');
     }
     if (x_reflection) {
-        fputs(" scale(1 -1)", out);
+        append_string(out, " scale(1 -1)");
     }
     if (magnification != 1) {
-        fputs(" scale(", out);
-        fputs(double_print(magnification, precision, double_buffer, COUNT(double_buffer)), out);
-        fputc(')', out);
+        append_string(out, " scale(");
+        append_string(out, double_print(magnification, precision, double_buffer,
+                                        COUNT(double_buffer)));
+        out.append(')');
     }
 
     // NOTE: Escape “<”, “>”, and “&” inside the SVG tag.  Here be dragons if the text is not ASCII.
     // The GDSII specification imposes ASCII-only for strings, but who knows…
-    fputs(" scale(1 -1)\">", out);
+    append_string(out, " scale(1 -1)\">");
     for (char* c = text; *c != 0; c++) {
         switch (*c) {
             case '<':
-                fputs("&lt;", out);
+                append_string(out, "&lt;");
                 break;
             case '>':
-                fputs("&gt;", out);
+                append_string(out, "&gt;");
                 break;
             case '&':
-                fputs("&amp;", out);
+                append_string(out, "&amp;");
                 break;
             default:
-                putc(*c, out);
+                out.append(*c);
         }
     }
-    fputs("</text>\n", out);
+    append_string(out, "</text>\n");
 
     if (repetition.type != RepetitionType::None) {
-        Array<Vec2> offsets = {};
-        repetition.get_offsets(offsets);
-        double* offset_p = (double*)(offsets.items + 1);
-        for (uint64_t offset_count = offsets.count - 1; offset_count > 0; offset_count--) {
-            double offset_x = *offset_p++;
-            double offset_y = *offset_p++;
-            fprintf(out, "<use href=\"#%p\" x=\"", this);
-            fputs(double_print(offset_x * scaling, precision, double_buffer, COUNT(double_buffer)),
-                  out);
-            fputs("\" y=\"", out);
-            fputs(double_print(offset_y * scaling, precision, double_buffer, COUNT(double_buffer)),
-                  out);
-            fputs("\"/>\n", out);
+        RepetitionIterator iterator = {};
+        iterator.init(repetition);
+        Vec2 offset;
+        // Skip first offset (0, 0)
+        iterator.next(offset);
+        while (iterator.next(offset)) {
+            append_format(out, "<use href=\"#%p\" x=\"", this);
+            append_string(out, double_print(offset.x * scaling, precision, double_buffer,
+                                            COUNT(double_buffer)));
+            append_string(out, "\" y=\"");
+            append_string(out, double_print(offset.y * scaling, precision, double_buffer,
+                                            COUNT(double_buffer)));
+            append_string(out, "\"/>\n");
         }
-        offsets.clear();
     }
     return ErrorCode::NoError;
 }
@@ -0,0 +1,303 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/labelindex.hpp>
+#include <gdstk/sort.hpp>
+
+#define GDSTK_LABEL_FILTER_BITS (64 * GDSTK_LABEL_FILTER_WORDS)
+
+namespace gdstk {
+
+// Each text sets 2 bits in the filters
+static void filter_add(uint64_t* filter, const char* text) {
+    const uint64_t h = hash(text);
+    const uint64_t b0 = h % GDSTK_LABEL_FILTER_BITS;
+    const uint64_t b1 = (h >> 32) % GDSTK_LABEL_FILTER_BITS;
+    filter[b0 / 64] |= (uint64_t)1 << (b0 % 64);
+    filter[b1 / 64] |= (uint64_t)1 << (b1 % 64);
+}
+
+static bool filter_contains(const uint64_t* filter, const char* text) {
+    const uint64_t h = hash(text);
+    const uint64_t b0 = h % GDSTK_LABEL_FILTER_BITS;
+    const uint64_t b1 = (h >> 32) % GDSTK_LABEL_FILTER_BITS;
+    return (filter[b0 / 64] & ((uint64_t)1 << (b0 % 64))) &&
+           (filter[b1 / 64] & ((uint64_t)1 << (b1 % 64)));
+}
+
+static void extend_box(Vec2& min, Vec2& max, const Vec2 point) {
+    if (point.x < min.x) min.x = point.x;
+    if (point.y < min.y) min.y = point.y;
+    if (point.x > max.x) max.x = point.x;
+    if (point.y > max.y) max.y = point.y;
+}
+
+static bool label_text_sorted(Label* const& label1, Label* const& label2) {
+    return strcmp(label1->text, label2->text) < 0;
+}
+
+static bool label_index_stale(const LabelIndexCell* entry, const Cell* cell) {
+    return entry->cell != cell || entry->modification_count != cell->modification_count ||
+           entry->label_items != cell->label_array.items ||
+           entry->label_count != cell->label_array.count ||
+           entry->reference_items != cell->reference_array.items ||
+           entry->reference_count != cell->reference_array.count;
+}
+
+// Index the labels in the cell itself
+static void label_index_build(LabelIndexCell* entry) {
+    const Cell* cell = entry->cell;
+    entry->label_array.clear();
+    entry->label_array.copy_from(cell->label_array);
+    sort(entry->label_array, label_text_sorted);
+
+    memset(entry->local_filter, 0, sizeof(entry->local_filter));
+    entry->local_min = Vec2{DBL_MAX, DBL_MAX};
+    entry->local_max = Vec2{-DBL_MAX, -DBL_MAX};
+    Array<Vec2> offsets = {};
+    Label** label = cell->label_array.items;
+    for (uint64_t i = cell->label_array.count; i > 0; i--, label++) {
+        const Label* lbl = *label;
+        filter_add(entry->local_filter, lbl->text);
+        if (lbl->repetition.type == RepetitionType::None) {
+            extend_box(entry->local_min, entry->local_max, lbl->origin);
+            continue;
+        }
+        offsets.count = 0;
+        lbl->repetition.get_extrema(offsets);
+        for (uint64_t j = 0; j < offsets.count; j++) {
+            extend_box(entry->local_min, entry->local_max, lbl->origin + offsets[j]);
+        }
+    }
+    offsets.clear();
+
+    entry->modification_count = cell->modification_count;
+    entry->label_items = cell->label_array.items;
+    entry->label_count = cell->label_array.count;
+    entry->reference_items = cell->reference_array.items;
+    entry->reference_count = cell->reference_array.count;
+    entry->generation = 0;
+}
+
+// Find the entries of the hierarchy of cell that must be (re)built.  Each
+// cell is visited once per update.
+static void label_index_collect(LabelIndex& index, const Cell* cell,
+                                Array<LabelIndexCell*>& stale) {
+    LabelIndexCell* entry = index.cell_map.get(cell->name);
+    if (!entry) {
+        entry = (LabelIndexCell*)allocate_clear(sizeof(LabelIndexCell));
+        index.cell_map.set(cell->name, entry);
+    } else if (entry->update_count == index.update_count) {
+        return;
+    }
+    entry->update_count = index.update_count;
+    if (entry->generation == 0 || label_index_stale(entry, cell)) {
+        entry->cell = cell;
+        stale.append(entry);
+    }
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        if ((*reference)->type == ReferenceType::Cell) {
+            label_index_collect(index, (*reference)->cell, stale);
+        }
+    }
+}
+
+// Update the hierarchy data of cell if it or any of its dependencies changed
+// since it was last computed.  Return the generation of the data.
+static uint64_t label_index_aggregate(LabelIndex& index, const Cell* cell) {
+    LabelIndexCell* entry = index.cell_map.get(cell->name);
+    if (entry->aggregate_count == index.update_count) return entry->generation;
+    entry->aggregate_count = index.update_count;
+
+    bool changed = entry->generation == 0;
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        if ((*reference)->type != ReferenceType::Cell) continue;
+        if (label_index_aggregate(index, (*reference)->cell) > entry->generation) changed = true;
+    }
+    if (!changed) return entry->generation;
+
+    memcpy(entry->filter, entry->local_filter, sizeof(entry->filter));
+    entry->min = entry->local_min;
+    entry->max = entry->local_max;
+    Array<Vec2> corners = {};
+    reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+        const LabelIndexCell* child = index.cell_map.get(ref->cell->name);
+        if (child->min.x > child->max.x) continue;
+        for (uint64_t j = 0; j < GDSTK_LABEL_FILTER_WORDS; j++) {
+            entry->filter[j] |= child->filter[j];
+        }
+        corners.count = 0;
+        corners.ensure_slots(4);
+        corners.append_unsafe(child->min);
+        corners.append_unsafe(child->max);
+        corners.append_unsafe(Vec2{child->min.x, child->max.y});
+        corners.append_unsafe(Vec2{child->max.x, child->min.y});
+        ref->repeat_and_transform(corners);
+        for (uint64_t j = 0; j < corners.count; j++) extend_box(entry->min, entry->max, corners[j]);
+    }
+    corners.clear();
+    entry->generation = ++index.generation;
+    return entry->generation;
+}
+
+void LabelIndex::clear() {
+    for (MapItem<LabelIndexCell*>* item = cell_map.next(NULL); item; item = cell_map.next(item)) {
+        item->value->clear();
+        free_allocation(item->value);
+    }
+    cell_map.clear();
+    update_count = 0;
+    generation = 0;
+}
+
+void LabelIndex::update(const Cell& top) {
+    if (label_change_count != gdstk::label_change_count) {
+        clear();
+        label_change_count = gdstk::label_change_count;
+    }
+    update_count++;
+    Array<LabelIndexCell*> stale = {};
+    label_index_collect(*this, &top, stale);
+
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)stale.count; i++) {
+        label_index_build(stale[i]);
+    }
+    stale.clear();
+
+    label_index_aggregate(*this, &top);
+}
+
+struct LabelQuery {
+    LabelIndex* index;
+    const char* text;
+    Vec2 min;
+    Vec2 max;
+    Array<LabelInstance>* result;
+};
+
+static Vec2 transform_point(const LabelInstance& transform, const Vec2 point) {
+    Vec2 q = point * transform.magnification;
+    if (transform.x_reflection) q.y = -q.y;
+    const double ca = cos(transform.rotation);
+    const double sa = sin(transform.rotation);
+    return Vec2{q.x * ca - q.y * sa, q.x * sa + q.y * ca} + transform.origin;
+}
+
+// Test whether the transformed bounding box of the labels in entry
+// intersects the query region
+static bool query_overlaps(const LabelQuery& query, const LabelIndexCell* entry,
+                           const LabelInstance& transform) {
+    if (entry->min.x > entry->max.x) return false;
+    if (query.min.x == -DBL_MAX && query.min.y == -DBL_MAX && query.max.x == DBL_MAX &&
+        query.max.y == DBL_MAX)
+        return true;
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    extend_box(min, max, transform_point(transform, entry->min));
+    extend_box(min, max, transform_point(transform, entry->max));
+    extend_box(min, max, transform_point(transform, Vec2{entry->min.x, entry->max.y}));
+    extend_box(min, max, transform_point(transform, Vec2{entry->max.x, entry->min.y}));
+    return min.x <= query.max.x && max.x >= query.min.x && min.y <= query.max.y &&
+           max.y >= query.min.y;
+}
+
+static void query_visit(const LabelQuery& query, const LabelIndexCell* entry,
+                        LabelInstance& transform) {
+    if (query.text && !filter_contains(entry->filter, query.text)) return;
+    if (!query_overlaps(query, entry, transform)) return;
+
+    const Cell* cell = entry->cell;
+    transform.cell = cell;
+    uint64_t first = 0;
+    uint64_t last = entry->label_array.count;
+    if (query.text) {
+        // Lower bound of the range with the requested text
+        uint64_t hi = last;
+        while (first < hi) {
+            uint64_t mid = (first + hi) / 2;
+            if (strcmp(entry->label_array[mid]->text, query.text) < 0) {
+                first = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        last = first;
+        while (last < entry->label_array.count &&
+               strcmp(entry->label_array[last]->text, query.text) == 0)
+            last++;
+    }
+    for (uint64_t i = first; i < last; i++) {
+        const Label* label = entry->label_array[i];
+        RepetitionIterator iterator = {};
+        iterator.init(label->repetition);
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            const Vec2 position = transform_point(transform, label->origin + offset);
+            if (position.x < query.min.x || position.x > query.max.x ||
+                position.y < query.min.y || position.y > query.max.y)
+                continue;
+            transform.label = label;
+            transform.position = position;
+            query.result->append(transform);
+        }
+    }
+
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+        const LabelIndexCell* child = query.index->cell_map.get(ref->cell->name);
+        if (query.text && !filter_contains(child->filter, query.text)) continue;
+        LabelInstance child_transform = {};
+        child_transform.magnification = transform.magnification * ref->magnification;
+        child_transform.x_reflection = transform.x_reflection ^ ref->x_reflection;
+        child_transform.rotation = transform.x_reflection ? transform.rotation - ref->rotation
+                                                          : transform.rotation + ref->rotation;
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            child_transform.origin = transform_point(transform, ref->origin + offset);
+            query_visit(query, child, child_transform);
+        }
+    }
+}
+
+void LabelIndex::find(const Cell& top, const char* text, const Vec2 min, const Vec2 max,
+                      Array<LabelInstance>& result) {
+    update(top);
+    LabelQuery query = {this, text, min, max, &result};
+    LabelInstance transform = {};
+    transform.magnification = 1;
+    query_visit(query, cell_map.get(top.name), transform);
+}
+
+void LabelIndex::find_text(const Cell& top, const char* text, Array<LabelInstance>& result) {
+    find(top, text, Vec2{-DBL_MAX, -DBL_MAX}, Vec2{DBL_MAX, DBL_MAX}, result);
+}
+
+void LabelIndex::find_region(const Cell& top, const Vec2 min, const Vec2 max,
+                             Array<LabelInstance>& result) {
+    find(top, NULL, min, max, result);
+}
+
+}  // namespace gdstk
@@ -19,6 +19,7 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include <gdstk/cell.hpp>
 #include <gdstk/flexpath.hpp>
 #include <gdstk/gdsii.hpp>
+#include <gdstk/gdswriter.hpp>
 #include <gdstk/label.hpp>
 #include <gdstk/library.hpp>
 #include <gdstk/map.hpp>
@@ -26,6 +27,7 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #include <gdstk/polygon.hpp>
 #include <gdstk/rawcell.hpp>
 #include <gdstk/reference.hpp>
+#include <gdstk/sort.hpp>
 #include <gdstk/utils.hpp>
 #include <gdstk/vec.hpp>
 
@@ -62,16 +64,34 @@ void Library::copy_from(const Library& library, bool deep_copy) {
     name = copy_string(library.name, NULL);
     unit = library.unit;
     precision = library.precision;
+    properties = properties_copy(library.properties);
     if (deep_copy) {
+        const uint64_t count = library.cell_array.count;
         cell_array.capacity = library.cell_array.capacity;
-        cell_array.count = library.cell_array.count;
+        cell_array.count = count;
         cell_array.items = (Cell**)allocate(sizeof(Cell*) * cell_array.capacity);
-        Cell** src = library.cell_array.items;
-        Cell** dst = cell_array.items;
-        for (uint64_t i = 0; i < library.cell_array.count; i++, src++, dst++) {
-            *dst = (Cell*)allocate_clear(sizeof(Cell));
-            (*dst)->copy_from(**src, NULL, true);
+        Map<uint64_t> index = {};  // Cell name to position + 1
+        for (uint64_t i = 0; i < count; i++) {
+            cell_array[i] = (Cell*)allocate_clear(sizeof(Cell));
+            index.set(library.cell_array[i]->name, i + 1);
         }
+
+        // Cells are copied concurrently and references to cells in the
+        // source library are redirected to their copies.
+        GDSTK_PARALLEL_FOR
+        for (int64_t i = 0; i < (int64_t)count; i++) {
+            Cell* cell = cell_array[i];
+            cell->copy_from(*library.cell_array[i], NULL, true);
+            Reference** reference = cell->reference_array.items;
+            for (uint64_t j = cell->reference_array.count; j > 0; j--, reference++) {
+                Reference* ref = *reference;
+                if (ref->type != ReferenceType::Cell) continue;
+                const uint64_t position = index.get(ref->cell->name);
+                if (position > 0 && library.cell_array[position - 1] == ref->cell)
+                    ref->cell = cell_array[position - 1];
+            }
+        }
+        index.clear();
     } else {
         cell_array.copy_from(library.cell_array);
     }
@@ -79,6 +99,37 @@ void Library::copy_from(const Library& library, bool deep_copy) {
     rawcell_array.copy_from(library.rawcell_array);
 }
 
+void Library::clone_from(const Library& library) {
+    name = copy_string(library.name, NULL);
+    unit = library.unit;
+    precision = library.precision;
+    properties = properties_copy(library.properties);
+
+    const uint64_t count = library.cell_array.count;
+    cell_array.ensure_slots(count);
+    Map<uint64_t> index = {};  // Cell name to position + 1
+    for (uint64_t i = 0; i < count; i++) {
+        Cell* cell = (Cell*)allocate_clear(sizeof(Cell));
+        cell->clone_from(*library.cell_array[i], NULL);
+        cell_array.append_unsafe(cell);
+        index.set(cell->name, i + 1);
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
+        Cell* cell = cell_array[i];
+        for (uint64_t j = 0; j < cell->reference_array.count; j++) {
+            const Reference* ref = cell->reference_array[j];
+            if (ref->type != ReferenceType::Cell) continue;
+            const uint64_t position = index.get(ref->cell->name);
+            if (position > 0 && library.cell_array[position - 1] == ref->cell)
+                cell->writable_reference(j)->cell = cell_array[position - 1];
+        }
+    }
+    index.clear();
+
+    rawcell_array.copy_from(library.rawcell_array);
+}
+
 void Library::get_shape_tags(Set<Tag>& result) const {
     for (uint64_t i = 0; i < cell_array.count; i++) {
         cell_array[i]->get_shape_tags(result);
@@ -143,6 +194,105 @@ RawCell* Library::get_rawcell(const char* rawcell_name) const {
     return NULL;
 }
 
+// Name of the cell, rawcell or name a reference refers to
+static const char* reference_target(const Reference* reference) {
+    switch (reference->type) {
+        case ReferenceType::Cell:
+            return reference->cell->name;
+        case ReferenceType::RawCell:
+            return reference->rawcell->name;
+        case ReferenceType::Name:
+            return reference->name;
+    }
+    return NULL;
+}
+
+static void rename_reference(Reference* reference, const char* new_name) {
+    uint64_t size = 1 + strlen(new_name);
+    reference->name = (char*)reallocate(reference->name, size);
+    memcpy(reference->name, new_name, size);
+}
+
+// Test whether a reference refers to the cell or rawcell being replaced
+// (either old_cell or old_rawcell, named old_name) and must be updated to
+// refer to new_cell or new_rawcell (whichever is not NULL).  References by name
+// must be updated only if the name changes.
+static bool reference_replaced(const Reference* reference, const Cell* old_cell,
+                               const RawCell* old_rawcell, const char* old_name,
+                               const Cell* new_cell, const RawCell* new_rawcell) {
+    switch (reference->type) {
+        case ReferenceType::Cell:
+            return old_cell ? reference->cell == old_cell
+                            : strcmp(reference->cell->name, old_name) == 0;
+        case ReferenceType::RawCell:
+            return old_rawcell ? reference->rawcell == old_rawcell
+                               : strcmp(reference->rawcell->name, old_name) == 0;
+        case ReferenceType::Name: {
+            const char* new_name = new_cell ? new_cell->name : new_rawcell->name;
+            return strcmp(reference->name, old_name) == 0 && strcmp(old_name, new_name) != 0;
+        }
+    }
+    return false;
+}
+
+// Update a reference to the cell or rawcell being replaced (see
+// reference_replaced).  References by name are renamed.  References to other
+// cells are not modified.
+static void replace_reference(Reference* reference, const Cell* old_cell,
+                              const RawCell* old_rawcell, const char* old_name, Cell* new_cell,
+                              RawCell* new_rawcell) {
+    if (!reference_replaced(reference, old_cell, old_rawcell, old_name, new_cell, new_rawcell))
+        return;
+    if (reference->type == ReferenceType::Name) {
+        rename_reference(reference, new_cell ? new_cell->name : new_rawcell->name);
+    } else if (new_cell) {
+        reference->type = ReferenceType::Cell;
+        reference->cell = new_cell;
+    } else {
+        reference->type = ReferenceType::RawCell;
+        reference->rawcell = new_rawcell;
+    }
+}
+
+// Move the references in the index entry for old_name that no longer refer
+// to that name to the entries for their new targets.
+static void update_reference_index(Map<Array<Reference*>>& index, const char* old_name) {
+    Array<Reference*> array = index.get(old_name);
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < array.count; i++) {
+        Reference* reference = array[i];
+        const char* target = reference_target(reference);
+        if (strcmp(target, old_name) == 0) {
+            array[count++] = reference;
+        } else {
+            Array<Reference*> moved = index.get(target);
+            moved.append(reference);
+            index.set(target, moved);
+        }
+    }
+    array.count = count;
+    if (count > 0) {
+        index.set(old_name, array);
+    } else {
+        array.clear();
+        index.del(old_name);
+    }
+}
+
+void Library::reference_index(Map<Array<Reference*>>& result) {
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        Cell* cell = cell_array[i];
+        for (uint64_t j = 0; j < cell->reference_array.count; j++) {
+            // Indexed references are modified in place
+            Reference* reference = cell->writable_reference(j);
+            const char* target = reference_target(reference);
+            Array<Reference*> array = result.get(target);
+            array.append(reference);
+            result.set(target, array);
+        }
+    }
+}
+
 void Library::rename_cell(const char* old_name, const char* new_name) {
     Cell* cell = get_cell(old_name);
     if (cell) {
@@ -152,169 +302,589 @@ void Library::rename_cell(const char* old_name, const char* new_name) {
 
 void Library::rename_cell(Cell* cell, const char* new_name) {
     const char* old_name = cell->name;
-    uint64_t size = 1 + strlen(new_name);
     for (uint64_t i = 0; i < cell_array.count; ++i) {
-        Array<Reference*> ref_array = cell_array[i]->reference_array;
-        for (uint64_t j = 0; j < ref_array.count; ++j) {
-            Reference* ref = ref_array[j];
+        Cell* c = cell_array[i];
+        for (uint64_t j = 0; j < c->reference_array.count; ++j) {
+            Reference* ref = c->reference_array[j];
             if (ref->type == ReferenceType::Name && strcmp(ref->name, old_name) == 0) {
-                ref->name = (char*)reallocate(ref->name, size);
-                memcpy(ref->name, new_name, size);
+                rename_reference(c->writable_reference(j), new_name);
             }
         }
     }
+    uint64_t size = 1 + strlen(new_name);
     cell->name = (char*)reallocate(cell->name, size);
     memcpy(cell->name, new_name, size);
 }
 
-void Library::replace_cell(Cell* old_cell, Cell* new_cell) {
-    uint64_t index = cell_array.index(old_cell);
-    if (index < cell_array.count) {
-        cell_array.items[index] = new_cell;
+void Library::rename_cell(Cell* cell, const char* new_name, Map<Array<Reference*>>& index) {
+    char* old_name = copy_string(cell->name, NULL);
+    Array<Reference*> array = index.get(old_name);
+    for (uint64_t i = 0; i < array.count; i++) {
+        Reference* ref = array[i];
+        if (ref->type == ReferenceType::Name) rename_reference(ref, new_name);
     }
-
-    const char* old_name = old_cell->name;
-    const char* new_name = new_cell->name;
     uint64_t size = 1 + strlen(new_name);
-    bool rename = strcmp(old_name, new_name) != 0;
-    for (uint64_t i = 0; i < cell_array.count; ++i) {
-        Array<Reference*> ref_array = cell_array[i]->reference_array;
-        for (uint64_t j = 0; j < ref_array.count; ++j) {
-            Reference* ref = ref_array[j];
-            switch (ref->type) {
-                case ReferenceType::Cell:
-                    if (ref->cell == old_cell) {
-                        ref->cell = new_cell;
-                    }
-                    break;
-                case ReferenceType::RawCell:
-                    if (strcmp(ref->rawcell->name, old_name) == 0) {
-                        ref->type = ReferenceType::Cell;
-                        ref->cell = new_cell;
-                    }
-                    break;
-                case ReferenceType::Name:
-                    if (rename && (strcmp(ref->name, old_name) == 0)) {
-                        ref->name = (char*)reallocate(ref->name, size);
-                        memcpy(ref->name, new_name, size);
-                    }
-                    break;
+    cell->name = (char*)reallocate(cell->name, size);
+    memcpy(cell->name, new_name, size);
+    update_reference_index(index, old_name);
+    free_allocation(old_name);
+}
+
+void Library::rename_cells(const Map<const char*>& names) {
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        Cell* cell = cell_array[i];
+        for (uint64_t j = 0; j < cell->reference_array.count; j++) {
+            Reference* ref = cell->reference_array[j];
+            if (ref->type != ReferenceType::Name) continue;
+            const char* new_name = names.get(ref->name);
+            if (new_name) rename_reference(cell->writable_reference(j), new_name);
+        }
+    }
+    // Cells are renamed only after all lookups, so names can be swapped
+    Array<const char*> new_names = {};
+    new_names.ensure_slots(cell_array.count);
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        new_names.append_unsafe(names.get(cell_array[i]->name));
+    }
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        const char* new_name = new_names[i];
+        if (!new_name) continue;
+        Cell* cell = cell_array[i];
+        uint64_t size = 1 + strlen(new_name);
+        cell->name = (char*)reallocate(cell->name, size);
+        memcpy(cell->name, new_name, size);
+    }
+    new_names.clear();
+}
+
+// Update all references in library (or only those in index, if not NULL) to
+// the replaced cell or rawcell.
+static void replace_references(const Library& library, const Cell* old_cell,
+                               const RawCell* old_rawcell, Cell* new_cell, RawCell* new_rawcell,
+                               Map<Array<Reference*>>* index) {
+    const char* old_name = old_cell ? old_cell->name : old_rawcell->name;
+    if (index) {
+        Array<Reference*> array = index->get(old_name);
+        for (uint64_t i = 0; i < array.count; i++) {
+            replace_reference(array[i], old_cell, old_rawcell, old_name, new_cell, new_rawcell);
+        }
+        update_reference_index(*index, old_name);
+        return;
+    }
+    for (uint64_t i = 0; i < library.cell_array.count; ++i) {
+        Cell* cell = library.cell_array[i];
+        for (uint64_t j = 0; j < cell->reference_array.count; ++j) {
+            if (reference_replaced(cell->reference_array[j], old_cell, old_rawcell, old_name,
+                                   new_cell, new_rawcell)) {
+                replace_reference(cell->writable_reference(j), old_cell, old_rawcell, old_name,
+                                  new_cell, new_rawcell);
             }
         }
     }
 }
 
+// Replace old_cell or old_rawcell (whichever is not NULL) in the library
+// arrays with new_cell or new_rawcell, if present.
+static void replace_library_entry(Library& library, Cell* old_cell, RawCell* old_rawcell,
+                                  Cell* new_cell, RawCell* new_rawcell) {
+    if (old_cell) {
+        uint64_t index = library.cell_array.index(old_cell);
+        if (index == library.cell_array.count) return;
+        if (new_cell) {
+            library.cell_array.items[index] = new_cell;
+        } else {
+            library.cell_array.remove_unordered(index);
+            library.rawcell_array.append(new_rawcell);
+        }
+    } else {
+        uint64_t index = library.rawcell_array.index(old_rawcell);
+        if (index == library.rawcell_array.count) return;
+        if (new_rawcell) {
+            library.rawcell_array.items[index] = new_rawcell;
+        } else {
+            library.rawcell_array.remove_unordered(index);
+            library.cell_array.append(new_cell);
+        }
+    }
+}
+
+void Library::replace_cell(Cell* old_cell, Cell* new_cell) {
+    replace_library_entry(*this, old_cell, NULL, new_cell, NULL);
+    replace_references(*this, old_cell, NULL, new_cell, NULL, NULL);
+}
+
 void Library::replace_cell(RawCell* old_cell, Cell* new_cell) {
-    uint64_t index = rawcell_array.index(old_cell);
-    if (index < rawcell_array.count) {
-        rawcell_array.remove_unordered(index);
-        cell_array.append(new_cell);
+    replace_library_entry(*this, NULL, old_cell, new_cell, NULL);
+    replace_references(*this, NULL, old_cell, new_cell, NULL, NULL);
+}
+
+void Library::replace_cell(Cell* old_cell, RawCell* new_cell) {
+    replace_library_entry(*this, old_cell, NULL, NULL, new_cell);
+    replace_references(*this, old_cell, NULL, NULL, new_cell, NULL);
+}
+
+void Library::replace_cell(RawCell* old_cell, RawCell* new_cell) {
+    replace_library_entry(*this, NULL, old_cell, NULL, new_cell);
+    replace_references(*this, NULL, old_cell, NULL, new_cell, NULL);
+}
+
+void Library::replace_cell(Cell* old_cell, Cell* new_cell, Map<Array<Reference*>>& index) {
+    replace_library_entry(*this, old_cell, NULL, new_cell, NULL);
+    replace_references(*this, old_cell, NULL, new_cell, NULL, &index);
+}
+
+void Library::replace_cell(RawCell* old_cell, Cell* new_cell, Map<Array<Reference*>>& index) {
+    replace_library_entry(*this, NULL, old_cell, new_cell, NULL);
+    replace_references(*this, NULL, old_cell, new_cell, NULL, &index);
+}
+
+void Library::replace_cell(Cell* old_cell, RawCell* new_cell, Map<Array<Reference*>>& index) {
+    replace_library_entry(*this, old_cell, NULL, NULL, new_cell);
+    replace_references(*this, old_cell, NULL, NULL, new_cell, &index);
+}
+
+void Library::replace_cell(RawCell* old_cell, RawCell* new_cell,
+                           Map<Array<Reference*>>& index) {
+    replace_library_entry(*this, NULL, old_cell, NULL, new_cell);
+    replace_references(*this, NULL, old_cell, NULL, new_cell, &index);
+}
+
+void Library::replace_cells(const Map<Cell*>& replacements) {
+    // Replaced cells and rawcells are removed; replacements not yet in the
+    // library are appended.
+    Map<Cell*> present = {};
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        Cell* cell = cell_array[i];
+        if (replacements.get(cell->name) == NULL) {
+            cell_array[count++] = cell;
+            present.set(cell->name, cell);
+        }
+    }
+    cell_array.count = count;
+    count = 0;
+    for (uint64_t i = 0; i < rawcell_array.count; i++) {
+        RawCell* rawcell = rawcell_array[i];
+        if (replacements.get(rawcell->name) == NULL) rawcell_array[count++] = rawcell;
     }
+    rawcell_array.count = count;
+    for (MapItem<Cell*>* item = replacements.next(NULL); item; item = replacements.next(item)) {
+        Cell* cell = item->value;
+        if (present.get(cell->name) != cell) {
+            cell_array.append(cell);
+            present.set(cell->name, cell);
+        }
+    }
+    present.clear();
 
-    const char* old_name = old_cell->name;
-    const char* new_name = new_cell->name;
-    uint64_t size = 1 + strlen(new_name);
-    bool rename = strcmp(old_name, new_name) != 0;
-    for (uint64_t i = 0; i < cell_array.count; ++i) {
-        Array<Reference*> ref_array = cell_array[i]->reference_array;
-        for (uint64_t j = 0; j < ref_array.count; ++j) {
-            Reference* ref = ref_array[j];
-            switch (ref->type) {
-                case ReferenceType::Cell:
-                    if (strcmp(ref->cell->name, old_name) == 0) {
-                        ref->cell = new_cell;
-                    }
-                    break;
-                case ReferenceType::RawCell:
-                    if (ref->rawcell == old_cell) {
-                        ref->type = ReferenceType::Cell;
-                        ref->cell = new_cell;
-                    }
-                    break;
-                case ReferenceType::Name:
-                    if (rename && (strcmp(ref->name, old_name) == 0)) {
-                        ref->name = (char*)reallocate(ref->name, size);
-                        memcpy(ref->name, new_name, size);
-                    }
-                    break;
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        Cell* cell = cell_array[i];
+        for (uint64_t j = 0; j < cell->reference_array.count; j++) {
+            Reference* ref = cell->reference_array[j];
+            Cell* new_cell = replacements.get(reference_target(ref));
+            if (!new_cell) continue;
+            if (ref->type == ReferenceType::Name) {
+                if (strcmp(ref->name, new_cell->name) != 0)
+                    rename_reference(cell->writable_reference(j), new_cell->name);
+            } else if (ref->type != ReferenceType::Cell || ref->cell != new_cell) {
+                ref = cell->writable_reference(j);
+                ref->type = ReferenceType::Cell;
+                ref->cell = new_cell;
             }
         }
     }
 }
 
-void Library::replace_cell(Cell* old_cell, RawCell* new_cell) {
-    uint64_t index = cell_array.index(old_cell);
-    if (index < cell_array.count) {
-        cell_array.remove_unordered(index);
-        rawcell_array.append(new_cell);
+struct DeduplicateEntry {
+    uint64_t hash;
+    uint64_t index;
+};
+
+static bool deduplicate_entry_order(const DeduplicateEntry& e1, const DeduplicateEntry& e2) {
+    return e1.hash < e2.hash || (e1.hash == e2.hash && e1.index < e2.index);
+}
+
+static Vec2 lower_left_corner(const Cell* cell, const Map<GeometryInfo>& geometry_cache) {
+    GeometryInfo info = geometry_cache.get(cell->name);
+    if (info.bounding_box_valid && info.bounding_box_min.x <= info.bounding_box_max.x)
+        return info.bounding_box_min;
+    return Vec2{0, 0};
+}
+
+void Library::deduplicate(bool translation_invariant, Array<Cell*>& removed,
+                          Array<Cell*>& replacements) {
+    const double scaling = unit / precision;
+    Map<uint64_t> cache = {};
+    Map<GeometryInfo> geometry_cache = {};
+    Array<DeduplicateEntry> entries = {};
+    entries.ensure_slots(cell_array.count);
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        const Cell* cell = cell_array[i];
+        uint64_t h = translation_invariant ? cell->content_hash(scaling, cache, geometry_cache)
+                                           : cell->content_hash(scaling, cache);
+        entries.append_unsafe(DeduplicateEntry{h, i});
+    }
+    sort(entries, deduplicate_entry_order);
+
+    // Index (+1) in removed, by name, of the cells to be replaced, and the
+    // translation from their replacements
+    Map<uint64_t> removed_index = {};
+    Array<Vec2> translations = {};
+    const uint64_t start = removed.count;
+    uint64_t keep = 0;
+    for (uint64_t i = 1; i < entries.count; i++) {
+        if (entries[i].hash != entries[keep].hash) {
+            keep = i;
+            continue;
+        }
+        Cell* cell = cell_array[entries[i].index];
+        Cell* replacement = cell_array[entries[keep].index];
+        removed.append(cell);
+        replacements.append(replacement);
+        translations.append(translation_invariant
+                                ? lower_left_corner(cell, geometry_cache) -
+                                      lower_left_corner(replacement, geometry_cache)
+                                : Vec2{0, 0});
+        removed_index.set(cell->name, removed.count - start);
     }
+    entries.clear();
 
-    const char* old_name = old_cell->name;
-    const char* new_name = new_cell->name;
-    uint64_t size = 1 + strlen(new_name);
-    bool rename = strcmp(old_name, new_name) != 0;
-    for (uint64_t i = 0; i < cell_array.count; ++i) {
-        Array<Reference*> ref_array = cell_array[i]->reference_array;
-        for (uint64_t j = 0; j < ref_array.count; ++j) {
-            Reference* ref = ref_array[j];
-            switch (ref->type) {
-                case ReferenceType::Cell:
-                    if (ref->cell == old_cell) {
-                        ref->type = ReferenceType::RawCell;
-                        ref->rawcell = new_cell;
-                    }
-                    break;
-                case ReferenceType::RawCell:
-                    if (strcmp(ref->rawcell->name, old_name) == 0) {
-                        ref->rawcell = new_cell;
-                    }
-                    break;
-                case ReferenceType::Name:
-                    if (rename && (strcmp(ref->name, old_name) == 0)) {
-                        ref->name = (char*)reallocate(ref->name, size);
-                        memcpy(ref->name, new_name, size);
-                    }
-                    break;
+    if (translations.count > 0) {
+        // Equivalent to replace_cell for each removed cell, but in a single
+        // pass over all references
+        for (uint64_t i = 0; i < cell_array.count; i++) {
+            Cell* cell = cell_array[i];
+            for (uint64_t j = 0; j < cell->reference_array.count; j++) {
+                Reference* ref = cell->reference_array[j];
+                if (ref->type == ReferenceType::Cell) {
+                    uint64_t index = removed_index.get(ref->cell->name);
+                    if (index == 0 || removed[start + index - 1] != ref->cell) continue;
+                    ref = cell->writable_reference(j);
+                    ref->cell = replacements[start + index - 1];
+                    Vec2 v = translations[index - 1] * ref->magnification;
+                    if (ref->x_reflection) v.y = -v.y;
+                    double ca = cos(ref->rotation);
+                    double sa = sin(ref->rotation);
+                    ref->origin += Vec2{v.x * ca - v.y * sa, v.x * sa + v.y * ca};
+                } else if (ref->type == ReferenceType::Name) {
+                    uint64_t index = removed_index.get(ref->name);
+                    if (index == 0) continue;
+                    ref = cell->writable_reference(j);
+                    const char* new_name = replacements[start + index - 1]->name;
+                    uint64_t size = 1 + strlen(new_name);
+                    ref->name = (char*)reallocate(ref->name, size);
+                    memcpy(ref->name, new_name, size);
+                }
             }
         }
+
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < cell_array.count; i++) {
+            Cell* cell = cell_array[i];
+            uint64_t index = removed_index.get(cell->name);
+            if (index == 0 || removed[start + index - 1] != cell) cell_array[count++] = cell;
+        }
+        cell_array.count = count;
     }
+
+    translations.clear();
+    removed_index.clear();
+    cache.clear();
+    clear_geometry_cache(geometry_cache);
 }
 
-void Library::replace_cell(RawCell* old_cell, RawCell* new_cell) {
-    uint64_t index = rawcell_array.index(old_cell);
-    if (index < rawcell_array.count) {
-        rawcell_array.items[index] = new_cell;
+// Cells sharing elements through copy-on-write storage cannot be modified
+// concurrently, so they are unshared before parallel loops.
+static void unshare_cells(Array<Cell*>& cell_array) {
+    for (uint64_t i = 0; i < cell_array.count; i++) cell_array[i]->unshare();
+}
+
+// Elements can still be shared between cells (or appear more than once in the
+// same cell), so transformations are applied to the unique elements of all
+// cells, each one exactly once.
+struct UniqueElements {
+    Array<Polygon*> polygon_array;
+    Array<FlexPath*> flexpath_array;
+    Array<RobustPath*> robustpath_array;
+    Array<Reference*> reference_array;
+    Array<Label*> label_array;
+
+    void clear() {
+        polygon_array.clear();
+        flexpath_array.clear();
+        robustpath_array.clear();
+        reference_array.clear();
+        label_array.clear();
     }
+};
 
-    const char* old_name = old_cell->name;
-    const char* new_name = new_cell->name;
-    uint64_t size = 1 + strlen(new_name);
-    bool rename = strcmp(old_name, new_name) != 0;
-    for (uint64_t i = 0; i < cell_array.count; ++i) {
-        Array<Reference*> ref_array = cell_array[i]->reference_array;
-        for (uint64_t j = 0; j < ref_array.count; ++j) {
-            Reference* ref = ref_array[j];
-            switch (ref->type) {
-                case ReferenceType::Cell:
-                    if (strcmp(ref->cell->name, old_name) == 0) {
-                        ref->type = ReferenceType::RawCell;
-                        ref->rawcell = new_cell;
-                    }
-                    break;
-                case ReferenceType::RawCell:
-                    if (ref->rawcell == old_cell) {
-                        ref->rawcell = new_cell;
-                    }
-                    break;
-                case ReferenceType::Name:
-                    if (rename && (strcmp(ref->name, old_name) == 0)) {
-                        ref->name = (char*)reallocate(ref->name, size);
-                        memcpy(ref->name, new_name, size);
-                    }
-                    break;
-            }
+template <class T>
+static void unique_items(const Array<Cell*>& cell_array, Array<T*> Cell::*member,
+                         Array<T*>& result) {
+    Set<T*> set = {};
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        const Array<T*>& array = cell_array[i]->*member;
+        for (uint64_t j = 0; j < array.count; j++) set.add(array[j]);
+    }
+    set.to_array(result);
+    set.clear();
+}
+
+static void unique_elements(const Array<Cell*>& cell_array, UniqueElements& result) {
+    unique_items(cell_array, &Cell::polygon_array, result.polygon_array);
+    unique_items(cell_array, &Cell::flexpath_array, result.flexpath_array);
+    unique_items(cell_array, &Cell::robustpath_array, result.robustpath_array);
+    unique_items(cell_array, &Cell::reference_array, result.reference_array);
+    unique_items(cell_array, &Cell::label_array, result.label_array);
+}
+
+void Library::remap_tags(const TagMap& map) {
+    unshare_cells(cell_array);
+    UniqueElements unique = {};
+    unique_elements(cell_array, unique);
+
+    Array<Polygon*>& polygon_array = unique.polygon_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)polygon_array.count; i++) {
+        polygon_array[i]->tag = map.get(polygon_array[i]->tag);
+    }
+
+    Array<FlexPath*>& flexpath_array = unique.flexpath_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)flexpath_array.count; i++) {
+        FlexPath* path = flexpath_array[i];
+        for (uint64_t j = 0; j < path->num_elements; j++) {
+            path->elements[j].tag = map.get(path->elements[j].tag);
+        }
+    }
+
+    Array<RobustPath*>& robustpath_array = unique.robustpath_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)robustpath_array.count; i++) {
+        RobustPath* path = robustpath_array[i];
+        for (uint64_t j = 0; j < path->num_elements; j++) {
+            path->elements[j].tag = map.get(path->elements[j].tag);
         }
     }
+
+    Array<Label*>& label_array = unique.label_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)label_array.count; i++) {
+        label_array[i]->tag = map.get(label_array[i]->tag);
+    }
+
+    unique.clear();
+    for (uint64_t i = 0; i < cell_array.count; i++) cell_array[i]->modification_count++;
+}
+
+static void scale_coordinates(double* coords, uint64_t count, double factor) {
+    GDSTK_SIMD
+    for (uint64_t i = 0; i < count; i++) coords[i] *= factor;
+}
+
+static void scale_repetition(Repetition& repetition, double factor) {
+    if (repetition.type == RepetitionType::Explicit) {
+        scale_coordinates((double*)repetition.offsets.items, 2 * repetition.offsets.count, factor);
+    } else if (repetition.type == RepetitionType::ExplicitX ||
+               repetition.type == RepetitionType::ExplicitY) {
+        scale_coordinates(repetition.coords.items, repetition.coords.count, factor);
+    } else {
+        repetition.transform(factor, false, 0);
+    }
+}
+
+void Library::rescale(double new_unit) {
+    const double factor = unit / new_unit;
+    unit = new_unit;
+    if (factor == 1) return;
+    unshare_cells(cell_array);
+    UniqueElements unique = {};
+    unique_elements(cell_array, unique);
+
+    Array<Polygon*>& polygon_array = unique.polygon_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)polygon_array.count; i++) {
+        Polygon* polygon = polygon_array[i];
+        scale_coordinates((double*)polygon->point_array.items, 2 * polygon->point_array.count,
+                          factor);
+        scale_repetition(polygon->repetition, factor);
+    }
+
+    Array<FlexPath*>& flexpath_array = unique.flexpath_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)flexpath_array.count; i++) {
+        FlexPath* path = flexpath_array[i];
+        // Widths are always scaled with the unit
+        const bool scale_width = path->scale_width;
+        path->scale_width = true;
+        path->scale(factor, Vec2{0, 0});
+        path->scale_width = scale_width;
+        path->spine.tolerance *= factor;
+        path->spine.last_ctrl *= factor;
+        FlexPathElement* el = path->elements;
+        for (uint64_t ne = path->num_elements; ne > 0; ne--, el++) el->bend_radius *= factor;
+        scale_repetition(path->repetition, factor);
+    }
+
+    Array<RobustPath*>& robustpath_array = unique.robustpath_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)robustpath_array.count; i++) {
+        RobustPath* path = robustpath_array[i];
+        const bool scale_width = path->scale_width;
+        path->scale_width = true;
+        path->scale(factor, Vec2{0, 0});
+        path->scale_width = scale_width;
+        path->tolerance *= factor;
+        scale_repetition(path->repetition, factor);
+    }
+
+    Array<Reference*>& reference_array = unique.reference_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)reference_array.count; i++) {
+        reference_array[i]->origin *= factor;
+        scale_repetition(reference_array[i]->repetition, factor);
+    }
+
+    Array<Label*>& label_array = unique.label_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)label_array.count; i++) {
+        label_array[i]->origin *= factor;
+        scale_repetition(label_array[i]->repetition, factor);
+    }
+
+    unique.clear();
+    for (uint64_t i = 0; i < cell_array.count; i++) cell_array[i]->modification_count++;
+}
+
+// Snap coordinates to multiples of grid, returning the number of coordinates
+// moved.  If apply is false, coordinates are only counted, not changed.
+static uint64_t snap_coordinates(double* coords, uint64_t count, double grid, bool apply) {
+    const double inv_grid = 1 / grid;
+    const double tolerance = 1e-6 * grid;
+    uint64_t moved = 0;
+    if (apply) {
+        GDSTK_SIMD_SUM(moved)
+        for (uint64_t i = 0; i < count; i++) {
+            const double snapped = grid * floor(coords[i] * inv_grid + 0.5);
+            moved += fabs(snapped - coords[i]) > tolerance ? 1 : 0;
+            coords[i] = snapped;
+        }
+    } else {
+        GDSTK_SIMD_SUM(moved)
+        for (uint64_t i = 0; i < count; i++) {
+            const double snapped = grid * floor(coords[i] * inv_grid + 0.5);
+            moved += fabs(snapped - coords[i]) > tolerance ? 1 : 0;
+        }
+    }
+    return moved;
+}
+
+static uint64_t snap_repetition(Repetition& repetition, double grid, bool apply) {
+    switch (repetition.type) {
+        case RepetitionType::Rectangular:
+            return snap_coordinates((double*)&repetition.spacing, 2, grid, apply);
+        case RepetitionType::Regular:
+            return snap_coordinates((double*)&repetition.v1, 2, grid, apply) +
+                   snap_coordinates((double*)&repetition.v2, 2, grid, apply);
+        case RepetitionType::Explicit:
+            return snap_coordinates((double*)repetition.offsets.items,
+                                    2 * repetition.offsets.count, grid, apply);
+        case RepetitionType::ExplicitX:
+        case RepetitionType::ExplicitY:
+            return snap_coordinates(repetition.coords.items, repetition.coords.count, grid,
+                                    apply);
+        default:
+            return 0;
+    }
+}
+
+static uint64_t snap_polygon(Polygon* polygon, double grid, bool apply) {
+    Array<Vec2>& point_array = polygon->point_array;
+    return snap_coordinates((double*)point_array.items, 2 * point_array.count, grid, apply) +
+           snap_repetition(polygon->repetition, grid, apply);
+}
+
+static uint64_t snap_flexpath(FlexPath* path, double grid, bool apply) {
+    Array<Vec2>& point_array = path->spine.point_array;
+    return snap_coordinates((double*)point_array.items, 2 * point_array.count, grid, apply) +
+           snap_repetition(path->repetition, grid, apply);
+}
+
+static uint64_t snap_reference(Reference* reference, double grid, bool apply) {
+    return snap_coordinates((double*)&reference->origin, 2, grid, apply) +
+           snap_repetition(reference->repetition, grid, apply);
+}
+
+static uint64_t snap_label(Label* label, double grid, bool apply) {
+    return snap_coordinates((double*)&label->origin, 2, grid, apply) +
+           snap_repetition(label->repetition, grid, apply);
+}
+
+// Count the coordinates that snapping would move in cell, without changing it.
+static uint64_t cell_snap_count(const Cell* cell, double grid) {
+    uint64_t moved = 0;
+    Polygon** polygon = cell->polygon_array.items;
+    for (uint64_t i = cell->polygon_array.count; i > 0; i--, polygon++) {
+        moved += snap_polygon(*polygon, grid, false);
+    }
+    FlexPath** flexpath = cell->flexpath_array.items;
+    for (uint64_t i = cell->flexpath_array.count; i > 0; i--, flexpath++) {
+        moved += snap_flexpath(*flexpath, grid, false);
+    }
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        moved += snap_reference(*reference, grid, false);
+    }
+    Label** label = cell->label_array.items;
+    for (uint64_t i = cell->label_array.count; i > 0; i--, label++) {
+        moved += snap_label(*label, grid, false);
+    }
+    return moved;
+}
+
+void Library::snap(double grid, Array<uint64_t>& moved) {
+    unshare_cells(cell_array);
+    const uint64_t first = moved.count;
+    moved.ensure_slots(cell_array.count);
+    moved.count += cell_array.count;
+    // Counts are taken before snapping, so that elements shared between cells
+    // are counted in each of them.
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)cell_array.count; i++) {
+        moved[first + i] = cell_snap_count(cell_array[i], grid);
+    }
+
+    UniqueElements unique = {};
+    unique_elements(cell_array, unique);
+
+    Array<Polygon*>& polygon_array = unique.polygon_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)polygon_array.count; i++) {
+        snap_polygon(polygon_array[i], grid, true);
+    }
+
+    Array<FlexPath*>& flexpath_array = unique.flexpath_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)flexpath_array.count; i++) {
+        snap_flexpath(flexpath_array[i], grid, true);
+    }
+
+    Array<Reference*>& reference_array = unique.reference_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)reference_array.count; i++) {
+        snap_reference(reference_array[i], grid, true);
+    }
+
+    Array<Label*>& label_array = unique.label_array;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)label_array.count; i++) {
+        snap_label(label_array[i], grid, true);
+    }
+
+    unique.clear();
+    for (uint64_t i = 0; i < cell_array.count; i++) {
+        if (moved[first + i] > 0) cell_array[i]->modification_count++;
+    }
 }
 
 ErrorCode Library::write_gds(const char* filename, uint64_t max_points, tm* timestamp) const {
@@ -406,6 +976,265 @@ static void* zalloc(void*, uInt count, uInt size) { return allocate(count * size
 
 static void zfree(void*, void* ptr) { free_allocation(ptr); }
 
+// Write the contents of cell to out (not including the CELL record itself).
+// References to cells missing from cell_name_map are written with explicit
+// names, unless new_names is true, in which case the referenced names are
+// added to the map with the next available reference numbers.
+static ErrorCode cell_contents_to_oas(const Cell* cell, OasisStream& out, OasisState& state,
+                                      Map<uint64_t>& cell_name_map, bool new_names,
+                                      Map<uint64_t>& text_string_map) {
+    ErrorCode error_code = ErrorCode::NoError;
+    ErrorCode err;
+
+    // TODO: Use modal variables
+    Polygon** poly_p = cell->polygon_array.items;
+    for (uint64_t j = cell->polygon_array.count; j > 0; j--) {
+        err = (*poly_p++)->to_oas(out, state);
+        if (err != ErrorCode::NoError) error_code = err;
+    }
+
+    FlexPath** flexpath_p = cell->flexpath_array.items;
+    for (uint64_t j = cell->flexpath_array.count; j > 0; j--) {
+        FlexPath* path = *flexpath_p++;
+        if (path->simple_path) {
+            err = path->to_oas(out, state);
+            if (err != ErrorCode::NoError) error_code = err;
+        } else {
+            Array<Polygon*> array = {};
+            err = path->to_polygons(false, 0, array);
+            if (err != ErrorCode::NoError) error_code = err;
+            poly_p = array.items;
+            for (uint64_t k = array.count; k > 0; k--) {
+                Polygon* poly = *poly_p++;
+                err = poly->to_oas(out, state);
+                if (err != ErrorCode::NoError) error_code = err;
+                poly->clear();
+                free_allocation(poly);
+            }
+            array.clear();
+        }
+    }
+
+    RobustPath** robustpath_p = cell->robustpath_array.items;
+    for (uint64_t j = cell->robustpath_array.count; j > 0; j--) {
+        RobustPath* path = *robustpath_p++;
+        if (path->simple_path) {
+            err = path->to_oas(out, state);
+            if (err != ErrorCode::NoError) error_code = err;
+        } else {
+            Array<Polygon*> array = {};
+            err = path->to_polygons(false, 0, array);
+            if (err != ErrorCode::NoError) error_code = err;
+            poly_p = array.items;
+            for (uint64_t k = array.count; k > 0; k--) {
+                Polygon* poly = *poly_p++;
+                err = poly->to_oas(out, state);
+                if (err != ErrorCode::NoError) error_code = err;
+                poly->clear();
+                free_allocation(poly);
+            }
+            array.clear();
+        }
+    }
+
+    Reference** ref_p = cell->reference_array.items;
+    for (uint64_t j = cell->reference_array.count; j > 0; j--) {
+        Reference* ref = *ref_p++;
+        if (ref->type == ReferenceType::RawCell) {
+            if (error_logger)
+                fputs("[GDSTK] Reference to a RawCell cannot be used in an OASIS file.\n",
+                      error_logger);
+            error_code = ErrorCode::MissingReference;
+            continue;
+        }
+        const char* name_ = (ref->type == ReferenceType::Cell) ? ref->cell->name : ref->name;
+        bool reference_exists = cell_name_map.has_key(name_);
+        if (!reference_exists && new_names) {
+            cell_name_map.set(name_, cell_name_map.count);
+            reference_exists = true;
+        }
+        uint8_t info = reference_exists ? 0xF0 : 0xB0;
+        bool has_repetition = ref->repetition.get_count() > 1;
+        if (has_repetition) info |= 0x08;
+        if (ref->x_reflection) info |= 0x01;
+        int64_t m;
+        if (ref->magnification == 1.0 && is_multiple_of_pi_over_2(ref->rotation, m)) {
+            if (m < 0) {
+                info |= ((uint8_t)(0x03 & ((m % 4) + 4))) << 1;
+            } else {
+                info |= ((uint8_t)(0x03 & (m % 4))) << 1;
+            }
+            oasis_putc((int)OasisRecord::PLACEMENT, out);
+            oasis_putc(info, out);
+            if (reference_exists) {
+                uint64_t index = cell_name_map.get(name_);
+                oasis_write_unsigned_integer(out, index);
+            } else {
+                uint64_t len = strlen(name_);
+                oasis_write_unsigned_integer(out, len);
+                oasis_write(name_, 1, len, out);
+            }
+        } else {
+            if (ref->magnification != 1) info |= 0x04;
+            if (ref->rotation != 0) info |= 0x02;
+            oasis_putc((int)OasisRecord::PLACEMENT_TRANSFORM, out);
+            oasis_putc(info, out);
+            if (reference_exists) {
+                uint64_t index = cell_name_map.get(name_);
+                oasis_write_unsigned_integer(out, index);
+            } else {
+                uint64_t len = strlen(name_);
+                oasis_write_unsigned_integer(out, len);
+                oasis_write(name_, 1, len, out);
+            }
+            if (ref->magnification != 1) {
+                oasis_write_real(out, ref->magnification);
+            }
+            if (ref->rotation != 0) {
+                oasis_write_real(out, ref->rotation * (180.0 / M_PI));
+            }
+        }
+        oasis_write_integer(out, (int64_t)llround(ref->origin.x * state.scaling));
+        oasis_write_integer(out, (int64_t)llround(ref->origin.y * state.scaling));
+        if (has_repetition) oasis_write_repetition(out, ref->repetition, state.scaling);
+        err = properties_to_oas(ref->properties, out, state);
+        if (err != ErrorCode::NoError) error_code = err;
+    }
+
+    Label** label_p = cell->label_array.items;
+    for (uint64_t j = cell->label_array.count; j > 0; j--) {
+        Label* label = *label_p++;
+        uint8_t info = 0x7B;
+        bool has_repetition = label->repetition.get_count() > 1;
+        if (has_repetition) info |= 0x04;
+        oasis_putc((int)OasisRecord::TEXT, out);
+        oasis_putc(info, out);
+        uint64_t index;
+        if (text_string_map.has_key(label->text)) {
+            index = text_string_map.get(label->text);
+        } else {
+            index = text_string_map.count;
+            text_string_map.set(label->text, index);
+        }
+        oasis_write_unsigned_integer(out, index);
+        oasis_write_unsigned_integer(out, get_layer(label->tag));
+        oasis_write_unsigned_integer(out, get_type(label->tag));
+        oasis_write_integer(out, (int64_t)llround(label->origin.x * state.scaling));
+        oasis_write_integer(out, (int64_t)llround(label->origin.y * state.scaling));
+        if (has_repetition) oasis_write_repetition(out, label->repetition, state.scaling);
+        err = properties_to_oas(label->properties, out, state);
+        if (err != ErrorCode::NoError) error_code = err;
+    }
+    return error_code;
+}
+
+// Compress size bytes from data and write them as a CBLOCK record to block,
+// which must be zeroed.  The record is written in memory, so this function can
+// be used concurrently for different cells.
+static ErrorCode oas_compress_cblock(const uint8_t* data, uint64_t size, uint8_t compression_level,
+                                     OasisStream& block) {
+    ErrorCode error_code = ErrorCode::NoError;
+    z_stream s = {};
+    s.zalloc = zalloc;
+    s.zfree = zfree;
+    if (deflateInit2(&s, compression_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        if (error_logger) fputs("[GDSTK] Unable to initialize zlib.\n", error_logger);
+        error_code = ErrorCode::ZlibError;
+    }
+    s.avail_out = deflateBound(&s, (uLong)size);
+    uint8_t* buffer = (uint8_t*)allocate(s.avail_out);
+    s.next_out = buffer;
+    s.avail_in = (uInt)size;
+    s.next_in = (uint8_t*)data;
+    int ret = deflate(&s, Z_FINISH);
+    if (ret != Z_STREAM_END) {
+        if (error_logger) fputs("[GDSTK] Unable to compress CBLOCK.\n", error_logger);
+        error_code = ErrorCode::ZlibError;
+    }
+
+    block.data_size = s.total_out + 32;
+    block.data = (uint8_t*)allocate(block.data_size);
+    block.cursor = block.data;
+    oasis_putc((int)OasisRecord::CBLOCK, block);
+    oasis_putc(0, block);
+    oasis_write_unsigned_integer(block, size);
+    oasis_write_unsigned_integer(block, s.total_out);
+    oasis_write(buffer, 1, s.total_out, block);
+    free_allocation(buffer);
+    deflateEnd(&s);
+    return error_code;
+}
+
+// Write the text string and property tables followed by the END record with
+// the table offsets, padding and validation signature.
+static void oas_write_tables(OasisStream& out, OasisState& state, Map<uint64_t>& text_string_map,
+                             uint64_t cell_name_offset) {
+    uint64_t text_string_offset = text_string_map.count > 0 ? ftell(out.file) : 0;
+    for (MapItem<uint64_t>* item = text_string_map.next(NULL); item;
+         item = text_string_map.next(item)) {
+        oasis_putc((int)OasisRecord::TEXTSTRING, out);
+        uint64_t len = strlen(item->key);
+        oasis_write_unsigned_integer(out, len);
+        oasis_write(item->key, 1, len, out);
+        oasis_write_unsigned_integer(out, item->value);
+    }
+
+    uint64_t prop_name_offset = state.property_name_map.count > 0 ? ftell(out.file) : 0;
+    for (MapItem<uint64_t>* item = state.property_name_map.next(NULL); item;
+         item = state.property_name_map.next(item)) {
+        oasis_putc((int)OasisRecord::PROPNAME, out);
+        uint64_t len = strlen(item->key);
+        oasis_write_unsigned_integer(out, len);
+        oasis_write(item->key, 1, len, out);
+        oasis_write_unsigned_integer(out, item->value);
+    }
+
+    uint64_t prop_string_offset = state.property_value_array.count > 0 ? ftell(out.file) : 0;
+    PropertyValue** value_p = state.property_value_array.items;
+    for (uint64_t i = state.property_value_array.count; i > 0; i--) {
+        PropertyValue* value = *value_p++;
+        oasis_putc((int)OasisRecord::PROPSTRING_IMPLICIT, out);
+        oasis_write_unsigned_integer(out, value->count);
+        oasis_write(value->bytes, 1, value->count, out);
+    }
+
+    oasis_putc((int)OasisRecord::END, out);
+
+    // END (1) + table-offsets (?) + b-string length (2) + padding + validation (1 or 5) = 256
+    uint64_t pad_len = 256 - 1 - 2 - 1 + ftell(out.file);
+    if (out.crc32 || out.checksum32) pad_len -= 4;
+
+    // Table offsets
+    oasis_putc(1, out);
+    oasis_write_unsigned_integer(out, cell_name_offset);
+    oasis_putc(1, out);
+    oasis_write_unsigned_integer(out, text_string_offset);
+    oasis_putc(1, out);
+    oasis_write_unsigned_integer(out, prop_name_offset);
+    oasis_putc(1, out);
+    oasis_write_unsigned_integer(out, prop_string_offset);
+    oasis_putc(1, out);
+    oasis_putc(0, out);  // LAYERNAME table
+    oasis_putc(1, out);
+    oasis_putc(0, out);  // XNAME table
+
+    pad_len -= ftell(out.file);
+    oasis_write_unsigned_integer(out, pad_len);
+    for (; pad_len > 0; pad_len--) oasis_putc(0, out);
+
+    if (out.crc32) {
+        oasis_putc(1, out);
+        little_endian_swap32(&out.signature, 1);
+        fwrite(&out.signature, 4, 1, out.file);
+    } else if (out.checksum32) {
+        oasis_putc(2, out);
+        little_endian_swap32(&out.signature, 1);
+        fwrite(&out.signature, 4, 1, out.file);
+    } else {
+        oasis_putc(0, out);
+    }
+}
+
 ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
                              uint8_t compression_level, uint16_t config_flags) {
     ErrorCode error_code = ErrorCode::NoError;
@@ -618,142 +1447,8 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
             out.cursor = out.data;
         }
 
-        // TODO: Use modal variables
-        // Cell contents
-        Polygon** poly_p = cell->polygon_array.items;
-        for (uint64_t j = cell->polygon_array.count; j > 0; j--) {
-            err = (*poly_p++)->to_oas(out, state);
-            if (err != ErrorCode::NoError) error_code = err;
-        }
-
-        FlexPath** flexpath_p = cell->flexpath_array.items;
-        for (uint64_t j = cell->flexpath_array.count; j > 0; j--) {
-            FlexPath* path = *flexpath_p++;
-            if (path->simple_path) {
-                err = path->to_oas(out, state);
-                if (err != ErrorCode::NoError) error_code = err;
-            } else {
-                Array<Polygon*> array = {};
-                err = path->to_polygons(false, 0, array);
-                if (err != ErrorCode::NoError) error_code = err;
-                poly_p = array.items;
-                for (uint64_t k = array.count; k > 0; k--) {
-                    Polygon* poly = *poly_p++;
-                    err = poly->to_oas(out, state);
-                    if (err != ErrorCode::NoError) error_code = err;
-                    poly->clear();
-                    free_allocation(poly);
-                }
-                array.clear();
-            }
-        }
-
-        RobustPath** robustpath_p = cell->robustpath_array.items;
-        for (uint64_t j = cell->robustpath_array.count; j > 0; j--) {
-            RobustPath* path = *robustpath_p++;
-            if (path->simple_path) {
-                err = path->to_oas(out, state);
-                if (err != ErrorCode::NoError) error_code = err;
-            } else {
-                Array<Polygon*> array = {};
-                err = path->to_polygons(false, 0, array);
-                if (err != ErrorCode::NoError) error_code = err;
-                poly_p = array.items;
-                for (uint64_t k = array.count; k > 0; k--) {
-                    Polygon* poly = *poly_p++;
-                    err = poly->to_oas(out, state);
-                    if (err != ErrorCode::NoError) error_code = err;
-                    poly->clear();
-                    free_allocation(poly);
-                }
-                array.clear();
-            }
-        }
-
-        Reference** ref_p = cell->reference_array.items;
-        for (uint64_t j = cell->reference_array.count; j > 0; j--) {
-            Reference* ref = *ref_p++;
-            if (ref->type == ReferenceType::RawCell) {
-                if (error_logger)
-                    fputs("[GDSTK] Reference to a RawCell cannot be used in an OASIS file.\n",
-                          error_logger);
-                error_code = ErrorCode::MissingReference;
-                continue;
-            }
-            const char* name_ = (ref->type == ReferenceType::Cell) ? ref->cell->name : ref->name;
-            bool reference_exists = cell_name_map.has_key(name_);
-            uint8_t info = reference_exists ? 0xF0 : 0xB0;
-            bool has_repetition = ref->repetition.get_count() > 1;
-            if (has_repetition) info |= 0x08;
-            if (ref->x_reflection) info |= 0x01;
-            int64_t m;
-            if (ref->magnification == 1.0 && is_multiple_of_pi_over_2(ref->rotation, m)) {
-                if (m < 0) {
-                    info |= ((uint8_t)(0x03 & ((m % 4) + 4))) << 1;
-                } else {
-                    info |= ((uint8_t)(0x03 & (m % 4))) << 1;
-                }
-                oasis_putc((int)OasisRecord::PLACEMENT, out);
-                oasis_putc(info, out);
-                if (reference_exists) {
-                    uint64_t index = cell_name_map.get(name_);
-                    oasis_write_unsigned_integer(out, index);
-                } else {
-                    uint64_t len = strlen(name_);
-                    oasis_write_unsigned_integer(out, len);
-                    oasis_write(ref->name, 1, len, out);
-                }
-            } else {
-                if (ref->magnification != 1) info |= 0x04;
-                if (ref->rotation != 0) info |= 0x02;
-                oasis_putc((int)OasisRecord::PLACEMENT_TRANSFORM, out);
-                oasis_putc(info, out);
-                if (reference_exists) {
-                    uint64_t index = cell_name_map.get(name_);
-                    oasis_write_unsigned_integer(out, index);
-                } else {
-                    uint64_t len = strlen(name_);
-                    oasis_write_unsigned_integer(out, len);
-                    oasis_write(ref->name, 1, len, out);
-                }
-                if (ref->magnification != 1) {
-                    oasis_write_real(out, ref->magnification);
-                }
-                if (ref->rotation != 0) {
-                    oasis_write_real(out, ref->rotation * (180.0 / M_PI));
-                }
-            }
-            oasis_write_integer(out, (int64_t)llround(ref->origin.x * state.scaling));
-            oasis_write_integer(out, (int64_t)llround(ref->origin.y * state.scaling));
-            if (has_repetition) oasis_write_repetition(out, ref->repetition, state.scaling);
-            err = properties_to_oas(ref->properties, out, state);
-            if (err != ErrorCode::NoError) error_code = err;
-        }
-
-        Label** label_p = cell->label_array.items;
-        for (uint64_t j = cell->label_array.count; j > 0; j--) {
-            Label* label = *label_p++;
-            uint8_t info = 0x7B;
-            bool has_repetition = label->repetition.get_count() > 1;
-            if (has_repetition) info |= 0x04;
-            oasis_putc((int)OasisRecord::TEXT, out);
-            oasis_putc(info, out);
-            uint64_t index;
-            if (text_string_map.has_key(label->text)) {
-                index = text_string_map.get(label->text);
-            } else {
-                index = text_string_map.count;
-                text_string_map.set(label->text, index);
-            }
-            oasis_write_unsigned_integer(out, index);
-            oasis_write_unsigned_integer(out, get_layer(label->tag));
-            oasis_write_unsigned_integer(out, get_type(label->tag));
-            oasis_write_integer(out, (int64_t)llround(label->origin.x * state.scaling));
-            oasis_write_integer(out, (int64_t)llround(label->origin.y * state.scaling));
-            if (has_repetition) oasis_write_repetition(out, label->repetition, state.scaling);
-            err = properties_to_oas(label->properties, out, state);
-            if (err != ErrorCode::NoError) error_code = err;
-        }
+        err = cell_contents_to_oas(cell, out, state, cell_name_map, false, text_string_map);
+        if (err != ErrorCode::NoError) error_code = err;
 
         if (compression_level > 0) {
             uint64_t uncompressed_size = out.cursor - out.data;
@@ -761,32 +1456,11 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
 
             // Skip empty cells
             if (uncompressed_size > 0) {
-                z_stream s = {};
-                s.zalloc = zalloc;
-                s.zfree = zfree;
-                if (deflateInit2(&s, compression_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) !=
-                    Z_OK) {
-                    if (error_logger) fputs("[GDSTK] Unable to initialize zlib.\n", error_logger);
-                    error_code = ErrorCode::ZlibError;
-                }
-                s.avail_out = deflateBound(&s, (uLong)uncompressed_size);
-                uint8_t* buffer = (uint8_t*)allocate(s.avail_out);
-                s.next_out = buffer;
-                s.avail_in = (uInt)uncompressed_size;
-                s.next_in = out.data;
-                int ret = deflate(&s, Z_FINISH);
-                if (ret != Z_STREAM_END) {
-                    if (error_logger) fputs("[GDSTK] Unable to compress CBLOCK.\n", error_logger);
-                    error_code = ErrorCode::ZlibError;
-                }
-
-                oasis_putc((int)OasisRecord::CBLOCK, out);
-                oasis_putc(0, out);
-                oasis_write_unsigned_integer(out, uncompressed_size);
-                oasis_write_unsigned_integer(out, s.total_out);
-                oasis_write(buffer, 1, s.total_out, out);
-                free_allocation(buffer);
-                deflateEnd(&s);
+                OasisStream block = {};
+                err = oas_compress_cblock(out.data, uncompressed_size, compression_level, block);
+                if (err != ErrorCode::NoError) error_code = err;
+                oasis_write(block.data, 1, block.cursor - block.data, out);
+                free_allocation(block.data);
             }
         }
     }
@@ -831,104 +1505,131 @@ ErrorCode Library::write_oas(const char* filename, double circle_tolerance,
         err = properties_to_oas(cell->properties, out, state);
         if (err != ErrorCode::NoError) error_code = err;
     }
-    for (MapItem<GeometryInfo>* item = cache.next(NULL); item; item = cache.next(item)) {
-        item->value.clear();
-    }
-    cache.clear();
-
-    uint64_t text_string_offset = text_string_map.count > 0 ? ftell(out.file) : 0;
-    for (MapItem<uint64_t>* item = text_string_map.next(NULL); item;
-         item = text_string_map.next(item)) {
-        oasis_putc((int)OasisRecord::TEXTSTRING, out);
-        uint64_t len = strlen(item->key);
-        oasis_write_unsigned_integer(out, len);
-        oasis_write(item->key, 1, len, out);
-        oasis_write_unsigned_integer(out, item->value);
-    }
-
-    uint64_t prop_name_offset = state.property_name_map.count > 0 ? ftell(out.file) : 0;
-    for (MapItem<uint64_t>* item = state.property_name_map.next(NULL); item;
-         item = state.property_name_map.next(item)) {
-        oasis_putc((int)OasisRecord::PROPNAME, out);
-        uint64_t len = strlen(item->key);
-        oasis_write_unsigned_integer(out, len);
-        oasis_write(item->key, 1, len, out);
-        oasis_write_unsigned_integer(out, item->value);
-    }
-
-    uint64_t prop_string_offset = state.property_value_array.count > 0 ? ftell(out.file) : 0;
-    PropertyValue** value_p = state.property_value_array.items;
-    for (uint64_t i = state.property_value_array.count; i > 0; i--) {
-        PropertyValue* value = *value_p++;
-        oasis_putc((int)OasisRecord::PROPSTRING_IMPLICIT, out);
-        oasis_write_unsigned_integer(out, value->count);
-        oasis_write(value->bytes, 1, value->count, out);
-    }
+    clear_geometry_cache(cache);
 
-    oasis_putc((int)OasisRecord::END, out);
+    oas_write_tables(out, state, text_string_map, cell_name_offset);
 
-    // END (1) + table-offsets (?) + b-string length (2) + padding + validation (1 or 5) = 256
-    uint64_t pad_len = 256 - 1 - 2 - 1 + ftell(out.file);
-    if (out.crc32 || out.checksum32) pad_len -= 4;
+    fclose(out.file);
+    free_allocation(out.data);
 
-    // Table offsets
-    oasis_putc(1, out);
-    oasis_write_unsigned_integer(out, cell_name_offset);
-    oasis_putc(1, out);
-    oasis_write_unsigned_integer(out, text_string_offset);
-    oasis_putc(1, out);
-    oasis_write_unsigned_integer(out, prop_name_offset);
-    oasis_putc(1, out);
-    oasis_write_unsigned_integer(out, prop_string_offset);
-    oasis_putc(1, out);
-    oasis_putc(0, out);  // LAYERNAME table
-    oasis_putc(1, out);
-    oasis_putc(0, out);  // XNAME table
+    cell_name_map.clear();
+    cell_offset_map.clear();
+    text_string_map.clear();
+    state.property_name_map.clear();
+    state.property_value_array.clear();
+    state.property_value_map.clear();
+    return error_code;
+}
 
-    pad_len -= ftell(out.file);
-    oasis_write_unsigned_integer(out, pad_len);
-    for (; pad_len > 0; pad_len--) oasis_putc(0, out);
+static const char* gdsii_record_names[] = {
+    "HEADER",    "BGNLIB",   "LIBNAME",   "UNITS",      "ENDLIB",      "BGNSTR",
+    "STRNAME",   "ENDSTR",   "BOUNDARY",  "PATH",       "SREF",        "AREF",
+    "TEXT",      "LAYER",    "DATATYPE",  "WIDTH",      "XY",          "ENDEL",
+    "SNAME",     "COLROW",   "TEXTNODE",  "NODE",       "TEXTTYPE",    "PRESENTATION",
+    "SPACING",   "STRING",   "STRANS",    "MAG",        "ANGLE",       "UINTEGER",
+    "USTRING",   "REFLIBS",  "FONTS",     "PATHTYPE",   "GENERATIONS", "ATTRTABLE",
+    "STYPTABLE", "STRTYPE",  "ELFLAGS",   "ELKEY",      "LINKTYPE",    "LINKKEYS",
+    "NODETYPE",  "PROPATTR", "PROPVALUE", "BOX",        "BOXTYPE",     "PLEX",
+    "BGNEXTN",   "ENDEXTN",  "TAPENUM",   "TAPECODE",   "STRCLASS",    "RESERVED",
+    "FORMAT",    "MASK",     "ENDMASKS",  "LIBDIRSIZE", "SRFNAME",     "LIBSECUR"};
+
+// Read the next record in buffer (with at least 65537 bytes, to allow for a
+// null-terminated string with maximal length) and convert its data to the
+// native byte order.
+static ErrorCode gdsii_read_native_record(FILE* in, uint8_t* buffer, uint64_t& record_length,
+                                          uint64_t& data_length) {
+    record_length = 65537;
+    ErrorCode err = gdsii_read_record(in, buffer, record_length);
+    if (err != ErrorCode::NoError) return err;
+
+    // printf("0x%02X %s (%" PRIu64 " bytes)", buffer[2],
+    //        buffer[2] < COUNT(gdsii_record_names) ? gdsii_record_names[buffer[2]] : "",
+    //        record_length);
+
+    switch ((GdsiiDataType)buffer[3]) {
+        case GdsiiDataType::BitArray:
+        case GdsiiDataType::TwoByteSignedInteger:
+            data_length = (record_length - 4) / 2;
+            big_endian_swap16((uint16_t*)(buffer + 4), data_length);
+            break;
+        case GdsiiDataType::FourByteSignedInteger:
+        case GdsiiDataType::FourByteReal:
+            data_length = (record_length - 4) / 4;
+            big_endian_swap32((uint32_t*)(buffer + 4), data_length);
+            break;
+        case GdsiiDataType::EightByteReal:
+            data_length = (record_length - 4) / 8;
+            big_endian_swap64((uint64_t*)(buffer + 4), data_length);
+            break;
+        default:
+            data_length = record_length - 4;
+    }
+    return ErrorCode::NoError;
+}
 
-    if (out.crc32) {
-        oasis_putc(1, out);
-        little_endian_swap32(&out.signature, 1);
-        fwrite(&out.signature, 4, 1, out.file);
-    } else if (out.checksum32) {
-        oasis_putc(2, out);
-        little_endian_swap32(&out.signature, 1);
-        fwrite(&out.signature, 4, 1, out.file);
-    } else {
-        oasis_putc(0, out);
+GdsReader gdsreader_init(const char* filename, double unit, double tolerance,
+                         const Set<Tag>* shape_tags, ErrorCode* error_code) {
+    GdsReader reader = {};
+    reader.in = fopen(filename, "rb");
+    if (reader.in == NULL) {
+        fputs("[GDSTK] Unable to open GDSII file for input.\n", stderr);
+        if (error_code) *error_code = ErrorCode::InputFileOpenError;
+        return reader;
     }
+    reader.factor = 1;
+    reader.tolerance = tolerance;
+    reader.shape_tags = shape_tags;
 
-    fclose(out.file);
-    free_allocation(out.data);
-
-    cell_name_map.clear();
-    cell_offset_map.clear();
-    text_string_map.clear();
-    state.property_name_map.clear();
-    state.property_value_array.clear();
-    return error_code;
+    uint8_t buffer[65537];
+    uint64_t* data64 = (uint64_t*)(buffer + 4);
+    char* str = (char*)(buffer + 4);
+    while (true) {
+        uint64_t record_length;
+        uint64_t data_length;
+        ErrorCode err = gdsii_read_native_record(reader.in, buffer, record_length, data_length);
+        if (err != ErrorCode::NoError) {
+            if (error_code) *error_code = err;
+            reader.close();
+            return reader;
+        }
+        switch ((GdsiiRecord)(buffer[2])) {
+            case GdsiiRecord::LIBNAME:
+                if (str[data_length - 1] == 0) data_length--;
+                if (reader.library_name) free_allocation(reader.library_name);
+                reader.library_name = (char*)allocate(data_length + 1);
+                memcpy(reader.library_name, str, data_length);
+                reader.library_name[data_length] = 0;
+                break;
+            case GdsiiRecord::UNITS: {
+                const double db_in_user = gdsii_real_to_double(data64[0]);
+                const double db_in_meters = gdsii_real_to_double(data64[1]);
+                if (unit > 0) {
+                    reader.factor = db_in_meters / unit;
+                    reader.unit = unit;
+                } else {
+                    reader.factor = db_in_user;
+                    reader.unit = db_in_meters / db_in_user;
+                }
+                reader.precision = db_in_meters;
+                if (reader.tolerance <= 0) {
+                    reader.tolerance = reader.precision / reader.unit;
+                }
+                return reader;
+            }
+            case GdsiiRecord::BGNSTR:
+            case GdsiiRecord::ENDLIB:
+                // No UNITS record: leave this record to be read with the cells
+                FSEEK64(reader.in, -(int64_t)record_length, SEEK_CUR);
+                return reader;
+            default:
+                break;
+        }
+    }
 }
 
-Library read_gds(const char* filename, double unit, double tolerance, const Set<Tag>* shape_tags,
-                 ErrorCode* error_code) {
-    const char* gdsii_record_names[] = {
-        "HEADER",    "BGNLIB",   "LIBNAME",   "UNITS",      "ENDLIB",      "BGNSTR",
-        "STRNAME",   "ENDSTR",   "BOUNDARY",  "PATH",       "SREF",        "AREF",
-        "TEXT",      "LAYER",    "DATATYPE",  "WIDTH",      "XY",          "ENDEL",
-        "SNAME",     "COLROW",   "TEXTNODE",  "NODE",       "TEXTTYPE",    "PRESENTATION",
-        "SPACING",   "STRING",   "STRANS",    "MAG",        "ANGLE",       "UINTEGER",
-        "USTRING",   "REFLIBS",  "FONTS",     "PATHTYPE",   "GENERATIONS", "ATTRTABLE",
-        "STYPTABLE", "STRTYPE",  "ELFLAGS",   "ELKEY",      "LINKTYPE",    "LINKKEYS",
-        "NODETYPE",  "PROPATTR", "PROPVALUE", "BOX",        "BOXTYPE",     "PLEX",
-        "BGNEXTN",   "ENDEXTN",  "TAPENUM",   "TAPECODE",   "STRCLASS",    "RESERVED",
-        "FORMAT",    "MASK",     "ENDMASKS",  "LIBDIRSIZE", "SRFNAME",     "LIBSECUR"};
+Cell* GdsReader::read_cell(ErrorCode* error_code) {
+    if (in == NULL) return NULL;
 
-    Library library = {};
-    // One extra char in case we need a 0-terminated string with max count (should never happen, but
-    // it doesn't hurt to be prepared).
     uint8_t buffer[65537];
     int16_t* data16 = (int16_t*)(buffer + 4);
     int32_t* data32 = (int32_t*)(buffer + 4);
@@ -941,111 +1642,35 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
     Reference* reference = NULL;
     Label* label = NULL;
 
-    double factor = 1;
     double width = 0;
     int16_t key = 0;
 
-    FILE* in = fopen(filename, "rb");
-    if (in == NULL) {
-        fputs("[GDSTK] Unable to open GDSII file for input.\n", stderr);
-        if (error_code) *error_code = ErrorCode::InputFileOpenError;
-        return library;
-    }
-
     while (true) {
-        uint64_t record_length = COUNT(buffer);
-        ErrorCode err = gdsii_read_record(in, buffer, record_length);
+        uint64_t record_length;
+        uint64_t data_length;
+        ErrorCode err = gdsii_read_native_record(in, buffer, record_length, data_length);
         if (err != ErrorCode::NoError) {
             if (error_code) *error_code = err;
             break;
         }
 
-        // printf("0x%02X %s (%" PRIu64 " bytes)", buffer[2],
-        //        buffer[2] < COUNT(gdsii_record_names) ? gdsii_record_names[buffer[2]] : "",
-        //        record_length);
-
-        uint64_t data_length;
-        switch ((GdsiiDataType)buffer[3]) {
-            case GdsiiDataType::BitArray:
-            case GdsiiDataType::TwoByteSignedInteger:
-                data_length = (record_length - 4) / 2;
-                big_endian_swap16((uint16_t*)data16, data_length);
-                // for (uint32_t i = 0; i < data_length; i++) printf(" %" PRId16, data16[i]);
-                break;
-            case GdsiiDataType::FourByteSignedInteger:
-            case GdsiiDataType::FourByteReal:
-                data_length = (record_length - 4) / 4;
-                big_endian_swap32((uint32_t*)data32, data_length);
-                // for (uint32_t i = 0; i < data_length; i++) printf(" %" PRId32, data32[i]);
-                break;
-            case GdsiiDataType::EightByteReal:
-                data_length = (record_length - 4) / 8;
-                big_endian_swap64(data64, data_length);
-                // for (uint32_t i = 0; i < data_length; i++)
-                // printf(" %" PRIu64 " (%g)", data64[i], gdsii_real_to_double(data64[i]));
-                break;
-            default:
-                data_length = record_length - 4;
-                // for (uint32_t i = 0; i < data_length; i++) printf(" %c", str[i]);
-        }
-
-        // putchar('\n');
-
         switch ((GdsiiRecord)(buffer[2])) {
             case GdsiiRecord::HEADER:
             case GdsiiRecord::BGNLIB:
-            case GdsiiRecord::ENDSTR:
-                break;
             case GdsiiRecord::LIBNAME:
-                if (str[data_length - 1] == 0) data_length--;
-                library.name = (char*)allocate(data_length + 1);
-                memcpy(library.name, str, data_length);
-                library.name[data_length] = 0;
+            case GdsiiRecord::UNITS:
+                break;
+            case GdsiiRecord::ENDLIB:
+                finished = true;
+                if (cell == NULL) return NULL;
+                if (error_logger) fputs("[GDSTK] Missing ENDSTR record.\n", error_logger);
+                if (error_code) *error_code = ErrorCode::InvalidFile;
+                cell->free_all();
+                free_allocation(cell);
+                return NULL;
+            case GdsiiRecord::ENDSTR:
+                if (cell) return cell;
                 break;
-            case GdsiiRecord::UNITS: {
-                const double db_in_user = gdsii_real_to_double(data64[0]);
-                const double db_in_meters = gdsii_real_to_double(data64[1]);
-                if (unit > 0) {
-                    factor = db_in_meters / unit;
-                    library.unit = unit;
-                } else {
-                    factor = db_in_user;
-                    library.unit = db_in_meters / db_in_user;
-                }
-                library.precision = db_in_meters;
-                if (tolerance <= 0) {
-                    tolerance = library.precision / library.unit;
-                }
-            } break;
-            case GdsiiRecord::ENDLIB: {
-                Map<Cell*> map = {};
-                uint64_t c_size = library.cell_array.count;
-                map.resize((uint64_t)(2.0 + 10.0 / GDSTK_MAP_CAPACITY_THRESHOLD * c_size));
-                Cell** c_item = library.cell_array.items;
-                for (uint64_t i = c_size; i > 0; i--, c_item++) map.set((*c_item)->name, *c_item);
-                c_item = library.cell_array.items;
-                for (uint64_t i = c_size; i > 0; i--) {
-                    cell = *c_item++;
-                    Reference** ref = cell->reference_array.items;
-                    for (uint64_t j = cell->reference_array.count; j > 0; j--) {
-                        reference = *ref++;
-                        Cell* cp = map.get(reference->name);
-                        if (cp) {
-                            free_allocation(reference->name);
-                            reference->type = ReferenceType::Cell;
-                            reference->cell = cp;
-                        } else {
-                            if (error_code) *error_code = ErrorCode::MissingReference;
-                            if (error_logger)
-                                fprintf(error_logger, "[GDSTK] Missing referenced cell %s\n",
-                                        reference->name);
-                        }
-                    }
-                }
-                map.clear();
-                fclose(in);
-                return library;
-            } break;
             case GdsiiRecord::BGNSTR:
                 cell = (Cell*)allocate_clear(sizeof(Cell));
                 break;
@@ -1055,7 +1680,6 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
                     cell->name = (char*)allocate(data_length + 1);
                     memcpy(cell->name, str, data_length);
                     cell->name[data_length] = 0;
-                    library.cell_array.append(cell);
                 }
                 break;
             case GdsiiRecord::BOUNDARY:
@@ -1277,83 +1901,533 @@ Library read_gds(const char* filename, double unit, double tolerance, const Set<
                     }
                 }
                 break;
-            case GdsiiRecord::PROPATTR:
-                key = data16[0];
-                break;
-            case GdsiiRecord::PROPVALUE:
-                if (str[data_length - 1] != 0) str[data_length++] = 0;
-                if (polygon) {
-                    set_gds_property(polygon->properties, key, str);
-                } else if (path) {
-                    set_gds_property(path->properties, key, str);
-                } else if (reference) {
-                    set_gds_property(reference->properties, key, str);
-                } else if (label) {
-                    set_gds_property(label->properties, key, str);
+            case GdsiiRecord::PROPATTR:
+                key = data16[0];
+                break;
+            case GdsiiRecord::PROPVALUE:
+                if (str[data_length - 1] != 0) str[data_length++] = 0;
+                if (polygon) {
+                    set_gds_property(polygon->properties, key, str);
+                } else if (path) {
+                    set_gds_property(path->properties, key, str);
+                } else if (reference) {
+                    set_gds_property(reference->properties, key, str);
+                } else if (label) {
+                    set_gds_property(label->properties, key, str);
+                }
+                break;
+            case GdsiiRecord::BGNEXTN:
+                if (path) path->elements[0].end_extensions.u = factor * data32[0];
+                break;
+            case GdsiiRecord::ENDEXTN:
+                if (path) path->elements[0].end_extensions.v = factor * data32[0];
+                break;
+            // TODO: Consider NODE support (even though it is not available for OASIS)
+            // case GdsiiRecord::TEXTNODE:
+            // case GdsiiRecord::NODE:
+            // case GdsiiRecord::SPACING:
+            // case GdsiiRecord::UINTEGER:
+            // case GdsiiRecord::USTRING:
+            // case GdsiiRecord::REFLIBS:
+            // case GdsiiRecord::FONTS:
+            // case GdsiiRecord::GENERATIONS:
+            // case GdsiiRecord::ATTRTABLE:
+            // case GdsiiRecord::STYPTABLE:
+            // case GdsiiRecord::STRTYPE:
+            // case GdsiiRecord::ELFLAGS:
+            // case GdsiiRecord::ELKEY:
+            // case GdsiiRecord::LINKTYPE:
+            // case GdsiiRecord::LINKKEYS:
+            // case GdsiiRecord::NODETYPE:
+            // case GdsiiRecord::PLEX:
+            // case GdsiiRecord::TAPENUM:
+            // case GdsiiRecord::TAPECODE:
+            // case GdsiiRecord::STRCLASS:
+            // case GdsiiRecord::RESERVED:
+            // case GdsiiRecord::FORMAT:
+            // case GdsiiRecord::MASK:
+            // case GdsiiRecord::ENDMASKS:
+            // case GdsiiRecord::LIBDIRSIZE:
+            // case GdsiiRecord::SRFNAME:
+            // case GdsiiRecord::LIBSECUR:
+            default:
+                if (buffer[2] < COUNT(gdsii_record_names)) {
+                    if (error_logger)
+                        fprintf(error_logger, "[GDSTK] Record type %s (0x%02X) is not supported.\n",
+                                gdsii_record_names[buffer[2]], buffer[2]);
+                } else {
+                    if (error_logger)
+                        fprintf(error_logger, "[GDSTK] Unknown record type 0x%02X.\n", buffer[2]);
+                }
+                if (error_code) *error_code = ErrorCode::UnsupportedRecord;
+        }
+    }
+
+    if (cell) {
+        cell->free_all();
+        free_allocation(cell);
+    }
+    return NULL;
+}
+
+void GdsReader::close() {
+    if (in) fclose(in);
+    in = NULL;
+    if (library_name) free_allocation(library_name);
+    library_name = NULL;
+}
+
+Library read_gds(const char* filename, double unit, double tolerance, const Set<Tag>* shape_tags,
+                 ErrorCode* error_code) {
+    Library library = {};
+    GdsReader reader = gdsreader_init(filename, unit, tolerance, shape_tags, error_code);
+    if (reader.in == NULL) return library;
+
+    library.name = reader.library_name;
+    reader.library_name = NULL;
+    library.unit = reader.unit;
+    library.precision = reader.precision;
+
+    Cell* cell;
+    while ((cell = reader.read_cell(error_code)) != NULL) library.cell_array.append(cell);
+    bool finished = reader.finished;
+    reader.close();
+    if (!finished) {
+        library.free_all();
+        return Library{};
+    }
+
+    Map<Cell*> map = {};
+    uint64_t c_size = library.cell_array.count;
+    map.resize((uint64_t)(2.0 + 10.0 / GDSTK_MAP_CAPACITY_THRESHOLD * c_size));
+    Cell** c_item = library.cell_array.items;
+    for (uint64_t i = c_size; i > 0; i--, c_item++) map.set((*c_item)->name, *c_item);
+    c_item = library.cell_array.items;
+    for (uint64_t i = c_size; i > 0; i--) {
+        cell = *c_item++;
+        Reference** ref = cell->reference_array.items;
+        for (uint64_t j = cell->reference_array.count; j > 0; j--) {
+            Reference* reference = *ref++;
+            Cell* cp = map.get(reference->name);
+            if (cp) {
+                free_allocation(reference->name);
+                reference->type = ReferenceType::Cell;
+                reference->cell = cp;
+            } else {
+                if (error_code) *error_code = ErrorCode::MissingReference;
+                if (error_logger)
+                    fprintf(error_logger, "[GDSTK] Missing referenced cell %s\n",
+                            reference->name);
+            }
+        }
+    }
+    map.clear();
+    return library;
+}
+
+ErrorCode gds_to_oas(const char* gds_filename, const char* oas_filename, double circle_tolerance,
+                     uint8_t compression_level, uint16_t config_flags) {
+    ErrorCode error_code = ErrorCode::NoError;
+    GdsReader reader = gdsreader_init(gds_filename, 0, 0, NULL, &error_code);
+    if (reader.in == NULL) return error_code;
+
+    OasisState state = {};
+    state.circle_tolerance = circle_tolerance;
+    state.config_flags = config_flags;
+    state.scaling = reader.unit / reader.precision;
+
+    if (compression_level > 9) compression_level = 9;
+
+    OasisStream out = {};
+    out.file = fopen(oas_filename, "wb");
+    if (out.file == NULL) {
+        if (error_logger) fputs("[GDSTK] Unable to open OASIS file for output.\n", error_logger);
+        reader.close();
+        return ErrorCode::OutputFileOpenError;
+    }
+    out.crc32 = state.config_flags & OASIS_CONFIG_INCLUDE_CRC32;
+    out.checksum32 = state.config_flags & OASIS_CONFIG_INCLUDE_CHECKSUM32;
+    if (out.crc32) out.signature = crc32(0, NULL, 0);
+
+    char header[] = {'%', 'S', 'E', 'M', 'I',  '-',  'O',
+                     'A', 'S', 'I', 'S', '\r', '\n', (char)OasisRecord::START,
+                     3,   '1', '.', '0'};
+    oasis_write(header, 1, COUNT(header), out);
+    oasis_write_real(out, 1e-6 / reader.precision);
+    oasis_putc(1, out);  // flag indicating that table-offsets will be stored in the END record
+
+    // Reference numbers are assigned to cell names as they are found, either
+    // in cell definitions or in references.
+    Map<uint64_t> cell_name_map = {};
+    Map<uint64_t> cell_offset_map = {};
+    Map<uint64_t> text_string_map = {};
+    bool write_cell_offsets = state.config_flags & OASIS_CONFIG_PROPERTY_CELL_OFFSET;
+
+    // Cells are read and encoded one at a time in batches.  Compression, the
+    // most expensive stage, is done for all cells in a batch in parallel.
+    const uint64_t batch_size = get_thread_count();
+    OasisStream* buffers = (OasisStream*)allocate_clear(batch_size * sizeof(OasisStream));
+    OasisStream* blocks = (OasisStream*)allocate_clear(batch_size * sizeof(OasisStream));
+    ErrorCode* errors = (ErrorCode*)allocate(batch_size * sizeof(ErrorCode));
+    char** names = (char**)allocate(batch_size * sizeof(char*));
+    bool done = false;
+    while (!done) {
+        uint64_t count = 0;
+        while (count < batch_size) {
+            Cell* cell = reader.read_cell(&error_code);
+            if (cell == NULL) {
+                done = true;
+                break;
+            }
+            if (!cell_name_map.has_key(cell->name)) {
+                cell_name_map.set(cell->name, cell_name_map.count);
+            }
+            OasisStream* buffer = buffers + count;
+            if (buffer->data == NULL) {
+                buffer->data_size = 64 * 1024;
+                buffer->data = (uint8_t*)allocate(buffer->data_size);
+            }
+            buffer->cursor = buffer->data;
+            ErrorCode err = cell_contents_to_oas(cell, *buffer, state, cell_name_map, true,
+                                                 text_string_map);
+            if (err != ErrorCode::NoError) error_code = err;
+            names[count++] = cell->name;
+            cell->name = NULL;
+            cell->free_all();
+            free_allocation(cell);
+        }
+
+        if (compression_level > 0) {
+            GDSTK_PARALLEL_FOR
+            for (int64_t i = 0; i < (int64_t)count; i++) {
+                errors[i] = ErrorCode::NoError;
+                uint64_t size = buffers[i].cursor - buffers[i].data;
+                if (size > 0) {
+                    errors[i] = oas_compress_cblock(buffers[i].data, size, compression_level,
+                                                    blocks[i]);
+                }
+            }
+        }
+
+        for (uint64_t i = 0; i < count; i++) {
+            if (write_cell_offsets) cell_offset_map.set(names[i], ftell(out.file));
+            oasis_putc((int)OasisRecord::CELL_REF_NUM, out);
+            oasis_write_unsigned_integer(out, cell_name_map.get(names[i]));
+            if (compression_level > 0) {
+                if (errors[i] != ErrorCode::NoError) error_code = errors[i];
+                if (blocks[i].data) {
+                    oasis_write(blocks[i].data, 1, blocks[i].cursor - blocks[i].data, out);
+                    free_allocation(blocks[i].data);
+                    blocks[i].data = NULL;
+                }
+            } else {
+                oasis_write(buffers[i].data, 1, buffers[i].cursor - buffers[i].data, out);
+            }
+            free_allocation(names[i]);
+        }
+    }
+    for (uint64_t i = 0; i < batch_size; i++) free_allocation(buffers[i].data);
+    free_allocation(buffers);
+    free_allocation(blocks);
+    free_allocation(errors);
+    free_allocation(names);
+
+    if (!reader.finished && error_code == ErrorCode::NoError) error_code = ErrorCode::InputFileError;
+    reader.close();
+
+    // Cell names in reference number order
+    const uint64_t c_size = cell_name_map.count;
+    char** cell_names = (char**)allocate(c_size * sizeof(char*));
+    for (MapItem<uint64_t>* item = cell_name_map.next(NULL); item;
+         item = cell_name_map.next(item)) {
+        cell_names[item->value] = item->key;
+    }
+
+    uint64_t cell_name_offset = c_size > 0 ? ftell(out.file) : 0;
+    for (uint64_t i = 0; i < c_size; i++) {
+        char* name_ = cell_names[i];
+        oasis_putc((int)OasisRecord::CELLNAME_IMPLICIT, out);
+        uint64_t len = strlen(name_);
+        oasis_write_unsigned_integer(out, len);
+        oasis_write(name_, 1, len, out);
+        if (write_cell_offsets) {
+            // Referenced cells not defined in the file have offset 0
+            Property* properties = NULL;
+            set_property(properties, s_cell_offset_property_name, cell_offset_map.get(name_),
+                         true);
+            ErrorCode err = properties_to_oas(properties, out, state);
+            if (err != ErrorCode::NoError) error_code = err;
+            properties_clear(properties);
+        }
+    }
+    free_allocation(cell_names);
+
+    oas_write_tables(out, state, text_string_map, cell_name_offset);
+
+    fclose(out.file);
+    cell_name_map.clear();
+    cell_offset_map.clear();
+    text_string_map.clear();
+    state.property_name_map.clear();
+    state.property_value_array.clear();
+    state.property_value_map.clear();
+    return error_code;
+}
+
+ErrorCode gds_transform(const char* input_filename, const char* output_filename,
+                        const Set<Tag>* shape_tags, const TagMap* tag_map,
+                        const Map<const char*>* cell_names, double unit, double precision) {
+    FILE* in = fopen(input_filename, "rb");
+    if (in == NULL) {
+        if (error_logger) fputs("[GDSTK] Unable to open GDSII file for input.\n", error_logger);
+        return ErrorCode::InputFileOpenError;
+    }
+    FILE* out = fopen(output_filename, "wb");
+    if (out == NULL) {
+        if (error_logger) fputs("[GDSTK] Unable to open GDSII file for output.\n", error_logger);
+        fclose(in);
+        return ErrorCode::OutputFileOpenError;
+    }
+    // Large stream buffers: most records are copied without modification, so
+    // this is mostly bound by I/O.
+    setvbuf(in, NULL, _IOFBF, 1 << 20);
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+    ErrorCode error_code = ErrorCode::NoError;
+    uint8_t buffer[65537];
+    double scaling = 1;
+    bool finished = false;
+
+    // Elements with layer and type are held in element until ENDEL, where
+    // they can be dropped or have their tags remapped.
+    Array<uint8_t> element = {};
+    bool in_element = false;
+    bool is_shape = false;
+    uint64_t layer_position = 0;
+    uint64_t type_position = 0;
+
+    while (!finished) {
+        uint64_t record_length = COUNT(buffer);
+        ErrorCode err = gdsii_read_record(in, buffer, record_length);
+        if (err != ErrorCode::NoError) {
+            error_code = err;
+            break;
+        }
+        // Restore the original byte order of the record length
+        big_endian_swap16((uint16_t*)buffer, 1);
+
+        const GdsiiRecord record = (GdsiiRecord)buffer[2];
+        switch (record) {
+            case GdsiiRecord::UNITS: {
+                uint64_t data64[2];
+                memcpy(data64, buffer + 4, sizeof(data64));
+                big_endian_swap64(data64, 2);
+                const double db_in_user = gdsii_real_to_double(data64[0]);
+                const double db_in_meters = gdsii_real_to_double(data64[1]);
+                const double new_precision = precision > 0 ? precision : db_in_meters;
+                const double new_unit = unit > 0 ? unit : db_in_meters / db_in_user;
+                scaling = db_in_meters / new_precision;
+                data64[0] = gdsii_real_from_double(new_precision / new_unit);
+                data64[1] = gdsii_real_from_double(new_precision);
+                big_endian_swap64(data64, 2);
+                memcpy(buffer + 4, data64, sizeof(data64));
+            } break;
+            case GdsiiRecord::ENDLIB:
+                finished = true;
+                break;
+            case GdsiiRecord::STRNAME:
+            case GdsiiRecord::SNAME:
+                if (cell_names && cell_names->count > 0) {
+                    uint64_t len = record_length - 4;
+                    char* str = (char*)(buffer + 4);
+                    if (len > 0 && str[len - 1] == 0) len--;
+                    str[len] = 0;
+                    const char* new_name = cell_names->get(str);
+                    if (new_name) {
+                        len = strlen(new_name);
+                        if (len > 65530) len = 65530;
+                        memcpy(str, new_name, len);
+                        if (len % 2) str[len++] = 0;
+                        record_length = 4 + len;
+                        uint16_t* length = (uint16_t*)buffer;
+                        *length = (uint16_t)record_length;
+                        big_endian_swap16(length, 1);
+                    }
+                }
+                break;
+            case GdsiiRecord::XY:
+            case GdsiiRecord::WIDTH:
+            case GdsiiRecord::BGNEXTN:
+            case GdsiiRecord::ENDEXTN:
+                if (scaling != 1) {
+                    uint64_t count = (record_length - 4) / 4;
+                    int32_t* data32 = (int32_t*)(buffer + 4);
+                    big_endian_swap32((uint32_t*)data32, count);
+                    for (uint64_t i = 0; i < count; i++) {
+                        data32[i] = (int32_t)llround(data32[i] * scaling);
+                    }
+                    big_endian_swap32((uint32_t*)data32, count);
                 }
                 break;
-            case GdsiiRecord::BGNEXTN:
-                if (path) path->elements[0].end_extensions.u = factor * data32[0];
+            case GdsiiRecord::BOUNDARY:
+            case GdsiiRecord::BOX:
+            case GdsiiRecord::PATH:
+            case GdsiiRecord::RAITHMBMSPATH:
+            case GdsiiRecord::TEXT:
+                in_element = true;
+                is_shape = record != GdsiiRecord::TEXT;
+                element.count = 0;
+                layer_position = 0;
+                type_position = 0;
                 break;
-            case GdsiiRecord::ENDEXTN:
-                if (path) path->elements[0].end_extensions.v = factor * data32[0];
+            case GdsiiRecord::LAYER:
+                if (in_element) layer_position = element.count + 4;
+                break;
+            case GdsiiRecord::DATATYPE:
+            case GdsiiRecord::BOXTYPE:
+            case GdsiiRecord::TEXTTYPE:
+                if (in_element) type_position = element.count + 4;
                 break;
-            // TODO: Consider NODE support (even though it is not available for OASIS)
-            // case GdsiiRecord::TEXTNODE:
-            // case GdsiiRecord::NODE:
-            // case GdsiiRecord::SPACING:
-            // case GdsiiRecord::UINTEGER:
-            // case GdsiiRecord::USTRING:
-            // case GdsiiRecord::REFLIBS:
-            // case GdsiiRecord::FONTS:
-            // case GdsiiRecord::GENERATIONS:
-            // case GdsiiRecord::ATTRTABLE:
-            // case GdsiiRecord::STYPTABLE:
-            // case GdsiiRecord::STRTYPE:
-            // case GdsiiRecord::ELFLAGS:
-            // case GdsiiRecord::ELKEY:
-            // case GdsiiRecord::LINKTYPE:
-            // case GdsiiRecord::LINKKEYS:
-            // case GdsiiRecord::NODETYPE:
-            // case GdsiiRecord::PLEX:
-            // case GdsiiRecord::TAPENUM:
-            // case GdsiiRecord::TAPECODE:
-            // case GdsiiRecord::STRCLASS:
-            // case GdsiiRecord::RESERVED:
-            // case GdsiiRecord::FORMAT:
-            // case GdsiiRecord::MASK:
-            // case GdsiiRecord::ENDMASKS:
-            // case GdsiiRecord::LIBDIRSIZE:
-            // case GdsiiRecord::SRFNAME:
-            // case GdsiiRecord::LIBSECUR:
             default:
-                if (buffer[2] < COUNT(gdsii_record_names)) {
-                    if (error_logger)
-                        fprintf(error_logger, "[GDSTK] Record type %s (0x%02X) is not supported.\n",
-                                gdsii_record_names[buffer[2]], buffer[2]);
-                } else {
-                    if (error_logger)
-                        fprintf(error_logger, "[GDSTK] Unknown record type 0x%02X.\n", buffer[2]);
-                }
-                if (error_code) *error_code = ErrorCode::UnsupportedRecord;
+                break;
+        }
+
+        if (!in_element) {
+            fwrite(buffer, 1, record_length, out);
+            continue;
         }
+
+        element.ensure_slots(record_length);
+        memcpy(element.items + element.count, buffer, record_length);
+        element.count += record_length;
+        if (record != GdsiiRecord::ENDEL) continue;
+
+        in_element = false;
+        uint16_t layer = 0;
+        uint16_t type = 0;
+        if (layer_position > 0) {
+            memcpy(&layer, element.items + layer_position, 2);
+            big_endian_swap16(&layer, 1);
+        }
+        if (type_position > 0) {
+            memcpy(&type, element.items + type_position, 2);
+            big_endian_swap16(&type, 1);
+        }
+        Tag tag = make_tag(layer, type);
+        if (is_shape && shape_tags && !shape_tags->has_value(tag)) continue;
+        if (tag_map) {
+            Tag new_tag = tag_map->get(tag);
+            if (new_tag != tag) {
+                layer = (uint16_t)get_layer(new_tag);
+                type = (uint16_t)get_type(new_tag);
+                big_endian_swap16(&layer, 1);
+                big_endian_swap16(&type, 1);
+                if (layer_position > 0) memcpy(element.items + layer_position, &layer, 2);
+                if (type_position > 0) memcpy(element.items + type_position, &type, 2);
+            }
+        }
+        fwrite(element.items, 1, element.count, out);
     }
+    element.clear();
 
-    library.free_all();
+    if (error_code == ErrorCode::NoError && !finished) {
+        if (error_logger) fputs("[GDSTK] Missing ENDLIB record.\n", error_logger);
+        error_code = ErrorCode::InvalidFile;
+    }
+    if (ferror(out) && error_code == ErrorCode::NoError) {
+        if (error_logger) fputs("[GDSTK] Unable to write GDSII file.\n", error_logger);
+        error_code = ErrorCode::FileError;
+    }
     fclose(in);
-    return Library{};
+    fclose(out);
+    return error_code;
 }
 
 // TODO: verify modal variables are correctly updated
-Library read_oas(const char* filename, double unit, double tolerance, ErrorCode* error_code) {
-    Library library = {};
+// Incremental OASIS reader used by read_oas and oas_to_gds.  Cells are
+// returned by read_cell as soon as they end, that is, at the next CELL, name
+// table or END record.
+//
+// If resolve_names is false, references to the name tables are left for the
+// caller to resolve after the END record: cells and labels without name or
+// text store their table index in owner, references of type Cell store the
+// index in cell, and the properties in unfinished_property_name and
+// unfinished_property_value store their indices in name and unsigned_integer
+// (resolved by resolve_properties).  If resolve_names is true, the name tables
+// must have been loaded beforehand by read_tables, and all names are resolved
+// as the records are read.
+struct OasisReader {
+    OasisStream in;
+    double unit;
+    double precision;
+    double factor;
+    double tolerance;
+    // Table offsets from the START or END record: 6 pairs of strict flag and
+    // offset for the cell name, text string, property name, property string,
+    // layer name and XNAME tables.
+    uint64_t table_offsets[12];
+    bool resolve_names;
+    // Used while pre-loading the tables: properties of cells and elements are
+    // not tracked for resolution, because they are discarded with the cells.
+    bool tables_only;
+    bool finished;  // END record found
+
+    // Modal variables
+    bool modal_absolute_pos;
+    uint32_t modal_layer;
+    uint32_t modal_datatype;
+    uint32_t modal_textlayer;
+    uint32_t modal_texttype;
+    Vec2 modal_placement_pos;
+    Vec2 modal_text_pos;
+    Vec2 modal_geom_pos;
+    Vec2 modal_geom_dim;
+    Repetition modal_repetition;
+    Label* modal_text_string;
+    Reference* modal_placement_cell;
+    Array<Vec2> modal_polygon_points;
+    Array<Vec2> modal_path_points;
+    double modal_path_halfwidth;
+    Vec2 modal_path_extensions;
+    uint8_t modal_ctrapezoid_type;
+    double modal_circle_radius;
+    // Owned copy of the last property name (or its table index, if
+    // modal_property_unfinished) and value list.  Values in modal_property
+    // that still hold a property string index are kept in
+    // modal_unfinished_values.
+    Property* modal_property;
+    bool modal_property_unfinished;
+    Array<PropertyValue*> modal_unfinished_values;
 
-    OasisStream in = {};
+    // Name tables
+    Array<ByteArray> cell_name_table;
+    Array<ByteArray> label_text_table;
+    Array<ByteArray> property_name_table;
+    Array<ByteArray> property_value_table;
+
+    Array<Property*> unfinished_property_name;
+    Array<PropertyValue*> unfinished_property_value;
+
+    Property* properties;          // File-level properties
+    Property* skipped_properties;  // Properties of name records already loaded
+    Property** next_property;
+    Cell* cell;  // Cell being read
+
+    Cell* read_cell(ErrorCode* error_code);
+    ErrorCode read_tables(const char* filename);
+    void resolve_properties();
+    void clear();
+};
+
+static OasisReader oasisreader_init(const char* filename, double unit, double tolerance,
+                                    ErrorCode* error_code) {
+    OasisReader reader = {};
+    OasisStream& in = reader.in;
     in.file = fopen(filename, "rb");
     if (in.file == NULL) {
         if (error_logger) fputs("[GDSTK] Unable to open OASIS file for input.\n", error_logger);
         if (error_code) *error_code = ErrorCode::InputFileOpenError;
-        return library;
+        return reader;
     }
 
     // Check header bytes and START record
@@ -1362,7 +2436,8 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
         if (error_logger) fputs("[GDSTK] Invalid OASIS header found.\n", error_logger);
         if (error_code) *error_code = ErrorCode::InvalidFile;
         fclose(in.file);
-        return library;
+        in.file = NULL;
+        return reader;
     }
 
     // Process START record
@@ -1371,7 +2446,8 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
     if (in.error_code != ErrorCode::NoError) {
         if (error_code) *error_code = in.error_code;
         fclose(in.file);
-        return library;
+        in.file = NULL;
+        return reader;
     }
     if (len != 3 || memcmp(version, "1.0", 3) != 0) {
         if (error_logger) fputs("[GDSTK] Unsupported OASIS file version.\n", error_logger);
@@ -1379,62 +2455,73 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
     }
     free_allocation(version);
 
-    double factor = 1 / oasis_read_real(in);
-    library.precision = 1e-6 * factor;
+    reader.factor = 1 / oasis_read_real(in);
+    reader.precision = 1e-6 * reader.factor;
     if (unit > 0) {
-        library.unit = unit;
-        factor *= 1e-6 / unit;
+        reader.unit = unit;
+        reader.factor *= 1e-6 / unit;
     } else {
-        library.unit = 1e-6;
-    }
-    if (tolerance <= 0) {
-        tolerance = library.precision / library.unit;
+        reader.unit = 1e-6;
     }
+    reader.tolerance = tolerance > 0 ? tolerance : reader.precision / reader.unit;
 
     uint64_t offset_table_flag = oasis_read_unsigned_integer(in);
     if (offset_table_flag == 0) {
-        // Skip offset table
-        for (uint8_t i = 12; i > 0; i--) oasis_read_unsigned_integer(in);
-    }
-
-    // State variables
-    bool modal_absolute_pos = true;
-    uint32_t modal_layer = 0;
-    uint32_t modal_datatype = 0;
-    uint32_t modal_textlayer = 0;
-    uint32_t modal_texttype = 0;
-    Vec2 modal_placement_pos = {0, 0};
-    Vec2 modal_text_pos = {0, 0};
-    Vec2 modal_geom_pos = {0, 0};
-    Vec2 modal_geom_dim = {0, 0};
-    Repetition modal_repetition = {RepetitionType::None};
-    Label* modal_text_string = NULL;
-    Reference* modal_placement_cell = NULL;
-    Array<Vec2> modal_polygon_points = {};
-    modal_polygon_points.append(Vec2{0, 0});
-    Array<Vec2> modal_path_points = {};
-    modal_path_points.append(Vec2{0, 0});
-    double modal_path_halfwidth = 0;
-    Vec2 modal_path_extensions = {0, 0};
-    uint8_t modal_ctrapezoid_type = 0;
-    double modal_circle_radius = 0;
-    Property* modal_property = NULL;
-    PropertyValue* modal_property_value_list = NULL;
-
-    Property** next_property = &library.properties;
-
-    Array<Property*> unfinished_property_name = {};
-    Array<PropertyValue*> unfinished_property_value = {};
-    bool modal_property_unfinished = false;
+        for (uint8_t i = 0; i < 12; i++) reader.table_offsets[i] = oasis_read_unsigned_integer(in);
+    } else {
+        // Table offsets are in the END record, which is always 256 bytes long
+        int64_t position = ftell(in.file);
+        uint8_t record;
+        if (FSEEK64(in.file, -256, SEEK_END) == 0 && fread(&record, 1, 1, in.file) == 1 &&
+            record == (uint8_t)OasisRecord::END) {
+            for (uint8_t i = 0; i < 12; i++) {
+                reader.table_offsets[i] = oasis_read_unsigned_integer(in);
+            }
+        }
+        in.error_code = ErrorCode::NoError;
+        FSEEK64(in.file, position, SEEK_SET);
+    }
 
-    // Name tables
-    Array<ByteArray> cell_name_table = {};
-    Array<ByteArray> label_text_table = {};
-    Array<ByteArray> property_name_table = {};
-    Array<ByteArray> property_value_table = {};
+    reader.modal_absolute_pos = true;
+    reader.modal_repetition.type = RepetitionType::None;
+    reader.modal_polygon_points.append(Vec2{0, 0});
+    reader.modal_path_points.append(Vec2{0, 0});
+    return reader;
+}
 
-    // Elements
-    Cell* cell = NULL;
+// Return the name table entry for the given reference number, or NULL (with
+// an error) if it is not defined.
+static ByteArray* oasis_table_entry(Array<ByteArray>& table, uint64_t index,
+                                    ErrorCode* error_code) {
+    if (index < table.count && table[index].bytes) return table.items + index;
+    if (error_logger)
+        fprintf(error_logger, "[GDSTK] Undefined name reference number %" PRIu64 ".\n", index);
+    if (error_code) *error_code = ErrorCode::InvalidFile;
+    return NULL;
+}
+
+// Replace a property string reference number by the string itself.
+static void oasis_resolve_property_value(Array<ByteArray>& table, PropertyValue* property_value) {
+    uint64_t index = property_value->unsigned_integer;
+    property_value->type = PropertyType::String;
+    property_value->bytes_inline = false;
+    if (index < table.count && table[index].count > 0) {
+        ByteArray* prop_string = table.items + index;
+        property_value->count = prop_string->count;
+        property_value->bytes = (uint8_t*)allocate(prop_string->count);
+        memcpy(property_value->bytes, prop_string->bytes, prop_string->count);
+    } else {
+        property_value->count = 0;
+        property_value->bytes = NULL;
+    }
+}
+
+Cell* OasisReader::read_cell(ErrorCode* error_code) {
+    if (finished || in.file == NULL) return NULL;
+    if (next_property == NULL) next_property = &properties;
+
+    Cell* result = NULL;
+    uint64_t len;
 
     // const char* oasis_record_names[] = {"PAD",
     //                                     "START",
@@ -1473,198 +2560,88 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
     //                                     "CBLOCK"};
 
     OasisRecord record;
-    while ((error_code == NULL || *error_code == ErrorCode::NoError) &&
+    while (result == NULL && !finished &&
+           (error_code == NULL || *error_code == ErrorCode::NoError) &&
            oasis_read(&record, 1, 1, in) == ErrorCode::NoError) {
         // DEBUG_PRINT("Record [%02u] %s\n", (uint8_t)record,
         //             (uint8_t)record < COUNT(oasis_record_names)
         //                 ? oasis_record_names[(uint8_t)record]
         //                 : "---");
+        if (cell == NULL && ((record >= OasisRecord::PLACEMENT && record <= OasisRecord::CIRCLE) ||
+                             record == OasisRecord::XELEMENT || record == OasisRecord::XGEOMETRY)) {
+            if (error_logger) fputs("[GDSTK] Element record found outside cell.\n", error_logger);
+            if (error_code) *error_code = ErrorCode::InvalidFile;
+            break;
+        }
         switch (record) {
             case OasisRecord::PAD:
                 break;
             case OasisRecord::START:
-                // START is parsed before this loop
+                // START is parsed in oasisreader_init
                 if (error_logger)
                     fputs("[GDSTK] Unexpected START record out of position in file.\n",
                           error_logger);
                 if (error_code) *error_code = ErrorCode::InvalidFile;
                 break;
-            case OasisRecord::END: {
+            case OasisRecord::END:
                 FSEEK64(in.file, 0, SEEK_END);
-                library.name = (char*)allocate(4);
-                library.name[0] = 'L';
-                library.name[1] = 'I';
-                library.name[2] = 'B';
-                library.name[3] = 0;
-
-                uint64_t c_size = library.cell_array.count;
-                Map<Cell*> map = {};
-                map.resize((uint64_t)(2.0 + 10.0 / GDSTK_MAP_CAPACITY_THRESHOLD * c_size));
-
-                Cell** cell_p = library.cell_array.items;
-                for (uint64_t i = c_size; i > 0; i--) {
-                    cell = *cell_p++;
-                    if (cell->name == NULL) {
-                        ByteArray* cell_name = cell_name_table.items + (uint64_t)cell->owner;
-                        cell->owner = NULL;
-                        cell->name = copy_string((char*)cell_name->bytes, NULL);
-                        if (cell_name->properties) {
-                            Property* last = cell_name->properties;
-                            while (last->next) last = last->next;
-                            last->next = cell->properties;
-                            cell->properties = cell_name->properties;
-                            cell_name->properties = NULL;
-                        }
-                    }
-                    map.set(cell->name, cell);
-
-                    Label** label_p = cell->label_array.items;
-                    for (uint64_t j = cell->label_array.count; j > 0; j--) {
-                        Label* label = *label_p++;
-                        if (label->text == NULL) {
-                            ByteArray* label_text = label_text_table.items + (uint64_t)label->owner;
-                            label->owner = NULL;
-                            label->text = copy_string((char*)label_text->bytes, NULL);
-                            if (label_text->properties) {
-                                Property* copy = properties_copy(label_text->properties);
-                                Property* last = copy;
-                                while (last->next) last = last->next;
-                                last->next = label->properties;
-                                label->properties = copy;
-                            }
-                        }
-                    }
+                result = cell;
+                cell = NULL;
+                finished = true;
+                break;
+            case OasisRecord::CELLNAME_IMPLICIT:
+            case OasisRecord::CELLNAME:
+            case OasisRecord::TEXTSTRING_IMPLICIT:
+            case OasisRecord::TEXTSTRING:
+            case OasisRecord::PROPNAME_IMPLICIT:
+            case OasisRecord::PROPNAME:
+            case OasisRecord::PROPSTRING_IMPLICIT:
+            case OasisRecord::PROPSTRING: {
+                // Name records end the current cell
+                result = cell;
+                cell = NULL;
+                Array<ByteArray>* table;
+                bool is_string = true;
+                if (record <= OasisRecord::CELLNAME) {
+                    table = &cell_name_table;
+                } else if (record <= OasisRecord::TEXTSTRING) {
+                    table = &label_text_table;
+                } else if (record <= OasisRecord::PROPNAME) {
+                    table = &property_name_table;
+                } else {
+                    table = &property_value_table;
+                    is_string = false;
                 }
-
-                cell_p = library.cell_array.items;
-                for (uint64_t i = c_size; i > 0; i--, cell_p++) {
-                    Reference** ref_p = (*cell_p)->reference_array.items;
-                    for (uint64_t j = (*cell_p)->reference_array.count; j > 0; j--, ref_p++) {
-                        Reference* ref = *ref_p;
-                        if (ref->type == ReferenceType::Cell) {
-                            // Using reference number
-                            ByteArray* cell_name = cell_name_table.items + (uint64_t)ref->cell;
-                            ref->cell = map.get((char*)cell_name->bytes);
-                            if (!ref->cell) {
-                                ref->type = ReferenceType::Name;
-                                ref->name = (char*)allocate(cell_name->count);
-                                memcpy(ref->name, cell_name->bytes, cell_name->count);
-                                if (error_code) *error_code = ErrorCode::MissingReference;
-                                if (error_logger)
-                                    fprintf(error_logger, "[GDSTK] Missing referenced cell %s\n",
-                                            ref->name);
-                            }
-                        } else {
-                            // Using name
-                            cell = map.get(ref->name);
-                            if (cell) {
-                                free_allocation(ref->name);
-                                ref->cell = cell;
-                                ref->type = ReferenceType::Cell;
-                            } else {
-                                if (error_code) *error_code = ErrorCode::MissingReference;
-                                if (error_logger)
-                                    fprintf(error_logger, "[GDSTK] Missing referenced cell %s\n",
-                                            ref->name);
-                            }
+                // Implicit records have odd values
+                bool implicit = ((uint8_t)record & 1) == 1;
+                uint8_t* bytes = oasis_read_string(in, is_string, len);
+                if (resolve_names) {
+                    // Tables were loaded by read_tables
+                    if (!implicit) oasis_read_unsigned_integer(in);
+                    if (bytes) free_allocation(bytes);
+                    properties_clear(skipped_properties);
+                    next_property = &skipped_properties;
+                } else if (implicit) {
+                    table->append(ByteArray{len, bytes, NULL});
+                    next_property = &(*table)[table->count - 1].properties;
+                } else {
+                    uint64_t ref_number = oasis_read_unsigned_integer(in);
+                    if (ref_number >= table->count) {
+                        table->ensure_slots(ref_number + 1 - table->count);
+                        for (uint64_t i = table->count; i < ref_number; i++) {
+                            (*table)[i] = ByteArray{0, NULL, NULL};
                         }
+                        table->count = ref_number + 1;
                     }
+                    (*table)[ref_number] = ByteArray{len, bytes, NULL};
+                    next_property = &(*table)[ref_number].properties;
                 }
-                map.clear();
-
-                Property** prop_p = unfinished_property_name.items;
-                for (uint64_t i = unfinished_property_name.count; i > 0; i--) {
-                    Property* property = *prop_p++;
-                    ByteArray* prop_name = property_name_table.items + (uint64_t)property->name;
-                    property->name = copy_string((char*)prop_name->bytes, NULL);
-                }
-                PropertyValue** prop_value_p = unfinished_property_value.items;
-                for (uint64_t i = unfinished_property_value.count; i > 0; i--) {
-                    PropertyValue* property_value = *prop_value_p++;
-                    ByteArray* prop_string =
-                        property_value_table.items + (uint64_t)property_value->unsigned_integer;
-                    property_value->type = PropertyType::String;
-                    property_value->count = prop_string->count;
-                    property_value->bytes = (uint8_t*)allocate(prop_string->count);
-                    memcpy(property_value->bytes, prop_string->bytes, prop_string->count);
-                }
-                goto CLEANUP;
-            } break;
-            case OasisRecord::CELLNAME_IMPLICIT: {
-                uint8_t* bytes = oasis_read_string(in, true, len);
-                cell_name_table.append(ByteArray{len, bytes, NULL});
-                next_property = &cell_name_table[cell_name_table.count - 1].properties;
-            } break;
-            case OasisRecord::CELLNAME: {
-                uint8_t* bytes = oasis_read_string(in, true, len);
-                uint64_t ref_number = oasis_read_unsigned_integer(in);
-                if (ref_number >= cell_name_table.count) {
-                    cell_name_table.ensure_slots(ref_number + 1 - cell_name_table.count);
-                    for (uint64_t i = cell_name_table.count; i < ref_number; i++) {
-                        cell_name_table[i] = ByteArray{0, NULL, NULL};
-                    }
-                    cell_name_table.count = ref_number + 1;
-                }
-                cell_name_table[ref_number] = ByteArray{len, bytes, NULL};
-                next_property = &cell_name_table[ref_number].properties;
-            } break;
-            case OasisRecord::TEXTSTRING_IMPLICIT: {
-                uint8_t* bytes = oasis_read_string(in, true, len);
-                label_text_table.append(ByteArray{len, bytes, NULL});
-                next_property = &label_text_table[label_text_table.count - 1].properties;
-            } break;
-            case OasisRecord::TEXTSTRING: {
-                uint8_t* bytes = oasis_read_string(in, true, len);
-                uint64_t ref_number = oasis_read_unsigned_integer(in);
-                if (ref_number >= label_text_table.count) {
-                    label_text_table.ensure_slots(ref_number + 1 - label_text_table.count);
-                    for (uint64_t i = label_text_table.count; i < ref_number; i++) {
-                        label_text_table[i] = ByteArray{0, NULL, NULL};
-                    }
-                    label_text_table.count = ref_number + 1;
-                }
-                label_text_table[ref_number] = ByteArray{len, bytes, NULL};
-                next_property = &label_text_table[ref_number].properties;
-            } break;
-            case OasisRecord::PROPNAME_IMPLICIT: {
-                uint8_t* bytes = oasis_read_string(in, true, len);
-                property_name_table.append(ByteArray{len, bytes, NULL});
-                next_property = &property_name_table[property_name_table.count - 1].properties;
-            } break;
-            case OasisRecord::PROPNAME: {
-                uint8_t* bytes = oasis_read_string(in, true, len);
-                uint64_t ref_number = oasis_read_unsigned_integer(in);
-                if (ref_number >= property_name_table.count) {
-                    property_name_table.ensure_slots(ref_number + 1 - property_name_table.count);
-                    for (uint64_t i = property_name_table.count; i < ref_number; i++) {
-                        property_name_table[i] = ByteArray{0, NULL, NULL};
-                    }
-                    property_name_table.count = ref_number + 1;
-                }
-                property_name_table[ref_number] = ByteArray{len, bytes, NULL};
-                next_property = &property_name_table[ref_number].properties;
-            } break;
-            case OasisRecord::PROPSTRING_IMPLICIT: {
-                uint8_t* bytes = oasis_read_string(in, false, len);
-                property_value_table.append(ByteArray{len, bytes, NULL});
-                next_property = &property_value_table[property_value_table.count - 1].properties;
-            } break;
-            case OasisRecord::PROPSTRING: {
-                uint8_t* bytes = oasis_read_string(in, false, len);
-                uint64_t ref_number = oasis_read_unsigned_integer(in);
-                if (ref_number >= property_value_table.count) {
-                    property_value_table.ensure_slots(ref_number + 1 - property_value_table.count);
-                    for (uint64_t i = property_value_table.count; i < ref_number; i++) {
-                        property_value_table[i] = ByteArray{0, NULL, NULL};
-                    }
-                    property_value_table.count = ref_number + 1;
-                }
-                property_value_table[ref_number] = ByteArray{len, bytes, NULL};
-                next_property = &property_value_table[ref_number].properties;
             } break;
             case OasisRecord::LAYERNAME_DATA:
             case OasisRecord::LAYERNAME_TEXT:
                 // Unused record
+                result = cell;
+                cell = NULL;
                 free_allocation(oasis_read_string(in, false, len));
                 for (uint32_t i = 2; i > 0; i--) {
                     uint64_t type = oasis_read_unsigned_integer(in);
@@ -1673,15 +2650,28 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                         oasis_read_unsigned_integer(in);
                     }
                 }
+                properties_clear(skipped_properties);
+                next_property = &skipped_properties;
                 break;
             case OasisRecord::CELL_REF_NUM:
             case OasisRecord::CELL: {
+                result = cell;
                 cell = (Cell*)allocate_clear(sizeof(Cell));
-                library.cell_array.append(cell);
                 next_property = &cell->properties;
                 if (record == OasisRecord::CELL_REF_NUM) {
-                    // Use owner as temporary storage for the reference number
-                    cell->owner = (void*)oasis_read_unsigned_integer(in);
+                    uint64_t ref_number = oasis_read_unsigned_integer(in);
+                    if (resolve_names) {
+                        ByteArray* cell_name =
+                            oasis_table_entry(cell_name_table, ref_number, error_code);
+                        if (cell_name) {
+                            cell->name = copy_string((char*)cell_name->bytes, NULL);
+                            cell->properties = properties_copy(cell_name->properties);
+                            while (*next_property) next_property = &(*next_property)->next;
+                        }
+                    } else {
+                        // Use owner as temporary storage for the reference number
+                        cell->owner = (void*)ref_number;
+                    }
                 } else {
                     cell->name = (char*)oasis_read_string(in, true, len);
                 }
@@ -1689,6 +2679,8 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                 modal_placement_pos = Vec2{0, 0};
                 modal_geom_pos = Vec2{0, 0};
                 modal_text_pos = Vec2{0, 0};
+                modal_placement_cell = NULL;
+                modal_text_string = NULL;
             } break;
             case OasisRecord::XYABSOLUTE:
                 modal_absolute_pos = true;
@@ -1707,14 +2699,28 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                     // Explicit reference
                     if (info & 0x40) {
                         // Reference number
-                        reference->type = ReferenceType::Cell;
-                        reference->cell = (Cell*)oasis_read_unsigned_integer(in);
+                        uint64_t ref_number = oasis_read_unsigned_integer(in);
+                        if (resolve_names) {
+                            reference->type = ReferenceType::Name;
+                            ByteArray* cell_name =
+                                oasis_table_entry(cell_name_table, ref_number, error_code);
+                            if (cell_name) {
+                                reference->name = copy_string((char*)cell_name->bytes, NULL);
+                            }
+                        } else {
+                            reference->type = ReferenceType::Cell;
+                            reference->cell = (Cell*)ref_number;
+                        }
                     } else {
                         // Cell name
                         reference->type = ReferenceType::Name;
                         reference->name = (char*)oasis_read_string(in, true, len);
                     }
                     modal_placement_cell = reference;
+                } else if (modal_placement_cell == NULL) {
+                    if (error_logger)
+                        fputs("[GDSTK] Undefined modal placement cell.\n", error_logger);
+                    if (error_code) *error_code = ErrorCode::InvalidFile;
                 } else {
                     // Use modal_placement_cell
                     if (modal_placement_cell->type == ReferenceType::Cell) {
@@ -1781,12 +2787,26 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                 if (info & 0x40) {
                     // Explicit text
                     if (info & 0x20) {
-                        // Reference number: use owner to temporarily store it
-                        label->owner = (void*)oasis_read_unsigned_integer(in);
+                        uint64_t ref_number = oasis_read_unsigned_integer(in);
+                        if (resolve_names) {
+                            ByteArray* label_text =
+                                oasis_table_entry(label_text_table, ref_number, error_code);
+                            if (label_text) {
+                                label->text = copy_string((char*)label_text->bytes, NULL);
+                                label->properties = properties_copy(label_text->properties);
+                                while (*next_property) next_property = &(*next_property)->next;
+                            }
+                        } else {
+                            // Reference number: use owner to temporarily store it
+                            label->owner = (void*)ref_number;
+                        }
                     } else {
                         label->text = (char*)oasis_read_string(in, true, len);
                     }
                     modal_text_string = label;
+                } else if (modal_text_string == NULL) {
+                    if (error_logger) fputs("[GDSTK] Undefined modal text string.\n", error_logger);
+                    if (error_code) *error_code = ErrorCode::InvalidFile;
                 } else {
                     // Use modal_text_string
                     if (modal_text_string->text == NULL) {
@@ -2306,6 +3326,11 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                 Property* property = (Property*)allocate_clear(sizeof(Property));
                 *next_property = property;
                 next_property = &property->next;
+                // Properties discarded with their cells are not tracked
+                bool track = !(tables_only && cell);
+                if (modal_property == NULL) {
+                    modal_property = (Property*)allocate_clear(sizeof(Property));
+                }
                 uint8_t info;
                 if (record == OasisRecord::LAST_PROPERTY) {
                     info = 0x08;
@@ -2314,45 +3339,41 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                 }
                 if (info & 0x04) {
                     // Explicit name
+                    if (!modal_property_unfinished) free_allocation(modal_property->name);
                     if (info & 0x02) {
                         // Reference number
-                        property->name = (char*)oasis_read_unsigned_integer(in);
-                        unfinished_property_name.append(property);
+                        modal_property->name = (char*)oasis_read_unsigned_integer(in);
                         modal_property_unfinished = true;
                     } else {
-                        property->name = (char*)oasis_read_string(in, true, len);
+                        modal_property->name = (char*)oasis_read_string(in, true, len);
                         modal_property_unfinished = false;
                     }
-                    modal_property = property;
-                } else {
-                    // Use modal variable
-                    if (modal_property_unfinished) {
-                        property->name = modal_property->name;
-                        unfinished_property_name.append(property);
-                    } else {
-                        property->name = copy_string(modal_property->name, NULL);
-                    }
+                } else if (modal_property->name == NULL && !modal_property_unfinished) {
+                    if (error_logger)
+                        fputs("[GDSTK] Undefined modal property name.\n", error_logger);
+                    if (error_code) *error_code = ErrorCode::InvalidFile;
+                    break;
                 }
-                if (info & 0x08) {
-                    // Use modal value list
-                    property->value = property_values_copy(modal_property_value_list);
-                    PropertyValue* src = modal_property_value_list;
-                    PropertyValue* dst = property->value;
-                    while (src) {
-                        if (src->type == PropertyType::UnsignedInteger &&
-                            unfinished_property_value.contains(src)) {
-                            unfinished_property_value.append(dst);
-                        }
-                        src = src->next;
-                        dst = dst->next;
-                    }
-                } else {
+                if (!modal_property_unfinished) {
+                    property->name = copy_string(modal_property->name, NULL);
+                } else if (resolve_names) {
+                    ByteArray* prop_name = oasis_table_entry(
+                        property_name_table, (uint64_t)modal_property->name, error_code);
+                    if (prop_name) property->name = copy_string((char*)prop_name->bytes, NULL);
+                } else if (track) {
+                    property->name = modal_property->name;
+                    unfinished_property_name.append(property);
+                }
+                if (!(info & 0x08)) {
                     // Explicit value list
+                    property_values_clear(modal_property->value);
+                    modal_property->value = NULL;
+                    modal_unfinished_values.count = 0;
                     uint64_t num_values = info >> 4;
                     if (num_values == 15) {
                         num_values = oasis_read_unsigned_integer(in);
                     }
-                    PropertyValue** next = &property->value;
+                    PropertyValue** next = &modal_property->value;
                     for (; num_values > 0; num_values--) {
                         PropertyValue* property_value =
                             (PropertyValue*)allocate_clear(sizeof(PropertyValue));
@@ -2392,20 +3413,44 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                             case OasisDataType::ReferenceN: {
                                 property_value->type = PropertyType::UnsignedInteger;
                                 property_value->unsigned_integer = oasis_read_unsigned_integer(in);
-                                unfinished_property_value.append(property_value);
+                                if (resolve_names) {
+                                    oasis_resolve_property_value(property_value_table,
+                                                                 property_value);
+                                } else {
+                                    modal_unfinished_values.append(property_value);
+                                }
                             } break;
                         }
                     }
-                    modal_property_value_list = property->value;
+                }
+                property->value = property_values_copy(modal_property->value);
+                if (track && modal_unfinished_values.count > 0) {
+                    PropertyValue* src = modal_property->value;
+                    PropertyValue* dst = property->value;
+                    while (src) {
+                        if (modal_unfinished_values.contains(src)) {
+                            unfinished_property_value.append(dst);
+                        }
+                        src = src->next;
+                        dst = dst->next;
+                    }
                 }
             } break;
             case OasisRecord::XNAME_IMPLICIT: {
+                result = cell;
+                cell = NULL;
+                properties_clear(skipped_properties);
+                next_property = &skipped_properties;
                 oasis_read_unsigned_integer(in);
                 free_allocation(oasis_read_string(in, false, len));
                 if (error_logger) fputs("[GDSTK] Record type XNAME ignored.\n", error_logger);
                 if (error_code) *error_code = ErrorCode::UnsupportedRecord;
             } break;
             case OasisRecord::XNAME: {
+                result = cell;
+                cell = NULL;
+                properties_clear(skipped_properties);
+                next_property = &skipped_properties;
                 oasis_read_unsigned_integer(in);
                 free_allocation(oasis_read_string(in, false, len));
                 oasis_read_unsigned_integer(in);
@@ -2504,49 +3549,322 @@ Library read_oas(const char* filename, double unit, double tolerance, ErrorCode*
                 if (error_code) *error_code = ErrorCode::UnsupportedRecord;
         }
     }
+    if (result == NULL && !finished) {
+        // Incomplete file or error: return the partial cell, if any
+        result = cell;
+        cell = NULL;
+    }
     if (in.error_code != ErrorCode::NoError && error_code) *error_code = in.error_code;
+    return result;
+}
 
-CLEANUP:
-    fclose(in.file);
+ErrorCode OasisReader::read_tables(const char* filename) {
+    ErrorCode error_code = ErrorCode::NoError;
+    OasisReader scan = oasisreader_init(filename, unit, tolerance, &error_code);
+    if (scan.in.file == NULL) return error_code;
+    scan.tables_only = true;
+
+    // With strict tables, all name records are found from the first table
+    // onwards; otherwise the whole file must be scanned.
+    bool strict = true;
+    uint64_t start = UINT64_MAX;
+    for (uint8_t i = 0; i < 8; i += 2) {
+        if (table_offsets[i] != 1) {
+            strict = false;
+        } else if (table_offsets[i + 1] > 0 && table_offsets[i + 1] < start) {
+            start = table_offsets[i + 1];
+        }
+    }
+    if (strict) {
+        if (start == UINT64_MAX) {
+            // No name tables in the file
+            scan.clear();
+            return error_code;
+        }
+        FSEEK64(scan.in.file, start, SEEK_SET);
+    }
 
-    ByteArray* ba = cell_name_table.items;
-    for (uint64_t i = cell_name_table.count; i > 0; i--, ba++) {
-        if (ba->bytes) free_allocation(ba->bytes);
-        properties_clear(ba->properties);
+    Cell* discarded;
+    while ((discarded = scan.read_cell(&error_code)) != NULL) {
+        discarded->free_all();
+        free_allocation(discarded);
     }
-    cell_name_table.clear();
+    if (!scan.finished) {
+        if (error_code == ErrorCode::NoError) error_code = ErrorCode::InvalidFile;
+        if (error_logger) fputs("[GDSTK] Unable to read OASIS name tables.\n", error_logger);
+        scan.clear();
+        return error_code;
+    }
+    scan.resolve_properties();
+
+    Array<ByteArray> temp;
+    temp = cell_name_table;
+    cell_name_table = scan.cell_name_table;
+    scan.cell_name_table = temp;
+    temp = label_text_table;
+    label_text_table = scan.label_text_table;
+    scan.label_text_table = temp;
+    temp = property_name_table;
+    property_name_table = scan.property_name_table;
+    scan.property_name_table = temp;
+    temp = property_value_table;
+    property_value_table = scan.property_value_table;
+    scan.property_value_table = temp;
+    scan.clear();
+    return error_code;
+}
 
-    ba = label_text_table.items;
-    for (uint64_t i = label_text_table.count; i > 0; i--, ba++) {
-        if (ba->bytes) free_allocation(ba->bytes);
-        properties_clear(ba->properties);
+void OasisReader::resolve_properties() {
+    Property** prop_p = unfinished_property_name.items;
+    for (uint64_t i = unfinished_property_name.count; i > 0; i--) {
+        Property* property = *prop_p++;
+        ByteArray* prop_name = property_name_table.items + (uint64_t)property->name;
+        property->name = copy_string((char*)prop_name->bytes, NULL);
     }
-    label_text_table.clear();
+    unfinished_property_name.count = 0;
 
-    ba = property_name_table.items;
-    for (uint64_t i = property_name_table.count; i > 0; i--, ba++) {
-        if (ba->bytes) free_allocation(ba->bytes);
-        properties_clear(ba->properties);
+    PropertyValue** prop_value_p = unfinished_property_value.items;
+    for (uint64_t i = unfinished_property_value.count; i > 0; i--) {
+        oasis_resolve_property_value(property_value_table, *prop_value_p++);
     }
-    property_name_table.clear();
+    unfinished_property_value.count = 0;
+}
 
-    ba = property_value_table.items;
-    for (uint64_t i = property_value_table.count; i > 0; i--, ba++) {
+static void byte_array_table_clear(Array<ByteArray>& table) {
+    ByteArray* ba = table.items;
+    for (uint64_t i = table.count; i > 0; i--, ba++) {
         if (ba->bytes) free_allocation(ba->bytes);
         properties_clear(ba->properties);
     }
-    property_value_table.clear();
+    table.clear();
+}
+
+void OasisReader::clear() {
+    if (in.file) fclose(in.file);
+    if (in.data) free_allocation(in.data);
+    in = OasisStream{};
+
+    if (cell) {
+        cell->free_all();
+        free_allocation(cell);
+        cell = NULL;
+    }
+
+    byte_array_table_clear(cell_name_table);
+    byte_array_table_clear(label_text_table);
+    byte_array_table_clear(property_name_table);
+    byte_array_table_clear(property_value_table);
 
     modal_repetition.clear();
     modal_polygon_points.clear();
     modal_path_points.clear();
+    if (modal_property) {
+        if (modal_property_unfinished) modal_property->name = NULL;
+        properties_clear(modal_property);
+    }
+    modal_unfinished_values.clear();
 
     unfinished_property_name.clear();
     unfinished_property_value.clear();
 
+    properties_clear(properties);
+    properties_clear(skipped_properties);
+    next_property = NULL;
+}
+
+Library read_oas(const char* filename, double unit, double tolerance, ErrorCode* error_code) {
+    Library library = {};
+    OasisReader reader = oasisreader_init(filename, unit, tolerance, error_code);
+    if (reader.in.file == NULL) return library;
+
+    library.unit = reader.unit;
+    library.precision = reader.precision;
+
+    Cell* cell;
+    while ((cell = reader.read_cell(error_code)) != NULL) library.cell_array.append(cell);
+
+    library.properties = reader.properties;
+    reader.properties = NULL;
+
+    if (reader.finished) {
+        library.name = (char*)allocate(4);
+        library.name[0] = 'L';
+        library.name[1] = 'I';
+        library.name[2] = 'B';
+        library.name[3] = 0;
+
+        uint64_t c_size = library.cell_array.count;
+        Map<Cell*> map = {};
+        map.resize((uint64_t)(2.0 + 10.0 / GDSTK_MAP_CAPACITY_THRESHOLD * c_size));
+
+        Cell** cell_p = library.cell_array.items;
+        for (uint64_t i = c_size; i > 0; i--) {
+            cell = *cell_p++;
+            if (cell->name == NULL) {
+                ByteArray* cell_name = reader.cell_name_table.items + (uint64_t)cell->owner;
+                cell->owner = NULL;
+                cell->name = copy_string((char*)cell_name->bytes, NULL);
+                if (cell_name->properties) {
+                    Property* last = cell_name->properties;
+                    while (last->next) last = last->next;
+                    last->next = cell->properties;
+                    cell->properties = cell_name->properties;
+                    cell_name->properties = NULL;
+                }
+            }
+            map.set(cell->name, cell);
+
+            Label** label_p = cell->label_array.items;
+            for (uint64_t j = cell->label_array.count; j > 0; j--) {
+                Label* label = *label_p++;
+                if (label->text == NULL) {
+                    ByteArray* label_text = reader.label_text_table.items + (uint64_t)label->owner;
+                    label->owner = NULL;
+                    label->text = copy_string((char*)label_text->bytes, NULL);
+                    if (label_text->properties) {
+                        Property* copy = properties_copy(label_text->properties);
+                        Property* last = copy;
+                        while (last->next) last = last->next;
+                        last->next = label->properties;
+                        label->properties = copy;
+                    }
+                }
+            }
+        }
+
+        cell_p = library.cell_array.items;
+        for (uint64_t i = c_size; i > 0; i--, cell_p++) {
+            Reference** ref_p = (*cell_p)->reference_array.items;
+            for (uint64_t j = (*cell_p)->reference_array.count; j > 0; j--, ref_p++) {
+                Reference* ref = *ref_p;
+                if (ref->type == ReferenceType::Cell) {
+                    // Using reference number
+                    ByteArray* cell_name = reader.cell_name_table.items + (uint64_t)ref->cell;
+                    ref->cell = map.get((char*)cell_name->bytes);
+                    if (!ref->cell) {
+                        ref->type = ReferenceType::Name;
+                        ref->name = (char*)allocate(cell_name->count);
+                        memcpy(ref->name, cell_name->bytes, cell_name->count);
+                        if (error_code) *error_code = ErrorCode::MissingReference;
+                        if (error_logger)
+                            fprintf(error_logger, "[GDSTK] Missing referenced cell %s\n",
+                                    ref->name);
+                    }
+                } else {
+                    // Using name
+                    cell = map.get(ref->name);
+                    if (cell) {
+                        free_allocation(ref->name);
+                        ref->cell = cell;
+                        ref->type = ReferenceType::Cell;
+                    } else {
+                        if (error_code) *error_code = ErrorCode::MissingReference;
+                        if (error_logger)
+                            fprintf(error_logger, "[GDSTK] Missing referenced cell %s\n",
+                                    ref->name);
+                    }
+                }
+            }
+        }
+        map.clear();
+
+        reader.resolve_properties();
+    }
+
+    reader.clear();
     return library;
 }
 
+// Fracture the polygons in cell to at most max_points vertices.
+static void cell_fracture_polygons(Cell* cell, uint64_t max_points, double precision) {
+    cell->modification_count++;
+    Array<Polygon*>& polygon_array = cell->polygon_array;
+    Array<Polygon*> fractured_array = {};
+    const uint64_t count = polygon_array.count;
+    for (uint64_t i = 0; i < count; i++) {
+        Polygon* polygon = polygon_array[i];
+        if (polygon->point_array.count <= max_points) continue;
+        polygon->fracture(max_points, precision, fractured_array);
+        polygon->clear();
+        free_allocation(polygon);
+        polygon_array[i] = fractured_array[0];
+        if (fractured_array.count > 1) {
+            polygon_array.ensure_slots(fractured_array.count - 1);
+            memcpy(polygon_array.items + polygon_array.count, fractured_array.items + 1,
+                   (fractured_array.count - 1) * sizeof(Polygon*));
+            polygon_array.count += fractured_array.count - 1;
+        }
+        fractured_array.count = 0;
+    }
+    fractured_array.clear();
+}
+
+ErrorCode oas_to_gds(const char* oas_filename, const char* gds_filename, double unit,
+                     double tolerance, uint64_t max_points, tm* timestamp) {
+    ErrorCode error_code = ErrorCode::NoError;
+    OasisReader reader = oasisreader_init(oas_filename, unit, tolerance, &error_code);
+    if (reader.in.file == NULL) return error_code;
+    if (error_code == ErrorCode::NoError) error_code = reader.read_tables(oas_filename);
+    if (error_code != ErrorCode::NoError) {
+        reader.clear();
+        return error_code;
+    }
+    reader.resolve_names = true;
+
+    // Errors from the writer are kept separate because reading stops at any
+    // error reported by read_cell.
+    ErrorCode write_error = ErrorCode::NoError;
+    GdsWriter writer = gdswriter_init(gds_filename, "LIB", reader.unit, reader.precision,
+                                      max_points, timestamp, &error_code);
+    if (writer.out == NULL) {
+        reader.clear();
+        return error_code;
+    }
+
+    // Cells are decoded in batches.  Polygon fracturing, the most expensive
+    // stage of the encoding, is done for all cells in a batch in parallel.
+    const uint64_t batch_size = get_thread_count();
+    Array<Cell*> batch = {};
+    batch.ensure_slots(batch_size);
+    bool done = false;
+    while (!done) {
+        batch.count = 0;
+        while (batch.count < batch_size) {
+            Cell* cell = reader.read_cell(&error_code);
+            if (cell == NULL) {
+                done = true;
+                break;
+            }
+            batch.append_unsafe(cell);
+        }
+
+        if (max_points > 4) {
+            GDSTK_PARALLEL_FOR
+            for (int64_t i = 0; i < (int64_t)batch.count; i++) {
+                cell_fracture_polygons(batch[i], max_points, writer.precision);
+            }
+        }
+
+        Cell** cell_p = batch.items;
+        for (uint64_t i = batch.count; i > 0; i--) {
+            Cell* cell = *cell_p++;
+            // Cells from a failed read might be incomplete
+            if (error_code == ErrorCode::NoError) {
+                ErrorCode err = writer.write_cell(*cell);
+                if (err != ErrorCode::NoError) write_error = err;
+            }
+            cell->free_all();
+            free_allocation(cell);
+        }
+    }
+    batch.clear();
+
+    if (!reader.finished && error_code == ErrorCode::NoError) error_code = ErrorCode::InvalidFile;
+    reader.clear();
+    writer.close();
+    return error_code == ErrorCode::NoError ? write_error : error_code;
+}
+
 ErrorCode gds_units(const char* filename, double& unit, double& precision) {
     uint8_t buffer[65537];
     uint64_t* data64 = (uint64_t*)(buffer + 4);
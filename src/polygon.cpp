@@ -199,6 +199,33 @@ void Polygon::bounding_box(Vec2& min, Vec2& max) const {
     }
 }
 
+uint64_t Polygon::content_hash(double scaling, const Vec2 offset) const {
+    uint64_t result = hash_combine(hash(tag), point_array.count);
+    const uint64_t count = point_array.count;
+    if (count > 0) {
+        // Start from the lowest vertex (after rounding)
+        uint64_t first = 0;
+        int64_t first_x = llround((point_array[0].x - offset.x) * scaling);
+        int64_t first_y = llround((point_array[0].y - offset.y) * scaling);
+        for (uint64_t i = 1; i < count; i++) {
+            int64_t x = llround((point_array[i].x - offset.x) * scaling);
+            int64_t y = llround((point_array[i].y - offset.y) * scaling);
+            if (x < first_x || (x == first_x && y < first_y)) {
+                first = i;
+                first_x = x;
+                first_y = y;
+            }
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            const Vec2 v = point_array[(first + i) % count] - offset;
+            result = hash_combine(result, hash_coordinate(v.x, scaling));
+            result = hash_combine(result, hash_coordinate(v.y, scaling));
+        }
+    }
+    result = hash_combine(result, repetition.content_hash(scaling));
+    return hash_combine(result, properties_hash(properties));
+}
+
 void Polygon::translate(const Vec2 v) {
     Vec2* p = point_array.items;
     for (uint64_t num = point_array.count; num > 0; num--) *p++ += v;
@@ -418,21 +445,24 @@ void Polygon::fracture(uint64_t max_points, double precision, Array<Polygon*>& r
 void Polygon::apply_repetition(Array<Polygon*>& result) {
     if (repetition.type == RepetitionType::None) return;
 
-    Array<Vec2> offsets = {};
-    repetition.get_offsets(offsets);
-    repetition.clear();
+    // Take the repetition out so that it is not copied to the new elements
+    Repetition rep = repetition;
+    repetition.type = RepetitionType::None;
 
+    RepetitionIterator iterator = {};
+    iterator.init(rep);
+    Vec2 offset;
     // Skip first offset (0, 0)
-    Vec2* offset_p = offsets.items + 1;
-    result.ensure_slots(offsets.count - 1);
-    for (uint64_t offset_count = offsets.count - 1; offset_count > 0; offset_count--) {
+    iterator.next(offset);
+    result.ensure_slots(iterator.count - 1);
+    while (iterator.next(offset)) {
         Polygon* poly = (Polygon*)allocate_clear(sizeof(Polygon));
         poly->copy_from(*this);
-        poly->translate(*offset_p++);
+        poly->translate(offset);
         result.append_unsafe(poly);
     }
 
-    offsets.clear();
+    rep.clear();
     return;
 }
 
@@ -458,26 +488,17 @@ ErrorCode Polygon::to_gds(FILE* out, double scaling) const {
     coords.ensure_slots(2 * total);
     coords.count = 2 * total;
 
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
-
-    double* offset_p = (double*)offsets.items;
-    for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
+    RepetitionIterator iterator = {};
+    iterator.init(repetition);
+    Vec2 offset;
+    while (iterator.next(offset)) {
         fwrite(buffer_start, sizeof(uint16_t), COUNT(buffer_start), out);
 
-        double offset_x = *offset_p++;
-        double offset_y = *offset_p++;
         int32_t* c = coords.items;
         Vec2* p = point_array.items;
         for (uint64_t j = point_array.count; j > 0; j--) {
-            *c++ = (int32_t)lround((offset_x + p->x) * scaling);
-            *c++ = (int32_t)lround((offset_y + p->y) * scaling);
+            *c++ = (int32_t)lround((offset.x + p->x) * scaling);
+            *c++ = (int32_t)lround((offset.y + p->y) * scaling);
             p++;
         }
         *c++ = coords[0];
@@ -500,7 +521,6 @@ ErrorCode Polygon::to_gds(FILE* out, double scaling) const {
         fwrite(buffer_end, sizeof(uint16_t), COUNT(buffer_end), out);
     }
 
-    if (repetition.type != RepetitionType::None) offsets.clear();
     coords.clear();
     return error_code;
 }
@@ -968,38 +988,49 @@ ErrorCode Polygon::to_oas(OasisStream& out, OasisState& state) const {
 }
 
 ErrorCode Polygon::to_svg(FILE* out, double scaling, uint32_t precision) const {
+    Array<char> buffer = {};
+    ErrorCode error_code = to_svg(buffer, scaling, precision);
+    fwrite(buffer.items, 1, buffer.count, out);
+    buffer.clear();
+    return error_code;
+}
+
+ErrorCode Polygon::to_svg(Array<char>& out, double scaling, uint32_t precision) const {
     if (point_array.count < 3) return ErrorCode::NoError;
     char double_buffer[GDSTK_DOUBLE_BUFFER_COUNT];
-    fprintf(out, "<polygon id=\"%p\" class=\"l%" PRIu32 "d%" PRIu32 "\" points=\"", this,
-            get_layer(tag), get_type(tag));
+    append_format(out, "<polygon id=\"%p\" class=\"l%" PRIu32 "d%" PRIu32 "\" points=\"", this,
+                  get_layer(tag), get_type(tag));
     Vec2* p = point_array.items;
     for (uint64_t j = 0; j < point_array.count - 1; j++) {
-        fputs(double_print(p->x * scaling, precision, double_buffer, COUNT(double_buffer)), out);
-        fputc(',', out);
-        fputs(double_print(p->y * scaling, precision, double_buffer, COUNT(double_buffer)), out);
-        fputc(' ', out);
+        append_string(out, double_print(p->x * scaling, precision, double_buffer,
+                                        COUNT(double_buffer)));
+        out.append(',');
+        append_string(out, double_print(p->y * scaling, precision, double_buffer,
+                                        COUNT(double_buffer)));
+        out.append(' ');
         p++;
     }
-    fputs(double_print(p->x * scaling, precision, double_buffer, COUNT(double_buffer)), out);
-    fputc(',', out);
-    fputs(double_print(p->y * scaling, precision, double_buffer, COUNT(double_buffer)), out);
-    fputs("\"/>\n", out);
+    append_string(out, double_print(p->x * scaling, precision, double_buffer,
+                                    COUNT(double_buffer)));
+    out.append(',');
+    append_string(out, double_print(p->y * scaling, precision, double_buffer,
+                                    COUNT(double_buffer)));
+    append_string(out, "\"/>\n");
     if (repetition.type != RepetitionType::None) {
-        Array<Vec2> offsets = {};
-        repetition.get_offsets(offsets);
-        double* offset_p = (double*)(offsets.items + 1);
-        for (uint64_t offset_count = offsets.count - 1; offset_count > 0; offset_count--) {
-            double offset_x = *offset_p++;
-            double offset_y = *offset_p++;
-            fprintf(out, "<use href=\"#%p\" x=\"", this);
-            fputs(double_print(offset_x * scaling, precision, double_buffer, COUNT(double_buffer)),
-                  out);
-            fputs("\" y=\"", out);
-            fputs(double_print(offset_y * scaling, precision, double_buffer, COUNT(double_buffer)),
-                  out);
-            fputs("\"/>\n", out);
+        RepetitionIterator iterator = {};
+        iterator.init(repetition);
+        Vec2 offset;
+        // Skip first offset (0, 0)
+        iterator.next(offset);
+        while (iterator.next(offset)) {
+            append_format(out, "<use href=\"#%p\" x=\"", this);
+            append_string(out, double_print(offset.x * scaling, precision, double_buffer,
+                                            COUNT(double_buffer)));
+            append_string(out, "\" y=\"");
+            append_string(out, double_print(offset.y * scaling, precision, double_buffer,
+                                            COUNT(double_buffer)));
+            append_string(out, "\"/>\n");
         }
-        offsets.clear();
     }
     return ErrorCode::NoError;
 }
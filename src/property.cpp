@@ -78,9 +78,163 @@ static bool is_gds_property(const Property* property) {
     return true;
 }
 
-static void property_values_clear(PropertyValue* values) {
+// Interned property names: each distinct name is allocated once and kept
+// until the end of the program.  Properties can be created from parallel
+// loops, so access to the table is serialized.
+static Map<char*> property_names = {};
+
+#ifdef _OPENMP
+#define PROPERTY_NAMES_CRITICAL _Pragma("omp critical(gdstk_property_names)")
+#else
+#define PROPERTY_NAMES_CRITICAL
+#endif
+
+char* property_name_intern(const char* name) {
+    char* result = NULL;
+    PROPERTY_NAMES_CRITICAL
+    {
+        if (property_names.count > 0) result = property_names.get_slot(name)->value;
+        if (result == NULL) {
+            result = copy_string(name, NULL);
+            property_names.set(name, result);
+        }
+    }
+    return result;
+}
+
+// Open addressing hash table with the first property of each name in the
+// list that starts with the property holding the index.
+struct PropertyIndex {
+    uint64_t capacity;  // Power of 2
+    uint64_t count;
+    Property** items;  // Stored after the index in the same allocation
+};
+
+static PropertyIndex* index_allocate(uint64_t count) {
+    uint64_t capacity = 2 * GDSTK_PROPERTY_INDEX_MIN;
+    while (capacity < 2 * count) capacity *= 2;
+    PropertyIndex* index =
+        (PropertyIndex*)allocate_clear(sizeof(PropertyIndex) + capacity * sizeof(Property*));
+    index->capacity = capacity;
+    index->items = (Property**)(index + 1);
+    return index;
+}
+
+static inline bool same_name(const char* name1, const char* name2) {
+    return name1 == name2 || strcmp(name1, name2) == 0;
+}
+
+static Property** index_slot(const PropertyIndex* index, const char* name) {
+    const uint64_t mask = index->capacity - 1;
+    uint64_t i = hash(name) & mask;
+    while (index->items[i] && !same_name(index->items[i]->name, name)) i = (i + 1) & mask;
+    return index->items + i;
+}
+
+// Add property to index.  If the name is already present, the existing entry
+// is kept, unless replace is true.
+static void index_add(PropertyIndex*& index, Property* property, bool replace) {
+    if (2 * (index->count + 1) > index->capacity) {
+        PropertyIndex* new_index = index_allocate(index->count + 1);
+        Property** item = index->items;
+        for (uint64_t i = index->capacity; i > 0; i--, item++) {
+            if (*item) *index_slot(new_index, (*item)->name) = *item;
+        }
+        new_index->count = index->count;
+        free_allocation(index);
+        index = new_index;
+    }
+    Property** slot = index_slot(index, property->name);
+    if (*slot == NULL) {
+        index->count++;
+        *slot = property;
+    } else if (replace) {
+        *slot = property;
+    }
+}
+
+// Index the list properties if it is large enough, removing any previous
+// indices from it.
+static void index_rebuild(Property* properties) {
+    uint64_t count = 0;
+    for (Property* property = properties; property; property = property->next) {
+        if (property->index) {
+            free_allocation(property->index);
+            property->index = NULL;
+        }
+        count++;
+    }
+    if (count < GDSTK_PROPERTY_INDEX_MIN) return;
+    PropertyIndex* index = index_allocate(count);
+    for (Property* property = properties; property; property = property->next) {
+        index_add(index, property, false);
+    }
+    properties->index = index;
+}
+
+// Update the index after property has been prepended to the list.  The index
+// is moved to property, including any properties prepended by hand before it.
+static void index_prepend(Property* property) {
+    Property* holder = property->next;
+    uint64_t prefix = 1;
+    while (holder && !holder->index) {
+        holder = holder->next;
+        prefix++;
+    }
+    if (!holder) {
+        if (prefix >= GDSTK_PROPERTY_INDEX_MIN) index_rebuild(property);
+        return;
+    }
+    Array<Property*> items = {};
+    items.ensure_slots(prefix);
+    for (Property* p = property; p != holder; p = p->next) items.append_unsafe(p);
+    PropertyIndex* index = holder->index;
+    holder->index = NULL;
+    // Properties closer to the start of the list take precedence
+    for (uint64_t i = items.count; i > 0; i--) index_add(index, items[i - 1], true);
+    items.clear();
+    property->index = index;
+}
+
+// First property with the given name
+static Property* find_property(Property* properties, const char* name) {
+    for (; properties; properties = properties->next) {
+        if (properties->index) return *index_slot(properties->index, name);
+        if (same_name(properties->name, name)) return properties;
+    }
+    return NULL;
+}
+
+// Compact storage: property names are interned and the bytes of a string
+// value are allocated in the same block as their PropertyValue.
+static Property* property_allocate(const char* name, bool interned) {
+    Property* property = (Property*)allocate_clear(sizeof(Property));
+    property->name = interned ? (char*)name : property_name_intern(name);
+    property->name_interned = true;
+    return property;
+}
+
+static PropertyValue* string_value_allocate(const uint8_t* bytes, uint64_t count) {
+    PropertyValue* value = (PropertyValue*)allocate(sizeof(PropertyValue) + count);
+    value->type = PropertyType::String;
+    value->bytes_inline = true;
+    value->count = count;
+    value->bytes = (uint8_t*)(value + 1);
+    if (count > 0) memcpy(value->bytes, bytes, count);
+    value->next = NULL;
+    return value;
+}
+
+static void property_free(Property* property) {
+    property_values_clear(property->value);
+    if (!property->name_interned) free_allocation(property->name);
+    if (property->index) free_allocation(property->index);
+    free_allocation(property);
+}
+
+void property_values_clear(PropertyValue* values) {
     while (values) {
-        if (values->type == PropertyType::String) {
+        if (values->type == PropertyType::String && !values->bytes_inline) {
             free_allocation(values->bytes);
         }
         PropertyValue* next_value = values->next;
@@ -91,208 +245,198 @@ static void property_values_clear(PropertyValue* values) {
 
 void properties_clear(Property*& properties) {
     while (properties) {
-        property_values_clear(properties->value);
-        free_allocation(properties->name);
         Property* next = properties->next;
-        free_allocation(properties);
+        property_free(properties);
         properties = next;
     }
 }
 
 PropertyValue* property_values_copy(const PropertyValue* values) {
     PropertyValue* result = NULL;
-    PropertyValue* dst = NULL;
+    PropertyValue** dst = &result;
     for (; values; values = values->next) {
-        if (result == NULL) {
-            result = (PropertyValue*)allocate(sizeof(PropertyValue));
-            dst = result;
+        if (values->type == PropertyType::String) {
+            *dst = string_value_allocate(values->bytes, values->count);
         } else {
-            dst->next = (PropertyValue*)allocate(sizeof(PropertyValue));
-            dst = dst->next;
+            // Copying the union copies whichever member is in use
+            *dst = (PropertyValue*)allocate(sizeof(PropertyValue));
+            **dst = *values;
+            (*dst)->bytes_inline = false;
+            (*dst)->next = NULL;
         }
-        dst->type = values->type;
-        switch (values->type) {
-            case PropertyType::UnsignedInteger:
-                dst->unsigned_integer = values->unsigned_integer;
-                break;
-            case PropertyType::Integer:
-                dst->integer = values->integer;
-                break;
-            case PropertyType::Real:
-                dst->real = values->real;
-                break;
-            case PropertyType::String: {
-                dst->count = values->count;
-                dst->bytes = (uint8_t*)allocate(dst->count);
-                memcpy(dst->bytes, values->bytes, dst->count);
-            }
-        }
-        dst->next = NULL;
+        dst = &(*dst)->next;
     }
     return result;
 }
 
 Property* properties_copy(const Property* properties) {
     Property* result = NULL;
-    Property* dst = NULL;
+    Property** dst = &result;
+    uint64_t count = 0;
     for (; properties; properties = properties->next) {
-        if (result == NULL) {
-            result = (Property*)allocate(sizeof(Property));
-            dst = result;
-        } else {
-            dst->next = (Property*)allocate(sizeof(Property));
-            dst = dst->next;
-        }
-        dst->name = copy_string(properties->name, NULL);
-        dst->value = property_values_copy(properties->value);
-        dst->next = NULL;
+        *dst = property_allocate(properties->name, properties->name_interned);
+        (*dst)->value = property_values_copy(properties->value);
+        dst = &(*dst)->next;
+        count++;
     }
+    if (count >= GDSTK_PROPERTY_INDEX_MIN) index_rebuild(result);
     return result;
 }
 
-static PropertyValue* get_or_add_property(Property*& properties, const char* name,
-                                          bool create_new) {
-    if (!create_new) {
-        Property* property = properties;
-        while (property && strcmp(property->name, name) != 0) property = property->next;
-        if (property) {
-            PropertyValue* value = (PropertyValue*)allocate_clear(sizeof(PropertyValue));
-            value->next = property->value;
-            property->value = value;
-            return value;
+uint64_t properties_hash(const Property* properties) {
+    uint64_t result = 0;
+    for (; properties; properties = properties->next) {
+        uint64_t h = hash((const char*)properties->name);
+        for (PropertyValue* value = properties->value; value; value = value->next) {
+            h = hash_combine(h, (uint64_t)value->type);
+            switch (value->type) {
+                case PropertyType::UnsignedInteger:
+                    h = hash_combine(h, value->unsigned_integer);
+                    break;
+                case PropertyType::Integer:
+                    h = hash_combine(h, (uint64_t)value->integer);
+                    break;
+                case PropertyType::Real:
+                    h = hash_combine(h, hash(value->real));
+                    break;
+                case PropertyType::String: {
+                    h = hash_combine(h, value->count);
+                    uint8_t* byte = value->bytes;
+                    for (uint64_t i = value->count; i > 0; i--, byte++) h = hash_combine(h, *byte);
+                }
+            }
         }
+        result += hash_combine(0, h);
     }
-    Property* property = (Property*)allocate(sizeof(Property));
+    return result;
+}
+
+static void property_prepend(Property*& properties, Property* property) {
     property->next = properties;
     properties = property;
+    index_prepend(property);
+}
+
+// Insert value at the start of the value list of the first property with
+// the given name, creating a new property if none exists or create_new.
+static void add_property_value(Property*& properties, const char* name, PropertyValue* value,
+                               bool create_new) {
+    Property* property = create_new ? NULL : find_property(properties, name);
+    if (!property) {
+        property = property_allocate(name, false);
+        property_prepend(properties, property);
+    }
+    value->next = property->value;
+    property->value = value;
+}
+
+void add_property(Property*& properties, const char* name, PropertyValue* values) {
+    Property* property = property_allocate(name, false);
+    property->value = values;
+    property_prepend(properties, property);
+}
 
-    property->name = copy_string(name, NULL);
-    properties->value = (PropertyValue*)allocate_clear(sizeof(PropertyValue));
-    return properties->value;
+static PropertyValue* value_allocate(PropertyType type) {
+    PropertyValue* value = (PropertyValue*)allocate_clear(sizeof(PropertyValue));
+    value->type = type;
+    return value;
 }
 
 void set_property(Property*& properties, const char* name, uint64_t unsigned_integer,
                   bool create_new) {
-    PropertyValue* value = get_or_add_property(properties, name, create_new);
-    value->type = PropertyType::UnsignedInteger;
+    PropertyValue* value = value_allocate(PropertyType::UnsignedInteger);
     value->unsigned_integer = unsigned_integer;
+    add_property_value(properties, name, value, create_new);
 }
 
 void set_property(Property*& properties, const char* name, int64_t integer, bool create_new) {
-    PropertyValue* value = get_or_add_property(properties, name, create_new);
-    value->type = PropertyType::Integer;
+    PropertyValue* value = value_allocate(PropertyType::Integer);
     value->integer = integer;
+    add_property_value(properties, name, value, create_new);
 }
 
 void set_property(Property*& properties, const char* name, double real, bool create_new) {
-    PropertyValue* value = get_or_add_property(properties, name, create_new);
-    value->type = PropertyType::Real;
+    PropertyValue* value = value_allocate(PropertyType::Real);
     value->real = real;
+    add_property_value(properties, name, value, create_new);
 }
 
 void set_property(Property*& properties, const char* name, const char* string, bool create_new) {
-    PropertyValue* value = get_or_add_property(properties, name, create_new);
-    value->type = PropertyType::String;
-    value->count = strlen(string);
-    value->bytes = (uint8_t*)allocate(value->count);
-    memcpy(value->bytes, string, value->count);
+    PropertyValue* value = string_value_allocate((const uint8_t*)string, strlen(string));
+    add_property_value(properties, name, value, create_new);
 }
 
 void set_property(Property*& properties, const char* name, const uint8_t* bytes, uint64_t count,
                   bool create_new) {
-    PropertyValue* value = get_or_add_property(properties, name, create_new);
-    value->type = PropertyType::String;
-    value->count = count;
-    value->bytes = (uint8_t*)allocate(count);
-    memcpy(value->bytes, bytes, count);
+    PropertyValue* value = string_value_allocate(bytes, count);
+    add_property_value(properties, name, value, create_new);
 }
 
 void set_gds_property(Property*& properties, uint16_t attribute, const char* value) {
-    PropertyValue* gds_attribute;
-    PropertyValue* gds_value;
+    const uint64_t count = strlen(value) + 1;
     Property* property = properties;
     for (; property; property = property->next) {
         if (is_gds_property(property) && property->value->unsigned_integer == attribute) {
-            gds_value = property->value->next;
-            gds_value->count = strlen(value) + 1;
-            gds_value->bytes = (uint8_t*)reallocate(gds_value->bytes, gds_value->count);
-            memcpy(gds_value->bytes, value, gds_value->count);
+            PropertyValue* gds_value = property->value->next;
+            if (gds_value->bytes_inline) {
+                gds_value->bytes = (uint8_t*)allocate(count);
+                gds_value->bytes_inline = false;
+            } else {
+                gds_value->bytes = (uint8_t*)reallocate(gds_value->bytes, count);
+            }
+            gds_value->count = count;
+            memcpy(gds_value->bytes, value, count);
             return;
         }
     }
-    gds_attribute = (PropertyValue*)allocate(sizeof(PropertyValue));
-    gds_value = (PropertyValue*)allocate(sizeof(PropertyValue));
-    gds_attribute->type = PropertyType::UnsignedInteger;
+    PropertyValue* gds_attribute = value_allocate(PropertyType::UnsignedInteger);
     gds_attribute->unsigned_integer = attribute;
-    gds_attribute->next = gds_value;
-    gds_value->type = PropertyType::String;
-    gds_value->bytes = (uint8_t*)copy_string(value, &gds_value->count);
-    gds_value->next = NULL;
-    property = (Property*)allocate(sizeof(Property));
-    property->name = (char*)allocate(COUNT(s_gds_property_name));
-    memcpy(property->name, s_gds_property_name, COUNT(s_gds_property_name));
-    property->value = gds_attribute;
-    property->next = properties;
-    properties = property;
+    gds_attribute->next = string_value_allocate((const uint8_t*)value, count);
+    add_property(properties, s_gds_property_name, gds_attribute);
 }
 
 uint64_t remove_property(Property*& properties, const char* name, bool all_occurences) {
+    if (!find_property(properties, name)) return 0;
     uint64_t removed = 0;
-    if (properties == NULL) return removed;
-    while (strcmp(properties->name, name) == 0) {
-        property_values_clear(properties->value);
-        free_allocation(properties->name);
-        Property* next = properties->next;
-        free_allocation(properties);
-        properties = next;
-        removed++;
-        if (!all_occurences) return removed;
-    }
-    Property* property = properties;
-    while (true) {
-        while (property->next && strcmp(property->next->name, name) != 0) property = property->next;
-        if (property->next) {
-            Property* rem = property->next;
-            property_values_clear(rem->value);
-            free_allocation(rem->name);
-            property->next = rem->next;
-            free_allocation(rem);
-            removed++;
-            if (!all_occurences) return removed;
-        } else {
-            return removed;
+    bool indexed = false;
+    Property** property = &properties;
+    while (*property) {
+        if ((*property)->index) indexed = true;
+        if (!same_name((*property)->name, name)) {
+            property = &(*property)->next;
+            continue;
         }
+        Property* rem = *property;
+        *property = rem->next;
+        property_free(rem);
+        removed++;
+        if (!all_occurences) break;
     }
+    // Removed properties might be referenced by the index
+    if (indexed) index_rebuild(properties);
+    return removed;
 }
 
 bool remove_gds_property(Property*& properties, uint16_t attribute) {
-    if (properties == NULL) return false;
-    if (is_gds_property(properties) && properties->value->unsigned_integer == attribute) {
-        property_values_clear(properties->value);
-        free_allocation(properties->name);
-        Property* next = properties->next;
-        free_allocation(properties);
-        properties = next;
-        return true;
-    }
-    Property* property = properties;
-    while (property->next &&
-           (!is_gds_property(property->next) || property->next->value->unsigned_integer != attribute))
-        property = property->next;
-    if (property->next) {
-        Property* rem = property->next;
-        property_values_clear(rem->value);
-        free_allocation(rem->name);
-        property->next = rem->next;
-        free_allocation(rem);
-        return true;
+    bool indexed = false;
+    Property** property = &properties;
+    while (*property && (!is_gds_property(*property) ||
+                         (*property)->value->unsigned_integer != attribute)) {
+        if ((*property)->index) indexed = true;
+        property = &(*property)->next;
     }
-    return false;
+    if (*property == NULL) return false;
+    Property* rem = *property;
+    if (rem->index) indexed = true;
+    *property = rem->next;
+    property_free(rem);
+    if (indexed) index_rebuild(properties);
+    return true;
 }
 
 PropertyValue* get_property(Property* properties, const char* name) {
-    while (properties && strcmp(properties->name, name) != 0) properties = properties->next;
-    if (properties) return properties->value;
+    Property* property = find_property(properties, name);
+    if (property) return property->value;
     return NULL;
 }
 
@@ -343,6 +487,18 @@ ErrorCode properties_to_gds(const Property* properties, FILE* out) {
     return ErrorCode::NoError;
 }
 
+static uint64_t string_value_hash(const PropertyValue* value) {
+    uint64_t h = hash(value->count);
+    uint8_t* byte = value->bytes;
+    for (uint64_t i = value->count; i > 0; i--, byte++) h = hash_combine(h, *byte);
+    return h;
+}
+
+static bool same_string_value(const PropertyValue* value1, const PropertyValue* value2) {
+    return value1->count == value2->count &&
+           memcmp(value1->bytes, value2->bytes, value1->count) == 0;
+}
+
 ErrorCode properties_to_oas(const Property* properties, OasisStream& out, OasisState& state) {
     while (properties) {
         uint8_t info = 0x06;
@@ -404,14 +560,24 @@ ErrorCode properties_to_oas(const Property* properties, OasisStream& out, OasisS
                     } else {
                         oasis_putc(15, out);
                     }
-                    for (index = 0; index < state.property_value_array.count; index++) {
-                        PropertyValue* it = state.property_value_array[index];
-                        if (it->count == value->count &&
-                            memcmp(it->bytes, value->bytes, it->count) == 0)
-                            break;
+                    const uint64_t key = string_value_hash(value);
+                    const uint64_t count = state.property_value_array.count;
+                    index = count;
+                    if (state.property_value_map.has_key(key)) {
+                        index = state.property_value_map.get(key) - 1;
+                        // Fall back to a linear search in case of hash collisions
+                        if (!same_string_value(state.property_value_array[index], value)) {
+                            for (index = 0; index < count; index++) {
+                                if (same_string_value(state.property_value_array[index], value))
+                                    break;
+                            }
+                        }
                     }
-                    if (index == state.property_value_array.count)
+                    if (index == count) {
                         state.property_value_array.append(value);
+                        if (!state.property_value_map.has_key(key))
+                            state.property_value_map.set(key, index + 1);
+                    }
                     oasis_write_unsigned_integer(out, index);
                 }
             }
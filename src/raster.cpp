@@ -0,0 +1,1336 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/clipper_tools.hpp>
+#include <gdstk/raster.hpp>
+#include <gdstk/sort.hpp>
+
+namespace gdstk {
+
+// Affine transformation (x, y) -> (xx * x + xy * y + x0, yx * x + yy * y + y0)
+struct RasterTransform {
+    double xx, xy, yx, yy, x0, y0;
+
+    Vec2 apply(const Vec2 p) const {
+        return Vec2{xx * p.x + xy * p.y + x0, yx * p.x + yy * p.y + y0};
+    }
+};
+
+// Polygon in pixel coordinates
+struct RasterPolygon {
+    uint64_t layer;  // Index in the tag list
+    double sign;     // Orientation correction for the accumulated area
+    double min_y;
+    double max_y;
+    Array<Vec2> point_array;
+};
+
+// Index of a tag in the tag list
+struct RasterLayer {
+    Tag tag;
+    uint64_t index;
+};
+
+struct RasterState {
+    uint64_t width;
+    uint64_t height;
+    RasterTransform to_pixel;   // User units to pixels
+    Array<RasterLayer> layers;  // Sorted by tag
+    Map<GeometryInfo> cache;
+    Array<RasterPolygon> polygons;
+};
+
+static bool raster_tag_order(const RasterLayer& l1, const RasterLayer& l2) {
+    return l1.tag < l2.tag;
+}
+
+static bool raster_layer_order(const RasterPolygon& p1, const RasterPolygon& p2) {
+    return p1.layer < p2.layer;
+}
+
+// Find the index of tag in the tag list.  Return false if not found.
+static bool raster_find_layer(const RasterState& state, Tag tag, uint64_t& index) {
+    uint64_t start = 0;
+    uint64_t end = state.layers.count;
+    while (start < end) {
+        uint64_t mid = (start + end) / 2;
+        Tag value = state.layers[mid].tag;
+        if (value == tag) {
+            index = state.layers[mid].index;
+            return true;
+        }
+        if (value < tag) {
+            start = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return false;
+}
+
+// Add the polygon with points transformed by transform and translated by
+// offset if it touches the image.
+static void raster_add_polygon(RasterState& state, const Array<Vec2>& point_array,
+                               uint64_t layer, const RasterTransform& transform,
+                               const Vec2 offset) {
+    if (point_array.count < 3) return;
+    RasterTransform t = transform;
+    t.x0 += t.xx * offset.x + t.xy * offset.y;
+    t.y0 += t.yx * offset.x + t.yy * offset.y;
+
+    RasterPolygon polygon = {layer};
+    polygon.point_array.ensure_slots(point_array.count);
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    double area = 0;
+    Vec2* src = point_array.items;
+    Vec2* dst = polygon.point_array.items;
+    for (uint64_t i = point_array.count; i > 0; i--, src++, dst++) {
+        *dst = state.to_pixel.apply(t.apply(*src));
+        if (dst->x < min.x) min.x = dst->x;
+        if (dst->x > max.x) max.x = dst->x;
+        if (dst->y < min.y) min.y = dst->y;
+        if (dst->y > max.y) max.y = dst->y;
+    }
+    polygon.point_array.count = point_array.count;
+
+    if (max.x <= 0 || max.y <= 0 || min.x >= state.width || min.y >= state.height) {
+        polygon.point_array.clear();
+        return;
+    }
+
+    Vec2* p = polygon.point_array.items;
+    Vec2 v0 = p[point_array.count - 1];
+    for (uint64_t i = point_array.count; i > 0; i--, p++) {
+        area += v0.x * p->y - v0.y * p->x;
+        v0 = *p;
+    }
+    polygon.sign = area < 0 ? -1 : 1;
+    polygon.min_y = min.y;
+    polygon.max_y = max.y;
+    state.polygons.append(polygon);
+}
+
+static void raster_add_polygons(RasterState& state, const Polygon* polygon,
+                                const RasterTransform& transform) {
+    uint64_t layer;
+    if (!raster_find_layer(state, polygon->tag, layer)) return;
+    if (polygon->repetition.type == RepetitionType::None) {
+        raster_add_polygon(state, polygon->point_array, layer, transform, Vec2{0, 0});
+        return;
+    }
+    RepetitionIterator iterator = {};
+    iterator.init(polygon->repetition);
+    Vec2 offset;
+    while (iterator.next(offset)) {
+        raster_add_polygon(state, polygon->point_array, layer, transform, offset);
+    }
+}
+
+// Return true if the bounding box of cell, transformed, touches the image.
+static bool raster_visible(RasterState& state, const Cell* cell, const RasterTransform& t) {
+    GeometryInfo info = state.cache.get(cell->name);
+    if (!info.bounding_box_valid) info = cell->bounding_box(state.cache);
+    if (info.bounding_box_min.x > info.bounding_box_max.x) return false;
+    Vec2 corners[] = {info.bounding_box_min,
+                      Vec2{info.bounding_box_min.x, info.bounding_box_max.y},
+                      info.bounding_box_max,
+                      Vec2{info.bounding_box_max.x, info.bounding_box_min.y}};
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    for (uint64_t i = 0; i < COUNT(corners); i++) {
+        Vec2 p = state.to_pixel.apply(t.apply(corners[i]));
+        if (p.x < min.x) min.x = p.x;
+        if (p.x > max.x) max.x = p.x;
+        if (p.y < min.y) min.y = p.y;
+        if (p.y > max.y) max.y = p.y;
+    }
+    return max.x > 0 && max.y > 0 && min.x < state.width && min.y < state.height;
+}
+
+static void raster_collect(RasterState& state, const Cell* cell, const RasterTransform& transform,
+                           ErrorCode& error_code) {
+    Polygon** polygon = cell->polygon_array.items;
+    for (uint64_t i = cell->polygon_array.count; i > 0; i--, polygon++) {
+        raster_add_polygons(state, *polygon, transform);
+    }
+
+    Array<Polygon*> path_polygons = {};
+    FlexPath** flexpath = cell->flexpath_array.items;
+    for (uint64_t i = cell->flexpath_array.count; i > 0; i--, flexpath++) {
+        ErrorCode err = (*flexpath)->to_polygons(false, 0, path_polygons);
+        if (err != ErrorCode::NoError) error_code = err;
+    }
+    RobustPath** robustpath = cell->robustpath_array.items;
+    for (uint64_t i = cell->robustpath_array.count; i > 0; i--, robustpath++) {
+        ErrorCode err = (*robustpath)->to_polygons(false, 0, path_polygons);
+        if (err != ErrorCode::NoError) error_code = err;
+    }
+    polygon = path_polygons.items;
+    for (uint64_t i = path_polygons.count; i > 0; i--, polygon++) {
+        raster_add_polygons(state, *polygon, transform);
+        (*polygon)->clear();
+        free_allocation(*polygon);
+    }
+    path_polygons.clear();
+
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+
+        double m = ref->magnification;
+        double ca = m * cos(ref->rotation);
+        double sa = m * sin(ref->rotation);
+        double r = ref->x_reflection ? -1 : 1;
+        RasterTransform rt = {ca, -r * sa, sa, r * ca, ref->origin.x, ref->origin.y};
+        RasterTransform t = {
+            transform.xx * rt.xx + transform.xy * rt.yx,
+            transform.xx * rt.xy + transform.xy * rt.yy,
+            transform.yx * rt.xx + transform.yy * rt.yx,
+            transform.yx * rt.xy + transform.yy * rt.yy,
+            transform.xx * rt.x0 + transform.xy * rt.y0 + transform.x0,
+            transform.yx * rt.x0 + transform.yy * rt.y0 + transform.y0,
+        };
+
+        if (ref->repetition.type == RepetitionType::None) {
+            if (raster_visible(state, ref->cell, t)) {
+                raster_collect(state, ref->cell, t, error_code);
+            }
+            continue;
+        }
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            RasterTransform ti = t;
+            ti.x0 += transform.xx * offset.x + transform.xy * offset.y;
+            ti.y0 += transform.yx * offset.x + transform.yy * offset.y;
+            if (raster_visible(state, ref->cell, ti)) {
+                raster_collect(state, ref->cell, ti, error_code);
+            }
+        }
+    }
+}
+
+// Accumulate the signed area contributions of the line segment p0–p1 to acc,
+// which holds rows lines with stride columns (at least 2 more than the image
+// width).  Coordinates must be within [0, width] horizontally and are relative
+// to the first row in acc.  The pixel coverage is given by the row prefix sums.
+template <class T>
+static void raster_segment(T* acc, uint64_t stride, uint64_t rows, double width, Vec2 p0,
+                           Vec2 p1, double sign) {
+    if (p0.y == p1.y) return;
+    double dir = sign;
+    if (p0.y > p1.y) {
+        Vec2 p = p0;
+        p0 = p1;
+        p1 = p;
+        dir = -dir;
+    }
+    if (p1.y <= 0 || p0.y >= rows) return;
+    double dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    double x = p0.x;
+    if (p0.y < 0) {
+        x -= p0.y * dxdy;
+        if (x < 0) {
+            x = 0;
+        } else if (x > width) {
+            x = width;
+        }
+    }
+    uint64_t y_start = p0.y < 0 ? 0 : (uint64_t)p0.y;
+    uint64_t y_end = p1.y >= rows ? rows : (uint64_t)ceil(p1.y);
+    for (uint64_t y = y_start; y < y_end; y++) {
+        T* line = acc + y * stride;
+        double dy = (y + 1 < p1.y ? y + 1 : p1.y) - (y > p0.y ? y : p0.y);
+        double x_next = x + dxdy * dy;
+        // Guard against rounding errors at the image borders
+        if (x_next < 0) {
+            x_next = 0;
+        } else if (x_next > width) {
+            x_next = width;
+        }
+        double d = dy * dir;
+        double x0 = x < x_next ? x : x_next;
+        double x1 = x < x_next ? x_next : x;
+        double x0_floor = floor(x0);
+        int64_t x0i = (int64_t)x0_floor;
+        double x1_ceil = ceil(x1);
+        int64_t x1i = (int64_t)x1_ceil;
+        if (x1i <= x0i + 1) {
+            double xm = 0.5 * (x + x_next) - x0_floor;
+            line[x0i] += (T)(d - d * xm);
+            line[x0i + 1] += (T)(d * xm);
+        } else {
+            double s = 1 / (x1 - x0);
+            double x0f = x0 - x0_floor;
+            double a0 = 0.5 * s * (1 - x0f) * (1 - x0f);
+            double x1f = x1 - x1_ceil + 1;
+            double am = 0.5 * s * x1f * x1f;
+            line[x0i] += (T)(d * a0);
+            if (x1i == x0i + 2) {
+                line[x0i + 1] += (T)(d * (1 - a0 - am));
+            } else {
+                double a1 = s * (1.5 - x0f);
+                line[x0i + 1] += (T)(d * (a1 - a0));
+                for (int64_t xi = x0i + 2; xi < x1i - 1; xi++) line[xi] += (T)(d * s);
+                double a2 = a1 + (x1i - x0i - 3) * s;
+                line[x1i - 1] += (T)(d * (1 - a2 - am));
+            }
+            line[x1i] += (T)(d * am);
+        }
+        x = x_next;
+    }
+}
+
+// Split the line p0–p1 at the image borders x = 0 and x = width, clamping the
+// parts outside the image to the borders.
+template <class T>
+static void raster_line(T* acc, uint64_t stride, uint64_t rows, double width, Vec2 p0, Vec2 p1,
+                        double sign) {
+    if (p0.y == p1.y) return;
+    if (p0.x > p1.x) {
+        Vec2 p = p0;
+        p0 = p1;
+        p1 = p;
+        sign = -sign;
+    }
+    if (p0.x < 0) {
+        if (p1.x <= 0) {
+            raster_segment(acc, stride, rows, width, Vec2{0, p0.y}, Vec2{0, p1.y}, sign);
+            return;
+        }
+        double y = p0.y + (p1.y - p0.y) * (0 - p0.x) / (p1.x - p0.x);
+        raster_segment(acc, stride, rows, width, Vec2{0, p0.y}, Vec2{0, y}, sign);
+        p0 = Vec2{0, y};
+    }
+    if (p1.x > width) {
+        if (p0.x >= width) {
+            raster_segment(acc, stride, rows, width, Vec2{width, p0.y}, Vec2{width, p1.y}, sign);
+            return;
+        }
+        double y = p0.y + (p1.y - p0.y) * (width - p0.x) / (p1.x - p0.x);
+        raster_segment(acc, stride, rows, width, Vec2{width, y}, Vec2{width, p1.y}, sign);
+        p1 = Vec2{width, y};
+    }
+    raster_segment(acc, stride, rows, width, p0, p1, sign);
+}
+
+// Image sink: coverage buffers or RGBA image
+struct RasterOutput {
+    uint8_t** coverage;
+    const uint32_t* colors;
+    uint32_t background;
+    uint8_t* rgba;
+};
+
+static void raster_compose(const uint8_t* coverage, uint64_t count, uint32_t color,
+                           uint8_t* rgba) {
+    float r = (float)((color >> 24) & 0xFF);
+    float g = (float)((color >> 16) & 0xFF);
+    float b = (float)((color >> 8) & 0xFF);
+    float a = (float)(color & 0xFF) / (255.0f * 255.0f);
+    for (uint64_t i = count; i > 0; i--, coverage++, rgba += 4) {
+        if (*coverage == 0) continue;
+        float alpha = *coverage * a;
+        float dst_alpha = rgba[3] / 255.0f * (1 - alpha);
+        float out_alpha = alpha + dst_alpha;
+        // Transparent color over transparent pixel: nothing to compose
+        if (out_alpha <= 0) continue;
+        float f = alpha / out_alpha;
+        float fd = dst_alpha / out_alpha;
+        rgba[0] = (uint8_t)(r * f + rgba[0] * fd + 0.5f);
+        rgba[1] = (uint8_t)(g * f + rgba[1] * fd + 0.5f);
+        rgba[2] = (uint8_t)(b * f + rgba[2] * fd + 0.5f);
+        rgba[3] = (uint8_t)(out_alpha * 255 + 0.5f);
+    }
+}
+
+static void raster_render_band(const RasterState& state, const Array<uint64_t>& band_polygons,
+                               uint64_t band, const RasterOutput& output) {
+    const uint64_t width = state.width;
+    const uint64_t first_row = band * GDSTK_RASTER_BAND_HEIGHT;
+    uint64_t rows = state.height - first_row;
+    if (rows > GDSTK_RASTER_BAND_HEIGHT) rows = GDSTK_RASTER_BAND_HEIGHT;
+    const uint64_t stride = width + 2;
+
+    if (output.rgba) {
+        uint8_t* pixel = output.rgba + 4 * first_row * width;
+        for (uint64_t i = rows * width; i > 0; i--) {
+            *pixel++ = (uint8_t)(output.background >> 24);
+            *pixel++ = (uint8_t)(output.background >> 16);
+            *pixel++ = (uint8_t)(output.background >> 8);
+            *pixel++ = (uint8_t)output.background;
+        }
+    }
+    if (band_polygons.count == 0) return;
+
+    float* acc = (float*)allocate(rows * stride * sizeof(float));
+    uint8_t* coverage = (uint8_t*)allocate(rows * width);
+    const uint64_t* index = band_polygons.items;
+    const uint64_t* end = band_polygons.items + band_polygons.count;
+    while (index < end) {
+        const uint64_t layer = state.polygons[*index].layer;
+        memset(acc, 0, rows * stride * sizeof(float));
+        for (; index < end && state.polygons[*index].layer == layer; index++) {
+            const RasterPolygon& polygon = state.polygons[*index];
+            const Vec2* p = polygon.point_array.items;
+            Vec2 v0 = p[polygon.point_array.count - 1];
+            v0.y -= first_row;
+            for (uint64_t i = polygon.point_array.count; i > 0; i--, p++) {
+                Vec2 v1 = {p->x, p->y - first_row};
+                raster_line(acc, stride, rows, (double)width, v0, v1, polygon.sign);
+                v0 = v1;
+            }
+        }
+
+        uint8_t* c = coverage;
+        for (uint64_t row = 0; row < rows; row++) {
+            float* a = acc + row * stride;
+            float sum = 0;
+            for (uint64_t i = width; i > 0; i--) {
+                sum += *a++;
+                float value = sum < 0 ? -sum : sum;
+                *c++ = value >= 1 ? 255 : (uint8_t)(value * 255 + 0.5f);
+            }
+        }
+
+        if (output.rgba) {
+            raster_compose(coverage, rows * width, output.colors[layer],
+                           output.rgba + 4 * first_row * width);
+        } else {
+            memcpy(output.coverage[layer] + first_row * width, coverage, rows * width);
+        }
+    }
+    free_allocation(acc);
+    free_allocation(coverage);
+}
+
+static ErrorCode raster_render(const Cell& cell, const Vec2 min, const Vec2 max, uint64_t width,
+                               uint64_t height, const Array<Tag>& tags,
+                               const RasterOutput& output) {
+    ErrorCode error_code = ErrorCode::NoError;
+    if (width == 0 || height == 0) return error_code;
+
+    RasterState state = {width, height};
+    bool empty = max.x <= min.x || max.y <= min.y;
+    if (!empty) {
+        // Pixel rows start from the top of the window
+        double sx = width / (max.x - min.x);
+        double sy = height / (max.y - min.y);
+        state.to_pixel = RasterTransform{sx, 0, 0, -sy, -min.x * sx, max.y * sy};
+        state.layers.ensure_slots(tags.count);
+        for (uint64_t i = 0; i < tags.count; i++) {
+            state.layers.append_unsafe(RasterLayer{tags[i], i});
+        }
+        sort(state.layers, raster_tag_order);
+        RasterTransform identity = {1, 0, 0, 1, 0, 0};
+        raster_collect(state, &cell, identity, error_code);
+    }
+
+    // Polygons are bucketed by image band, ordered by layer within each band
+    sort(state.polygons, raster_layer_order);
+    const uint64_t band_height = GDSTK_RASTER_BAND_HEIGHT;
+    const uint64_t band_count = (height + band_height - 1) / band_height;
+    Array<uint64_t>* bands =
+        (Array<uint64_t>*)allocate_clear(band_count * sizeof(Array<uint64_t>));
+    RasterPolygon* polygon = state.polygons.items;
+    for (uint64_t i = 0; i < state.polygons.count; i++, polygon++) {
+        uint64_t first = polygon->min_y <= 0 ? 0 : (uint64_t)polygon->min_y / band_height;
+        uint64_t last =
+            polygon->max_y >= height ? band_count - 1 : (uint64_t)polygon->max_y / band_height;
+        for (uint64_t b = first; b <= last; b++) bands[b].append(i);
+    }
+
+    if (output.coverage) {
+        for (uint64_t i = 0; i < tags.count; i++) memset(output.coverage[i], 0, width * height);
+    }
+
+    GDSTK_PARALLEL_FOR
+    for (int64_t b = 0; b < (int64_t)band_count; b++) {
+        raster_render_band(state, bands[b], b, output);
+    }
+
+    for (uint64_t b = 0; b < band_count; b++) bands[b].clear();
+    free_allocation(bands);
+    polygon = state.polygons.items;
+    for (uint64_t i = state.polygons.count; i > 0; i--, polygon++) polygon->point_array.clear();
+    state.polygons.clear();
+    state.layers.clear();
+    clear_geometry_cache(state.cache);
+    return error_code;
+}
+
+ErrorCode rasterize_coverage(const Cell& cell, const Vec2 min, const Vec2 max, uint64_t width,
+                             uint64_t height, const Array<Tag>& tags, uint8_t** coverage) {
+    RasterOutput output = {coverage};
+    return raster_render(cell, min, max, width, height, tags, output);
+}
+
+ErrorCode rasterize_rgba(const Cell& cell, const Vec2 min, const Vec2 max, uint64_t width,
+                         uint64_t height, const Array<Tag>& tags, const uint32_t* colors,
+                         uint32_t background, uint8_t* rgba) {
+    RasterOutput output = {NULL, colors, background, rgba};
+    return raster_render(cell, min, max, width, height, tags, output);
+}
+
+// Density map accumulation buffers for rows × columns windows, starting at
+// (column0, row0) in the global grid.  Each row has stride = columns + 2
+// entries, as required by raster_segment, and the buffers for each tag are
+// layer_stride entries apart.
+struct DensityGrid {
+    int64_t column0;
+    int64_t row0;
+    uint64_t columns;
+    uint64_t rows;
+    uint64_t stride;
+    uint64_t layer_stride;
+    double* acc;
+};
+
+// Contents of a cell prepared for the density accumulation
+struct DensityCell {
+    // Merged polygons with repetitions applied and tags replaced by layer
+    // indices
+    Array<Polygon*> polygon_array;
+    // True if the polygons and reference instances in the cell may overlap,
+    // in which case their areas cannot be simply added
+    bool overlapping;
+};
+
+struct DensityState {
+    RasterTransform to_grid;  // User units to grid coordinates
+    uint64_t layer_count;
+    Array<RasterLayer> layers;  // Sorted by tag
+    Map<GeometryInfo> cache;    // Read-only during accumulation
+    Map<DensityCell> cells;
+    double scaling;       // Boolean scaling in user units
+    double grid_scaling;  // Boolean scaling in grid coordinates
+};
+
+// Merged polygons from cell with tags in state.layers, with repetitions
+// applied.  Polygon tags are replaced by layer indices.
+static ErrorCode density_cell_polygons(const DensityState& state, const Cell* cell,
+                                       double scaling, Array<Polygon*>& result) {
+    ErrorCode error_code = ErrorCode::NoError;
+    Array<Polygon*> polygons = {};
+    cell->get_polygons(true, true, 0, false, 0, polygons);
+    Array<Polygon*> layer_polygons = {};
+    Array<Polygon*> empty = {};
+    for (uint64_t i = 0; i < state.layers.count; i++) {
+        Tag tag = state.layers[i].tag;
+        layer_polygons.count = 0;
+        for (uint64_t j = 0; j < polygons.count; j++) {
+            if (polygons[j]->tag == tag) layer_polygons.append(polygons[j]);
+        }
+        if (layer_polygons.count == 0) continue;
+        uint64_t start = result.count;
+        ErrorCode err = boolean(layer_polygons, empty, Operation::Or, scaling, result);
+        if (err != ErrorCode::NoError) error_code = err;
+        for (uint64_t j = start; j < result.count; j++) result[j]->tag = state.layers[i].index;
+    }
+    layer_polygons.clear();
+    for (uint64_t j = 0; j < polygons.count; j++) {
+        polygons[j]->clear();
+        free_allocation(polygons[j]);
+    }
+    polygons.clear();
+    return error_code;
+}
+
+// Transform from the coordinates of the cell referenced by ref to the
+// coordinates given by t
+static RasterTransform density_reference_transform(const Reference* ref,
+                                                   const RasterTransform& t) {
+    double m = ref->magnification;
+    double ca = m * cos(ref->rotation);
+    double sa = m * sin(ref->rotation);
+    double r = ref->x_reflection ? -1 : 1;
+    RasterTransform rt = {ca, -r * sa, sa, r * ca, ref->origin.x, ref->origin.y};
+    return RasterTransform{
+        t.xx * rt.xx + t.xy * rt.yx,          t.xx * rt.xy + t.xy * rt.yy,
+        t.yx * rt.xx + t.yy * rt.yx,          t.yx * rt.xy + t.yy * rt.yy,
+        t.xx * rt.x0 + t.xy * rt.y0 + t.x0, t.yx * rt.x0 + t.yy * rt.y0 + t.y0,
+    };
+}
+
+// Bounding box of cell in grid coordinates under transform t
+static void density_bounding_box(const DensityState& state, const Cell* cell,
+                                 const RasterTransform& t, Vec2& min, Vec2& max) {
+    GeometryInfo info = state.cache.get(cell->name);
+    min = Vec2{DBL_MAX, DBL_MAX};
+    max = Vec2{-DBL_MAX, -DBL_MAX};
+    if (info.bounding_box_min.x > info.bounding_box_max.x) return;
+    Vec2 corners[] = {info.bounding_box_min,
+                      Vec2{info.bounding_box_min.x, info.bounding_box_max.y},
+                      info.bounding_box_max,
+                      Vec2{info.bounding_box_max.x, info.bounding_box_min.y}};
+    for (uint64_t i = 0; i < COUNT(corners); i++) {
+        Vec2 p = t.apply(corners[i]);
+        if (p.x < min.x) min.x = p.x;
+        if (p.x > max.x) max.x = p.x;
+        if (p.y < min.y) min.y = p.y;
+        if (p.y > max.y) max.y = p.y;
+    }
+}
+
+// Add the contents of grid source, shifted by (columns, rows), to target.
+// Contributions left of the target are accumulated in its first column.
+static void density_add_shifted(const DensityGrid& source, int64_t columns, int64_t rows,
+                                uint64_t layer_count, DensityGrid& target) {
+    for (uint64_t layer = 0; layer < layer_count; layer++) {
+        const double* src_layer = source.acc + layer * source.layer_stride;
+        double* dst_layer = target.acc + layer * target.layer_stride;
+        for (uint64_t r = 0; r < source.rows; r++) {
+            int64_t row = source.row0 + (int64_t)r + rows - target.row0;
+            if (row < 0 || row >= (int64_t)target.rows) continue;
+            const double* src = src_layer + r * source.stride;
+            double* dst = dst_layer + row * target.stride;
+            int64_t column = source.column0 + columns - target.column0;
+            for (uint64_t c = source.stride; c > 0; c--, src++, column++) {
+                if (column >= (int64_t)target.stride) break;
+                dst[column < 0 ? 0 : column] += *src;
+            }
+        }
+    }
+}
+
+// Accumulate the area of polygon, under transform t (to grid coordinates),
+// into grid.
+static void density_accumulate_polygon(const Polygon* polygon, const RasterTransform& t,
+                                       DensityGrid& grid) {
+    const Array<Vec2>& point_array = polygon->point_array;
+    if (point_array.count < 3) return;
+    double* acc = grid.acc + polygon->tag * grid.layer_stride;
+    double area = 0;
+    Vec2 v0 = t.apply(point_array[point_array.count - 1]);
+    v0.x -= grid.column0;
+    v0.y -= grid.row0;
+    Vec2* p = point_array.items;
+    for (uint64_t j = point_array.count; j > 0; j--, p++) {
+        Vec2 v1 = t.apply(*p);
+        v1.x -= grid.column0;
+        v1.y -= grid.row0;
+        area += v0.x * v1.y - v0.y * v1.x;
+        v0 = v1;
+    }
+    // Positive accumulated area for either orientation
+    double sign = area < 0 ? 1 : -1;
+    v0 = t.apply(point_array[point_array.count - 1]);
+    v0.x -= grid.column0;
+    v0.y -= grid.row0;
+    p = point_array.items;
+    for (uint64_t j = point_array.count; j > 0; j--, p++) {
+        Vec2 v1 = t.apply(*p);
+        v1.x -= grid.column0;
+        v1.y -= grid.row0;
+        raster_line(acc, grid.stride, grid.rows, (double)grid.columns, v0, v1, sign);
+        v0 = v1;
+    }
+}
+
+// Instances of a reference in grid coordinates
+struct DensityReference {
+    RasterTransform t;  // Transform of the first instance
+    Vec2 min, max;      // Bounding box of the first instance
+    // Accumulation buffers for the first instance, reused by the others when
+    // the offset between them is a whole number of windows (only for
+    // repetitions)
+    DensityGrid local;
+};
+
+// Return false if the referenced cell is empty
+static bool density_reference_init(const DensityState& state, const Reference* ref,
+                                   const RasterTransform& t, uint64_t instance_count,
+                                   DensityReference& dr) {
+    dr.t = density_reference_transform(ref, t);
+    density_bounding_box(state, ref->cell, dr.t, dr.min, dr.max);
+    if (dr.min.x > dr.max.x) return false;
+    dr.local = DensityGrid{};
+    if (instance_count > 1) {
+        dr.local.column0 = (int64_t)floor(dr.min.x);
+        dr.local.row0 = (int64_t)floor(dr.min.y);
+        dr.local.columns = (uint64_t)((int64_t)ceil(dr.max.x) - dr.local.column0);
+        dr.local.rows = (uint64_t)((int64_t)ceil(dr.max.y) - dr.local.row0);
+        if (dr.local.columns == 0) dr.local.columns = 1;
+        if (dr.local.rows == 0) dr.local.rows = 1;
+        dr.local.stride = dr.local.columns + 2;
+        dr.local.layer_stride = dr.local.rows * dr.local.stride;
+    }
+    return true;
+}
+
+static bool density_instance_overlaps(const DensityReference& dr, const Vec2 shift,
+                                      const DensityGrid& grid) {
+    return dr.max.x + shift.x > grid.column0 &&
+           dr.min.x + shift.x < grid.column0 + (double)grid.columns &&
+           dr.max.y + shift.y > grid.row0 && dr.min.y + shift.y < grid.row0 + (double)grid.rows;
+}
+
+// True if the instance shifted by shift can reuse the local buffers
+static bool density_instance_aligned(const DensityReference& dr, const Vec2 shift, Vec2& whole) {
+    whole = Vec2{round(shift.x), round(shift.y)};
+    return dr.local.stride > 0 && fabs(shift.x - whole.x) < 1e-9 &&
+           fabs(shift.y - whole.y) < 1e-9;
+}
+
+// Bounding box of a contribution to the density of a cell, clipped to the
+// analyzed region: one of its merged polygons (group 0, which never overlap
+// each other) or a reference instance (one group for each instance)
+struct DensityBox {
+    Vec2 min, max;
+    uint64_t group;
+};
+
+// True if any 2 boxes that are not both in group 0 overlap by more than
+// tolerance.  Boxes are binned in a uniform grid with bins about the size of
+// the average box (with at most 4 bins for each box in total), and only the
+// boxes that share a bin are compared.
+static bool density_boxes_overlap(const Array<DensityBox>& boxes, double tolerance) {
+    if (boxes.count < 2) return false;
+    Vec2 min = {DBL_MAX, DBL_MAX};
+    Vec2 max = {-DBL_MAX, -DBL_MAX};
+    Vec2 size = {0, 0};
+    for (uint64_t i = 0; i < boxes.count; i++) {
+        const DensityBox& box = boxes[i];
+        if (box.min.x < min.x) min.x = box.min.x;
+        if (box.min.y < min.y) min.y = box.min.y;
+        if (box.max.x > max.x) max.x = box.max.x;
+        if (box.max.y > max.y) max.y = box.max.y;
+        size += box.max - box.min;
+    }
+    size /= (double)boxes.count;
+    const Vec2 extent = max - min;
+    const double bin_limit = 4.0 * boxes.count;
+    if (extent.x / size.x * (extent.y / size.y) > bin_limit) {
+        size *= sqrt(extent.x / size.x * (extent.y / size.y) / bin_limit);
+    }
+    const uint64_t columns = (uint64_t)(extent.x / size.x) + 1;
+    const uint64_t rows = (uint64_t)(extent.y / size.y) + 1;
+
+    // Boxes are sorted by bin in 2 passes: the first counts the boxes in each
+    // bin and the second fills them in.
+    const uint64_t bin_count = columns * rows;
+    uint64_t* bin_start = (uint64_t*)allocate_clear((bin_count + 1) * sizeof(uint64_t));
+    Array<uint64_t> bins = {};
+    for (uint64_t pass = 0; pass < 2; pass++) {
+        for (uint64_t i = 0; i < boxes.count; i++) {
+            const DensityBox& box = boxes[i];
+            uint64_t column0 = (uint64_t)((box.min.x - min.x) / size.x);
+            uint64_t column1 = (uint64_t)((box.max.x - min.x) / size.x);
+            uint64_t row0 = (uint64_t)((box.min.y - min.y) / size.y);
+            uint64_t row1 = (uint64_t)((box.max.y - min.y) / size.y);
+            if (column1 >= columns) column1 = columns - 1;
+            if (row1 >= rows) row1 = rows - 1;
+            for (uint64_t r = row0; r <= row1; r++) {
+                for (uint64_t c = column0; c <= column1; c++) {
+                    const uint64_t bin = r * columns + c;
+                    if (pass == 0) {
+                        bin_start[bin + 1]++;
+                    } else {
+                        bins[bin_start[bin]++] = i;
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (uint64_t b = 0; b < bin_count; b++) bin_start[b + 1] += bin_start[b];
+            bins.ensure_slots(bin_start[bin_count]);
+            bins.count = bin_start[bin_count];
+        } else {
+            // bin_start[b] now holds the end of bin b, which is the start of
+            // bin b + 1
+            for (uint64_t b = bin_count; b > 0; b--) bin_start[b] = bin_start[b - 1];
+            bin_start[0] = 0;
+        }
+    }
+
+    bool overlap = false;
+    for (uint64_t b = 0; b < bin_count && !overlap; b++) {
+        const uint64_t end = bin_start[b + 1];
+        for (uint64_t i = bin_start[b]; i < end && !overlap; i++) {
+            const DensityBox& box = boxes[bins[i]];
+            for (uint64_t j = i + 1; j < end; j++) {
+                const DensityBox& other = boxes[bins[j]];
+                if ((box.group > 0 || other.group > 0) && other.max.x > box.min.x + tolerance &&
+                    box.max.x > other.min.x + tolerance && other.max.y > box.min.y + tolerance &&
+                    box.max.y > other.min.y + tolerance) {
+                    overlap = true;
+                    break;
+                }
+            }
+        }
+    }
+    free_allocation(bin_start);
+    bins.clear();
+    return overlap;
+}
+
+static void density_append_box(Vec2 box_min, Vec2 box_max, const Vec2 min, const Vec2 max,
+                               uint64_t group, Array<DensityBox>& boxes) {
+    if (box_min.x < min.x) box_min.x = min.x;
+    if (box_min.y < min.y) box_min.y = min.y;
+    if (box_max.x > max.x) box_max.x = max.x;
+    if (box_max.y > max.y) box_max.y = max.y;
+    if (box_min.x >= box_max.x || box_min.y >= box_max.y) return;
+    boxes.append(DensityBox{box_min, box_max, group});
+}
+
+// True if the contents of cell (its merged polygons and reference instances)
+// may overlap within the region between min and max, in cell coordinates.
+// Contents that overlap by less than tolerance are not reported.
+static bool density_contents_overlap(const DensityState& state, const Cell* cell,
+                                     const Array<Polygon*>& polygons, const Vec2 min,
+                                     const Vec2 max, double tolerance) {
+    Array<DensityBox> boxes = {};
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        Vec2 box_min, box_max;
+        polygons[i]->bounding_box(box_min, box_max);
+        density_append_box(box_min, box_max, min, max, 0, boxes);
+    }
+    const RasterTransform identity = {1, 0, 0, 1, 0, 0};
+    uint64_t group = 0;
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+        Vec2 ref_min, ref_max;
+        density_bounding_box(state, ref->cell, density_reference_transform(ref, identity), ref_min,
+                             ref_max);
+        if (ref_min.x > ref_max.x) continue;
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            density_append_box(ref_min + offset, ref_max + offset, min, max, ++group, boxes);
+        }
+    }
+
+    bool overlap = density_boxes_overlap(boxes, tolerance);
+    boxes.clear();
+    return overlap;
+}
+
+// Append to layers (one array for each tag) copies of the polygons in the
+// hierarchy of cell, under transform t (to grid coordinates), that intersect
+// grid.
+static void density_collect(const DensityState& state, const Cell* cell,
+                            const RasterTransform& t, const DensityGrid& grid,
+                            Array<Polygon*>* layers) {
+    const Vec2 grid_min = {(double)grid.column0, (double)grid.row0};
+    const Vec2 grid_max = {grid_min.x + grid.columns, grid_min.y + grid.rows};
+    const Array<Polygon*> polygons = state.cells.get(cell->name).polygon_array;
+    for (uint64_t i = 0; i < polygons.count; i++) {
+        const Array<Vec2>& point_array = polygons[i]->point_array;
+        if (point_array.count < 3) continue;
+        Polygon* polygon = (Polygon*)allocate_clear(sizeof(Polygon));
+        polygon->tag = polygons[i]->tag;
+        polygon->point_array.ensure_slots(point_array.count);
+        Vec2 min = {DBL_MAX, DBL_MAX};
+        Vec2 max = {-DBL_MAX, -DBL_MAX};
+        Vec2* p = point_array.items;
+        for (uint64_t j = point_array.count; j > 0; j--, p++) {
+            Vec2 q = t.apply(*p);
+            if (q.x < min.x) min.x = q.x;
+            if (q.x > max.x) max.x = q.x;
+            if (q.y < min.y) min.y = q.y;
+            if (q.y > max.y) max.y = q.y;
+            polygon->point_array.append_unsafe(q);
+        }
+        if (max.x <= grid_min.x || min.x >= grid_max.x || max.y <= grid_min.y ||
+            min.y >= grid_max.y) {
+            polygon->clear();
+            free_allocation(polygon);
+            continue;
+        }
+        layers[polygon->tag].append(polygon);
+    }
+
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+        DensityReference dr;
+        if (!density_reference_init(state, ref, t, 1, dr)) continue;
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            Vec2 shift = {t.xx * offset.x + t.xy * offset.y, t.yx * offset.x + t.yy * offset.y};
+            if (!density_instance_overlaps(dr, shift, grid)) continue;
+            RasterTransform t0 = dr.t;
+            t0.x0 += shift.x;
+            t0.y0 += shift.y;
+            density_collect(state, ref->cell, t0, grid, layers);
+        }
+    }
+}
+
+// Merge the polygons with the given indices, clipped to the rectangle between
+// min and max, and accumulate their area into grid.  Regions with many
+// polygons are split in half recursively, so that each boolean operation
+// remains small.
+static ErrorCode density_merge_region(const DensityState& state, const Array<Polygon*>& polygons,
+                                      const Array<DensityBox>& boxes,
+                                      const Array<uint64_t>& indices, const Vec2 min,
+                                      const Vec2 max, uint64_t depth, DensityGrid& grid) {
+    ErrorCode error_code = ErrorCode::NoError;
+    if (indices.count > GDSTK_DENSITY_MERGE_COUNT && depth < GDSTK_DENSITY_MERGE_DEPTH) {
+        const bool split_x = max.x - min.x >= max.y - min.y;
+        const double middle = split_x ? 0.5 * (min.x + max.x) : 0.5 * (min.y + max.y);
+        const Vec2 mins[] = {min, split_x ? Vec2{middle, min.y} : Vec2{min.x, middle}};
+        const Vec2 maxs[] = {split_x ? Vec2{middle, max.y} : Vec2{max.x, middle}, max};
+        Array<uint64_t> half = {};
+        half.ensure_slots(indices.count);
+        for (uint64_t h = 0; h < 2; h++) {
+            half.count = 0;
+            for (uint64_t i = 0; i < indices.count; i++) {
+                const DensityBox& box = boxes[indices[i]];
+                if (box.max.x > mins[h].x && box.min.x < maxs[h].x && box.max.y > mins[h].y &&
+                    box.min.y < maxs[h].y) {
+                    half.append_unsafe(indices[i]);
+                }
+            }
+            if (half.count == 0) continue;
+            ErrorCode err = density_merge_region(state, polygons, boxes, half, mins[h], maxs[h],
+                                                 depth + 1, grid);
+            if (err != ErrorCode::NoError) error_code = err;
+        }
+        half.clear();
+        return error_code;
+    }
+
+    Array<Polygon*> subset = {};
+    subset.ensure_slots(indices.count);
+    for (uint64_t i = 0; i < indices.count; i++) subset.append_unsafe(polygons[indices[i]]);
+    Polygon clip = rectangle(min, max, 0);
+    Polygon* clip_pointer = &clip;
+    const Array<Polygon*> clip_array = {1, 1, &clip_pointer};
+    Array<Polygon*> merged = {};
+    error_code = boolean(subset, clip_array, Operation::And, state.grid_scaling, merged);
+    const RasterTransform identity = {1, 0, 0, 1, 0, 0};
+    const Tag layer = subset[0]->tag;
+    for (uint64_t i = 0; i < merged.count; i++) {
+        merged[i]->tag = layer;
+        density_accumulate_polygon(merged[i], identity, grid);
+        merged[i]->clear();
+        free_allocation(merged[i]);
+    }
+    merged.clear();
+    clip.clear();
+    subset.clear();
+    return error_code;
+}
+
+// Merge the polygons in the hierarchy of cell, under transform t (to grid
+// coordinates), clipped to grid, and accumulate their area into grid.
+static ErrorCode density_merge(const DensityState& state, const Cell* cell,
+                               const RasterTransform& t, DensityGrid& grid) {
+    ErrorCode error_code = ErrorCode::NoError;
+    Array<Polygon*>* layers =
+        (Array<Polygon*>*)allocate_clear(state.layer_count * sizeof(Array<Polygon*>));
+    density_collect(state, cell, t, grid, layers);
+
+    const Vec2 min = {(double)grid.column0, (double)grid.row0};
+    const Vec2 max = {min.x + grid.columns, min.y + grid.rows};
+    Array<DensityBox> boxes = {};
+    Array<uint64_t> indices = {};
+    for (uint64_t layer = 0; layer < state.layer_count; layer++) {
+        Array<Polygon*>& polygons = layers[layer];
+        if (polygons.count == 0) continue;
+        boxes.count = 0;
+        indices.count = 0;
+        boxes.ensure_slots(polygons.count);
+        indices.ensure_slots(polygons.count);
+        for (uint64_t i = 0; i < polygons.count; i++) {
+            DensityBox box = {};
+            polygons[i]->bounding_box(box.min, box.max);
+            boxes.append_unsafe(box);
+            indices.append_unsafe(i);
+        }
+        ErrorCode err = density_merge_region(state, polygons, boxes, indices, min, max, 0, grid);
+        if (err != ErrorCode::NoError) error_code = err;
+        for (uint64_t i = 0; i < polygons.count; i++) {
+            polygons[i]->clear();
+            free_allocation(polygons[i]);
+        }
+        polygons.clear();
+    }
+    boxes.clear();
+    indices.clear();
+    free_allocation(layers);
+    return error_code;
+}
+
+static ErrorCode density_accumulate(const DensityState& state, const Cell* cell,
+                                    const RasterTransform& t, DensityGrid& grid);
+
+static ErrorCode density_accumulate_local(const DensityState& state, const Reference* ref,
+                                          DensityReference& dr) {
+    dr.local.acc =
+        (double*)allocate_clear(state.layer_count * dr.local.layer_stride * sizeof(double));
+    return density_accumulate(state, ref->cell, dr.t, dr.local);
+}
+
+// Accumulate the instances of the references in cell, under transform t, into
+// grid.  If shared is not NULL, it holds the prebuilt local buffers for each
+// reference, which are used instead of building new ones.  The instances must
+// not overlap each other.
+static ErrorCode density_accumulate_references(const DensityState& state, const Cell* cell,
+                                               const RasterTransform& t, DensityGrid& grid,
+                                               const DensityGrid* shared) {
+    ErrorCode error_code = ErrorCode::NoError;
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = 0; i < cell->reference_array.count; i++, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type != ReferenceType::Cell) continue;
+
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        DensityReference dr;
+        if (!density_reference_init(state, ref, t, iterator.count, dr)) continue;
+        if (shared) dr.local.acc = shared[i].acc;
+        const bool owned = dr.local.acc == NULL;
+
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            Vec2 shift = {t.xx * offset.x + t.xy * offset.y, t.yx * offset.x + t.yy * offset.y};
+            if (!density_instance_overlaps(dr, shift, grid)) continue;
+            Vec2 whole;
+            ErrorCode err = ErrorCode::NoError;
+            if (density_instance_aligned(dr, shift, whole)) {
+                if (dr.local.acc == NULL) err = density_accumulate_local(state, ref, dr);
+                density_add_shifted(dr.local, (int64_t)whole.x, (int64_t)whole.y,
+                                    state.layer_count, grid);
+            } else {
+                RasterTransform t0 = dr.t;
+                t0.x0 += shift.x;
+                t0.y0 += shift.y;
+                err = density_accumulate(state, ref->cell, t0, grid);
+            }
+            if (err != ErrorCode::NoError) error_code = err;
+        }
+        if (owned && dr.local.acc) free_allocation(dr.local.acc);
+    }
+    return error_code;
+}
+
+// Accumulate the area of the contents of cell, under transform t (to grid
+// coordinates), into grid.  The areas of contents that do not overlap are
+// simply added, otherwise they are merged first.
+static ErrorCode density_accumulate(const DensityState& state, const Cell* cell,
+                                    const RasterTransform& t, DensityGrid& grid) {
+    const DensityCell density_cell = state.cells.get(cell->name);
+    if (density_cell.overlapping) return density_merge(state, cell, t, grid);
+    Polygon** polygon = density_cell.polygon_array.items;
+    for (uint64_t i = density_cell.polygon_array.count; i > 0; i--, polygon++) {
+        density_accumulate_polygon(*polygon, t, grid);
+    }
+    return density_accumulate_references(state, cell, t, grid, NULL);
+}
+
+ErrorCode density_map(const Cell& cell, const Vec2 origin, const Vec2 window_size,
+                      uint64_t columns, uint64_t rows, const Array<Tag>& tags, double precision,
+                      double** density) {
+    ErrorCode error_code = ErrorCode::NoError;
+    for (uint64_t i = 0; i < tags.count; i++) {
+        memset(density[i], 0, columns * rows * sizeof(double));
+    }
+    if (columns == 0 || rows == 0 || tags.count == 0 || window_size.x <= 0 || window_size.y <= 0)
+        return error_code;
+
+    DensityState state = {};
+    state.to_grid = RasterTransform{1 / window_size.x, 0, 0, 1 / window_size.y,
+                                    -origin.x / window_size.x, -origin.y / window_size.y};
+    state.layer_count = tags.count;
+    state.layers.ensure_slots(tags.count);
+    for (uint64_t i = 0; i < tags.count; i++) state.layers.append_unsafe(RasterLayer{tags[i], i});
+    sort(state.layers, raster_tag_order);
+    state.scaling = 1 / precision;
+    state.grid_scaling =
+        (window_size.x > window_size.y ? window_size.x : window_size.y) * state.scaling;
+
+    // Bounding boxes, merged polygons and overlaps are calculated for all
+    // cells before the parallel accumulation.
+    Map<Cell*> cell_map = {};
+    cell.get_dependencies(true, cell_map);
+    Array<Cell*> cells = {};
+    cells.ensure_slots(cell_map.count + 1);
+    cells.append_unsafe((Cell*)&cell);
+    for (MapItem<Cell*>* item = cell_map.next(NULL); item; item = cell_map.next(item)) {
+        cells.append_unsafe(item->value);
+    }
+    cell_map.clear();
+    for (uint64_t i = 0; i < cells.count; i++) {
+        if (!state.cache.get(cells[i]->name).bounding_box_valid) {
+            cells[i]->bounding_box(state.cache);
+        }
+    }
+
+    DensityCell* cell_data = (DensityCell*)allocate_clear(cells.count * sizeof(DensityCell));
+    ErrorCode* cell_errors = (ErrorCode*)allocate_clear(cells.count * sizeof(ErrorCode));
+    const Vec2 all_min = {-DBL_MAX, -DBL_MAX};
+    const Vec2 all_max = {DBL_MAX, DBL_MAX};
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)cells.count; i++) {
+        DensityCell& data = cell_data[i];
+        cell_errors[i] =
+            density_cell_polygons(state, cells[i], state.scaling, data.polygon_array);
+        data.overlapping = density_contents_overlap(state, cells[i], data.polygon_array, all_min,
+                                                    all_max, precision);
+    }
+    for (uint64_t i = 0; i < cells.count; i++) {
+        if (cell_errors[i] != ErrorCode::NoError) error_code = cell_errors[i];
+        state.cells.set(cells[i]->name, cell_data[i]);
+    }
+    free_allocation(cell_errors);
+
+    // Bands of rows are accumulated in parallel into disjoint parts of the
+    // buffers.  The polygons of the top cell are bucketed by band and the
+    // local buffers of its references are built only once for all bands.
+    const uint64_t stride = columns + 2;
+    double* acc = (double*)allocate_clear(tags.count * rows * stride * sizeof(double));
+    uint64_t band_count = 4 * get_thread_count();
+    if (band_count > rows) band_count = rows;
+    const uint64_t band_rows = (rows + band_count - 1) / band_count;
+    band_count = (rows + band_rows - 1) / band_rows;
+
+    const DensityCell top = state.cells.get(cell.name);
+    const Array<Polygon*>& top_polygons = top.polygon_array;
+    Array<uint64_t>* bands =
+        (Array<uint64_t>*)allocate_clear(band_count * sizeof(Array<uint64_t>));
+    for (uint64_t i = 0; i < top_polygons.count; i++) {
+        const Array<Vec2>& point_array = top_polygons[i]->point_array;
+        if (point_array.count < 3) continue;
+        double min_y = DBL_MAX;
+        double max_y = -DBL_MAX;
+        Vec2* p = point_array.items;
+        for (uint64_t j = point_array.count; j > 0; j--, p++) {
+            double y = state.to_grid.apply(*p).y;
+            if (y < min_y) min_y = y;
+            if (y > max_y) max_y = y;
+        }
+        if (max_y <= 0 || min_y >= rows) continue;
+        uint64_t first = min_y <= 0 ? 0 : (uint64_t)min_y / band_rows;
+        uint64_t last = max_y >= rows ? band_count - 1 : (uint64_t)max_y / band_rows;
+        for (uint64_t b = first; b <= last; b++) bands[b].append(i);
+    }
+
+    const uint64_t reference_count = cell.reference_array.count;
+    DensityGrid* shared = (DensityGrid*)allocate_clear(reference_count * sizeof(DensityGrid));
+    ErrorCode* shared_errors = (ErrorCode*)allocate_clear(reference_count * sizeof(ErrorCode));
+    const DensityGrid window = {0, 0, columns, rows};
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)reference_count; i++) {
+        const Reference* ref = cell.reference_array[i];
+        if (ref->type != ReferenceType::Cell) continue;
+        RepetitionIterator iterator = {};
+        iterator.init(ref->repetition);
+        DensityReference dr;
+        if (!density_reference_init(state, ref, state.to_grid, iterator.count, dr)) continue;
+        const RasterTransform& t = state.to_grid;
+        Vec2 offset;
+        while (iterator.next(offset)) {
+            Vec2 shift = {t.xx * offset.x + t.xy * offset.y, t.yx * offset.x + t.yy * offset.y};
+            Vec2 whole;
+            if (density_instance_overlaps(dr, shift, window) &&
+                density_instance_aligned(dr, shift, whole)) {
+                shared_errors[i] = density_accumulate_local(state, ref, dr);
+                shared[i] = dr.local;
+                break;
+            }
+        }
+    }
+    for (uint64_t i = 0; i < reference_count; i++) {
+        if (shared_errors[i] != ErrorCode::NoError) error_code = shared_errors[i];
+    }
+    free_allocation(shared_errors);
+
+    // The contents of the top cell are merged only in the bands where they
+    // overlap.
+    ErrorCode* band_errors = (ErrorCode*)allocate_clear(band_count * sizeof(ErrorCode));
+    GDSTK_PARALLEL_FOR
+    for (int64_t b = 0; b < (int64_t)band_count; b++) {
+        DensityGrid grid = {};
+        grid.row0 = b * band_rows;
+        grid.rows = rows - grid.row0 < band_rows ? rows - grid.row0 : band_rows;
+        grid.columns = columns;
+        grid.stride = stride;
+        grid.layer_stride = rows * stride;
+        grid.acc = acc + grid.row0 * stride;
+        if (top.overlapping) {
+            const Vec2 band_min = {origin.x, origin.y + grid.row0 * window_size.y};
+            const Vec2 band_max = {origin.x + columns * window_size.x,
+                                   band_min.y + grid.rows * window_size.y};
+            if (density_contents_overlap(state, &cell, top_polygons, band_min, band_max,
+                                         precision)) {
+                band_errors[b] = density_merge(state, &cell, state.to_grid, grid);
+                continue;
+            }
+        }
+        const Array<uint64_t>& band = bands[b];
+        for (uint64_t i = 0; i < band.count; i++) {
+            density_accumulate_polygon(top_polygons[band[i]], state.to_grid, grid);
+        }
+        band_errors[b] = density_accumulate_references(state, &cell, state.to_grid, grid, shared);
+    }
+    for (uint64_t b = 0; b < band_count; b++) {
+        if (band_errors[b] != ErrorCode::NoError) error_code = band_errors[b];
+        bands[b].clear();
+    }
+    free_allocation(band_errors);
+    free_allocation(bands);
+    for (uint64_t i = 0; i < reference_count; i++) {
+        if (shared[i].acc) free_allocation(shared[i].acc);
+    }
+    free_allocation(shared);
+
+    GDSTK_PARALLEL_FOR
+    for (int64_t r = 0; r < (int64_t)(tags.count * rows); r++) {
+        const uint64_t layer = r / rows;
+        const uint64_t row = r % rows;
+        const double* a = acc + r * stride;
+        double* d = density[layer] + row * columns;
+        double sum = 0;
+        for (uint64_t c = columns; c > 0; c--) {
+            sum += *a++;
+            *d++ = sum < 0 ? 0 : (sum > 1 ? 1 : sum);
+        }
+    }
+    free_allocation(acc);
+
+    for (uint64_t i = 0; i < cells.count; i++) {
+        Array<Polygon*>& polygons = cell_data[i].polygon_array;
+        for (uint64_t j = 0; j < polygons.count; j++) {
+            polygons[j]->clear();
+            free_allocation(polygons[j]);
+        }
+        polygons.clear();
+    }
+    free_allocation(cell_data);
+    cells.clear();
+    state.cells.clear();
+    state.layers.clear();
+    clear_geometry_cache(state.cache);
+    return error_code;
+}
+
+static void png_write_chunk(FILE* out, const char* type, const uint8_t* data, uint32_t size) {
+    uint32_t header[] = {size, 0};
+    big_endian_swap32(header, 1);
+    memcpy(header + 1, type, 4);
+    fwrite(header, sizeof(uint32_t), COUNT(header), out);
+    if (size > 0) fwrite(data, 1, size, out);
+    uint32_t crc = (uint32_t)crc32(0, (const Bytef*)type, 4);
+    if (size > 0) crc = (uint32_t)crc32(crc, data, size);
+    big_endian_swap32(&crc, 1);
+    fwrite(&crc, sizeof(uint32_t), 1, out);
+}
+
+static void* png_zalloc(void*, uInt count, uInt size) { return allocate(count * size); }
+
+static void png_zfree(void*, void* ptr) { free_allocation(ptr); }
+
+ErrorCode write_png(const char* filename, const uint8_t* data, uint64_t width, uint64_t height,
+                    uint8_t channels) {
+    const uint8_t color_types[] = {0, 4, 2, 6};
+    if (channels < 1 || channels > 4 || width == 0 || height == 0 || width > 0x7FFFFFFF ||
+        height > 0x7FFFFFFF) {
+        if (error_logger) fputs("[GDSTK] Invalid PNG image dimensions.\n", error_logger);
+        return ErrorCode::InvalidFile;
+    }
+
+    FILE* out = fopen(filename, "wb");
+    if (out == NULL) {
+        if (error_logger) fputs("[GDSTK] Unable to open file for PNG output.\n", error_logger);
+        return ErrorCode::OutputFileOpenError;
+    }
+
+    const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, COUNT(signature), out);
+
+    uint32_t dimensions[] = {(uint32_t)width, (uint32_t)height};
+    big_endian_swap32(dimensions, COUNT(dimensions));
+    uint8_t ihdr[13];
+    memcpy(ihdr, dimensions, 8);
+    ihdr[8] = 8;  // Bit depth
+    ihdr[9] = color_types[channels - 1];
+    ihdr[10] = 0;  // Compression method
+    ihdr[11] = 0;  // Filter method
+    ihdr[12] = 0;  // Interlace method
+    png_write_chunk(out, "IHDR", ihdr, COUNT(ihdr));
+
+    ErrorCode error_code = ErrorCode::NoError;
+    z_stream s = {};
+    s.zalloc = png_zalloc;
+    s.zfree = png_zfree;
+    if (deflateInit(&s, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        if (error_logger) fputs("[GDSTK] Unable to initialize zlib.\n", error_logger);
+        fclose(out);
+        return ErrorCode::ZlibError;
+    }
+
+    // Rows are filtered with the Up filter (difference from the row above),
+    // which favors the large uniform areas typical of layouts.
+    const uint64_t row_size = width * channels;
+    const uint64_t buffer_size = 1 << 18;
+    uint8_t* row = (uint8_t*)allocate(row_size + 1);
+    uint8_t* buffer = (uint8_t*)allocate(buffer_size);
+    s.next_out = buffer;
+    s.avail_out = (uInt)buffer_size;
+    for (uint64_t y = 0; y <= height && error_code == ErrorCode::NoError; y++) {
+        int flush = Z_FINISH;
+        if (y < height) {
+            const uint8_t* src = data + y * row_size;
+            row[0] = y == 0 ? 0 : 2;
+            if (y == 0) {
+                memcpy(row + 1, src, row_size);
+            } else {
+                const uint8_t* above = src - row_size;
+                for (uint64_t i = 0; i < row_size; i++) row[i + 1] = src[i] - above[i];
+            }
+            s.next_in = row;
+            s.avail_in = (uInt)(row_size + 1);
+            flush = Z_NO_FLUSH;
+        }
+        int ret;
+        do {
+            ret = deflate(&s, flush);
+            if (ret == Z_STREAM_ERROR) {
+                if (error_logger) fputs("[GDSTK] Unable to compress PNG data.\n", error_logger);
+                error_code = ErrorCode::ZlibError;
+                break;
+            }
+            if (s.avail_out == 0 || (flush == Z_FINISH && ret == Z_STREAM_END)) {
+                png_write_chunk(out, "IDAT", buffer, (uint32_t)(buffer_size - s.avail_out));
+                s.next_out = buffer;
+                s.avail_out = (uInt)buffer_size;
+            }
+        } while (s.avail_in > 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    }
+    deflateEnd(&s);
+    free_allocation(row);
+    free_allocation(buffer);
+
+    png_write_chunk(out, "IEND", NULL, 0);
+    fclose(out);
+    return error_code;
+}
+
+}  // namespace gdstk
@@ -109,10 +109,7 @@ void Reference::repeat_and_transform(Array<Vec2>& point_array) const {
 void Reference::bounding_box(Vec2& min, Vec2& max) const {
     Map<GeometryInfo> cache = {};
     bounding_box(min, max, cache);
-    for (MapItem<GeometryInfo>* item = cache.next(NULL); item; item = cache.next(item)) {
-        item->value.clear();
-    }
-    cache.clear();
+    clear_geometry_cache(cache);
 }
 
 void Reference::bounding_box(Vec2& min, Vec2& max, Map<GeometryInfo>& cache) const {
@@ -161,10 +158,7 @@ void Reference::convex_hull(Array<Vec2>& result) const {
     if (type != ReferenceType::Cell) return;
     Map<GeometryInfo> cache = {};
     convex_hull(result, cache);
-    for (MapItem<GeometryInfo>* item = cache.next(NULL); item; item = cache.next(item)) {
-        item->value.clear();
-    }
-    cache.clear();
+    clear_geometry_cache(cache);
 }
 
 void Reference::convex_hull(Array<Vec2>& result, Map<GeometryInfo>& cache) const {
@@ -180,6 +174,30 @@ void Reference::convex_hull(Array<Vec2>& result, Map<GeometryInfo>& cache) const
     point_array.clear();
 }
 
+uint64_t Reference::placement_hash(double scaling, const Vec2 offset) const {
+    uint64_t result = hash_combine(0, hash_coordinate(origin.x - offset.x, scaling));
+    result = hash_combine(result, hash_coordinate(origin.y - offset.y, scaling));
+    result = hash_combine(result, hash_coordinate(rotation, 1e9));
+    result = hash_combine(result, hash_coordinate(magnification, 1e9));
+    result = hash_combine(result, x_reflection ? 1 : 0);
+    result = hash_combine(result, repetition.content_hash(scaling));
+    return hash_combine(result, properties_hash(properties));
+}
+
+uint64_t Reference::content_hash(double scaling, Map<uint64_t>& cache) const {
+    uint64_t result = placement_hash(scaling, Vec2{0, 0});
+    switch (type) {
+        case ReferenceType::Cell:
+            return hash_combine(result, cell->content_hash(scaling, cache));
+        case ReferenceType::RawCell:
+            result = hash_combine(result, hash((const char*)rawcell->name));
+            return hash_combine(result, rawcell->size);
+        case ReferenceType::Name:
+            return hash_combine(result, hash((const char*)name));
+    }
+    return result;
+}
+
 void Reference::transform(double mag, bool x_refl, double rot, const Vec2 orig) {
     const int r1 = x_refl ? -1 : 1;
     const double crot = cos(rot);
@@ -196,173 +214,208 @@ void Reference::transform(double mag, bool x_refl, double rot, const Vec2 orig)
 void Reference::apply_repetition(Array<Reference*>& result) {
     if (repetition.type == RepetitionType::None) return;
 
-    Array<Vec2> offsets = {};
-    repetition.get_offsets(offsets);
-    repetition.clear();
+    // Take the repetition out so that it is not copied to the new elements
+    Repetition rep = repetition;
+    repetition.type = RepetitionType::None;
 
+    RepetitionIterator iterator = {};
+    iterator.init(rep);
+    Vec2 offset;
     // Skip first offset (0, 0)
-    double* offset_p = (double*)(offsets.items + 1);
-    result.ensure_slots(offsets.count - 1);
-    for (uint64_t offset_count = offsets.count - 1; offset_count > 0; offset_count--) {
+    iterator.next(offset);
+    result.ensure_slots(iterator.count - 1);
+    while (iterator.next(offset)) {
         Reference* reference = (Reference*)allocate_clear(sizeof(Reference));
         reference->copy_from(*this);
-        reference->origin.x += *offset_p++;
-        reference->origin.y += *offset_p++;
+        reference->origin += offset;
         result.append_unsafe(reference);
     }
 
-    offsets.clear();
+    rep.clear();
     return;
 }
 
-// Depth is passed as-is to Cell::get_polygons, where it is inspected and applied.
-void Reference::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
-                             Tag tag, Array<Polygon*>& result) const {
-    if (type != ReferenceType::Cell) return;
-
-    Array<Polygon*> array = {};
-    cell->get_polygons(apply_repetitions, include_paths, depth, filter, tag, array);
+// Move the elements in array to result, transformed by reference, creating
+// the copies required by its repetition.
+template <class T>
+static void place_elements(const Reference& reference, const Array<T*>& array,
+                           Array<T*>& result) {
+    RepetitionIterator iterator = {};
+    iterator.init(reference.repetition);
+    result.ensure_slots(array.count * iterator.count);
 
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
-    result.ensure_slots(array.count * offsets.count);
-
-    Polygon** a_item = array.items;
+    T** a_item = array.items;
     for (uint64_t i = 0; i < array.count; i++) {
-        Polygon* src = *a_item++;
-        Vec2* offset_p = offsets.items;
-        for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
-            Polygon* dst;
-            // Avoid an extra allocation by moving the last polygon.
-            if (offset_count == 1) {
+        T* src = *a_item++;
+        Vec2 offset;
+        iterator.init(reference.repetition);
+        while (iterator.next(offset)) {
+            T* dst;
+            // Avoid an extra allocation by moving the last element.
+            if (iterator.index == iterator.count) {
                 dst = src;
             } else {
-                dst = (Polygon*)allocate_clear(sizeof(Polygon));
+                dst = (T*)allocate_clear(sizeof(T));
                 dst->copy_from(*src);
             }
-            dst->transform(magnification, x_reflection, rotation, origin + *offset_p++);
+            dst->transform(reference.magnification, reference.x_reflection, reference.rotation,
+                           reference.origin + offset);
             result.append_unsafe(dst);
         }
     }
+}
+
+// Depth is passed as-is to Cell::get_polygons, where it is inspected and applied.
+void Reference::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                             Tag tag, Array<Polygon*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_polygons(apply_repetitions, include_paths, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth, bool filter,
+                             Tag tag, Array<Polygon*>& result, Map<GeometryInfo>& cache) const {
+    if (type != ReferenceType::Cell) return;
+
+    Array<Polygon*> array = {};
+    cell->get_polygons(apply_repetitions, include_paths, depth, filter, tag, array, cache);
+    place_elements(*this, array, result);
     array.clear();
-    if (repetition.type != RepetitionType::None) offsets.clear();
 }
 
 void Reference::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                               Array<FlexPath*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_flexpaths(apply_repetitions, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_flexpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                              Array<FlexPath*>& result, Map<GeometryInfo>& cache) const {
     if (type != ReferenceType::Cell) return;
 
     Array<FlexPath*> array = {};
-    cell->get_flexpaths(apply_repetitions, depth, filter, tag, array);
-
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
-    result.ensure_slots(array.count * offsets.count);
-
-    FlexPath** a_item = array.items;
-    for (uint64_t i = 0; i < array.count; i++) {
-        FlexPath* src = *a_item++;
-        Vec2* offset_p = offsets.items;
-        for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
-            FlexPath* dst;
-            if (offset_count == 1) {
-                dst = src;
-            } else {
-                dst = (FlexPath*)allocate_clear(sizeof(FlexPath));
-                dst->copy_from(*src);
-            }
-            dst->transform(magnification, x_reflection, rotation, origin + *offset_p++);
-            result.append_unsafe(dst);
-        }
-    }
+    cell->get_flexpaths(apply_repetitions, depth, filter, tag, array, cache);
+    place_elements(*this, array, result);
     array.clear();
-    if (repetition.type != RepetitionType::None) offsets.clear();
 }
 
 void Reference::get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                                 Array<RobustPath*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_robustpaths(apply_repetitions, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_robustpaths(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                                Array<RobustPath*>& result, Map<GeometryInfo>& cache) const {
     if (type != ReferenceType::Cell) return;
 
     Array<RobustPath*> array = {};
-    cell->get_robustpaths(apply_repetitions, depth, filter, tag, array);
-
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
-    result.ensure_slots(array.count * offsets.count);
-
-    RobustPath** a_item = array.items;
-    for (uint64_t i = 0; i < array.count; i++) {
-        RobustPath* src = *a_item++;
-        Vec2* offset_p = offsets.items;
-        for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
-            RobustPath* dst;
-            if (offset_count == 1) {
-                dst = src;
-            } else {
-                dst = (RobustPath*)allocate_clear(sizeof(RobustPath));
-                dst->copy_from(*src);
-            }
-            dst->transform(magnification, x_reflection, rotation, origin + *offset_p++);
-            result.append_unsafe(dst);
-        }
-    }
+    cell->get_robustpaths(apply_repetitions, depth, filter, tag, array, cache);
+    place_elements(*this, array, result);
     array.clear();
-    if (repetition.type != RepetitionType::None) offsets.clear();
 }
 
 void Reference::get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
                            Array<Label*>& result) const {
+    Map<GeometryInfo> cache = {};
+    get_labels(apply_repetitions, depth, filter, tag, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_labels(bool apply_repetitions, int64_t depth, bool filter, Tag tag,
+                           Array<Label*>& result, Map<GeometryInfo>& cache) const {
     if (type != ReferenceType::Cell) return;
 
     Array<Label*> array = {};
-    cell->get_labels(apply_repetitions, depth, filter, tag, array);
+    cell->get_labels(apply_repetitions, depth, filter, tag, array, cache);
+    place_elements(*this, array, result);
+    array.clear();
+}
 
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
+void Reference::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                             const Array<Tag>& tags, Array<Polygon*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_polygons(apply_repetitions, include_paths, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_polygons(bool apply_repetitions, bool include_paths, int64_t depth,
+                             const Array<Tag>& tags, Array<Polygon*>* result,
+                             Map<GeometryInfo>& cache) const {
+    if (type != ReferenceType::Cell) return;
+
+    Array<Polygon*>* arrays =
+        (Array<Polygon*>*)allocate_clear(tags.count * sizeof(Array<Polygon*>));
+    cell->get_polygons(apply_repetitions, include_paths, depth, tags, arrays, cache);
+    for (uint64_t t = 0; t < tags.count; t++) {
+        place_elements(*this, arrays[t], result[t]);
+        arrays[t].clear();
     }
-    result.ensure_slots(array.count * offsets.count);
+    free_allocation(arrays);
+}
 
-    Label** a_item = array.items;
-    for (uint64_t i = 0; i < array.count; i++) {
-        Label* src = *a_item++;
-        Vec2* offset_p = offsets.items;
-        for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
-            Label* dst;
-            if (offset_count == 1) {
-                dst = src;
-            } else {
-                dst = (Label*)allocate_clear(sizeof(Label));
-                dst->copy_from(*src);
-            }
-            dst->transform(magnification, x_reflection, rotation, origin + *offset_p++);
-            result.append_unsafe(dst);
-        }
+void Reference::get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                              Array<FlexPath*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_flexpaths(apply_repetitions, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_flexpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                              Array<FlexPath*>* result, Map<GeometryInfo>& cache) const {
+    if (type != ReferenceType::Cell) return;
+
+    Array<FlexPath*>* arrays =
+        (Array<FlexPath*>*)allocate_clear(tags.count * sizeof(Array<FlexPath*>));
+    cell->get_flexpaths(apply_repetitions, depth, tags, arrays, cache);
+    for (uint64_t t = 0; t < tags.count; t++) {
+        place_elements(*this, arrays[t], result[t]);
+        arrays[t].clear();
     }
-    array.clear();
-    if (repetition.type != RepetitionType::None) offsets.clear();
+    free_allocation(arrays);
+}
+
+void Reference::get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                                Array<RobustPath*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_robustpaths(apply_repetitions, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_robustpaths(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                                Array<RobustPath*>* result, Map<GeometryInfo>& cache) const {
+    if (type != ReferenceType::Cell) return;
+
+    Array<RobustPath*>* arrays =
+        (Array<RobustPath*>*)allocate_clear(tags.count * sizeof(Array<RobustPath*>));
+    cell->get_robustpaths(apply_repetitions, depth, tags, arrays, cache);
+    for (uint64_t t = 0; t < tags.count; t++) {
+        place_elements(*this, arrays[t], result[t]);
+        arrays[t].clear();
+    }
+    free_allocation(arrays);
+}
+
+void Reference::get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                           Array<Label*>* result) const {
+    Map<GeometryInfo> cache = {};
+    get_labels(apply_repetitions, depth, tags, result, cache);
+    clear_geometry_cache(cache);
+}
+
+void Reference::get_labels(bool apply_repetitions, int64_t depth, const Array<Tag>& tags,
+                           Array<Label*>* result, Map<GeometryInfo>& cache) const {
+    if (type != ReferenceType::Cell) return;
+
+    Array<Label*>* arrays = (Array<Label*>*)allocate_clear(tags.count * sizeof(Array<Label*>));
+    cell->get_labels(apply_repetitions, depth, tags, arrays, cache);
+    for (uint64_t t = 0; t < tags.count; t++) {
+        place_elements(*this, arrays[t], result[t]);
+        arrays[t].clear();
+    }
+    free_allocation(arrays);
 }
 
 #define GDSTK_REFERENCE_REPETITION_TOLERANCE 1e-12
@@ -370,10 +423,6 @@ ErrorCode Reference::to_gds(FILE* out, double scaling) const {
     ErrorCode error_code = ErrorCode::NoError;
     bool array = false;
     double x2, y2, x3, y3;
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    offsets.count = 1;
-    offsets.items = &zero;
 
     uint16_t buffer_array[] = {8, 0x1302, 0, 0, 28, 0x1003};
     int32_t buffer_coord[6];
@@ -447,10 +496,6 @@ ErrorCode Reference::to_gds(FILE* out, double scaling) const {
             buffer_coord[4] = (int32_t)(lround(x3 * scaling));
             buffer_coord[5] = (int32_t)(lround(y3 * scaling));
             big_endian_swap32((uint32_t*)buffer_coord, COUNT(buffer_coord));
-        } else {
-            offsets.count = 0;
-            offsets.items = NULL;
-            repetition.get_offsets(offsets);
         }
     }
 
@@ -490,8 +535,12 @@ ErrorCode Reference::to_gds(FILE* out, double scaling) const {
         big_endian_swap16(buffer_flags, COUNT(buffer_flags));
     }
 
-    Vec2* offset_p = offsets.items;
-    for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--, offset_p++) {
+    // GDSII arrays are written in a single record
+    const Repetition no_repetition = {};
+    RepetitionIterator iterator = {};
+    iterator.init(array ? no_repetition : repetition);
+    Vec2 offset;
+    while (iterator.next(offset)) {
         fwrite(buffer_start, sizeof(uint16_t), COUNT(buffer_start), out);
         fwrite(ref_name, 1, len, out);
 
@@ -512,8 +561,8 @@ ErrorCode Reference::to_gds(FILE* out, double scaling) const {
             fwrite(buffer_coord, sizeof(int32_t), COUNT(buffer_coord), out);
         } else {
             fwrite(buffer_single, sizeof(uint16_t), COUNT(buffer_single), out);
-            int32_t buffer_single_coord[] = {(int32_t)(lround((origin.x + offset_p->x) * scaling)),
-                                             (int32_t)(lround((origin.y + offset_p->y) * scaling))};
+            int32_t buffer_single_coord[] = {(int32_t)(lround((origin.x + offset.x) * scaling)),
+                                             (int32_t)(lround((origin.y + offset.y) * scaling))};
             big_endian_swap32((uint32_t*)buffer_single_coord, COUNT(buffer_single_coord));
             fwrite(buffer_single_coord, sizeof(int32_t), COUNT(buffer_single_coord), out);
         }
@@ -523,11 +572,18 @@ ErrorCode Reference::to_gds(FILE* out, double scaling) const {
         fwrite(buffer_end, sizeof(uint16_t), COUNT(buffer_end), out);
     }
 
-    if (repetition.type != RepetitionType::None && !array) offsets.clear();
     return error_code;
 }
 
 ErrorCode Reference::to_svg(FILE* out, double scaling, uint32_t precision) const {
+    Array<char> buffer = {};
+    ErrorCode error_code = to_svg(buffer, scaling, precision);
+    fwrite(buffer.items, 1, buffer.count, out);
+    buffer.clear();
+    return error_code;
+}
+
+ErrorCode Reference::to_svg(Array<char>& out, double scaling, uint32_t precision) const {
     const char* src_name = type == ReferenceType::Cell
                                ? cell->name
                                : (type == ReferenceType::RawCell ? rawcell->name : name);
@@ -538,44 +594,36 @@ ErrorCode Reference::to_svg(FILE* out, double scaling, uint32_t precision) const
     for (const char* c = src_name; *c != 0; c++, d++) *d = *c == '#' ? '_' : *c;
     *d = 0;
 
-    Vec2 zero = {0, 0};
-    Array<Vec2> offsets = {};
-    if (repetition.type != RepetitionType::None) {
-        repetition.get_offsets(offsets);
-    } else {
-        offsets.count = 1;
-        offsets.items = &zero;
-    }
-
     char double_buffer[GDSTK_DOUBLE_BUFFER_COUNT];
-    double* offset_p = (double*)offsets.items;
-    for (uint64_t offset_count = offsets.count; offset_count > 0; offset_count--) {
-        double offset_x = scaling * (origin.x + *offset_p++);
-        double offset_y = scaling * (origin.y + *offset_p++);
-        fputs("<use transform=\"translate(", out);
-        fputs(double_print(offset_x, precision, double_buffer, COUNT(double_buffer)), out);
-        fputc(' ', out);
-        fputs(double_print(offset_y, precision, double_buffer, COUNT(double_buffer)), out);
-        fputc(')', out);
+    RepetitionIterator iterator = {};
+    iterator.init(repetition);
+    Vec2 offset;
+    while (iterator.next(offset)) {
+        double offset_x = scaling * (origin.x + offset.x);
+        double offset_y = scaling * (origin.y + offset.y);
+        append_string(out, "<use transform=\"translate(");
+        append_string(out, double_print(offset_x, precision, double_buffer, COUNT(double_buffer)));
+        out.append(' ');
+        append_string(out, double_print(offset_y, precision, double_buffer, COUNT(double_buffer)));
+        out.append(')');
         if (rotation != 0) {
-            fputs(" rotate(", out);
-            fputs(double_print(rotation * (180.0 / M_PI), precision, double_buffer,
-                               COUNT(double_buffer)),
-                  out);
-            fputc(')', out);
+            append_string(out, " rotate(");
+            append_string(out, double_print(rotation * (180.0 / M_PI), precision, double_buffer,
+                                            COUNT(double_buffer)));
+            out.append(')');
         }
         if (x_reflection) {
-            fputs(" scale(1 -1)", out);
+            append_string(out, " scale(1 -1)");
         }
         if (magnification != 1) {
-            fputs(" scale(", out);
-            fputs(double_print(magnification, precision, double_buffer, COUNT(double_buffer)), out);
-            fputc(')', out);
+            append_string(out, " scale(");
+            append_string(out, double_print(magnification, precision, double_buffer,
+                                            COUNT(double_buffer)));
+            out.append(')');
         }
-        fprintf(out, "\" xlink:href=\"#%s\"/>\n", ref_name);
+        append_format(out, "\" xlink:href=\"#%s\"/>\n", ref_name);
     }
     free_allocation(ref_name);
-    if (repetition.type != RepetitionType::None) offsets.clear();
     return ErrorCode::NoError;
 }
 
@@ -8,11 +8,13 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 #define __STDC_FORMAT_MACROS 1
 #define _USE_MATH_DEFINES
 
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 
 #include <gdstk/array.hpp>
 #include <gdstk/repetition.hpp>
+#include <gdstk/sort.hpp>
 #include <gdstk/vec.hpp>
 
 namespace gdstk {
@@ -150,6 +152,51 @@ void Repetition::get_offsets(Array<Vec2>& result) const {
     }
 }
 
+void RepetitionIterator::init(const Repetition& repetition_) {
+    repetition = &repetition_;
+    count = repetition_.type == RepetitionType::None ? 1 : repetition_.get_count();
+    index = 0;
+    column = 0;
+    row = 0;
+}
+
+bool RepetitionIterator::next(Vec2& offset) {
+    if (index >= count) return false;
+    switch (repetition->type) {
+        case RepetitionType::Rectangular:
+            offset.x = column * repetition->spacing.x;
+            offset.y = row * repetition->spacing.y;
+            if (++row == repetition->rows) {
+                row = 0;
+                column++;
+            }
+            break;
+        case RepetitionType::Regular:
+            offset.x = column * repetition->v1.x + row * repetition->v2.x;
+            offset.y = column * repetition->v1.y + row * repetition->v2.y;
+            if (++row == repetition->rows) {
+                row = 0;
+                column++;
+            }
+            break;
+        case RepetitionType::ExplicitX:
+            offset.x = index == 0 ? 0 : repetition->coords[index - 1];
+            offset.y = 0;
+            break;
+        case RepetitionType::ExplicitY:
+            offset.x = 0;
+            offset.y = index == 0 ? 0 : repetition->coords[index - 1];
+            break;
+        case RepetitionType::Explicit:
+            offset = index == 0 ? Vec2{0, 0} : repetition->offsets[index - 1];
+            break;
+        case RepetitionType::None:
+            offset = Vec2{0, 0};
+    }
+    index++;
+    return true;
+}
+
 void Repetition::get_extrema(Array<Vec2>& result) const {
     switch (type) {
         case RepetitionType::Rectangular:
@@ -388,4 +435,245 @@ void Repetition::transform(double magnification, bool x_reflection, double rotat
     }
 }
 
+uint64_t Repetition::content_hash(double scaling) const {
+    uint64_t result = hash_combine(0, (uint64_t)type);
+    switch (type) {
+        case RepetitionType::Rectangular:
+            result = hash_combine(result, columns);
+            result = hash_combine(result, rows);
+            result = hash_combine(result, hash_coordinate(spacing.x, scaling));
+            result = hash_combine(result, hash_coordinate(spacing.y, scaling));
+            break;
+        case RepetitionType::Regular:
+            result = hash_combine(result, columns);
+            result = hash_combine(result, rows);
+            result = hash_combine(result, hash_coordinate(v1.x, scaling));
+            result = hash_combine(result, hash_coordinate(v1.y, scaling));
+            result = hash_combine(result, hash_coordinate(v2.x, scaling));
+            result = hash_combine(result, hash_coordinate(v2.y, scaling));
+            break;
+        case RepetitionType::Explicit: {
+            uint64_t sum = 0;
+            Vec2* v = offsets.items;
+            for (uint64_t i = offsets.count; i > 0; i--, v++) {
+                sum += hash_combine(hash_coordinate(v->x, scaling), hash_coordinate(v->y, scaling));
+            }
+            result = hash_combine(result, sum);
+        } break;
+        case RepetitionType::ExplicitX:
+        case RepetitionType::ExplicitY: {
+            uint64_t sum = 0;
+            double* c = coords.items;
+            for (uint64_t i = coords.count; i > 0; i--, c++) {
+                sum += hash_combine(0, hash_coordinate(*c, scaling));
+            }
+            result = hash_combine(result, sum);
+        } break;
+        case RepetitionType::None:
+            break;
+    }
+    return result;
+}
+
+// Point rounded to integer coordinates
+struct RepetitionPoint {
+    int64_t x;
+    int64_t y;
+    uint64_t index;
+};
+
+static bool repetition_point_yx_order(const RepetitionPoint& p1, const RepetitionPoint& p2) {
+    return p1.y < p2.y || (p1.y == p2.y && (p1.x < p2.x || (p1.x == p2.x && p1.index < p2.index)));
+}
+
+static bool repetition_point_xy_order(const RepetitionPoint& p1, const RepetitionPoint& p2) {
+    return p1.x < p2.x || (p1.x == p2.x && (p1.y < p2.y || (p1.y == p2.y && p1.index < p2.index)));
+}
+
+// Binary search in points (sorted in yx order and without duplicates)
+static int64_t repetition_point_find(const Array<RepetitionPoint>& points, int64_t x, int64_t y) {
+    int64_t lo = 0;
+    int64_t hi = points.count;
+    while (lo < hi) {
+        int64_t mid = (lo + hi) / 2;
+        const RepetitionPoint& p = points[mid];
+        if (p.y < y || (p.y == y && p.x < x)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < (int64_t)points.count && points[lo].x == x && points[lo].y == y) return lo;
+    return -1;
+}
+
+// Check whether all points (sorted in yx order and without duplicates) form a
+// lattice p0 + i * g1 + j * g2 with 0 <= i < columns and 0 <= j < rows.
+static bool find_lattice(const Array<Vec2>& original, const Array<RepetitionPoint>& points,
+                         Repetition& repetition) {
+    const uint64_t count = points.count;
+    const RepetitionPoint p0 = points[0];
+    // Points are sorted, so the lattice generators are the differences from
+    // p0 to the first point and to the first point not along g1.
+    const int64_t g1x = points[1].x - p0.x;
+    const int64_t g1y = points[1].y - p0.y;
+    int64_t columns = 2;
+    while (columns < (int64_t)count &&
+           repetition_point_find(points, p0.x + columns * g1x, p0.y + columns * g1y) >= 0)
+        columns++;
+
+    int64_t g2x = 0;
+    int64_t g2y = 0;
+    int64_t rows = 1;
+    if (columns < (int64_t)count) {
+        if (count % columns != 0) return false;
+        rows = count / columns;
+        const double g1_len_sq = (double)g1x * g1x + (double)g1y * g1y;
+        for (uint64_t i = 2; i < count; i++) {
+            int64_t dx = points[i].x - p0.x;
+            int64_t dy = points[i].y - p0.y;
+            bool along_g1 = dx * g1y == dy * g1x;
+            if (along_g1) {
+                double m = (dx * g1x + dy * g1y) / g1_len_sq;
+                along_g1 = m >= 0 && m < columns;
+            }
+            if (!along_g1) {
+                g2x = dx;
+                g2y = dy;
+                break;
+            }
+        }
+        if (g2x * g1y == g2y * g1x) return false;
+        for (int64_t j = 1; j < rows; j++) {
+            for (int64_t i = 0; i < columns; i++) {
+                if (repetition_point_find(points, p0.x + i * g1x + j * g2x,
+                                          p0.y + i * g1y + j * g2y) < 0)
+                    return false;
+            }
+        }
+    }
+
+    // Generators from the extreme points for better accuracy
+    const Vec2 origin = original[p0.index];
+    int64_t i1 = repetition_point_find(points, p0.x + (columns - 1) * g1x,
+                                       p0.y + (columns - 1) * g1y);
+    Vec2 v1 = (original[points[i1].index] - origin) / (double)(columns - 1);
+    Vec2 v2 = {0, 0};
+    if (rows > 1) {
+        int64_t i2 = repetition_point_find(points, p0.x + (rows - 1) * g2x,
+                                           p0.y + (rows - 1) * g2y);
+        v2 = (original[points[i2].index] - origin) / (double)(rows - 1);
+    }
+
+    repetition.columns = columns;
+    repetition.rows = rows;
+    if (g1y == 0 && g2x == 0) {
+        repetition.type = RepetitionType::Rectangular;
+        repetition.spacing = Vec2{v1.x, v2.y};
+    } else if (g1x == 0 && g2y == 0) {
+        repetition.type = RepetitionType::Rectangular;
+        repetition.columns = rows;
+        repetition.rows = columns;
+        repetition.spacing = Vec2{v2.x, v1.y};
+    } else {
+        repetition.type = RepetitionType::Regular;
+        repetition.v1 = v1;
+        repetition.v2 = rows > 1 ? v2 : v1.ortho();
+    }
+    return true;
+}
+
+// Repetition for points along a line (sorted along the line), with direction
+// 0 for x, 1 for y.
+static void find_line_repetition(const Array<Vec2>& original, const RepetitionPoint* points,
+                                 uint64_t count, int direction, Repetition& repetition) {
+    const Vec2 origin = original[points[0].index];
+    const int64_t step = direction == 0 ? points[1].x - points[0].x : points[1].y - points[0].y;
+    bool regular = true;
+    for (uint64_t i = 2; i < count && regular; i++) {
+        int64_t d = direction == 0 ? points[i].x - points[i - 1].x : points[i].y - points[i - 1].y;
+        regular = d == step;
+    }
+    if (regular) {
+        double spacing = (original[points[count - 1].index].e[direction] - origin.e[direction]) /
+                         (count - 1);
+        repetition.type = RepetitionType::Rectangular;
+        repetition.columns = direction == 0 ? count : 1;
+        repetition.rows = direction == 0 ? 1 : count;
+        repetition.spacing = direction == 0 ? Vec2{spacing, 0} : Vec2{0, spacing};
+    } else {
+        repetition.type = direction == 0 ? RepetitionType::ExplicitX : RepetitionType::ExplicitY;
+        repetition.coords = {};
+        repetition.coords.ensure_slots(count - 1);
+        for (uint64_t i = 1; i < count; i++) {
+            repetition.coords.append_unsafe(original[points[i].index].e[direction] -
+                                            origin.e[direction]);
+        }
+    }
+}
+
+void find_repetitions(const Array<Vec2>& points, double scaling, Array<uint64_t>& origins,
+                      Array<Repetition>& repetitions, bool* covered) {
+    if (points.count < 2) return;
+    Array<RepetitionPoint> unique = {};
+    unique.ensure_slots(points.count);
+    for (uint64_t i = 0; i < points.count; i++) {
+        unique.append_unsafe(RepetitionPoint{llround(points[i].x * scaling),
+                                             llround(points[i].y * scaling), i});
+    }
+    sort(unique, repetition_point_yx_order);
+    uint64_t count = 1;
+    for (uint64_t i = 1; i < unique.count; i++) {
+        if (unique[i].x != unique[count - 1].x || unique[i].y != unique[count - 1].y) {
+            unique[count++] = unique[i];
+        }
+    }
+    unique.count = count;
+    if (count < 2) {
+        unique.clear();
+        return;
+    }
+
+    Repetition repetition = {RepetitionType::None};
+    if (find_lattice(points, unique, repetition)) {
+        origins.append(unique[0].index);
+        repetitions.append(repetition);
+        for (uint64_t i = 1; i < count; i++) covered[unique[i].index] = true;
+        unique.clear();
+        return;
+    }
+
+    // Rows
+    Array<RepetitionPoint> remaining = {};
+    uint64_t start = 0;
+    for (uint64_t i = 1; i <= count; i++) {
+        if (i < count && unique[i].y == unique[start].y) continue;
+        if (i - start > 1) {
+            find_line_repetition(points, unique.items + start, i - start, 0, repetition);
+            origins.append(unique[start].index);
+            repetitions.append(repetition);
+            for (uint64_t j = start + 1; j < i; j++) covered[unique[j].index] = true;
+        } else {
+            remaining.append(unique[start]);
+        }
+        start = i;
+    }
+    unique.clear();
+
+    // Columns from the points left alone in their rows
+    sort(remaining, repetition_point_xy_order);
+    start = 0;
+    for (uint64_t i = 1; i <= remaining.count; i++) {
+        if (i < remaining.count && remaining[i].x == remaining[start].x) continue;
+        if (i - start > 1) {
+            find_line_repetition(points, remaining.items + start, i - start, 1, repetition);
+            origins.append(remaining[start].index);
+            repetitions.append(repetition);
+            for (uint64_t j = start + 1; j < i; j++) covered[remaining[j].index] = true;
+        }
+        start = i;
+    }
+    remaining.clear();
+}
+
 }  // namespace gdstk
@@ -0,0 +1,449 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/spill.hpp>
+#include <gdstk/utils.hpp>
+
+namespace gdstk {
+
+#ifndef GDSTK_CUSTOM_ALLOCATOR
+
+uint64_t spill_threshold = 0;
+uint8_t* spill_begin = NULL;
+uint8_t* spill_end = NULL;
+
+#ifndef _WIN32
+
+#define SPILL_MIN_CLASS 5
+#define SPILL_NONE UINT64_MAX
+
+// Minimal number of resident chunks, so that the data copied by the allocator
+// (or by any memcpy) between 2 blocks is never evicted while in use
+#define SPILL_MIN_RESIDENT 4
+
+// Every spill block starts with this header.  Block sizes are powers of 2 and
+// free blocks are kept in singly-linked lists per size class.
+struct SpillBlock {
+    uint64_t size_class;
+    uint64_t next_free;  // offset + 1 of the next free block in the class list
+};
+
+// Chunks of the file are kept in a doubly-linked list in least recently used
+// order (head is the most recent).  Only chunks marked resident are listed and
+// accessible: the others are protected, so that the first access to them
+// (from any code) is caught by the fault handler, which makes them resident
+// again.
+struct SpillState {
+    int fd;
+    uint64_t mapped;
+    uint64_t top;
+    uint64_t free_head[64];
+    uint64_t allocated;
+    uint64_t block_count;
+    uint64_t resident_limit;
+    uint64_t resident_count;
+    uint64_t chunk_capacity;
+    uint64_t* chunk_prev;
+    uint64_t* chunk_next;
+    uint8_t* chunk_resident;
+    uint64_t lru_head;
+    uint64_t lru_tail;
+};
+
+static SpillState spill = {-1};
+
+// The spill state is shared by the allocator and the fault handler, so it is
+// protected by a spin lock that can be taken in a signal handler.  The lock is
+// recursive: the allocator can fault while holding it (when copying data from
+// a chunk that is not resident), in which case the handler runs on the same
+// thread without locking again.
+static int spill_lock_state = 0;
+static uint64_t spill_lock_owner = 0;
+
+static bool spill_lock() {
+    const uint64_t self = (uint64_t)(uintptr_t)pthread_self();
+    if (__atomic_load_n(&spill_lock_owner, __ATOMIC_ACQUIRE) == self) return false;
+    while (__atomic_exchange_n(&spill_lock_state, 1, __ATOMIC_ACQUIRE)) sched_yield();
+    __atomic_store_n(&spill_lock_owner, self, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void spill_unlock(bool locked) {
+    if (!locked) return;
+    __atomic_store_n(&spill_lock_owner, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&spill_lock_state, 0, __ATOMIC_RELEASE);
+}
+
+static void lru_remove(uint64_t chunk) {
+    uint64_t prev = spill.chunk_prev[chunk];
+    uint64_t next = spill.chunk_next[chunk];
+    if (prev == SPILL_NONE) {
+        spill.lru_head = next;
+    } else {
+        spill.chunk_next[prev] = next;
+    }
+    if (next == SPILL_NONE) {
+        spill.lru_tail = prev;
+    } else {
+        spill.chunk_prev[next] = prev;
+    }
+    spill.chunk_resident[chunk] = 0;
+    spill.resident_count--;
+}
+
+static void lru_push_front(uint64_t chunk) {
+    spill.chunk_prev[chunk] = SPILL_NONE;
+    spill.chunk_next[chunk] = spill.lru_head;
+    if (spill.lru_head == SPILL_NONE) {
+        spill.lru_tail = chunk;
+    } else {
+        spill.chunk_prev[spill.lru_head] = chunk;
+    }
+    spill.lru_head = chunk;
+    spill.chunk_resident[chunk] = 1;
+    spill.resident_count++;
+}
+
+static void release_chunk(uint64_t chunk) {
+    lru_remove(chunk);
+    // The mapping is shared, so the contents are kept in the file and faulted
+    // back in when accessed again.
+    uint8_t* address = spill_begin + chunk * GDSTK_SPILL_CHUNK_SIZE;
+    madvise(address, GDSTK_SPILL_CHUNK_SIZE, MADV_DONTNEED);
+    mprotect(address, GDSTK_SPILL_CHUNK_SIZE, PROT_NONE);
+}
+
+// Mark the chunks in [offset, offset + size) as most recently used, making
+// them accessible, and release the least recently used ones beyond the
+// resident limit.  This is called by the allocator and by the fault handler,
+// so accesses that do not go through the allocator are tracked as well.
+static void touch(uint64_t offset, uint64_t size) {
+    const uint64_t first = offset / GDSTK_SPILL_CHUNK_SIZE;
+    const uint64_t last = (offset + size - 1) / GDSTK_SPILL_CHUNK_SIZE;
+    for (uint64_t chunk = first; chunk <= last; chunk++) {
+        if (spill.chunk_resident[chunk]) {
+            lru_remove(chunk);
+        } else {
+            mprotect(spill_begin + chunk * GDSTK_SPILL_CHUNK_SIZE, GDSTK_SPILL_CHUNK_SIZE,
+                     PROT_READ | PROT_WRITE);
+        }
+        lru_push_front(chunk);
+    }
+    const uint64_t limit = spill.resident_limit / GDSTK_SPILL_CHUNK_SIZE;
+    while (spill.resident_count > limit) {
+        uint64_t chunk = spill.lru_tail;
+        if (chunk >= first && chunk <= last) break;
+        release_chunk(chunk);
+    }
+}
+
+static struct sigaction spill_previous_action[2];
+static bool spill_handler_installed = false;
+
+static void spill_fault_handler(int signal, siginfo_t* info, void* context) {
+    uint8_t* address = (uint8_t*)info->si_addr;
+    if (address >= spill_begin && address < spill_end) {
+        bool locked = spill_lock();
+        const uint64_t offset = address - spill_begin;
+        bool handled = offset < spill.mapped;
+        // Another thread might have made the chunk resident in the mean time
+        if (handled && !spill.chunk_resident[offset / GDSTK_SPILL_CHUNK_SIZE]) touch(offset, 1);
+        spill_unlock(locked);
+        if (handled) return;
+    }
+    // Not a spill access: use the previous handler
+    struct sigaction& previous = spill_previous_action[signal == SIGSEGV ? 0 : 1];
+    if (previous.sa_flags & SA_SIGINFO) {
+        previous.sa_sigaction(signal, info, context);
+    } else if (previous.sa_handler == SIG_DFL || previous.sa_handler == SIG_IGN) {
+        // The faulting instruction is executed again with the default action
+        sigaction(signal, &previous, NULL);
+    } else {
+        previous.sa_handler(signal);
+    }
+}
+
+static bool install_handler() {
+    if (spill_handler_installed) return true;
+    struct sigaction action = {};
+    action.sa_sigaction = spill_fault_handler;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, spill_previous_action) != 0) return false;
+    if (sigaction(SIGBUS, &action, spill_previous_action + 1) != 0) {
+        sigaction(SIGSEGV, spill_previous_action, NULL);
+        return false;
+    }
+    spill_handler_installed = true;
+    return true;
+}
+
+static bool grow(uint64_t size) {
+    uint64_t new_mapped =
+        ((size + GDSTK_SPILL_GROWTH - 1) / GDSTK_SPILL_GROWTH) * GDSTK_SPILL_GROWTH;
+    if (new_mapped > GDSTK_SPILL_RESERVATION) return false;
+    if (ftruncate(spill.fd, new_mapped) != 0) return false;
+    // New chunks are only made accessible when touched
+    void* result = mmap(spill_begin + spill.mapped, new_mapped - spill.mapped, PROT_NONE,
+                        MAP_SHARED | MAP_FIXED, spill.fd, spill.mapped);
+    if (result == MAP_FAILED) return false;
+
+    uint64_t new_capacity = new_mapped / GDSTK_SPILL_CHUNK_SIZE;
+    spill.chunk_prev = (uint64_t*)realloc(spill.chunk_prev, sizeof(uint64_t) * new_capacity);
+    spill.chunk_next = (uint64_t*)realloc(spill.chunk_next, sizeof(uint64_t) * new_capacity);
+    spill.chunk_resident = (uint8_t*)realloc(spill.chunk_resident, new_capacity);
+    memset(spill.chunk_resident + spill.chunk_capacity, 0, new_capacity - spill.chunk_capacity);
+    spill.chunk_capacity = new_capacity;
+    spill.mapped = new_mapped;
+    return true;
+}
+
+static void close_spill() {
+    munmap(spill_begin, GDSTK_SPILL_RESERVATION);
+    close(spill.fd);
+    free(spill.chunk_prev);
+    free(spill.chunk_next);
+    free(spill.chunk_resident);
+    memset(&spill, 0, sizeof(SpillState));
+    spill.fd = -1;
+    spill_begin = NULL;
+    spill_end = NULL;
+}
+
+static void* allocate_block(uint64_t size) {
+    const uint64_t total = size + sizeof(SpillBlock);
+    uint64_t size_class = SPILL_MIN_CLASS;
+    while ((1ULL << size_class) < total) size_class++;
+    const uint64_t capacity = 1ULL << size_class;
+
+    uint64_t offset;
+    SpillBlock* block;
+    if (spill.free_head[size_class] > 0) {
+        offset = spill.free_head[size_class] - 1;
+        block = (SpillBlock*)(spill_begin + offset);
+        touch(offset, total);
+        spill.free_head[size_class] = block->next_free;
+    } else {
+        offset = spill.top;
+        if (offset + capacity > spill.mapped && !grow(offset + capacity)) {
+            if (error_logger)
+                fputs("[GDSTK] Unable to grow spill file, using heap memory.\n", error_logger);
+            return malloc(size);
+        }
+        spill.top += capacity;
+        block = (SpillBlock*)(spill_begin + offset);
+        touch(offset, total);
+    }
+    block->size_class = size_class;
+    block->next_free = 0;
+    spill.allocated += capacity;
+    spill.block_count++;
+    return block + 1;
+}
+
+static void free_block(void* ptr) {
+    SpillBlock* block = (SpillBlock*)ptr - 1;
+    const uint64_t offset = (uint8_t*)block - spill_begin;
+    touch(offset, sizeof(SpillBlock));
+    const uint64_t capacity = 1ULL << block->size_class;
+    block->next_free = spill.free_head[block->size_class];
+    spill.free_head[block->size_class] = offset + 1;
+    spill.allocated -= capacity;
+    spill.block_count--;
+
+    // Chunks entirely within the freed data are dropped from memory right away
+    const uint64_t first = (offset + sizeof(SpillBlock)) / GDSTK_SPILL_CHUNK_SIZE + 1;
+    const uint64_t end = (offset + capacity) / GDSTK_SPILL_CHUNK_SIZE;
+    for (uint64_t chunk = first; chunk < end; chunk++) {
+        if (spill.chunk_resident[chunk]) release_chunk(chunk);
+    }
+
+    if (spill.block_count == 0 && spill_threshold == 0) close_spill();
+}
+
+static void* reallocate_block(void* ptr, uint64_t size) {
+    if (ptr == NULL) return allocate_block(size);
+    if (is_spilled(ptr)) {
+        SpillBlock* block = (SpillBlock*)ptr - 1;
+        const uint64_t offset = (uint8_t*)block - spill_begin;
+        touch(offset, sizeof(SpillBlock));
+        const uint64_t available = (1ULL << block->size_class) - sizeof(SpillBlock);
+        if (size <= available) {
+            touch(offset, size + sizeof(SpillBlock));
+            return ptr;
+        }
+        void* result = (spill_threshold > 0 && size >= spill_threshold) ? allocate_block(size)
+                                                                          : malloc(size);
+        if (result) {
+            // Chunks of the old block released by the allocation are faulted
+            // back in by the copy
+            memcpy(result, ptr, available);
+            free_block(ptr);
+        }
+        return result;
+    }
+    // Moving a heap block into the spill file: we don't know its original
+    // size, so we use realloc to guarantee that size bytes are valid.
+    void* heap = realloc(ptr, size);
+    if (heap == NULL) return NULL;
+    void* result = allocate_block(size);
+    if (result != heap) {
+        memcpy(result, heap, size);
+        free(heap);
+    }
+    return result;
+}
+
+void* spill_allocate(uint64_t size) {
+    bool locked = spill_lock();
+    void* result = allocate_block(size);
+    spill_unlock(locked);
+    return result;
+}
+
+void* spill_reallocate(void* ptr, uint64_t size) {
+    bool locked = spill_lock();
+    void* result = reallocate_block(ptr, size);
+    spill_unlock(locked);
+    return result;
+}
+
+void spill_free(void* ptr) {
+    bool locked = spill_lock();
+    free_block(ptr);
+    spill_unlock(locked);
+}
+
+ErrorCode spill_enable(const char* directory, uint64_t threshold, uint64_t resident_limit) {
+    if (threshold == 0) threshold = 1;
+    if (resident_limit < SPILL_MIN_RESIDENT * GDSTK_SPILL_CHUNK_SIZE)
+        resident_limit = SPILL_MIN_RESIDENT * GDSTK_SPILL_CHUNK_SIZE;
+    if (spill.fd < 0) {
+        if (!install_handler()) {
+            if (error_logger)
+                fputs("[GDSTK] Unable to install spill fault handler.\n", error_logger);
+            return ErrorCode::InsufficientMemory;
+        }
+        if (directory == NULL) directory = getenv("TMPDIR");
+        if (directory == NULL) directory = "/tmp";
+        const char suffix[] = "/gdstk-spill-XXXXXX";
+        uint64_t len = strlen(directory);
+        char* filename = (char*)malloc(len + sizeof(suffix));
+        memcpy(filename, directory, len);
+        memcpy(filename + len, suffix, sizeof(suffix));
+        int fd = mkstemp(filename);
+        if (fd < 0) {
+            if (error_logger)
+                fprintf(error_logger, "[GDSTK] Unable to create spill file %s.\n", filename);
+            free(filename);
+            return ErrorCode::OutputFileOpenError;
+        }
+        // The file is removed from the file system right away; its contents
+        // remain available until it is closed.
+        unlink(filename);
+        free(filename);
+
+        void* base = mmap(NULL, GDSTK_SPILL_RESERVATION, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            if (error_logger)
+                fputs("[GDSTK] Unable to reserve address space for spill file.\n", error_logger);
+            close(fd);
+            return ErrorCode::InsufficientMemory;
+        }
+        spill.fd = fd;
+        spill.lru_head = SPILL_NONE;
+        spill.lru_tail = SPILL_NONE;
+        spill_begin = (uint8_t*)base;
+        spill_end = spill_begin + GDSTK_SPILL_RESERVATION;
+    }
+    spill.resident_limit = resident_limit;
+    spill_threshold = threshold;
+    return ErrorCode::NoError;
+}
+
+void spill_disable() {
+    spill_threshold = 0;
+    if (spill.fd >= 0 && spill.block_count == 0) close_spill();
+}
+
+void spill_release() {
+    if (spill.fd < 0) return;
+    bool locked = spill_lock();
+    while (spill.lru_tail != SPILL_NONE) release_chunk(spill.lru_tail);
+    spill_unlock(locked);
+}
+
+SpillInfo spill_info() {
+    SpillInfo result = {};
+    result.threshold = spill_threshold;
+    if (spill.fd >= 0) {
+        result.file_size = spill.mapped;
+        result.allocated = spill.allocated;
+        result.block_count = spill.block_count;
+        result.resident = spill.resident_count * GDSTK_SPILL_CHUNK_SIZE;
+        result.resident_limit = spill.resident_limit;
+    }
+    return result;
+}
+
+#else  // _WIN32
+
+void* spill_allocate(uint64_t size) { return malloc(size); }
+
+void* spill_reallocate(void* ptr, uint64_t size) { return realloc(ptr, size); }
+
+void spill_free(void* ptr) { free(ptr); }
+
+ErrorCode spill_enable(const char* directory, uint64_t threshold, uint64_t resident_limit) {
+    if (error_logger)
+        fputs("[GDSTK] Spill mode is not available on this platform.\n", error_logger);
+    return ErrorCode::FileError;
+}
+
+void spill_disable() {}
+
+void spill_release() {}
+
+SpillInfo spill_info() { return SpillInfo{}; }
+
+#endif  // _WIN32
+
+#else  // GDSTK_CUSTOM_ALLOCATOR
+
+ErrorCode spill_enable(const char* directory, uint64_t threshold, uint64_t resident_limit) {
+    if (error_logger)
+        fputs("[GDSTK] Spill mode is not available with a custom allocator.\n", error_logger);
+    return ErrorCode::FileError;
+}
+
+void spill_disable() {}
+
+void spill_release() {}
+
+SpillInfo spill_info() { return SpillInfo{}; }
+
+#endif  // GDSTK_CUSTOM_ALLOCATOR
+
+}  // namespace gdstk
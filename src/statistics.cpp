@@ -0,0 +1,177 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/map.hpp>
+#include <gdstk/statistics.hpp>
+
+namespace gdstk {
+
+void CellStatistics::print() const {
+    printf("CellStatistics <%p> for cell <%p>, %" PRIu64 " instances, %" PRIu64
+           " polygons, %" PRIu64 " vertices, %" PRIu64 " labels, %" PRIu64
+           " references, area %lg\n",
+           this, cell, instance_count, polygon_count, vertex_count, label_count, reference_count,
+           area);
+    const TagStatistics* item = tag_array.items;
+    for (uint64_t i = 0; i < tag_array.count; i++, item++) {
+        printf("(%" PRIu32 ", %" PRIu32 "): %" PRIu64 " polygons, %" PRIu64 " vertices, %" PRIu64
+               " labels, area %lg\n",
+               get_layer(item->tag), get_type(item->tag), item->polygon_count, item->vertex_count,
+               item->label_count, item->area);
+    }
+}
+
+void CellStatistics::clear() { tag_array.clear(); }
+
+// Return the entry for tag in the sorted array, inserting it if necessary.
+static TagStatistics* tag_statistics(Array<TagStatistics>& array, Tag tag) {
+    uint64_t lo = 0;
+    uint64_t hi = array.count;
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (array[mid].tag < tag) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == array.count || array[lo].tag != tag) array.insert(lo, TagStatistics{tag, 0, 0, 0, 0});
+    return array.items + lo;
+}
+
+static uint64_t repetition_count(const Repetition& repetition) {
+    return repetition.type == RepetitionType::None ? 1 : repetition.get_count();
+}
+
+static void statistics_add_polygon(Array<TagStatistics>& array, const Polygon* polygon) {
+    const uint64_t count = repetition_count(polygon->repetition);
+    TagStatistics* stats = tag_statistics(array, polygon->tag);
+    stats->polygon_count += count;
+    stats->vertex_count += count * polygon->point_array.count;
+    // Polygon::area already accounts for repetitions
+    stats->area += polygon->area();
+}
+
+struct StatisticsState {
+    bool include_paths;
+    Map<uint64_t> index;  // Cell name to position in result + 1
+    Array<CellStatistics>* result;
+    ErrorCode error_code;
+};
+
+// Return the position of the statistics for cell in the result array,
+// computing them (and those of its dependencies) if necessary.
+static uint64_t statistics_visit(const Cell* cell, StatisticsState& state) {
+    uint64_t position = state.index.get(cell->name);
+    if (position > 0) return position - 1;
+
+    CellStatistics stats = {};
+    stats.cell = cell;
+
+    Polygon** polygon = cell->polygon_array.items;
+    for (uint64_t i = cell->polygon_array.count; i > 0; i--, polygon++) {
+        statistics_add_polygon(stats.tag_array, *polygon);
+    }
+
+    if (state.include_paths) {
+        Array<Polygon*> array = {};
+        FlexPath** flexpath = cell->flexpath_array.items;
+        for (uint64_t i = cell->flexpath_array.count; i > 0; i--, flexpath++) {
+            ErrorCode err = (*flexpath)->to_polygons(false, 0, array);
+            if (err != ErrorCode::NoError) state.error_code = err;
+        }
+        RobustPath** robustpath = cell->robustpath_array.items;
+        for (uint64_t i = cell->robustpath_array.count; i > 0; i--, robustpath++) {
+            ErrorCode err = (*robustpath)->to_polygons(false, 0, array);
+            if (err != ErrorCode::NoError) state.error_code = err;
+        }
+        for (uint64_t i = 0; i < array.count; i++) {
+            statistics_add_polygon(stats.tag_array, array[i]);
+            array[i]->clear();
+            free_allocation(array[i]);
+        }
+        array.clear();
+    }
+
+    Label** label = cell->label_array.items;
+    for (uint64_t i = cell->label_array.count; i > 0; i--, label++) {
+        tag_statistics(stats.tag_array, (*label)->tag)->label_count +=
+            repetition_count((*label)->repetition);
+    }
+
+    Reference** reference = cell->reference_array.items;
+    for (uint64_t i = cell->reference_array.count; i > 0; i--, reference++) {
+        const Reference* ref = *reference;
+        if (ref->type == ReferenceType::Name) continue;
+        const uint64_t count = repetition_count(ref->repetition);
+        stats.reference_count += count;
+        if (ref->type != ReferenceType::Cell) continue;
+
+        // The result array may be reallocated while visiting
+        const uint64_t child_position = statistics_visit(ref->cell, state);
+        const CellStatistics* child = state.result->items + child_position;
+        const double area_factor = count * ref->magnification * ref->magnification;
+        stats.reference_count += count * child->reference_count;
+        const TagStatistics* src = child->tag_array.items;
+        for (uint64_t j = child->tag_array.count; j > 0; j--, src++) {
+            TagStatistics* dst = tag_statistics(stats.tag_array, src->tag);
+            dst->polygon_count += count * src->polygon_count;
+            dst->vertex_count += count * src->vertex_count;
+            dst->label_count += count * src->label_count;
+            dst->area += area_factor * src->area;
+        }
+    }
+
+    const TagStatistics* item = stats.tag_array.items;
+    for (uint64_t i = stats.tag_array.count; i > 0; i--, item++) {
+        stats.polygon_count += item->polygon_count;
+        stats.vertex_count += item->vertex_count;
+        stats.label_count += item->label_count;
+        stats.area += item->area;
+    }
+
+    position = state.result->count;
+    state.result->append(stats);
+    state.index.set(cell->name, position + 1);
+    return position;
+}
+
+ErrorCode cell_statistics(const Cell& cell, bool include_paths, Array<CellStatistics>& result) {
+    StatisticsState state = {};
+    state.include_paths = include_paths;
+    state.result = &result;
+    const uint64_t first = result.count;
+    const uint64_t top = statistics_visit(&cell, state);
+
+    // Entries are sorted so that all references to a cell come from entries
+    // after it, so instance counts can be propagated from the top down.
+    result[top].instance_count = 1;
+    for (uint64_t i = top + 1; i > first; i--) {
+        const CellStatistics* parent = result.items + i - 1;
+        Reference** reference = parent->cell->reference_array.items;
+        for (uint64_t j = parent->cell->reference_array.count; j > 0; j--, reference++) {
+            const Reference* ref = *reference;
+            if (ref->type != ReferenceType::Cell) continue;
+            const uint64_t position = state.index.get(ref->cell->name) - 1;
+            result[position].instance_count +=
+                parent->instance_count * repetition_count(ref->repetition);
+        }
+    }
+
+    state.index.clear();
+    return state.error_code;
+}
+
+}  // namespace gdstk
@@ -10,10 +10,17 @@ LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
 #include <assert.h>
 #include <math.h>
+#include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include <gdstk/allocator.hpp>
 #include <gdstk/utils.hpp>
 #include <gdstk/vec.hpp>
@@ -641,6 +648,29 @@ char* double_print(double value, uint32_t precision, char* buffer, size_t buffer
     return buffer;
 }
 
+void append_string(Array<char>& buffer, const char* str) {
+    uint64_t len = strlen(str);
+    buffer.ensure_slots(len);
+    memcpy(buffer.items + buffer.count, str, len);
+    buffer.count += len;
+}
+
+void append_format(Array<char>& buffer, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = vsnprintf(NULL, 0, format, args_copy);
+    va_end(args_copy);
+    if (len > 0) {
+        // vsnprintf writes the terminator, which is not counted
+        buffer.ensure_slots(len + 1);
+        vsnprintf(buffer.items + buffer.count, len + 1, format, args);
+        buffer.count += len;
+    }
+    va_end(args);
+}
+
 tm* get_now(tm& result) {
     time_t t = time(NULL);
 #ifdef _WIN32
@@ -651,6 +681,14 @@ tm* get_now(tm& result) {
     return &result;
 }
 
+uint64_t get_thread_count() {
+#ifdef _OPENMP
+    return (uint64_t)omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
 // Kenneth Kelly's 22 colors of maximum contrast (minus B/W: "F2F3F4", "222222")
 const char* colors[] = {"F3C300", "875692", "F38400", "A1CAF1", "BE0032", "C2B280", "848482",
                         "008856", "E68FAC", "0067A5", "F99379", "604E97", "F6A600", "B3446C",
@@ -675,4 +713,8 @@ const char* default_svg_label_style(Tag tag) {
     return buffer;
 }
 
+uint32_t default_raster_color(Tag tag) {
+    return ((uint32_t)strtoul(default_color(tag), NULL, 16) << 8) | 0x80;
+}
+
 }  // namespace gdstk
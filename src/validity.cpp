@@ -0,0 +1,201 @@
+/*
+Copyright 2020 Lucas Heitzmann Gabrielli.
+This file is part of gdstk, distributed under the terms of the
+Boost Software License - Version 1.0.  See the accompanying
+LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
+*/
+
+#define __STDC_FORMAT_MACROS 1
+#define _USE_MATH_DEFINES
+
+#include <stdint.h>
+
+#include <gdstk/allocator.hpp>
+#include <gdstk/clipper_tools.hpp>
+#include <gdstk/sort.hpp>
+#include <gdstk/validity.hpp>
+
+namespace gdstk {
+
+struct SweepEdge {
+    double xmin;
+    double xmax;
+    double ymin;
+    double ymax;
+    uint64_t index;
+};
+
+static bool sweep_edge_sorted(const SweepEdge& a, const SweepEdge& b) { return a.xmin < b.xmin; }
+
+// True if the segments cross at a single point interior to both of them
+static bool segments_cross(const Vec2 a, const Vec2 b, const Vec2 c, const Vec2 d) {
+    const Vec2 ab = b - a;
+    const double c1 = ab.cross(c - a);
+    const double c2 = ab.cross(d - a);
+    if (c1 == 0 || c2 == 0 || (c1 > 0) == (c2 > 0)) return false;
+    const Vec2 cd = d - c;
+    const double c3 = cd.cross(a - c);
+    const double c4 = cd.cross(b - c);
+    if (c3 == 0 || c4 == 0 || (c3 > 0) == (c4 > 0)) return false;
+    return true;
+}
+
+// Sweep the edges of the closed polygon defined by point_array, which must
+// have no consecutive duplicates, from left to right.  Edges leave the active
+// list once the sweep line passes their maximal x coordinate.
+static bool self_intersecting(const Array<Vec2>& point_array) {
+    const uint64_t count = point_array.count;
+    if (count < 4) return false;
+
+    Array<SweepEdge> edges = {};
+    edges.ensure_slots(count);
+    for (uint64_t i = 0; i < count; i++) {
+        const Vec2 p0 = point_array[i];
+        const Vec2 p1 = point_array[i + 1 < count ? i + 1 : 0];
+        SweepEdge edge = {p0.x, p1.x, p0.y, p1.y, i};
+        if (edge.xmin > edge.xmax) swap_values(edge.xmin, edge.xmax);
+        if (edge.ymin > edge.ymax) swap_values(edge.ymin, edge.ymax);
+        edges.append_unsafe(edge);
+    }
+    sort(edges, sweep_edge_sorted);
+
+    bool result = false;
+    Array<SweepEdge*> active = {};
+    for (uint64_t i = 0; i < count && !result; i++) {
+        SweepEdge* edge = edges.items + i;
+        uint64_t j = 0;
+        while (j < active.count) {
+            const SweepEdge* other = active[j];
+            if (other->xmax < edge->xmin) {
+                active.remove_unordered(j);
+                continue;
+            }
+            j++;
+            if (other->ymax < edge->ymin || other->ymin > edge->ymax) continue;
+            const uint64_t i0 = edge->index < other->index ? edge->index : other->index;
+            const uint64_t i1 = edge->index < other->index ? other->index : edge->index;
+            if (i1 == i0 + 1 || (i0 == 0 && i1 == count - 1)) continue;
+            if (segments_cross(point_array[i0], point_array[i0 + 1], point_array[i1],
+                               point_array[i1 + 1 < count ? i1 + 1 : 0])) {
+                result = true;
+                break;
+            }
+        }
+        active.append(edge);
+    }
+    active.clear();
+    edges.clear();
+    return result;
+}
+
+PolygonCheck check_polygon(const Polygon& polygon) {
+    PolygonCheck result = {};
+    const Array<Vec2>& point_array = polygon.point_array;
+
+    // Work on a copy without consecutive duplicates
+    Array<Vec2> points = {};
+    points.ensure_slots(point_array.count);
+    for (uint64_t i = 0; i < point_array.count; i++) {
+        const Vec2 p = point_array[i];
+        if (points.count > 0 && points[points.count - 1] == p) {
+            result.duplicate_point = true;
+            continue;
+        }
+        points.append_unsafe(p);
+    }
+    while (points.count > 1 && points[points.count - 1] == points[0]) {
+        result.duplicate_point = true;
+        points.count--;
+    }
+
+    const uint64_t count = points.count;
+    if (count < 3) {
+        result.degenerate = true;
+        points.clear();
+        return result;
+    }
+
+    double area = 0;
+    Vec2 v0 = points[0] - points[count - 1];
+    for (uint64_t i = 0; i < count; i++) {
+        const Vec2 p = points[i];
+        const Vec2 v1 = points[i + 1 < count ? i + 1 : 0] - p;
+        if (v0.cross(v1) == 0 && v0.inner(v1) < 0) result.spike = true;
+        area += (p - points[0]).cross(v1);
+        v0 = v1;
+    }
+    result.degenerate = area == 0;
+    result.clockwise = area < 0;
+    result.self_intersecting = self_intersecting(points);
+
+    points.clear();
+    return result;
+}
+
+void check_polygons(const Array<Polygon*>& polygons, Array<PolygonCheck>& result) {
+    result.ensure_slots(polygons.count);
+    PolygonCheck* checks = result.items + result.count;
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)polygons.count; i++) {
+        checks[i] = check_polygon(*polygons[i]);
+    }
+    result.count += polygons.count;
+}
+
+ErrorCode repair_polygons(Array<Polygon*>& polygons, const Array<PolygonCheck>& checks,
+                          double scaling, Array<Polygon*>& removed) {
+    const uint64_t count = polygons.count;
+    Array<Polygon*>* merged = (Array<Polygon*>*)allocate_clear(count * sizeof(Array<Polygon*>));
+    ErrorCode* errors = (ErrorCode*)allocate_clear(count * sizeof(ErrorCode));
+    GDSTK_PARALLEL_FOR
+    for (int64_t i = 0; i < (int64_t)count; i++) {
+        if (checks[i].valid()) continue;
+        const Polygon* polygon = polygons[i];
+        const Array<Polygon*> single = {1, 1, polygons.items + i};
+        errors[i] = merge(single, scaling, merged[i]);
+        for (uint64_t j = 0; j < merged[i].count; j++) {
+            Polygon* result = merged[i][j];
+            result->tag = polygon->tag;
+            result->repetition.copy_from(polygon->repetition);
+            result->properties = properties_copy(polygon->properties);
+        }
+    }
+
+    ErrorCode error_code = ErrorCode::NoError;
+    Array<Polygon*> result = {};
+    result.ensure_slots(count);
+    for (uint64_t i = 0; i < count; i++) {
+        if (errors[i] != ErrorCode::NoError) error_code = errors[i];
+        if (checks[i].valid()) {
+            result.append(polygons[i]);
+            continue;
+        }
+        removed.append(polygons[i]);
+        result.extend(merged[i]);
+        merged[i].clear();
+    }
+    free_allocation(merged);
+    free_allocation(errors);
+
+    polygons.clear();
+    polygons = result;
+    return error_code;
+}
+
+ErrorCode check_cell_polygons(Cell& cell, bool repair, double scaling,
+                              Array<PolygonCheck>& result, Array<Polygon*>& removed) {
+    const uint64_t first = result.count;
+    check_polygons(cell.polygon_array, result);
+    if (!repair) return ErrorCode::NoError;
+
+    bool all_valid = true;
+    for (uint64_t i = first; i < result.count && all_valid; i++) all_valid = result[i].valid();
+    if (all_valid) return ErrorCode::NoError;
+
+    cell.unshare();
+    cell.modification_count++;
+    const Array<PolygonCheck> checks = {0, result.count - first, result.items + first};
+    return repair_polygons(cell.polygon_array, checks, scaling, removed);
+}
+
+}  // namespace gdstk
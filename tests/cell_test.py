@@ -5,6 +5,7 @@
 # Boost Software License - Version 1.0.  See the accompanying
 # LICENSE file or <http://www.boost.org/LICENSE_1_0.txt>
 
+import gzip
 import pytest
 import numpy
 import gdstk
@@ -331,3 +332,544 @@ def test_get_labels(tree):
     assert len(labels) == 0
     labels = c3.get_labels(depth=2, layer=11, texttype=0)
     assert len(labels) == 6
+
+
+def test_write_svg_lod(tmpdir):
+    sub = gdstk.Cell("SUB")
+    sub.add(gdstk.rectangle((0, 0), (0.01, 0.01)))
+    cell = gdstk.Cell("SVG")
+    for i in range(10):
+        cell.add(gdstk.rectangle((i, 0), (i + 0.5 + 0.01 * i, 1), layer=1))
+        cell.add(gdstk.rectangle((i, 2), (i + 0.01, 2.01), layer=2))
+    cell.add(gdstk.Reference(sub, (0, 5), columns=10, rows=10, spacing=(0.02, 0.02)))
+
+    fname = str(tmpdir.join("full.svg"))
+    cell.write_svg(fname)
+    with open(fname) as fin:
+        svg = fin.read()
+    assert svg.count("<polygon") == 21
+    assert svg.count("<use") == 100
+
+    fname = str(tmpdir.join("lod.svg"))
+    cell.write_svg(fname, min_size=1, max_polygons=4, background=None)
+    with open(fname) as fin:
+        svg = fin.read()
+    assert svg.count("<polygon") == 4
+    assert svg.count("<rect") == 0
+    assert svg.count("<use") == 0
+    assert 'id="SUB"' not in svg
+    assert 'class="l2d0"' not in svg
+
+    fname = str(tmpdir.join("lod.svgz"))
+    cell.write_svg(fname, min_size=1, outline=True, background=None)
+    with gzip.open(fname) as fin:
+        svg = fin.read().decode()
+    assert svg.count("<polygon") == 10
+    assert svg.count('<rect class="l2d0"') == 10
+    assert svg.count("<rect") == 11
+
+
+def test_rasterize():
+    sub = gdstk.Cell("SUB")
+    sub.add(gdstk.Polygon([(0, 0), (2, 0), (0, 1)]))
+    sub.add(gdstk.rectangle((0, 0), (0.5, 0.5), layer=1))
+    cell = gdstk.Cell("RASTER")
+    cell.add(gdstk.rectangle((0.25, 0.25), (5.75, 3.5)))
+    cell.add(
+        gdstk.Reference(
+            sub,
+            (5, 5),
+            rotation=0.7,
+            magnification=1.5,
+            x_reflection=True,
+            columns=2,
+            rows=2,
+            spacing=(3, 3),
+        )
+    )
+    window = ((0, 0), (20, 20))
+    coverage = cell.rasterize(200, window=window)
+    assert set(coverage.keys()) == {(0, 0), (1, 0)}
+    assert coverage[(0, 0)].shape == (200, 200)
+    assert coverage[(0, 0)].dtype == numpy.uint8
+
+    flat = cell.copy("FLAT").flatten()
+    area = flat.area(True)
+    flat_coverage = flat.rasterize(200, window=window, tags=[(0, 0)])
+    assert list(flat_coverage.keys()) == [(0, 0)]
+    assert numpy.abs(coverage[(0, 0)] - flat_coverage[(0, 0)].astype(float)).max() <= 1
+    for tag, value in coverage.items():
+        assert abs(value.sum() / 255 * 0.01 - area[tag]) < 1e-3 * area[tag]
+
+    # Rows start at the top of the window
+    coverage = cell.rasterize(10, 10, window=((0, 0), (10, 10)), tags=[(0, 0)])[(0, 0)]
+    assert coverage[0].sum() == 0
+    assert coverage[9, 0] == 143
+    assert coverage[8, 1] == 255
+
+
+def test_render(tmpdir):
+    cell = gdstk.Cell("RENDER")
+    cell.add(gdstk.rectangle((0, 0), (2, 1)))
+    cell.add(gdstk.rectangle((1, 0), (2, 1), layer=1))
+    image = cell.render(4, colors={(1, 0): "#FF000080"}, background="#0000FF")
+    assert image.shape == (2, 4, 4)
+    assert (image[:, 0] == (0, 0, 255, 255)).all()
+    assert (image[:, 3] == (128, 0, 127, 255)).all()
+
+    # Fully transparent color over a transparent background
+    image = cell.render(4, colors={(0, 0): "#FF000000"}, background="#00000000")
+    assert (image == 0).all()
+
+    fname = str(tmpdir.join("render.png"))
+    cell.write_png(fname, 40, window=((-1, -1), (3, 2)))
+    with open(fname, "rb") as fin:
+        assert fin.read(8) == b"\x89PNG\r\n\x1a\n"
+
+
+def test_density_map():
+    cell = gdstk.Cell("DENSITY")
+    cell.add(gdstk.rectangle((0, 0), (3, 1)), gdstk.rectangle((1, 0), (2, 2)))
+    density = cell.density_map(2, window=((0, 0), (4, 2)))
+    assert list(density.keys()) == [(0, 0)]
+    assert density[(0, 0)].shape == (1, 2)
+    assert numpy.allclose(density[(0, 0)], [[0.75, 0.25]])
+
+    unit = gdstk.Cell("UNIT")
+    unit.add(
+        gdstk.regular_polygon((0.5, 0.5), 0.3, 5),
+        gdstk.rectangle((0, 0), (0.5, 0.5), layer=1),
+    )
+    top = gdstk.Cell("TOP")
+    top.add(gdstk.Reference(unit, columns=10, rows=7, spacing=(1, 1)))
+    top.add(gdstk.Reference(unit, (0.3, 8.2), rotation=0.3, columns=6, rows=3, spacing=(1.3, 1.1)))
+    # Overlapping instances in the top cell and in a referenced cell
+    block = gdstk.Cell("BLOCK")
+    block.add(gdstk.Reference(unit, columns=3, rows=2, spacing=(0.4, 0.4)))
+    block.add(gdstk.Reference(unit, (0.3, 0.2), rotation=0.3))
+    overlap = gdstk.Cell("OVERLAP")
+    overlap.add(gdstk.Reference(block, columns=2, rows=2, spacing=(1.5, 1.2)))
+    overlap.add(gdstk.Reference(unit, (1, 1), columns=2, rows=2, spacing=(0.7, 0.7)))
+    overlap.add(gdstk.rectangle((0, 0), (3, 0.4)))
+    for layout, size in ((top, 1), (top, (0.7, 1.3)), (overlap, 1), (overlap, (0.7, 1.3))):
+        density = layout.density_map(size, precision=1e-7)
+        (x0, y0), _ = layout.bounding_box()
+        sx, sy = size if isinstance(size, tuple) else (size, size)
+        flat = layout.copy("FLAT").flatten()
+        for tag, value in density.items():
+            polygons = flat.get_polygons(layer=tag[0], datatype=tag[1])
+            expected = numpy.zeros_like(value)
+            for i, j in numpy.ndindex(*value.shape):
+                window = gdstk.rectangle(
+                    (x0 + j * sx, y0 + i * sy), (x0 + (j + 1) * sx, y0 + (i + 1) * sy)
+                )
+                clipped = gdstk.boolean(polygons, window, "and", precision=1e-7)
+                expected[i, j] = sum(p.area() for p in clipped) / (sx * sy)
+            assert numpy.abs(value - expected).max() < 1e-6
+
+
+def test_fill():
+    element = gdstk.Cell("ELEMENT")
+    element.add(gdstk.rectangle((0.2, 0.1), (1.2, 0.9), layer=2))
+    unit = gdstk.Cell("UNIT")
+    unit.add(gdstk.ellipse((0, 0), (3, 2), inner_radius=(1.5, 1), layer=1))
+    unit.add(gdstk.FlexPath([(0, -5), (5, 5), (9, 0)], 0.5, layer=3))
+    chip = gdstk.Cell("CHIP")
+    chip.add(gdstk.Reference(unit, (10, 10), rotation=0.4, columns=3, rows=2, spacing=(15, 14)))
+    chip.add(gdstk.rectangle((0, 0), (50, 40), layer=10))
+    exclusions = {(1, 0): 0.5, (3, 0): 0.3}
+    flat = chip.copy("FLAT").flatten()
+
+    for tile_size in (None, 7):
+        fill = chip.fill(element, (1.5, 1.1), exclusions=exclusions, tile_size=tile_size)
+        assert all(isinstance(ref, gdstk.Reference) and ref.cell is element for ref in fill)
+        placed = set()
+        for ref in fill:
+            for offset in ref.repetition.get_offsets() if ref.repetition.size else [(0, 0)]:
+                x, y = numpy.array(ref.origin) + offset
+                placed.add((round((x + 0.2) / 1.5), round((y + 0.1) / 1.1)))
+        assert len(placed) == sum(ref.repetition.size or 1 for ref in fill)
+        for i in range(33):
+            for j in range(36):
+                x, y = i * 1.5, j * 1.1
+                blocked = False
+                for (layer, datatype), keep_out in exclusions.items():
+                    site = gdstk.rectangle(
+                        (x - keep_out, y - keep_out), (x + 1 + keep_out, y + 0.8 + keep_out)
+                    )
+                    polygons = flat.get_polygons(layer=layer, datatype=datatype)
+                    overlap = gdstk.boolean(polygons, site, "and", precision=1e-6)
+                    blocked = blocked or sum(p.area() for p in overlap) > 1e-9
+                assert blocked != ((i, j) in placed)
+
+    chip = gdstk.Cell("DENSE")
+    chip.add(gdstk.rectangle((0, 0), (10, 10), layer=2))
+    square = gdstk.rectangle((0, 0), (1, 1), layer=2)
+    fill = chip.fill(square, 2, window=((0, 0), (20, 10)), density=0.2, tile_size=10)
+    assert all(isinstance(polygon, gdstk.Polygon) for polygon in fill)
+    chip.add(*fill)
+    density = chip.density_map(10, window=((0, 0), (20, 10)))[(2, 0)]
+    assert density[0, 0] == 1
+    assert 0.2 <= density[0, 1] <= 0.25
+
+
+def test_extract_nets():
+    unit = gdstk.Cell("UNIT")
+    unit.add(
+        gdstk.rectangle((0, 0), (10, 1), layer=1),
+        gdstk.rectangle((9, 0), (10, 1), layer=2),
+        gdstk.rectangle((9, 0), (10, 10), layer=3),
+        gdstk.FlexPath([(0, 5), (5, 5)], 1, layer=3),
+        gdstk.Label("VDD", (0.5, 0.5), layer=1),
+        gdstk.Label("OUT", (1, 5), layer=3, texttype=1),
+    )
+    top = gdstk.Cell("TOP")
+    top.add(gdstk.Reference(unit, rotation=numpy.pi / 2, columns=3, rows=1, spacing=(20, 0)))
+    # Bridge between the first two instances
+    top.add(gdstk.rectangle((-0.8, 5), (-0.2, 25), layer=1))
+    vias = {(2, 0): ((1, 0), (3, 0))}
+
+    nets = top.extract_nets([(1, 0), (3, 0)], vias=vias)
+    assert sorted(len(polygons) for _, polygons in nets) == [1, 1, 1, 3, 7]
+    assert sorted(names for names, _ in nets) == [[], [], [], ["VDD"], ["VDD"]]
+    assert all(isinstance(p, gdstk.Polygon) for _, polygons in nets for p in polygons)
+
+    nets = top.extract_nets([(1, 0), (3, 0)], vias=vias, labels={(3, 1): (3, 0)})
+    assert sorted(names for names, _ in nets) == [[], [], ["OUT"], ["OUT"], ["OUT"]]
+
+    nets = top.extract_nets([(1, 0), (3, 0)], window=((-15, 0), (-5, 10)))
+    assert sorted(len(polygons) for _, polygons in nets) == [1, 1]
+
+
+def test_check_rules():
+    unit = gdstk.Cell("UNIT")
+    unit.add(
+        gdstk.rectangle((0, 0), (0.5, 5)),
+        gdstk.rectangle((1, 0), (3, 5)),
+        gdstk.rectangle((0, 0), (4, 6), layer=1),
+        gdstk.rectangle((0.3, 1), (2.5, 4), layer=2),
+    )
+    top = gdstk.Cell("TOP")
+    top.add(gdstk.Reference(unit, columns=3, rows=1, spacing=(10, 0)))
+    # Too close to the last instance
+    top.add(gdstk.rectangle((23.5, 0), (25, 1)))
+    rules = [
+        ("width", (0, 0), 1),
+        ("spacing", (0, 0), 1),
+        ("enclosure", (1, 0), (2, 0), 0.5),
+        ("area", (2, 0), 7),
+    ]
+
+    markers = top.check_rules(rules)
+    assert [len(m) for m in markers] == [3, 4, 3, 3]
+    assert all(m.layer == r[1][0] for r, ms in zip(rules, markers) for m in ms)
+    assert sorted(m.area() for m in markers[0]) == pytest.approx([2.5, 2.5, 2.5])
+
+    flat = top.copy("FLAT").flatten()
+    flat_markers = flat.check_rules(rules)
+    assert [len(m) for m in flat_markers] == [len(m) for m in markers]
+    for ms1, ms2 in zip(markers, flat_markers):
+        assert sum(m.area() for m in ms1) == pytest.approx(sum(m.area() for m in ms2))
+
+    # Magnified instances are checked at their final scale
+    thin = gdstk.Cell("THIN")
+    thin.add(gdstk.rectangle((0, 0), (1, 10)))
+    magnified = gdstk.Cell("MAGNIFIED")
+    magnified.add(gdstk.Reference(thin, magnification=2))
+    rules = [("width", (0, 0), 1.5), ("area", (0, 0), 15)]
+    assert [len(m) for m in magnified.check_rules(rules)] == [0, 0]
+    assert [len(m) for m in thin.check_rules(rules)] == [1, 1]
+
+    with pytest.raises(TypeError):
+        top.check_rules([("length", (0, 0), 1)])
+    with pytest.raises(ValueError):
+        top.check_rules([("width", (0, 0), -1)])
+
+
+def test_diff():
+    unit1 = gdstk.Cell("UNIT")
+    unit1.add(gdstk.rectangle((0, 0), (1, 1)), gdstk.rectangle((0, 0), (1, 1), layer=1))
+    same1 = gdstk.Cell("SAME")
+    same1.add(gdstk.regular_polygon((0, 0), 1, 6), gdstk.Label("A", (0, 0)))
+    top1 = gdstk.Cell("TOP")
+    top1.add(
+        gdstk.Reference(unit1, columns=8, rows=8, spacing=(2, 2)),
+        gdstk.Reference(same1, (-5, 0)),
+        gdstk.Reference(same1, (-5, 5)),
+        gdstk.rectangle((20, 0), (22, 2), layer=2),
+    )
+
+    unit2 = gdstk.Cell("UNIT")
+    unit2.add(gdstk.rectangle((0, 0), (1, 1), layer=1), gdstk.rectangle((0, 0), (1, 2)))
+    same2 = gdstk.Cell("OTHER")
+    same2.add(gdstk.Label("A", (0, 0)), gdstk.regular_polygon((0, 0), 1, 6))
+    top2 = gdstk.Cell("TOP")
+    top2.add(
+        gdstk.rectangle((20, 0), (22, 2), layer=2),
+        gdstk.Reference(same2, (-5, 5)),
+        gdstk.Reference(unit2, columns=8, rows=8, spacing=(2, 2)),
+        gdstk.Reference(same2, (-5, -5)),
+    )
+
+    assert top1.diff(top1) == []
+
+    for tile_size in (None, 0.3):
+        diffs = top1.diff(top2, tile_size=tile_size)
+        assert [(c1.name, c2.name) for c1, c2, _ in diffs] == [("TOP", "TOP"), ("UNIT", "UNIT")]
+        assert list(diffs[0][2].keys()) == [(0, 0)]
+        assert sum(p.area() for p in diffs[0][2][(0, 0)]) == pytest.approx(
+            2 * gdstk.regular_polygon((0, 0), 1, 6).area(), abs=1e-2
+        )
+        assert list(diffs[1][2].keys()) == [(0, 0)]
+        assert sum(p.area() for p in diffs[1][2][(0, 0)]) == pytest.approx(1)
+
+
+def test_content_hash():
+    cell1 = gdstk.Cell("A")
+    cell1.add(
+        gdstk.rectangle((0, 0), (1, 1)),
+        gdstk.FlexPath([(0, 0), (3, 0)], 0.2, layer=1),
+        gdstk.Label("A", (0, 0)),
+    )
+    cell2 = gdstk.Cell("B")
+    cell2.add(
+        gdstk.Label("A", (2, 0)),
+        gdstk.FlexPath([(2, 0), (5, 0)], 0.2, layer=1),
+        gdstk.Polygon([(3, 1), (2, 1), (2, 0), (3, 0)]),
+    )
+    assert cell1.content_hash() != cell2.content_hash()
+    assert cell1.content_hash(translation_invariant=True) == cell2.content_hash(
+        translation_invariant=True
+    )
+    cell3 = cell2.copy("C", (-2, 0))
+    assert cell1.content_hash() == cell3.content_hash()
+    cell3.labels[0].text = "B"
+    assert cell1.content_hash() != cell3.content_hash()
+
+
+def test_group_repetitions():
+    def boxes(cell):
+        return sorted(
+            tuple(numpy.round(p.bounding_box(), 6).flatten()) + (p.layer,)
+            for p in cell.get_polygons()
+        )
+
+    unit = gdstk.Cell("UNIT")
+    unit.add(gdstk.rectangle((0, 0), (1, 1)))
+    cell = gdstk.Cell("CELL")
+    for i in range(4):
+        for j in range(3):
+            cell.add(gdstk.Reference(unit, (2 * i, 3 * j)))
+    for i in range(3):
+        for j in range(2):
+            cell.add(gdstk.Reference(unit, (i * 3 + j, 20 + j * 2 + i), rotation=numpy.pi / 2))
+    for x in (0, 1, 5, 6.5):
+        cell.add(gdstk.rectangle((x, -10), (x + 0.5, -9), layer=1))
+    cell.add(gdstk.rectangle((10, 10), (11, 12), layer=2))
+    expected = boxes(cell)
+
+    assert cell.group_repetitions() is cell
+    assert len(cell.references) == 2
+    ref0, ref1 = sorted(cell.references, key=lambda r: r.rotation)
+    assert (ref0.repetition.columns, ref0.repetition.rows) == (4, 3)
+    assert ref0.repetition.spacing == (2, 3)
+    assert ref1.repetition.columns * ref1.repetition.rows == 6
+    assert ref1.repetition.v1 is not None
+    assert len(cell.polygons) == 2
+    explicit = [p for p in cell.polygons if p.layer == 1][0]
+    assert explicit.repetition.x_offsets is not None
+    assert len(explicit.repetition.get_offsets()) == 4
+    assert boxes(cell) == expected
+
+
+def test_statistics():
+    unit = gdstk.Cell("UNIT")
+    unit.add(
+        gdstk.rectangle((0, 0), (1, 2), layer=1),
+        gdstk.FlexPath([(0, 0), (3, 0)], 0.5, layer=2),
+        gdstk.Label("A", (0, 0), layer=3),
+    )
+    poly = gdstk.regular_polygon((0, 0), 1, 6, layer=1)
+    poly.repetition = gdstk.Repetition(x_offsets=[5, 7])
+    unit.add(poly)
+    mid = gdstk.Cell("MID")
+    mid.add(
+        gdstk.Reference(unit, columns=3, rows=2, spacing=(10, 10)),
+        gdstk.Reference(unit, (0, -20), rotation=numpy.pi / 3, magnification=2),
+    )
+    top = gdstk.Cell("TOP")
+    top.add(gdstk.Reference(mid, columns=4, rows=1, spacing=(100, 0)), gdstk.Reference(unit))
+
+    stats = top.statistics()
+    assert set(stats) == {top, mid, unit}
+    assert stats[top]["instances"] == 1
+    assert stats[mid]["instances"] == 4
+    assert stats[unit]["instances"] == 4 * 7 + 1
+    assert stats[top]["references"] == 4 + 4 * 7 + 1
+
+    polygons = top.get_polygons()
+    assert stats[top]["polygons"] == len(polygons)
+    assert stats[top]["vertices"] == sum(p.size for p in polygons)
+    assert stats[top]["labels"] == len(top.get_labels())
+    assert stats[top]["area"] == pytest.approx(sum(p.area() for p in polygons))
+    for tag, layer_stats in stats[top]["layers"].items():
+        tagged = [p for p in polygons if (p.layer, p.datatype) == tag]
+        assert layer_stats["polygons"] == len(tagged)
+        assert layer_stats["area"] == pytest.approx(sum(p.area() for p in tagged))
+    assert stats[top]["layers"][(3, 0)]["labels"] == 4 * 7 + 1
+
+    stats = top.statistics(include_paths=False)
+    assert (2, 0) not in stats[top]["layers"]
+
+
+def test_filtered_hierarchy():
+    leaf = gdstk.Cell("LEAF")
+    leaf.add(gdstk.rectangle((0, 0), (1, 1)))
+    marked = gdstk.Cell("MARKED")
+    marked.add(gdstk.rectangle((0, 0), (1, 1), layer=5), gdstk.Label("M", (0, 0), layer=6))
+    mid = gdstk.Cell("MID")
+    mid.add(*[gdstk.Reference(leaf, (i, 0)) for i in range(10)])
+    mid.add(gdstk.Reference(marked, (0, 5), columns=2, rows=1, spacing=(3, 0)))
+    top = gdstk.Cell("TOP")
+    top.add(gdstk.Reference(mid), gdstk.Reference(leaf, (-5, 0)))
+
+    assert len(top.get_polygons(layer=5, datatype=0)) == 2
+    assert len(top.get_polygons(layer=0, datatype=0)) == 11
+    assert len(top.get_polygons(layer=6, datatype=0)) == 0
+    assert len(top.get_labels(layer=6, texttype=0)) == 2
+    assert len(top.get_labels(layer=5, texttype=0)) == 0
+    assert len(top.get_polygons(layer=5, datatype=0, depth=1)) == 0
+
+    leaf.add(gdstk.FlexPath([(0, 0), (1, 0)], 0.1, layer=5))
+    assert len(top.get_polygons(layer=5, datatype=0)) == 13
+    assert len(top.get_paths(layer=5, datatype=0)) == 11
+    assert len(top.get_polygons(layer=5, datatype=0, include_paths=False)) == 2
+
+
+def test_multi_tag_extraction():
+    leaf = gdstk.Cell("LEAF")
+    leaf.add(
+        gdstk.rectangle((0, 0), (1, 1)),
+        gdstk.rectangle((0, 0), (2, 1), layer=1),
+        gdstk.FlexPath([(0, 0), (1, 0)], [0.1, 0.1], 0.5, layer=[1, 2]),
+        gdstk.Label("L", (0, 0), layer=3),
+    )
+    other = gdstk.Cell("OTHER")
+    other.add(gdstk.rectangle((0, 0), (1, 1), layer=4))
+    top = gdstk.Cell("TOP")
+    top.add(
+        gdstk.Reference(leaf, columns=3, rows=2, spacing=(5, 5)),
+        gdstk.Reference(other, (20, 0), rotation=numpy.pi / 2),
+        gdstk.rectangle((-1, -1), (0, 0), layer=2),
+    )
+
+    tags = [(0, 0), (1, 0), (2, 0), (4, 0), (7, 0)]
+    result = top.get_polygons(tags=tags)
+    assert set(result.keys()) == set(tags)
+    for layer, datatype in tags:
+        single = top.get_polygons(layer=layer, datatype=datatype)
+        multi = result[(layer, datatype)]
+        assert len(multi) == len(single)
+        areas = sorted(p.area() for p in single)
+        assert sorted(p.area() for p in multi) == pytest.approx(areas)
+        assert all(p.layer == layer for p in multi)
+    assert len(result[(7, 0)]) == 0
+
+    paths = top.get_paths(tags=[(1, 0), (2, 0)])
+    assert len(paths[(1, 0)]) == 6
+    assert len(paths[(2, 0)]) == 6
+    assert all(p.layers == (2,) for p in paths[(2, 0)])
+
+    labels = top.get_labels(tags=[(3, 0)], depth=0)
+    assert labels == {(3, 0): []}
+    labels = top.get_labels(tags=[(3, 0)])
+    assert len(labels[(3, 0)]) == 6
+
+    ref_result = top.references[1].get_polygons(tags=[(4, 0)])
+    assert len(ref_result[(4, 0)]) == 1
+    expected = top.get_polygons(layer=4, datatype=0)[0].bounding_box()
+    assert ref_result[(4, 0)][0].bounding_box() == expected
+
+    with pytest.raises(ValueError):
+        top.get_polygons(layer=1, datatype=0, tags=[(1, 0)])
+    with pytest.raises(TypeError):
+        top.get_polygons(tags=[1])
+
+
+def test_tag_buckets():
+    def contents(cell):
+        polygons = sorted(
+            (p.layer, p.datatype, tuple(p.points.flatten())) for p in cell.get_polygons(depth=0)
+        )
+        labels = sorted((lbl.layer, lbl.texttype, lbl.text) for lbl in cell.labels)
+        return polygons, labels
+
+    cell = gdstk.Cell("BUCKETS")
+    for i in range(30):
+        cell.add(gdstk.rectangle((i, 0), (i + 1, 1), layer=i % 4, datatype=i % 2))
+        cell.add(gdstk.Label(str(i), (i, 0), layer=i % 3))
+    cell.add(gdstk.FlexPath([(0, 0), (5, 0)], 0.5, layer=1))
+    cell.add(gdstk.FlexPath([(0, 2), (5, 2)], [0.2, 0.2], 0.5, layer=[1, 2]))
+    cell.add(gdstk.RobustPath((0, 4), 0.5, layer=3).segment((5, 4)))
+    flat = contents(cell)
+    tags = cell.get_polygons(tags=[(1, 0), (1, 1), (2, 0), (3, 1), (9, 9)])
+
+    assert not cell.tag_buckets
+    cell.tag_buckets = True
+    assert cell.tag_buckets
+    assert contents(cell) == flat
+    # Polygons with the same tag are contiguous
+    keys = [(p.layer, p.datatype) for p in cell.polygons]
+    runs = [k for i, k in enumerate(keys) if i == 0 or keys[i - 1] != k]
+    assert len(runs) == len(set(keys))
+    for layer in range(4):
+        for datatype in range(2):
+            assert len(cell.get_polygons(layer=layer, datatype=datatype)) == sum(
+                1 for p in flat[0] if p[0] == layer and p[1] == datatype
+            )
+    assert len(cell.get_paths(layer=1, datatype=0)) == 2
+    assert len(cell.get_paths(layer=2, datatype=0)) == 1
+    assert len(cell.get_labels(layer=2, texttype=0)) == 10
+    bucketed = cell.get_polygons(tags=[(1, 0), (1, 1), (2, 0), (3, 1), (9, 9)])
+    assert {k: len(v) for k, v in bucketed.items()} == {k: len(v) for k, v in tags.items()}
+
+    # Additions and removals are detected
+    cell.add(gdstk.rectangle((0, 0), (1, 1), layer=7))
+    assert len(cell.get_polygons(layer=7, datatype=0)) == 1
+    cell.remove(*cell.get_polygons(layer=7, datatype=0, depth=0))
+    cell.remove(*[p for p in cell.polygons if p.layer == 7])
+    assert len(cell.get_polygons(layer=7, datatype=0)) == 0
+
+    # Removal followed by an addition keeps the array size
+    small = gdstk.Cell("SMALL")
+    a, b, c = (gdstk.rectangle((i, 0), (i + 1, 1), layer=i + 1) for i in range(3))
+    small.add(a, b, c)
+    small.tag_buckets = True
+    small.remove(a)
+    small.add(gdstk.rectangle((0, 2), (1, 3), layer=2))
+    assert len(small.get_polygons(layer=2, datatype=0)) == 2
+    assert len(small.get_polygons(layer=3, datatype=0)) == 1
+    # In-place tag changes
+    b.layer = 7
+    assert len(small.get_polygons(layer=7, datatype=0)) == 1
+    assert len(small.get_polygons(layer=2, datatype=0)) == 1
+
+    plain = cell.copy("PLAIN")
+    assert not plain.tag_buckets
+    remapping = {(0, 0): (5, 0), (1, 1): (0, 0), (2, 0): (1, 0)}
+    cell.remap(remapping)
+    plain.remap(remapping)
+    assert contents(cell) == contents(plain)
+    assert len(cell.get_polygons(layer=5, datatype=0)) == 8
+    assert len(cell.get_polygons(layer=0, datatype=0)) == 8
+    assert len(cell.get_paths(layer=1, datatype=0)) == len(plain.get_paths(layer=1, datatype=0))
+    lib1 = gdstk.Library()
+    lib1.add(cell)
+    lib2 = gdstk.Library()
+    lib2.add(plain)
+    assert lib1.layers_and_datatypes() == lib2.layers_and_datatypes()
+    assert lib1.layers_and_texttypes() == lib2.layers_and_texttypes()
+
+    cell.tag_buckets = False
+    assert not cell.tag_buckets
+    assert len(cell.get_polygons(layer=5, datatype=0)) == 8
@@ -7,6 +7,7 @@
 
 import hashlib
 import pathlib
+from copy import deepcopy
 from datetime import datetime
 from typing import Callable, Union
 
@@ -14,6 +15,8 @@ import numpy
 import pytest
 
 import gdstk
+import gdstk.convert
+from conftest import assert_same_shape
 
 
 @pytest.fixture
@@ -368,6 +371,107 @@ def test_rw_oas(tmpdir, sample_library):
     assert c.references[0].repetition.v2 == (0.0, 8.0)
 
 
+@pytest.mark.parametrize("compression_level", (0, 6))
+def test_gds_to_oas(tmpdir, sample_library, compression_level):
+    gds_name = str(tmpdir.join("test.gds"))
+    oas_name = str(tmpdir.join("test.oas"))
+    sample_library.write_gds(gds_name)
+    gdstk.gds_to_oas(
+        gds_name,
+        oas_name,
+        compression_level=compression_level,
+        cell_offsets=True,
+        validation="crc32",
+    )
+    assert gdstk.oas_validate(oas_name)[0]
+    gds = gdstk.read_gds(gds_name)
+    oas = gdstk.read_oas(oas_name, unit=gds.unit)
+    assert abs(oas.precision - gds.precision) < 1e-20
+    oas_cells = {c.name: c for c in oas.cells}
+    assert set(oas_cells) == {c.name for c in gds.cells}
+    for cell in gds.cells:
+        other = oas_cells[cell.name]
+        assert len(other.references) == len(cell.references)
+        for r0, r1 in zip(cell.references, other.references):
+            assert r1.cell.name == r0.cell.name
+        assert len(other.labels) == len(cell.labels)
+        assert_same_shape(cell.get_polygons(), other.get_polygons())
+
+    oas_name = str(tmpdir.join("cli.oas"))
+    assert gdstk.convert.main([gds_name, oas_name]) == 0
+    assert {c.name for c in gdstk.read_oas(oas_name).cells} == set(oas_cells)
+
+
+@pytest.mark.parametrize("compression_level", (0, 6))
+def test_oas_to_gds(tmpdir, sample_library, compression_level):
+    c5 = gdstk.Cell("gl_rw_gds_5")
+    c5.add(gdstk.regular_polygon((0, 0), 1, 5))
+    c5.polygons[0].repetition = gdstk.Repetition(x_offsets=(0, 3, 7))
+    c5.add(gdstk.Reference(sample_library["gl_rw_gds_1"]))
+    c5.references[0].repetition = gdstk.Repetition(offsets=((2, 1), (5, 5)))
+    sample_library.add(c5)
+    oas_name = str(tmpdir.join("test.oas"))
+    gds_name = str(tmpdir.join("test.gds"))
+    sample_library.write_oas(
+        oas_name, compression_level=compression_level, circle_tolerance=1e-3
+    )
+    gdstk.oas_to_gds(oas_name, gds_name, unit=sample_library.unit, max_points=20)
+    expected = gdstk.read_oas(oas_name, unit=sample_library.unit)
+    gds = gdstk.read_gds(gds_name)
+    assert abs(gds.unit - expected.unit) < 1e-20
+    assert abs(gds.precision - expected.precision) < 1e-20
+    gds_cells = {c.name: c for c in gds.cells}
+    assert set(gds_cells) == {c.name for c in expected.cells}
+    for cell in expected.cells:
+        other = gds_cells[cell.name]
+        assert all(len(p.points) <= 20 for p in other.polygons)
+        assert len(other.labels) == len(cell.labels)
+        assert_same_shape(cell.get_polygons(), other.get_polygons())
+    assert len(gds_cells["gl_rw_gds_4"].references) == 1
+    assert gds_cells["gl_rw_gds_4"].references[0].repetition.columns == 2
+    assert len(gds_cells["gl_rw_gds_5"].references) == 3
+
+    gds_name = str(tmpdir.join("cli.gds"))
+    assert gdstk.convert.main([oas_name, gds_name, "--max-points", "20"]) == 0
+    assert {c.name for c in gdstk.read_gds(gds_name).cells} == set(gds_cells)
+
+
+def test_gds_transform(tmpdir, sample_library):
+    infile = str(tmpdir.join("in.gds"))
+    outfile = str(tmpdir.join("out.gds"))
+    sample_library.write_gds(infile)
+    gdstk.gds_transform(
+        infile,
+        outfile,
+        filter={(2, 4), (5, 6)},
+        layer_type_map={(2, 4): (7, 8), (5, 6): (9, 10)},
+        rename={"gl_rw_gds_1": "renamed"},
+        unit=1e-6,
+        precision=5e-9,
+    )
+    lib = gdstk.read_gds(outfile)
+    assert lib.unit == pytest.approx(1e-6)
+    assert lib.precision == pytest.approx(5e-9)
+    cells = {c.name: c for c in lib.cells}
+    assert set(cells) == {"renamed", "gl_rw_gds_2", "gl_rw_gds_3", "gl_rw_gds_4"}
+    assert len(cells["gl_rw_gds_2"].polygons) == 0
+    assert cells["gl_rw_gds_3"].references[0].cell is cells["renamed"]
+    polygon = cells["renamed"].polygons[0]
+    assert (polygon.layer, polygon.datatype) == (7, 8)
+    label = cells["renamed"].labels[0]
+    assert (label.layer, label.texttype) == (9, 10)
+    # Geometry is the same in physical units
+    expected = sample_library["gl_rw_gds_1"].polygons[0].scale(sample_library.unit / 1e-6)
+    assert_same_shape(polygon, expected)
+
+    outfile = str(tmpdir.join("cli.gds"))
+    argv = [infile, outfile, "--remap", "2/4:3/3", "--rename", "gl_rw_gds_2:circle"]
+    assert gdstk.convert.main(argv) == 0
+    cells = {c.name: c for c in gdstk.read_gds(outfile).cells}
+    assert "circle" in cells
+    assert cells["gl_rw_gds_1"].polygons[0].layer == 3
+
+
 def test_replace(tree, tmpdir):
     lib, c = tree
     fname = str(tmpdir.join("tree.gds"))
@@ -490,6 +594,209 @@ def test_rename_cell():
     assert c4.references[1].cell is c3
 
 
+def test_rename_cells():
+    c1 = gdstk.Cell("C1")
+    c2 = gdstk.Cell("C2")
+    c3 = gdstk.Cell("C3")
+    c3.add(gdstk.Reference("C1"), gdstk.Reference("C2"), gdstk.Reference(c1))
+    lib = gdstk.Library("TEST")
+    lib.add(c1, c2, c3)
+    lib.rename_cells({"C1": "C2", c2: "C1", "X": "Y"})
+    assert c1.name == "C2"
+    assert c2.name == "C1"
+    assert c3.name == "C3"
+    assert c3.references[0].cell == "C2"
+    assert c3.references[1].cell == "C1"
+    assert c3.references[2].cell is c1
+    with pytest.raises(TypeError):
+        lib.rename_cells({"C1": 1})
+
+
+def test_replace_multiple():
+    lib = gdstk.Library()
+    leaves = [gdstk.Cell(f"LEAF{i}") for i in range(5)]
+    top = gdstk.Cell("TOP")
+    top.add(*[gdstk.Reference(c) for c in leaves], gdstk.Reference("LEAF0"))
+    lib.add(top, *leaves)
+    new_leaves = [gdstk.Cell(f"LEAF{i}") for i in range(3)]
+    raw = gdstk.RawCell("LEAF4")
+    lib.replace(iter(new_leaves), raw, gdstk.Cell("LEAF4"), raw)
+    assert len(lib.cells) == 6
+    assert all(c in lib.cells for c in new_leaves)
+    assert all(c not in lib.cells for c in leaves[:3])
+    assert leaves[3] in lib.cells
+    assert [r.cell for r in top.references[:4]] == new_leaves + [leaves[3]]
+    assert top.references[4].cell is raw
+    assert top.references[5].cell == "LEAF0"
+    with pytest.raises(TypeError):
+        lib.replace(new_leaves[0], 1)
+    assert len(lib.cells) == 6
+
+
+def test_copy():
+    raw = gdstk.RawCell("RAW")
+    lib = gdstk.Library("TEST")
+    lib.set_property("LIB", 1)
+    leaf = lib.new_cell("LEAF")
+    leaf.add(*[gdstk.regular_polygon((i, 0), 0.4, 4, layer=i % 3) for i in range(2000)])
+    leaf.add(gdstk.FlexPath([(0, 0), (1, 0)], 0.1), gdstk.Label("L", (0, 0)))
+    outside = gdstk.Cell("OUTSIDE")
+    top = lib.new_cell("TOP")
+    top.add(gdstk.Reference(leaf), gdstk.Reference(outside), gdstk.Reference(raw))
+    top.add(gdstk.Reference("NAME"))
+    lib.add(raw)
+
+    for result in (lib.copy(), deepcopy(lib)):
+        assert result.name == "TEST"
+        assert result.get_property("LIB") == [1]
+        assert [c.name for c in result.cells] == ["LEAF", "TOP", "RAW"]
+        new_leaf, new_top, new_raw = result.cells
+        assert new_leaf is not leaf and new_top is not top and new_raw is raw
+        assert len(new_leaf.polygons) == 2000
+        assert all(p is not q for p, q in zip(new_leaf.polygons, leaf.polygons))
+        assert_same_shape(new_leaf.polygons, leaf.polygons)
+        assert new_leaf.paths[0] is not leaf.paths[0]
+        assert new_leaf.labels[0].text == "L"
+        refs = new_top.references
+        assert refs[0].cell is new_leaf
+        assert refs[1].cell is outside
+        assert refs[2].cell is raw
+        assert refs[3].cell == "NAME"
+        new_leaf.remove(*new_leaf.polygons)
+        assert len(leaf.polygons) == 2000
+
+    cell = deepcopy(top)
+    assert cell.name == "TOP"
+    assert cell.references[0] is not top.references[0]
+    assert cell.references[0].cell is leaf
+
+    shallow = lib.copy(deep_copy=False)
+    assert shallow.cells[0] is leaf and shallow.cells[1] is top
+    del lib
+    assert top.references[0].cell is leaf
+
+
+def test_rescale_snap():
+    lib = gdstk.Library(unit=1e-6)
+    leaf = lib.new_cell("LEAF")
+    leaf.add(gdstk.rectangle((0, 0), (1, 2), layer=1))
+    leaf.add(gdstk.FlexPath([(0, 0), (3, 0)], 0.5, ends="extended"))
+    leaf.add(gdstk.RobustPath((0, 0), 0.25).segment((2, 0)))
+    top = lib.new_cell("TOP")
+    rep = gdstk.Repetition(offsets=[(1, 1), (2.5, 0)])
+    top.add(gdstk.Reference(leaf, (1, 2), magnification=2, columns=2, rows=1, spacing=(5, 0)))
+    label = gdstk.Label("A", (0.5, 0.5))
+    label.repetition = rep
+    top.add(label)
+    area = leaf.area()
+    bbox = numpy.array(top.bounding_box())
+    spacing = numpy.array(top.references[0].repetition.spacing)
+
+    assert lib.rescale(1e-9) is lib
+    assert lib.unit == 1e-9
+    assert abs(leaf.area() - area * 1e6) < 1e-6
+    numpy.testing.assert_allclose(top.bounding_box(), bbox * 1000)
+    assert top.references[0].magnification == 2
+    numpy.testing.assert_allclose(top.references[0].repetition.spacing, spacing * 1000)
+    numpy.testing.assert_allclose(top.labels[0].repetition.offsets, [(1000, 1000), (2500, 0)])
+    assert abs(leaf.paths[0].widths()[0][0] - 500) < 1e-9
+    assert abs(leaf.paths[1].widths(0)[0] - 250) < 1e-9
+
+    lib.rescale(1e-6)
+    leaf.polygons[0].translate(0.1004, -0.0003)
+    top.labels[0].origin = (0.5, 0.493)
+    moved = lib.snap(0.01)
+    assert moved == {"LEAF": 8, "TOP": 1}
+    numpy.testing.assert_allclose(leaf.polygons[0].points, [(0.1, 0), (1.1, 0), (1.1, 2), (0.1, 2)])
+    numpy.testing.assert_allclose(top.labels[0].origin, (0.5, 0.49))
+    assert lib.snap(0.01) == {}
+
+    lib.remap({(1, 0): (5, 2)})
+    assert leaf.polygons[0].layer == 5 and leaf.polygons[0].datatype == 2
+
+    with pytest.raises(ValueError):
+        lib.snap(0)
+    with pytest.raises(ValueError):
+        lib.rescale(-1)
+
+
+
+def test_rescale_snap_shared():
+    lib = gdstk.Library(unit=1e-6)
+    rect = gdstk.rectangle((0, 0), (1, 1), layer=1)
+    label = gdstk.Label("A", (0.504, 0))
+    cells = [lib.new_cell(f"CELL{i}") for i in range(2)]
+    for cell in cells:
+        cell.add(rect, label)
+    cells[1].add(rect)
+
+    lib.rescale(1e-9)
+    numpy.testing.assert_allclose(rect.bounding_box(), ((0, 0), (1000, 1000)))
+    numpy.testing.assert_allclose(label.origin, (504, 0))
+
+    assert lib.snap(10) == {"CELL0": 1, "CELL1": 1}
+    numpy.testing.assert_allclose(label.origin, (500, 0))
+
+    lib.remap({(1, 0): (2, 0), (2, 0): (3, 0)})
+    assert rect.layer == 2
+
+def test_find_labels():
+    lib = gdstk.Library()
+    pin = lib.new_cell("PIN")
+    vdd = gdstk.Label("VDD", (0, 1))
+    pin.add(vdd, gdstk.Label("VSS", (1, 0)))
+    block = lib.new_cell("BLOCK")
+    block.add(gdstk.Reference(pin, (10, 0), x_reflection=True, columns=2, rows=1, spacing=(5, 0)))
+    top = lib.new_cell("TOP")
+    top.add(gdstk.Reference(block, (0, 100), rotation=numpy.pi / 2, magnification=2))
+    top.add(gdstk.Label("VDD", (-1, -1)))
+
+    result = lib.find_labels(top, "VDD")
+    assert len(result) == 3
+    assert all(r[1].text == "VDD" for r in result)
+    positions = sorted(numpy.round(r[2], 9).tolist() for r in result)
+    assert positions == [[-1, -1], [2, 120], [2, 130]]
+    expected = {tuple(numpy.round(lbl.origin, 9)) for lbl in top.get_labels() if lbl.text == "VDD"}
+    assert {tuple(numpy.round(r[2], 9)) for r in result} == expected
+
+    cell, label, position, (origin, rotation, magnification, x_reflection) = [
+        r for r in result if r[0] is pin
+    ][0]
+    assert label is vdd
+    assert abs(rotation - numpy.pi / 2) < 1e-12
+    assert magnification == 2 and x_reflection
+
+    assert len(lib.find_labels(top)) == 5
+    assert lib.find_labels(top, "GND") == []
+    assert len(lib.find_labels(top, region=((0, 110), (10, 125)))) == 2
+    assert len(lib.find_labels(block, "VSS", ((10, -10), (20, 0)))) == 2
+
+    pin.add(gdstk.Label("GND", (0, 0)))
+    assert len(lib.find_labels(top, "GND", ((-1, 115), (1, 135)))) == 2
+    block.references[0].origin = (0, 0)
+    assert lib.find_labels(top, "GND", ((-1, 115), (1, 135)), rebuild=True) == []
+
+    top_vdd = [lbl for lbl in top.labels if lbl.text == "VDD"][0]
+    top.remove(top_vdd)
+    del top_vdd
+    top.add(gdstk.Label("GND", (-1, -1)))
+    result = lib.find_labels(top, "GND", ((-2, -2), (0, 0)))
+    assert len(result) == 1 and result[0][0] is top
+    assert len(lib.find_labels(top, "VDD")) == 2
+
+    vdd.text = "PWR"
+    assert lib.find_labels(top, "VDD") == []
+    assert len(lib.find_labels(top, "PWR")) == 2
+    gnd = result[0][1]
+    gnd.origin = (50, 50)
+    assert lib.find_labels(top, region=((-2, -2), (0, 0))) == []
+    result = lib.find_labels(top, region=((49, 49), (51, 51)))
+    assert len(result) == 1 and result[0][1] is gnd
+
+    with pytest.raises(TypeError):
+        lib.find_labels("TOP")
+
+
 # def test_replace_cell():
 #     c0 = gdstk.Cell("C0")
 #     c1 = gdstk.Cell("C1")
@@ -593,3 +900,100 @@ def test_empty_path_warning(
 
     with pytest.warns(RuntimeWarning, match="Empty path"):
         write_f(lib, tmp_path / "out")
+
+
+def test_spill(tmp_path, sample_library):
+    gdstk.spill_enable(threshold=64, resident_limit=2**20, directory=tmp_path)
+    try:
+        cell = gdstk.Cell("spill")
+        cell.add(gdstk.ellipse((0, 0), 10, tolerance=1e-4))
+        cell.add(
+            gdstk.Reference(sample_library["gl_rw_gds_4"], columns=30, rows=40, spacing=(5, 5))
+        )
+        info = gdstk.spill_info()
+        assert info["threshold"] == 64
+        assert info["block_count"] > 0
+        assert info["resident"] <= info["resident_limit"]
+        polygons = cell.get_polygons()
+        assert len(polygons) == 1 + 30 * 40 * 6
+        area = sum(p.area() for p in polygons)
+        cell.flatten()
+        assert len(cell.polygons) == len(polygons)
+        sample_library.add(cell)
+        fname = tmp_path / "spill.gds"
+        sample_library.write_gds(fname)
+    finally:
+        gdstk.spill_disable()
+    assert gdstk.spill_info()["threshold"] == 0
+    lib = gdstk.read_gds(fname)
+    assert abs(sum(p.area() for p in lib["spill"].polygons) - area) < 1e-3 * area
+
+
+def spill_rss():
+    # Resident size of the spill file mappings
+    rss = 0
+    in_spill = False
+    with open("/proc/self/smaps") as smaps:
+        for line in smaps:
+            fields = line.split()
+            if fields[0].endswith(":"):
+                if in_spill and fields[0] == "Rss:":
+                    rss += int(fields[1]) * 1024
+            else:
+                in_spill = "gdstk-spill-" in line
+    return rss
+
+
+@pytest.mark.skipif(not pathlib.Path("/proc/self/smaps").exists(), reason="Linux only")
+def test_spill_access(tmp_path):
+    limit = 2**22
+    gdstk.spill_enable(threshold=64, resident_limit=limit, directory=tmp_path)
+    try:
+        polygons = [gdstk.ellipse((i, 0), 10, tolerance=1e-6) for i in range(256)]
+        info = gdstk.spill_info()
+        assert info["allocated"] > 4 * limit
+        assert info["resident"] <= limit
+        gdstk.spill_release()
+        assert gdstk.spill_info()["resident"] == 0
+        assert spill_rss() == 0
+        # Reading does not go through the allocator, but still counts towards
+        # the resident limit
+        area = sum(p.area() for p in polygons)
+        assert gdstk.spill_info()["resident"] <= limit
+        assert 0 < spill_rss() <= limit
+        for p in polygons:
+            p.translate(1, 0)
+        assert gdstk.spill_info()["resident"] <= limit
+        assert 0 < spill_rss() <= limit
+        area = sum(p.area() for p in polygons)
+        gdstk.spill_release()
+        assert spill_rss() == 0
+        assert sum(p.area() for p in polygons) == area
+    finally:
+        gdstk.spill_disable()
+
+
+def test_deduplicate():
+    lib = gdstk.Library()
+    unit1 = lib.new_cell("UNIT1")
+    unit1.add(gdstk.rectangle((0, 0), (1, 2)), gdstk.FlexPath([(0, 0), (3, 0)], 0.2))
+    unit2 = lib.new_cell("UNIT2")
+    unit2.add(gdstk.FlexPath([(5, 1), (8, 1)], 0.2), gdstk.rectangle((5, 1), (6, 3)))
+    unit3 = lib.new_cell("UNIT3")
+    unit3.add(gdstk.rectangle((0, 0), (1, 2)), gdstk.FlexPath([(0, 0), (3, 0)], 0.2))
+    top = lib.new_cell("TOP")
+    top.add(
+        gdstk.Reference(unit2, (10, 0), rotation=numpy.pi / 3, magnification=2, x_reflection=True),
+        gdstk.Reference(unit3, (5, 5), columns=2, rows=1, spacing=(4, 0)),
+    )
+    before = sorted(tuple(p.bounding_box()[0]) for p in top.get_polygons())
+
+    assert [c.name for c in lib.deduplicate()] == ["UNIT3"]
+    assert [c.name for c in lib.cells] == ["UNIT1", "UNIT2", "TOP"]
+    assert top.references[1].cell is unit1
+
+    assert [c.name for c in lib.deduplicate(translation_invariant=True)] == ["UNIT2"]
+    assert [c.name for c in lib.cells] == ["UNIT1", "TOP"]
+    assert all(r.cell is unit1 for r in top.references)
+    after = sorted(tuple(p.bounding_box()[0]) for p in top.get_polygons())
+    assert numpy.allclose(before, after)
@@ -181,3 +181,44 @@ def test_transform():
     poly = gdstk.Polygon([0j, 1 + 0j, 1j])
     poly.transform(matrix=[[1, 2, 3], [4, 5, 6], [3, 2, -1]])
     assert_close(poly.points, [[-3, -6], [2, 5], [5, 11]])
+
+
+def test_check_polygons():
+    square = gdstk.rectangle((0, 0), (1, 1))
+    bowtie = gdstk.Polygon([(0, 1), (2, 0), (2, 2), (0, 0)], layer=2)
+    spike = gdstk.Polygon([(0, 0), (2, 0), (3, 0), (1, 0), (1, 1), (1, 1)])
+    # Hole connected to the outer boundary by a zero-width cut
+    outer = [(0, 0), (4, 0), (4, 4), (0, 4), (0, 2)]
+    inner = [(1, 2), (1, 3), (3, 3), (3, 1), (1, 1), (1, 2)]
+    keyhole = gdstk.Polygon(outer + inner + [(0, 2)])
+    assert gdstk.check_polygons([square, bowtie, spike, keyhole, [(0, 0), (1, 1), (2, 2)]]) == [
+        set(),
+        {"self_intersecting"},
+        {"duplicate_point", "spike"},
+        set(),
+        {"degenerate", "spike"},
+    ]
+    assert gdstk.check_polygons(gdstk.Polygon([(0, 0), (0, 1), (1, 0)])) == [{"clockwise"}]
+
+    ref = gdstk.Reference(gdstk.Cell("REF").add(square, bowtie))
+    assert gdstk.check_polygons(ref) == [set(), {"self_intersecting"}]
+    assert gdstk.check_polygons([spike, ref]) == [
+        {"duplicate_point", "spike"},
+        set(),
+        {"self_intersecting"},
+    ]
+
+    cell = gdstk.Cell("CELL")
+    cell.add(square, bowtie, spike)
+    assert cell.check_polygons() == [set(), {"self_intersecting"}, {"duplicate_point", "spike"}]
+    assert len(cell.polygons) == 3
+    assert cell.check_polygons(repair=True) == [
+        set(),
+        {"self_intersecting"},
+        {"duplicate_point", "spike"},
+    ]
+    assert len(cell.polygons) == 4
+    assert cell.polygons[0] is square
+    assert all(p.layer == 2 for p in cell.polygons[1:3])
+    assert cell.check_polygons() == [set()] * 4
+    assert cell.area() == pytest.approx(1 + 5 / 3 + 0.5, abs=1e-3)
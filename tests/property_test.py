@@ -137,3 +137,84 @@ def test_delete_gds_property():
             ["S_GDS_PROPERTY", 102, b"quux\x00"],
             ["S_GDS_PROPERTY", 101, b"baz\x00"],
         ]
+
+
+def test_properties_copy_and_oas(tmp_path):
+    cell = gdstk.Cell("CELL")
+    for i in range(300):
+        rect = gdstk.rectangle((i, 0), (i + 0.5, 1))
+        rect.set_property("NET", f"N{i % 7}")
+        rect.set_gds_property(1, "short")
+        rect.set_gds_property(1, "a longer replacement value")
+        cell.add(rect)
+    copy = cell.copy("COPY")
+    for rect in cell.polygons:
+        rect.delete_property("NET")
+        rect.set_gds_property(1, "x")
+    for i, rect in enumerate(copy.polygons):
+        assert rect.properties == [
+            ["S_GDS_PROPERTY", 1, b"a longer replacement value\x00"],
+            ["NET", f"N{i % 7}".encode()],
+        ]
+
+    lib = gdstk.Library()
+    lib.add(copy)
+    fname = str(tmp_path / "properties.oas")
+    lib.write_oas(fname)
+    read = gdstk.read_oas(fname).cells[0]
+    nets = sorted(rect.get_property("NET")[0] for rect in read.polygons)
+    assert nets == sorted(f"N{i % 7}".encode() for i in range(300))
+
+
+def test_large_property_sets(tmp_path):
+    obj = gdstk.rectangle((0, 0), (1, 1))
+    for i in range(100):
+        obj.set_property(f"P{i}", i)
+    obj.set_gds_property(3, "three")
+    obj.set_property("P10", -10)
+    assert obj.get_property("P10") == [-10]
+    assert obj.get_property("P99") == [99]
+    assert obj.get_property("P100") is None
+    assert obj.get_gds_property(3) == "three"
+
+    obj.delete_property("P10")
+    assert obj.get_property("P10") == [10]
+    obj.delete_property("P10")
+    assert obj.get_property("P10") is None
+    obj.delete_property("P0")
+    assert obj.get_property("P0") is None
+    assert obj.get_property("P1") == [1]
+    obj.delete_gds_property(3)
+    assert obj.get_gds_property(3) is None
+
+    copy = obj.copy()
+    copy.set_property("P1", "one")
+    copy.delete_property("P2")
+    assert copy.get_property("P1") == [b"one"]
+    assert copy.get_property("P2") is None
+    assert obj.get_property("P1") == [1]
+    assert obj.get_property("P2") == [2]
+    assert len(copy.properties) == len(obj.properties)
+    assert copy.properties[1:] == [p for p in obj.properties if p[0] != "P2"]
+
+    # Replacing all properties
+    copy.properties = [[f"Q{i}", i] for i in range(50)]
+    assert copy.get_property("P1") is None
+    assert copy.get_property("Q49") == [49]
+    copy.set_property("Q0", 0.5)
+    assert copy.get_property("Q0") == [0.5]
+
+    cell = gdstk.Cell("CELL")
+    cell.add(obj, copy)
+    lib = gdstk.Library()
+    lib.add(cell)
+    fname = str(tmp_path / "large.oas")
+    lib.write_oas(fname)
+    read = gdstk.read_oas(fname).cells[0]
+    assert sorted(sorted(p.properties) for p in read.polygons) == sorted(
+        sorted(p.properties) for p in (obj, copy)
+    )
+    polygon = [p for p in read.polygons if p.get_property("Q0") is not None][0]
+    polygon.set_property("Q1", "new")
+    assert polygon.get_property("Q1") == [b"new"]
+    assert polygon.get_property("Q2") == [2]
@@ -235,3 +235,38 @@ def test_get_labels(tree):
     assert len(labels) == 0
     labels = r3.get_labels(depth=1, layer=11, texttype=0)
     assert len(labels) == 6
+
+
+@pytest.mark.parametrize(
+    "repetition",
+    [
+        gdstk.Repetition(3, 2, spacing=(2, 3)),
+        gdstk.Repetition(2, 3, v1=(1, 1), v2=(-1, 2)),
+        gdstk.Repetition(offsets=[(1, 2), (-3, 0.5)]),
+        gdstk.Repetition(x_offsets=[1, 4.5]),
+        gdstk.Repetition(y_offsets=[-2, 3]),
+    ],
+)
+def test_repetition_expansion(repetition, tmpdir):
+    cell = gdstk.Cell("CELL")
+    cell.add(gdstk.rectangle((0, 0), (0.5, 0.5)))
+    ref = gdstk.Reference(cell, (1, -1))
+    ref.repetition = repetition
+    expected = repetition.get_offsets() + numpy.array((1, -1))
+    polygons = ref.get_polygons()
+    assert len(polygons) == len(expected)
+    for polygon, offset in zip(polygons, expected):
+        assert_close(polygon.bounding_box()[0], offset)
+
+    top = gdstk.Cell("TOP")
+    top.add(ref)
+    label = gdstk.Label("L", (0, 0))
+    label.repetition = repetition
+    top.add(label)
+    fname = str(tmpdir.join("repetition.gds"))
+    gdstk.Library().add(top, cell).write_gds(fname)
+    read = [c for c in gdstk.read_gds(fname).cells if c.name == "TOP"][0]
+    assert sorted(tuple(p.bounding_box()[0]) for p in read.get_polygons()) == sorted(
+        tuple(p.bounding_box()[0]) for p in polygons
+    )
+    assert len(read.get_labels()) == len(expected)